@@ -0,0 +1,105 @@
+#include "AllocationCounter.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - AllocationCounter.cpp */
+
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+// glibc's own allocator, so malloc can be replaced below while still using it.
+extern "C" void* __libc_malloc(std::size_t aSize);
+extern "C" void* __libc_calloc(std::size_t aCount, std::size_t aSize);
+extern "C" void* __libc_realloc(void* aPointer, std::size_t aSize);
+#endif
+
+namespace
+{
+    // Per thread, so allocations of other threads (like the logger) do not end up in the measurements.
+    thread_local uint64_t gAllocations{0};
+
+    void* CountedMalloc(std::size_t aSize)
+    {
+        gAllocations++;
+#if defined(__GLIBC__)
+        return __libc_malloc(aSize);
+#else
+        return std::malloc(aSize);
+#endif
+    }
+
+    void* Allocate(std::size_t aSize)
+    {
+        // malloc(0) is allowed to return nullptr, operator new is not.
+        void* lReturn{CountedMalloc((aSize > 0) ? aSize : 1)};
+        if (lReturn == nullptr) {
+            throw std::bad_alloc();
+        }
+        return lReturn;
+    }
+}  // namespace
+
+uint64_t AllocationCounter::GetAllocations()
+{
+    return gAllocations;
+}
+
+void* operator new(std::size_t aSize)
+{
+    return Allocate(aSize);
+}
+
+void* operator new[](std::size_t aSize)
+{
+    return Allocate(aSize);
+}
+
+void* operator new(std::size_t aSize, const std::nothrow_t& /*aTag*/) noexcept
+{
+    return CountedMalloc((aSize > 0) ? aSize : 1);
+}
+
+void* operator new[](std::size_t aSize, const std::nothrow_t& /*aTag*/) noexcept
+{
+    return CountedMalloc((aSize > 0) ? aSize : 1);
+}
+
+void operator delete(void* aPointer) noexcept
+{
+    std::free(aPointer);
+}
+
+void operator delete[](void* aPointer) noexcept
+{
+    std::free(aPointer);
+}
+
+void operator delete(void* aPointer, std::size_t /*aSize*/) noexcept
+{
+    std::free(aPointer);
+}
+
+void operator delete[](void* aPointer, std::size_t /*aSize*/) noexcept
+{
+    std::free(aPointer);
+}
+
+#if defined(__GLIBC__)
+// C code, like libpcap and the C++ runtime itself, allocates with malloc directly. Memory from these still gets freed
+// by glibc's free, so that one does not need replacing.
+extern "C" void* malloc(std::size_t aSize)
+{
+    return CountedMalloc(aSize);
+}
+
+extern "C" void* calloc(std::size_t aCount, std::size_t aSize)
+{
+    gAllocations++;
+    return __libc_calloc(aCount, aSize);
+}
+
+extern "C" void* realloc(void* aPointer, std::size_t aSize)
+{
+    gAllocations++;
+    return __libc_realloc(aPointer, aSize);
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - AllocationCounter.h
+ *
+ * This file contains a counter for heap allocations, by replacing the global operator new and, with glibc, malloc,
+ * calloc and realloc. Only link this into test and benchmark executables, never into the program itself.
+ *
+ **/
+
+#include <cstdint>
+
+namespace AllocationCounter
+{
+    /**
+     * Gets the amount of heap allocations done by the calling thread since it started.
+     * @return amount of allocations.
+     */
+    uint64_t GetAllocations();
+}  // namespace AllocationCounter
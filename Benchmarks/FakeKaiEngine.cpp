@@ -0,0 +1,250 @@
+#include "FakeKaiEngine.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - FakeKaiEngine.cpp */
+
+#include <algorithm>
+#include <cstring>
+
+#include "../Includes/LatencyTrace.h"
+#include "../Includes/Logger.h"
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace boost::asio;
+using namespace std::chrono;
+
+void TrafficStatistics::Record(std::size_t aBytes, nanoseconds aNow, nanoseconds aOrigin)
+{
+    mFrames++;
+    mBytes += aBytes;
+    if (mFirst.count() == 0) {
+        mFirst = aNow;
+    }
+    mLast = aNow;
+
+    if (aOrigin.count() != 0) {
+        auto lValue{static_cast<uint64_t>(std::max<int64_t>((aNow - aOrigin).count(), 0))};
+        mLatency.mBuckets.at(HistogramSnapshot::GetBucketIndex(lValue))++;
+        mLatency.mCount++;
+        mLatency.mSum += lValue;
+        mLatency.mMax = std::max(mLatency.mMax, lValue);
+    }
+}
+
+FakeKaiEngine::~FakeKaiEngine()
+{
+    Stop();
+}
+
+bool FakeKaiEngine::Start(unsigned int aPort)
+{
+    bool lReturn{true};
+
+    try {
+        mSocket.open(ip::udp::v4());
+        mSocket.bind(ip::udp::endpoint(ip::address::from_string(cIp.data()), aPort));
+        // A large buffer makes sure frames only get lost on the side of the program.
+        mSocket.set_option(socket_base::receive_buffer_size(cReceiveBufferSize));
+        mSocket.non_blocking(true);
+        mPort    = mSocket.local_endpoint().port();
+        mRunning = true;
+        mThread  = std::thread([&] { Run(); });
+    } catch (const boost::system::system_error& lException) {
+        Logger::GetInstance().Log("Failed to start fake XLink Kai: " + std::string(lException.what()),
+                                  Logger::Level::ERROR);
+        lReturn = false;
+    }
+
+    return lReturn;
+}
+
+void FakeKaiEngine::Stop()
+{
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    if (mSocket.is_open()) {
+        boost::system::error_code lError;
+        mSocket.close(lError);
+    }
+    mConnected = false;
+}
+
+unsigned int FakeKaiEngine::GetPort() const
+{
+    return mPort;
+}
+
+bool FakeKaiEngine::IsConnected() const
+{
+    return mConnected;
+}
+
+void FakeKaiEngine::Blast(std::string_view aFrame, uint64_t aCount, uint64_t aRate, unsigned int aCopies)
+{
+    std::lock_guard<std::mutex> lLock{mBlastMutex};
+
+    mBlastDatagram = std::string(cEthernetDataString) + std::string(aFrame);
+    AddTimestamp(mBlastDatagram, nanoseconds(0));
+    mBlastCount    = aCount;
+    mBlastRate     = aRate;
+    mBlastCopies   = std::max(aCopies, 1U);
+    mBlastSent     = 0;
+    mBlastStart    = nanoseconds(0);
+    mBlastDuration = 0;
+    mBlasting      = (aCount > 0);
+}
+
+bool FakeKaiEngine::IsBlasting() const
+{
+    return mBlasting;
+}
+
+TrafficStatistics FakeKaiEngine::GetReceived()
+{
+    std::lock_guard<std::mutex> lLock{mReceivedMutex};
+    return mReceived;
+}
+
+nanoseconds FakeKaiEngine::GetBlastDuration() const
+{
+    return nanoseconds(mBlastDuration.load());
+}
+
+void FakeKaiEngine::AddTimestamp(std::string& aFrame, nanoseconds aTimestamp)
+{
+    int64_t     lTimestamp{aTimestamp.count()};
+    std::size_t lIndex{aFrame.size()};
+
+    aFrame.resize(aFrame.size() + cTimestampLength);
+    memcpy(aFrame.data() + lIndex, &cTimestampMagic, sizeof(cTimestampMagic));
+    memcpy(aFrame.data() + lIndex + sizeof(cTimestampMagic), &lTimestamp, sizeof(lTimestamp));
+}
+
+nanoseconds FakeKaiEngine::GetTimestamp(std::string_view aFrame)
+{
+    nanoseconds lReturn{0};
+
+    if (aFrame.size() >= cTimestampLength) {
+        std::size_t lIndex{aFrame.size() - cTimestampLength};
+        uint32_t    lMagic{0};
+        memcpy(&lMagic, aFrame.data() + lIndex, sizeof(lMagic));
+
+        if (lMagic == cTimestampMagic) {
+            int64_t lTimestamp{0};
+            memcpy(&lTimestamp, aFrame.data() + lIndex + sizeof(lMagic), sizeof(lTimestamp));
+            lReturn = nanoseconds(lTimestamp);
+        }
+    }
+
+    return lReturn;
+}
+
+void FakeKaiEngine::HandleDatagram(std::string_view aData, const ip::udp::endpoint& aSender)
+{
+    if (aData.substr(0, cEthernetDataString.size()) == cEthernetDataString) {
+        std::string_view lFrame{aData.substr(cEthernetDataString.size())};
+        nanoseconds      lOrigin{GetTimestamp(lFrame)};
+        std::size_t      lSize{(lOrigin.count() != 0) ? lFrame.size() - cTimestampLength : lFrame.size()};
+
+        std::lock_guard<std::mutex> lLock{mReceivedMutex};
+        mReceived.Record(lSize, LatencyTrace::Now(), lOrigin);
+    } else if (aData.substr(0, cConnectFormat.size() + cSeparator.size()) ==
+               std::string(cConnectFormat) + cSeparator.data()) {
+        boost::system::error_code lError;
+        mClient = aSender;
+        mSocket.send_to(buffer(cConnectedString), mClient, 0, lError);
+        mLastKeepAlive = steady_clock::now();
+        mConnected     = !lError;
+        Logger::GetInstance().Log("Fake XLink Kai accepted connection from port " + std::to_string(aSender.port()),
+                                  Logger::Level::INFO);
+    } else if (aData.substr(0, cDisconnectString.size()) == cDisconnectString) {
+        mConnected = false;
+    }
+}
+
+bool FakeKaiEngine::SendBurst()
+{
+    bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mBlastMutex};
+    nanoseconds                 lNow{LatencyTrace::Now()};
+    if (mBlastStart.count() == 0) {
+        mBlastStart = lNow;
+    }
+
+    std::size_t lSourceIndex{cEthernetDataString.size() + Net_8023_Constants::cSourceAddressIndex};
+    std::size_t lTimestampIndex{mBlastDatagram.size() - sizeof(int64_t)};
+
+    for (unsigned int lBurst = 0; (lBurst < cBurstSize) && (mBlastSent < mBlastCount); lBurst++) {
+        // Sending on an absolute schedule keeps the rate right, even if a burst got delayed.
+        if ((mBlastRate > 0) && (lNow < mBlastStart + nanoseconds(mBlastSent * 1000000000 / mBlastRate))) {
+            break;
+        }
+
+        if (mBlastCopies > 1) {
+            auto lCopy{static_cast<uint16_t>(mBlastSent % mBlastCopies)};
+            mBlastDatagram.at(lSourceIndex + 4) = static_cast<char>(lCopy >> 8);
+            mBlastDatagram.at(lSourceIndex + 5) = static_cast<char>(lCopy & 0xff);
+        }
+
+        int64_t lTimestamp{lNow.count()};
+        memcpy(mBlastDatagram.data() + lTimestampIndex, &lTimestamp, sizeof(lTimestamp));
+
+        boost::system::error_code lError;
+        mSocket.send_to(buffer(mBlastDatagram), mClient, 0, lError);
+        if (lError) {
+            // Socket buffer is full, try again next round.
+            break;
+        }
+
+        mBlastSent++;
+        lReturn = true;
+        lNow    = LatencyTrace::Now();
+    }
+
+    if (mBlastSent >= mBlastCount) {
+        mBlastDuration = (lNow - mBlastStart).count();
+        mBlasting      = false;
+    }
+
+    return lReturn;
+}
+
+void FakeKaiEngine::Run()
+{
+    while (mRunning) {
+        bool lBusy{false};
+
+        for (unsigned int lBurst = 0; lBurst < cBurstSize; lBurst++) {
+            boost::system::error_code lError;
+            ip::udp::endpoint         lSender;
+            std::size_t               lLength{mSocket.receive_from(buffer(mData), lSender, 0, lError)};
+
+            if (lError) {
+                break;
+            }
+            HandleDatagram(std::string_view(mData.data(), lLength), lSender);
+            lBusy = true;
+        }
+
+        if (mConnected) {
+            if (mBlasting) {
+                lBusy |= SendBurst();
+            }
+
+            // The program drops the connection if it doesn't hear from XLink Kai for a while.
+            if (steady_clock::now() > (mLastKeepAlive + cKeepAliveInterval)) {
+                boost::system::error_code lError;
+                mSocket.send_to(buffer(cKeepAliveString), mClient, 0, lError);
+                mLastKeepAlive = steady_clock::now();
+            }
+        }
+
+        if (!lBusy) {
+            std::this_thread::sleep_for(cIdleSleep);
+        }
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - FakeKaiEngine.h
+ *
+ * This file contains a stand-in for the XLink Kai engine, used to benchmark the program end-to-end on localhost.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include "../Includes/Metrics.h"
+
+namespace FakeKaiEngine_Constants
+{
+    // Marks a frame carrying a timestamp at the end, so latency can be measured without a side channel.
+    static constexpr uint32_t    cTimestampMagic{0x42484c58};
+    static constexpr std::size_t cTimestampLength{sizeof(uint32_t) + sizeof(int64_t)};
+
+    static constexpr std::chrono::seconds      cKeepAliveInterval{5};
+    static constexpr std::chrono::microseconds cIdleSleep{20};
+    static constexpr unsigned int              cBurstSize{64};
+    static constexpr int                       cReceiveBufferSize{8 * 1024 * 1024};
+}  // namespace FakeKaiEngine_Constants
+
+using namespace FakeKaiEngine_Constants;
+
+/**
+ * Frames and bytes seen at one end of the benchmark, with the latency of frames that carried a timestamp.
+ */
+struct TrafficStatistics
+{
+    /**
+     * Adds a frame to the statistics.
+     * @param aBytes - Size of the frame, without timestamp.
+     * @param aNow - Time since epoch the frame arrived.
+     * @param aOrigin - Time since epoch the frame was sent, 0 if the frame did not carry a timestamp.
+     */
+    void Record(std::size_t aBytes, std::chrono::nanoseconds aNow, std::chrono::nanoseconds aOrigin);
+
+    uint64_t                 mFrames{0};
+    uint64_t                 mBytes{0};
+    std::chrono::nanoseconds mFirst{0};
+    std::chrono::nanoseconds mLast{0};
+    HistogramSnapshot        mLatency{};
+};
+
+/**
+ * Pretends to be XLink Kai on localhost: accepts the connection of the program, counts the frames it forwards and
+ * can blast frames back at it. Everything happens on a single thread that owns the socket, like the real engine.
+ */
+class FakeKaiEngine
+{
+public:
+    FakeKaiEngine() = default;
+    ~FakeKaiEngine();
+    FakeKaiEngine(const FakeKaiEngine& aFakeKaiEngine) = delete;
+    FakeKaiEngine& operator=(const FakeKaiEngine& aFakeKaiEngine) = delete;
+
+    /**
+     * Binds to localhost and starts the engine thread.
+     * @param aPort - Port to listen on, 0 to let the operating system pick one.
+     * @return true if successful.
+     */
+    bool Start(unsigned int aPort);
+
+    /**
+     * Stops the engine thread and closes the socket.
+     */
+    void Stop();
+
+    /**
+     * Gets the port the engine listens on.
+     * @return the port, 0 if not started.
+     */
+    [[nodiscard]] unsigned int GetPort() const;
+
+    /**
+     * Checks whether the program has connected.
+     * @return true if a connect has been received and no disconnect after that.
+     */
+    [[nodiscard]] bool IsConnected() const;
+
+    /**
+     * Starts sending a frame to the connected program over and over, returns immediately.
+     * @param aFrame - Ethernet frame to send, a timestamp gets added to every copy.
+     * @param aCount - Amount of frames to send.
+     * @param aRate - Frames per second, 0 to send as fast as possible.
+     * @param aCopies - Amount of source MAC addresses to cycle through, the last bytes are rewritten per copy.
+     */
+    void Blast(std::string_view aFrame, uint64_t aCount, uint64_t aRate, unsigned int aCopies);
+
+    /**
+     * Checks whether a blast started with Blast() is still going.
+     * @return true if there are frames left to send.
+     */
+    [[nodiscard]] bool IsBlasting() const;
+
+    /**
+     * Gets statistics about the frames received from the program.
+     * @return copy of the statistics.
+     */
+    [[nodiscard]] TrafficStatistics GetReceived();
+
+    /**
+     * Gets how long the last blast took, from the first frame until the last frame had been sent.
+     * @return the duration, 0 if nothing has been blasted.
+     */
+    [[nodiscard]] std::chrono::nanoseconds GetBlastDuration() const;
+
+    /**
+     * Appends the current time to a frame, so the receiving end can measure latency.
+     * @param aFrame - Frame to append the timestamp to.
+     * @param aTimestamp - Time since epoch to append.
+     */
+    static void AddTimestamp(std::string& aFrame, std::chrono::nanoseconds aTimestamp);
+
+    /**
+     * Reads the timestamp added by AddTimestamp().
+     * @param aFrame - Frame to read the timestamp from.
+     * @return the time since epoch, 0 if the frame does not carry a timestamp.
+     */
+    static std::chrono::nanoseconds GetTimestamp(std::string_view aFrame);
+
+private:
+    void HandleDatagram(std::string_view aData, const boost::asio::ip::udp::endpoint& aSender);
+    bool SendBurst();
+    void Run();
+
+    unsigned int                          mBlastCopies{1};
+    uint64_t                              mBlastCount{0};
+    std::string                           mBlastDatagram{};
+    std::atomic<int64_t>                  mBlastDuration{0};
+    std::mutex                            mBlastMutex{};
+    uint64_t                              mBlastRate{0};
+    uint64_t                              mBlastSent{0};
+    std::chrono::nanoseconds              mBlastStart{0};
+    std::atomic<bool>                     mBlasting{false};
+    boost::asio::ip::udp::endpoint        mClient{};
+    std::atomic<bool>                     mConnected{false};
+    std::array<char, 65536>               mData{};
+    boost::asio::io_context               mIoContext{};
+    std::chrono::steady_clock::time_point mLastKeepAlive{};
+    unsigned int                          mPort{0};
+    TrafficStatistics                     mReceived{};
+    std::mutex                            mReceivedMutex{};
+    std::atomic<bool>                     mRunning{false};
+    boost::asio::ip::udp::socket          mSocket{mIoContext};
+    std::thread                           mThread{};
+};
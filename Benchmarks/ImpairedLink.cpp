@@ -0,0 +1,223 @@
+#include "ImpairedLink.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - ImpairedLink.cpp */
+
+#include <algorithm>
+
+#include "../Includes/Logger.h"
+#include "../Includes/SystemClock.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace boost::asio;
+using namespace std::chrono;
+
+Impairment::Impairment(const ImpairmentProfile& aProfile, std::shared_ptr<IClock> aClock, uint64_t aSeed) :
+    mClock(std::move(aClock)), mGenerator(aSeed), mProfile(aProfile)
+{
+    mStart = mClock->Now();
+}
+
+void Impairment::Push(std::string_view aData)
+{
+    std::lock_guard<std::mutex>            lLock{mMutex};
+    std::uniform_real_distribution<double> lChance{0, 1};
+    steady_clock::time_point               lNow{mClock->Now()};
+
+    mStatistics.mOffered++;
+    if (InOutage(lNow)) {
+        mStatistics.mOutageDrops++;
+    } else if (lChance(mGenerator) < mProfile.mLoss) {
+        mStatistics.mLost++;
+    } else {
+        unsigned int lCopies{1};
+        if (lChance(mGenerator) < mProfile.mDuplicate) {
+            mStatistics.mDuplicated++;
+            lCopies++;
+        }
+
+        for (unsigned int lCopy = 0; lCopy < lCopies; lCopy++) {
+            steady_clock::time_point lDue{lNow};
+            if (lChance(mGenerator) < mProfile.mReorder) {
+                // Goes out right away, overtaking everything that is still being delayed.
+                mStatistics.mReordered++;
+            } else {
+                std::uniform_int_distribution<int64_t> lJitter{-mProfile.mJitter.count(), mProfile.mJitter.count()};
+                lDue = std::max(lNow, lNow + mProfile.mDelay + microseconds(lJitter(mGenerator)));
+            }
+            Queue(lDue, aData);
+        }
+    }
+}
+
+std::optional<std::string> Impairment::Pop()
+{
+    std::optional<std::string> lReturn{};
+
+    std::lock_guard<std::mutex> lLock{mMutex};
+    if (!mDatagrams.empty() && (mDatagrams.top().mDue <= mClock->Now())) {
+        lReturn = mDatagrams.top().mData;
+        mDatagrams.pop();
+        mStatistics.mDelivered++;
+    }
+
+    return lReturn;
+}
+
+std::optional<steady_clock::time_point> Impairment::GetNextDue() const
+{
+    std::optional<steady_clock::time_point> lReturn{};
+
+    std::lock_guard<std::mutex> lLock{mMutex};
+    if (!mDatagrams.empty()) {
+        lReturn = mDatagrams.top().mDue;
+    }
+
+    return lReturn;
+}
+
+ImpairmentStatistics Impairment::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    return mStatistics;
+}
+
+bool Impairment::InOutage(steady_clock::time_point aNow) const
+{
+    bool lReturn{false};
+
+    if (mProfile.mOutagePeriod.count() > 0) {
+        steady_clock::duration lInPeriod{(aNow - mStart) % mProfile.mOutagePeriod};
+        lReturn = lInPeriod >= (mProfile.mOutagePeriod - mProfile.mOutageLength);
+    }
+
+    return lReturn;
+}
+
+void Impairment::Queue(steady_clock::time_point aDue, std::string_view aData)
+{
+    if (mDatagrams.size() >= mProfile.mLimit) {
+        mStatistics.mLimitDrops++;
+    } else {
+        mDatagrams.push({aDue, mSequence, std::string(aData)});
+        mSequence++;
+        mStatistics.mPeakQueue = std::max(mStatistics.mPeakQueue, mDatagrams.size());
+    }
+}
+
+ImpairedLink::ImpairedLink(const ImpairmentProfile& aProfile, uint64_t aSeed) :
+    mToClient(aProfile, std::make_shared<SystemClock>(), aSeed),
+    mToEngine(aProfile, std::make_shared<SystemClock>(), aSeed + 1)
+{}
+
+ImpairedLink::~ImpairedLink()
+{
+    Stop();
+}
+
+bool ImpairedLink::Start(unsigned int aEnginePort)
+{
+    bool lReturn{true};
+
+    try {
+        mEngine = ip::udp::endpoint(ip::address::from_string(cIp.data()), aEnginePort);
+        mSocket.open(ip::udp::v4());
+        mSocket.bind(ip::udp::endpoint(ip::address::from_string(cIp.data()), 0));
+        mSocket.set_option(socket_base::receive_buffer_size(cLinkReceiveBufferSize));
+        mSocket.non_blocking(true);
+        mPort    = mSocket.local_endpoint().port();
+        mRunning = true;
+        mThread  = std::thread([&] { Run(); });
+    } catch (const boost::system::system_error& lException) {
+        Logger::GetInstance().Log("Failed to start impaired link: " + std::string(lException.what()),
+                                  Logger::Level::ERROR);
+        lReturn = false;
+    }
+
+    return lReturn;
+}
+
+void ImpairedLink::Stop()
+{
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    if (mSocket.is_open()) {
+        boost::system::error_code lError;
+        mSocket.close(lError);
+    }
+}
+
+unsigned int ImpairedLink::GetPort() const
+{
+    return mPort;
+}
+
+ImpairmentStatistics ImpairedLink::GetToEngineStatistics() const
+{
+    return mToEngine.GetStatistics();
+}
+
+ImpairmentStatistics ImpairedLink::GetToClientStatistics() const
+{
+    return mToClient.GetStatistics();
+}
+
+std::optional<ImpairmentProfile> ImpairedLink::GetProfile(std::string_view aName)
+{
+    std::optional<ImpairmentProfile> lReturn{};
+
+    auto lProfile{std::find_if(cImpairmentProfiles.begin(),
+                               cImpairmentProfiles.end(),
+                               [&](const ImpairmentProfile& aProfile) { return aProfile.mName == aName; })};
+    if (lProfile != cImpairmentProfiles.end()) {
+        lReturn = *lProfile;
+    }
+
+    return lReturn;
+}
+
+void ImpairedLink::Flush(Impairment& aImpairment, const ip::udp::endpoint& aTarget)
+{
+    while (std::optional<std::string> lDatagram{aImpairment.Pop()}) {
+        boost::system::error_code lError;
+        mSocket.send_to(buffer(*lDatagram), aTarget, 0, lError);
+    }
+}
+
+void ImpairedLink::Run()
+{
+    while (mRunning) {
+        bool lBusy{false};
+
+        for (unsigned int lBurst = 0; lBurst < cLinkBurstSize; lBurst++) {
+            boost::system::error_code lError;
+            ip::udp::endpoint         lSender;
+            std::size_t               lLength{mSocket.receive_from(buffer(mData), lSender, 0, lError)};
+
+            if (lError) {
+                break;
+            }
+
+            std::string_view lDatagram{mData.data(), lLength};
+            if (lSender == mEngine) {
+                mToClient.Push(lDatagram);
+            } else {
+                // Whoever talks to the link that is not the engine is the program, it gets a new port on reconnects.
+                mClient = lSender;
+                mToEngine.Push(lDatagram);
+            }
+            lBusy = true;
+        }
+
+        Flush(mToEngine, mEngine);
+        if (mClient.port() != 0) {
+            Flush(mToClient, mClient);
+        }
+
+        if (!lBusy) {
+            std::this_thread::sleep_for(cLinkIdleSleep);
+        }
+    }
+}
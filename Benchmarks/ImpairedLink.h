@@ -0,0 +1,216 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - ImpairedLink.h
+ *
+ * This file contains an in-process stand-in for netem, which impairs the link between the program and XLink Kai in
+ * the benchmarks and tests, without needing root.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../Includes/IClock.h"
+
+/**
+ * How a link gets impaired, the fields work like their netem counterparts. Every direction is impaired on its own.
+ */
+struct ImpairmentProfile
+{
+    std::string_view          mName{"none"};    /**< Name to select the profile with. */
+    std::chrono::microseconds mDelay{0};        /**< Delay added to every datagram. */
+    std::chrono::microseconds mJitter{0};       /**< Delay is spread evenly by up to this much either way. */
+    double                    mLoss{0};         /**< Chance a datagram gets lost, 0-1. */
+    double                    mDuplicate{0};    /**< Chance a datagram arrives twice, 0-1. */
+    double                    mReorder{0};      /**< Chance a datagram skips the delay and overtakes others, 0-1. */
+    std::size_t               mLimit{1000};     /**< Datagrams that can be in flight, more get dropped. */
+    std::chrono::seconds      mOutagePeriod{0}; /**< Time between the starts of two outages, 0 for none. */
+    std::chrono::seconds      mOutageLength{0}; /**< Time nothing gets through at the end of every period. */
+};
+
+namespace ImpairedLink_Constants
+{
+    using namespace std::chrono_literals;
+
+    // Uplinks seen at venues, from a decent one to one that keeps dropping out for longer than cKeepAliveTimeout.
+    static constexpr std::array<ImpairmentProfile, 6> cImpairmentProfiles{
+        ImpairmentProfile{"none"},
+        ImpairmentProfile{"dsl", 15ms, 2ms, 0.001, 0, 0, 1000},
+        ImpairmentProfile{"venue", 40ms, 15ms, 0.01, 0.005, 0.01, 1000},
+        ImpairmentProfile{"congested", 120ms, 60ms, 0.05, 0.01, 0.05, 200},
+        ImpairmentProfile{"lossy", 30ms, 10ms, 0.2, 0, 0.02, 1000},
+        ImpairmentProfile{"dropout", 30ms, 5ms, 0.01, 0, 0, 1000, 120s, 70s}};
+
+    static constexpr std::chrono::microseconds cLinkIdleSleep{20};
+    static constexpr unsigned int              cLinkBurstSize{64};
+    static constexpr int                       cLinkReceiveBufferSize{8 * 1024 * 1024};
+}  // namespace ImpairedLink_Constants
+
+using namespace ImpairedLink_Constants;
+
+/**
+ * What happened to the datagrams going one way.
+ */
+struct ImpairmentStatistics
+{
+    uint64_t    mOffered{0};
+    uint64_t    mDelivered{0};
+    uint64_t    mLost{0};
+    uint64_t    mDuplicated{0};
+    uint64_t    mReordered{0};
+    uint64_t    mOutageDrops{0};
+    uint64_t    mLimitDrops{0};
+    std::size_t mPeakQueue{0};
+};
+
+/**
+ * Impairs the datagrams going one way: decides which get lost or duplicated and holds the rest back until they are due.
+ * Runs on an IClock, so it can be driven by a VirtualClock to get the same outcome every run.
+ */
+class Impairment
+{
+public:
+    /**
+     * Sets up the impairment, outages are counted from the time of construction.
+     * @param aProfile - How to impair the datagrams.
+     * @param aClock - Clock to take the time from.
+     * @param aSeed - Seed for the random decisions, the same seed gives the same decisions.
+     */
+    Impairment(const ImpairmentProfile& aProfile, std::shared_ptr<IClock> aClock, uint64_t aSeed);
+
+    /**
+     * Hands a datagram to the link.
+     * @param aData - Datagram.
+     */
+    void Push(std::string_view aData);
+
+    /**
+     * Takes the first datagram that is due out of the link.
+     * @return the datagram, nothing if none are due.
+     */
+    std::optional<std::string> Pop();
+
+    /**
+     * Gets the time the next datagram is due.
+     * @return the time, nothing if the link is empty.
+     */
+    [[nodiscard]] std::optional<std::chrono::steady_clock::time_point> GetNextDue() const;
+
+    /**
+     * Gets what happened to the datagrams so far.
+     * @return copy of the statistics.
+     */
+    [[nodiscard]] ImpairmentStatistics GetStatistics() const;
+
+private:
+    struct Datagram
+    {
+        std::chrono::steady_clock::time_point mDue{};
+        uint64_t                              mSequence{0};
+        std::string                           mData{};
+    };
+
+    struct DatagramOrder
+    {
+        bool operator()(const Datagram& aFirst, const Datagram& aSecond) const
+        {
+            return (aFirst.mDue != aSecond.mDue) ? (aFirst.mDue > aSecond.mDue) :
+                                                   (aFirst.mSequence > aSecond.mSequence);
+        }
+    };
+
+    bool InOutage(std::chrono::steady_clock::time_point aNow) const;
+    void Queue(std::chrono::steady_clock::time_point aDue, std::string_view aData);
+
+    std::shared_ptr<IClock>                                             mClock{nullptr};
+    std::priority_queue<Datagram, std::vector<Datagram>, DatagramOrder> mDatagrams{};
+    std::mt19937_64                                                     mGenerator;
+    mutable std::mutex                                                  mMutex{};
+    ImpairmentProfile                                                   mProfile{};
+    uint64_t                                                            mSequence{0};
+    std::chrono::steady_clock::time_point                               mStart{};
+    ImpairmentStatistics                                                mStatistics{};
+};
+
+/**
+ * Relays datagrams between the program and a (fake) XLink Kai engine on localhost, impairing both directions. The
+ * program connects to the port of the link instead of the one of the engine.
+ */
+class ImpairedLink
+{
+public:
+    /**
+     * Sets up the link.
+     * @param aProfile - How to impair the datagrams, both directions get their own random decisions.
+     * @param aSeed - Seed for the random decisions.
+     */
+    ImpairedLink(const ImpairmentProfile& aProfile, uint64_t aSeed);
+    ~ImpairedLink();
+    ImpairedLink(const ImpairedLink& aImpairedLink) = delete;
+    ImpairedLink& operator=(const ImpairedLink& aImpairedLink) = delete;
+
+    /**
+     * Binds to localhost and starts relaying.
+     * @param aEnginePort - Port the engine listens on.
+     * @return true if successful.
+     */
+    bool Start(unsigned int aEnginePort);
+
+    /**
+     * Stops relaying and closes the socket, datagrams still in flight are lost.
+     */
+    void Stop();
+
+    /**
+     * Gets the port the program should connect to.
+     * @return the port, 0 if not started.
+     */
+    [[nodiscard]] unsigned int GetPort() const;
+
+    /**
+     * Gets what happened to the datagrams going from the program to the engine.
+     * @return copy of the statistics.
+     */
+    [[nodiscard]] ImpairmentStatistics GetToEngineStatistics() const;
+
+    /**
+     * Gets what happened to the datagrams going from the engine to the program.
+     * @return copy of the statistics.
+     */
+    [[nodiscard]] ImpairmentStatistics GetToClientStatistics() const;
+
+    /**
+     * Looks up an impairment profile by name.
+     * @param aName - Name of the profile.
+     * @return the profile, nothing if there is no profile with that name.
+     */
+    static std::optional<ImpairmentProfile> GetProfile(std::string_view aName);
+
+private:
+    void Run();
+    void Flush(Impairment& aImpairment, const boost::asio::ip::udp::endpoint& aTarget);
+
+    boost::asio::ip::udp::endpoint mClient{};
+    std::array<char, 65536>        mData{};
+    boost::asio::ip::udp::endpoint mEngine{};
+    boost::asio::io_context        mIoContext{};
+    unsigned int                   mPort{0};
+    std::atomic<bool>              mRunning{false};
+    boost::asio::ip::udp::socket   mSocket{mIoContext};
+    std::thread                    mThread{};
+    Impairment                     mToClient;
+    Impairment                     mToEngine;
+};
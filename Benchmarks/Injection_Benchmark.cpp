@@ -0,0 +1,190 @@
+/* Copyright (c) 2021 [Rick de Bondt] - Injection_Benchmark.cpp
+ * This file contains benchmarks comparing the ways frames can be injected.
+ *
+ * Injects on a real adapter, by default the dummy adapter xlha0, which drops everything it gets so only the cost of
+ * getting frames to the driver gets measured. Needs root, or CAP_NET_RAW:
+ *   ip link add xlha0 type dummy && ip link set xlha0 up
+ * Another adapter, like one end of a veth pair, can be used with the XLHA_INJECT_INTERFACE environment variable. Every
+ * iteration injects a batch of frames, p50_ns and p99_ns are the time per frame within a batch. The AF_XDP case
+ * attaches an XDP program to the adapter while it runs.
+ **/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <pcap/pcap.h>
+
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/PacketSocket.h"
+#include "../Includes/XdpSocket.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr std::string_view cDefaultInterface{"xlha0"};
+    constexpr std::string_view cInterfaceVariable{"XLHA_INJECT_INTERFACE"};
+    constexpr unsigned int     cPayloadLength{256};
+    constexpr int              cSnapshotLength{65535};
+    constexpr int              cRepetitions{5};
+    constexpr std::size_t      cMaxSamples{1000000};
+    constexpr int64_t          cPacketBackend{static_cast<int64_t>(InjectionBackend::Packet)};
+    constexpr int64_t          cPacketRingBackend{static_cast<int64_t>(InjectionBackend::PacketRing)};
+
+    std::string GetInterface()
+    {
+        const char* lInterface{std::getenv(cInterfaceVariable.data())};
+        return (lInterface != nullptr) ? std::string(lInterface) : std::string(cDefaultInterface);
+    }
+
+    std::string GetSkipReason()
+    {
+        std::string lDefault{cDefaultInterface};
+        return "Could not inject on " + GetInterface() + ", run as root on an adapter that is up, for example: " +
+               "ip link add " + lDefault + " type dummy && ip link set " + lDefault + " up";
+    }
+
+    std::string MakeEthernetFrame()
+    {
+        std::string lReturn(Net_8023_Constants::cHeaderLength + cPayloadLength, '\0');
+        memcpy(lReturn.data() + Net_8023_Constants::cDestinationAddressIndex,
+               &Net_Constants::cBroadcastMac,
+               Net_8023_Constants::cDestinationAddressLength);
+        memcpy(lReturn.data() + Net_8023_Constants::cEtherTypeIndex,
+               &Net_Constants::cPSPEtherType,
+               Net_8023_Constants::cEtherTypeLength);
+        return lReturn;
+    }
+
+    /**
+     * Times every batch, so the spread of the injection latency can be reported next to the average.
+     */
+    class BatchTimer
+    {
+    public:
+        BatchTimer()
+        {
+            mSamples.reserve(cMaxSamples);
+        }
+
+        void Start()
+        {
+            mStart = steady_clock::now();
+        }
+
+        void Stop()
+        {
+            if (mSamples.size() < cMaxSamples) {
+                mSamples.push_back(steady_clock::now() - mStart);
+            }
+        }
+
+        /**
+         * Reports frames, bytes and the per frame percentiles, call after the benchmark loop.
+         * @param aState - State of the benchmark.
+         * @param aFrame - Frame that got injected.
+         */
+        void Report(benchmark::State& aState, std::string_view aFrame)
+        {
+            auto lBatch{aState.range(0)};
+            aState.SetItemsProcessed(aState.iterations() * lBatch);
+            aState.SetBytesProcessed(aState.iterations() * lBatch * static_cast<int64_t>(aFrame.size()));
+
+            if (!mSamples.empty()) {
+                std::sort(mSamples.begin(), mSamples.end());
+                auto lPercentile{[&](double aPercentile) {
+                    auto lIndex{static_cast<std::size_t>(aPercentile * static_cast<double>(mSamples.size() - 1))};
+                    return static_cast<double>(duration_cast<nanoseconds>(mSamples.at(lIndex)).count()) /
+                           static_cast<double>(lBatch);
+                }};
+                aState.counters["p50_ns"] = lPercentile(0.5);
+                aState.counters["p99_ns"] = lPercentile(0.99);
+            }
+        }
+
+    private:
+        std::vector<steady_clock::duration> mSamples{};
+        steady_clock::time_point            mStart{};
+    };
+}  // namespace
+
+static void InjectPCap(benchmark::State& aState)
+{
+    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+    pcap_t* lHandler{pcap_open_live(GetInterface().c_str(), cSnapshotLength, 0, 1, lErrorBuffer.data())};
+    if (lHandler == nullptr) {
+        aState.SkipWithError(GetSkipReason().c_str());
+        return;
+    }
+
+    std::string lFrame{MakeEthernetFrame()};
+    const auto* lData{reinterpret_cast<const unsigned char*>(lFrame.data())};
+    BatchTimer  lTimer{};
+    for (auto lIteration : aState) {
+        lTimer.Start();
+        for (int64_t lCount = 0; lCount < aState.range(0); lCount++) {
+            benchmark::DoNotOptimize(pcap_sendpacket(lHandler, lData, lFrame.size()));
+        }
+        lTimer.Stop();
+    }
+    lTimer.Report(aState, lFrame);
+
+    pcap_close(lHandler);
+}
+BENCHMARK(InjectPCap)->ArgName("batch")->Arg(1)->Arg(16)->Repetitions(cRepetitions)->DisplayAggregatesOnly();
+
+static void InjectPacketSocket(benchmark::State& aState)
+{
+    auto         lBackend{static_cast<InjectionBackend>(aState.range(1))};
+    PacketSocket lSocket{};
+    if (!lSocket.Open(GetInterface(), lBackend == InjectionBackend::PacketRing)) {
+        aState.SkipWithError(GetSkipReason().c_str());
+        return;
+    }
+
+    std::string lFrame{MakeEthernetFrame()};
+    BatchTimer  lTimer{};
+    for (auto lIteration : aState) {
+        lTimer.Start();
+        for (int64_t lCount = 0; lCount < aState.range(0); lCount++) {
+            benchmark::DoNotOptimize(lSocket.Queue(lFrame));
+        }
+        lSocket.Flush();
+        lTimer.Stop();
+    }
+    lTimer.Report(aState, lFrame);
+    aState.SetLabel(cInjectionBackendTexts.at(static_cast<std::size_t>(lBackend)).data());
+}
+BENCHMARK(InjectPacketSocket)
+    ->ArgNames({"batch", "backend"})
+    ->ArgsProduct({{1, 16}, {cPacketBackend, cPacketRingBackend}})
+    ->Repetitions(cRepetitions)
+    ->DisplayAggregatesOnly();
+
+static void InjectXdpSocket(benchmark::State& aState)
+{
+    XdpSocket lSocket{};
+    if (!lSocket.Open(GetInterface())) {
+        aState.SkipWithError(GetSkipReason().c_str());
+        return;
+    }
+
+    std::string lFrame{MakeEthernetFrame()};
+    BatchTimer  lTimer{};
+    for (auto lIteration : aState) {
+        lTimer.Start();
+        for (int64_t lCount = 0; lCount < aState.range(0); lCount++) {
+            benchmark::DoNotOptimize(lSocket.Queue(lFrame));
+        }
+        lSocket.Flush();
+        lTimer.Stop();
+    }
+    lTimer.Report(aState, lFrame);
+}
+BENCHMARK(InjectXdpSocket)->ArgName("batch")->Arg(1)->Arg(16)->Repetitions(cRepetitions)->DisplayAggregatesOnly();
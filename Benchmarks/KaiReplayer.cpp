@@ -0,0 +1,199 @@
+#include "KaiReplayer.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - KaiReplayer.cpp */
+
+#include <algorithm>
+
+#include "../Includes/LatencyTrace.h"
+#include "../Includes/Logger.h"
+#include "../Includes/PcapNgWriter.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace boost::asio;
+using namespace std::chrono;
+
+KaiReplayer::~KaiReplayer()
+{
+    Stop();
+}
+
+bool KaiReplayer::Open(std::string_view aPath)
+{
+    bool lReturn{mCapture.Open(aPath)};
+
+    if (lReturn && (mCapture.GetLinkType() != PcapNgWriter_Constants::cLinkTypeUser0)) {
+        Logger::GetInstance().Log(std::string(aPath) + " is not a recording of XLink Kai traffic",
+                                  Logger::Level::ERROR);
+        mCapture.Close();
+        lReturn = false;
+    }
+
+    return lReturn;
+}
+
+void KaiReplayer::SetTimeAccurate(bool aTimeAccurate)
+{
+    mTimeAccurate = aTimeAccurate;
+}
+
+void KaiReplayer::SetClock(std::shared_ptr<IClock> aClock)
+{
+    mClock = std::move(aClock);
+}
+
+bool KaiReplayer::Start(unsigned int aPort)
+{
+    bool lReturn{mCapture.IsOpen()};
+
+    if (lReturn) {
+        try {
+            mSocket.open(ip::udp::v4());
+            mSocket.bind(ip::udp::endpoint(ip::address::from_string(cIp.data()), aPort));
+            mSocket.non_blocking(true);
+            mPort    = mSocket.local_endpoint().port();
+            mDone    = false;
+            mRunning = true;
+            mThread  = std::thread([&] {
+                if (WaitFor(std::string(cConnectFormat) + cSeparator.data(), steady_clock::duration::max())) {
+                    Logger::GetInstance().Log("XLink Kai replay accepted connection from port " +
+                                                  std::to_string(mClient.port()),
+                                              Logger::Level::INFO);
+                    Replay();
+                }
+            });
+        } catch (const boost::system::system_error& lException) {
+            Logger::GetInstance().Log("Failed to start XLink Kai replay: " + std::string(lException.what()),
+                                      Logger::Level::ERROR);
+            lReturn = false;
+        }
+    } else {
+        Logger::GetInstance().Log("Can't start replaying without an opened recording!", Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+void KaiReplayer::Stop()
+{
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    if (mSocket.is_open()) {
+        boost::system::error_code lError;
+        mSocket.close(lError);
+    }
+}
+
+unsigned int KaiReplayer::GetPort() const
+{
+    return mPort;
+}
+
+bool KaiReplayer::IsDone() const
+{
+    return mDone;
+}
+
+KaiReplayStatistics KaiReplayer::GetStatistics()
+{
+    std::lock_guard<std::mutex> lLock{mStatisticsMutex};
+    return mStatistics;
+}
+
+bool KaiReplayer::WaitFor(std::string_view aPrefix, steady_clock::duration aTimeout)
+{
+    bool lReturn{false};
+    auto lStart{steady_clock::now()};
+
+    while (mRunning && !lReturn && ((steady_clock::now() - lStart) < aTimeout)) {
+        boost::system::error_code lError;
+        std::size_t               lLength{mSocket.receive_from(buffer(mData), mClient, 0, lError)};
+
+        if (lError) {
+            std::this_thread::sleep_for(cReplayIdleSleep);
+        } else {
+            lReturn = std::string_view(mData.data(), lLength).substr(0, aPrefix.size()) == aPrefix;
+        }
+    }
+
+    return lReturn;
+}
+
+void KaiReplayer::Replay()
+{
+    MappedCapture::Cursor lCursor{mCapture.GetCursor()};
+    CapturedPacket        lPacket{};
+    bool                  lNext{lCursor.Next(lPacket)};
+
+    // The program ignores everything until XLink Kai has confirmed the connection, the recorded confirmation is used
+    // when the recording starts with one.
+    if (lNext && (lPacket.mData.substr(0, cConnectedString.size()) == cConnectedString)) {
+        SendDatagram(lPacket.mData);
+        lNext = lCursor.Next(lPacket);
+    } else {
+        SendDatagram(cConnectedString);
+    }
+
+    // Only start once the program answers a keepalive, datagrams sent before it reads the socket could overflow it.
+    bool lReady{false};
+    while (mRunning && !lReady) {
+        SendDatagram(cKeepAliveString);
+        lReady = WaitFor(cKeepAliveString, cReplayReadyRetryInterval);
+    }
+
+    if (lReady) {
+        nanoseconds              lFirstTimestamp{lPacket.mTimestamp};
+        steady_clock::time_point lStart{mClock->Now()};
+        {
+            std::lock_guard<std::mutex> lLock{mStatisticsMutex};
+            mStatistics.mStart = LatencyTrace::Now();
+        }
+
+        while (mRunning && lNext) {
+            if (mTimeAccurate) {
+                nanoseconds              lOffset{lPacket.mTimestamp - lFirstTimestamp};
+                steady_clock::time_point lDeadline{lStart + duration_cast<steady_clock::duration>(lOffset)};
+                steady_clock::time_point lNow{mClock->Now()};
+                while (mRunning && (lNow < lDeadline)) {
+                    mClock->SleepUntil(std::min(lDeadline, lNow + cReplayStopCheckInterval));
+                    lNow = mClock->Now();
+                }
+            }
+
+            SendDatagram(lPacket.mData);
+            lNext = lCursor.Next(lPacket);
+
+            std::lock_guard<std::mutex> lLock{mStatisticsMutex};
+            mStatistics.mDuration = mClock->Now() - lStart;
+        }
+    }
+
+    mDone = true;
+}
+
+void KaiReplayer::SendDatagram(std::string_view aData)
+{
+    boost::system::error_code lError{error::would_block};
+
+    // As fast as possible can outrun the socket buffer, wait for room rather than losing the datagram here.
+    while (mRunning && (lError == error::would_block)) {
+        lError.clear();
+        mSocket.send_to(buffer(aData.data(), aData.size()), mClient, 0, lError);
+        if (lError == error::would_block) {
+            std::this_thread::sleep_for(cReplayIdleSleep);
+        }
+    }
+
+    std::lock_guard<std::mutex> lLock{mStatisticsMutex};
+    if (lError) {
+        mStatistics.mSendFailures++;
+    } else {
+        mStatistics.mDatagrams++;
+        if (aData.substr(0, cEthernetDataString.size()) == cEthernetDataString) {
+            mStatistics.mDataFrames++;
+            mStatistics.mDataBytes += aData.size() - cEthernetDataString.size();
+        }
+    }
+}
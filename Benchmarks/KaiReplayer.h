@@ -0,0 +1,130 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - KaiReplayer.h
+ *
+ * This file contains a stand-in for the XLink Kai engine that replays a session recorded by XLinkKaiConnection.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include "../Includes/IClock.h"
+#include "../Includes/MappedCapture.h"
+#include "../Includes/SystemClock.h"
+
+namespace KaiReplayer_Constants
+{
+    static constexpr std::chrono::microseconds cReplayIdleSleep{20};
+    // Long gaps in the recording are waited out in steps, so stopping does not have to wait for them.
+    static constexpr std::chrono::milliseconds cReplayStopCheckInterval{100};
+    // The keepalive the replay waits on gets sent again if it is not answered in time, it may have been lost.
+    static constexpr std::chrono::seconds      cReplayReadyRetryInterval{2};
+}  // namespace KaiReplayer_Constants
+
+using namespace KaiReplayer_Constants;
+
+/**
+ * What has been replayed so far, the start is in time since epoch.
+ */
+struct KaiReplayStatistics
+{
+    uint64_t                 mDatagrams{0};
+    uint64_t                 mDataFrames{0};
+    uint64_t                 mDataBytes{0};
+    uint64_t                 mSendFailures{0};
+    std::chrono::nanoseconds mStart{0};
+    std::chrono::nanoseconds mDuration{0};
+};
+
+/**
+ * Pretends to be XLink Kai on localhost: waits for the program to connect, then sends it the datagrams of a recording
+ * made with XLinkKaiConnection::StartRecording(), either with the original timing or as fast as possible. The
+ * recording is sent as is, keepalives and (dis)connect messages included. If the recording started after the
+ * connection had been confirmed, a confirmation is sent first. Before the rest of the recording a keepalive is sent,
+ * which the program has to answer first, so nothing gets lost while it is still busy connecting.
+ */
+class KaiReplayer
+{
+public:
+    KaiReplayer() = default;
+    ~KaiReplayer();
+    KaiReplayer(const KaiReplayer& aKaiReplayer) = delete;
+    KaiReplayer& operator=(const KaiReplayer& aKaiReplayer) = delete;
+
+    /**
+     * Opens a recording.
+     * @param aPath - Path of the recording.
+     * @return true if the file could be opened and holds XLink Kai datagrams.
+     */
+    bool Open(std::string_view aPath);
+
+    /**
+     * Sets whether to keep the time between datagrams the same as when they were recorded.
+     * @param aTimeAccurate - True for the original timing, false to send as fast as possible.
+     */
+    void SetTimeAccurate(bool aTimeAccurate);
+
+    /**
+     * Sets the clock the original timing is kept on.
+     * @param aClock - Clock to use.
+     */
+    void SetClock(std::shared_ptr<IClock> aClock);
+
+    /**
+     * Binds to localhost and starts waiting for the program to connect, the replay starts when it does.
+     * @param aPort - Port to listen on, 0 to let the operating system pick one.
+     * @return true if successful.
+     */
+    bool Start(unsigned int aPort);
+
+    /**
+     * Stops the replay and closes the socket.
+     */
+    void Stop();
+
+    /**
+     * Gets the port the replayer listens on.
+     * @return the port, 0 if not started.
+     */
+    [[nodiscard]] unsigned int GetPort() const;
+
+    /**
+     * Checks whether the whole recording has been sent.
+     * @return true if done.
+     */
+    [[nodiscard]] bool IsDone() const;
+
+    /**
+     * Gets what has been replayed so far.
+     * @return copy of the statistics.
+     */
+    [[nodiscard]] KaiReplayStatistics GetStatistics();
+
+private:
+    bool WaitFor(std::string_view aPrefix, std::chrono::steady_clock::duration aTimeout);
+    void Replay();
+    void SendDatagram(std::string_view aData);
+
+    MappedCapture                  mCapture{};
+    std::shared_ptr<IClock>        mClock{std::make_shared<SystemClock>()};
+    boost::asio::ip::udp::endpoint mClient{};
+    std::array<char, 65536>        mData{};
+    std::atomic<bool>              mDone{false};
+    boost::asio::io_context        mIoContext{};
+    unsigned int                   mPort{0};
+    std::atomic<bool>              mRunning{false};
+    boost::asio::ip::udp::socket   mSocket{mIoContext};
+    KaiReplayStatistics            mStatistics{};
+    std::mutex                     mStatisticsMutex{};
+    std::thread                    mThread{};
+    bool                           mTimeAccurate{true};
+};
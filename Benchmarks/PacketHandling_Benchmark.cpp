@@ -0,0 +1,403 @@
+/* Copyright (c) 2021 [Rick de Bondt] - PacketHandling_Benchmark.cpp
+ * This file contains benchmarks for the packet handling hot paths.
+ *
+ * Every iteration handles one frame, so the reported time is the time per frame. Run with
+ * --benchmark_format=json (or --benchmark_out=<file>) to get results that can be compared between changes.
+ **/
+
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <pcap/pcap.h>
+
+#include "../Includes/Handler80211.h"
+#include "../Includes/Handler8023.h"
+#include "../Includes/MappedCapture.h"
+#include "../Includes/NetConversionFunctions.h"
+#include "../Includes/Parameter80211Reader.h"
+#include "../Includes/RadioTapReader.h"
+#include "../Includes/TrafficGenerator.h"
+#include "../Includes/XLinkKaiConnection.h"
+#include "AllocationCounter.h"
+
+namespace
+{
+    constexpr std::string_view cCaptureFile{"../Tests/Input/MonitorHelloWorld.pcapng"};
+    // Session recorded with XLinkKaiConnection::StartRecording(), can be swapped for a real one with this variable.
+    constexpr std::string_view cKaiRecordingFile{"../Tests/Input/KaiSession.pcapng"};
+    constexpr std::string_view cKaiRecordingVariable{"XLHA_KAI_RECORDING"};
+    constexpr std::string_view cSSID{"PSP_AULJM05555_L_Benchmark"};
+    constexpr uint64_t         cBSSID{0x0000b5aa0a02};
+    constexpr uint64_t         cSourceMAC{0x0000aa5a0c00};
+    constexpr uint64_t         cDestinationMAC{0x0000bb5a0c00};
+    constexpr unsigned int     cPayloadLength{256};
+
+    /**
+     * Kinds of frames used as benchmark argument.
+     */
+    enum class FrameKind
+    {
+        Management = 0,
+        Control,
+        Data
+    };
+
+    constexpr std::array<std::string_view, 3> cFrameKindTexts{"management (beacon)", "control (ack)", "data"};
+
+    /**
+     * Reports time and allocations per frame, call after the benchmark loop.
+     * @param aState - State of the benchmark.
+     * @param aAllocationsBefore - Allocations counted before the benchmark loop.
+     * @param aBytesPerFrame - Size of the frames handled.
+     */
+    void ReportPerFrame(benchmark::State& aState, uint64_t aAllocationsBefore, std::size_t aBytesPerFrame)
+    {
+        aState.SetItemsProcessed(aState.iterations());
+        aState.SetBytesProcessed(aState.iterations() * static_cast<int64_t>(aBytesPerFrame));
+        aState.counters["allocs_per_frame"] =
+            benchmark::Counter(static_cast<double>(AllocationCounter::GetAllocations() - aAllocationsBefore),
+                               benchmark::Counter::kAvgIterations);
+    }
+
+    std::string MakeEthernetFrame()
+    {
+        std::string lReturn(Net_8023_Constants::cHeaderLength + cPayloadLength, '\0');
+        memcpy(lReturn.data() + Net_8023_Constants::cDestinationAddressIndex,
+               &cDestinationMAC,
+               Net_8023_Constants::cDestinationAddressLength);
+        memcpy(lReturn.data() + Net_8023_Constants::cSourceAddressIndex,
+               &cSourceMAC,
+               Net_8023_Constants::cSourceAddressLength);
+        memcpy(lReturn.data() + Net_8023_Constants::cEtherTypeIndex,
+               &Net_Constants::cPSPEtherType,
+               Net_8023_Constants::cEtherTypeLength);
+        return lReturn;
+    }
+
+    // Radiotap + 802.11 data frame, made the same way the program makes them.
+    std::string MakeDataFrame()
+    {
+        Handler8023 lHandler{};
+        lHandler.Update(MakeEthernetFrame());
+        return lHandler.ConvertPacket(cBSSID, RadioTapReader::PhysicalDeviceParameters{});
+    }
+
+    std::string MakeAcknowledgementFrame()
+    {
+        return ConstructAcknowledgementFrame(cSourceMAC, RadioTapReader::PhysicalDeviceParameters{});
+    }
+
+    // Radiotap + 802.11 beacon of an ad-hoc network, like the ones a PSP sends.
+    std::string MakeBeaconFrame()
+    {
+        std::string lReturn(RadioTap_Constants::cRadioTapSize, '\0');
+        InsertRadioTapHeader(lReturn.data(), RadioTapReader::PhysicalDeviceParameters{});
+
+        ieee80211_hdr lHeader{};
+        lHeader.frame_control = Net_80211_Constants::cBeaconType;
+        memcpy(&lHeader.addr1[0], &Net_Constants::cBroadcastMac, Net_80211_Constants::cDestinationAddressLength);
+        memcpy(&lHeader.addr2[0], &cSourceMAC, Net_80211_Constants::cSourceAddressLength);
+        memcpy(&lHeader.addr3[0], &cBSSID, Net_80211_Constants::cBSSIDLength);
+        lReturn.append(reinterpret_cast<const char*>(&lHeader), sizeof(lHeader));
+
+        // Timestamp, beacon interval and capabilities (IBSS).
+        lReturn.append(std::string{0, 0, 0, 0, 0, 0, 0, 0, 0x64, 0, 0x02, 0});
+
+        lReturn += static_cast<char>(0);
+        lReturn += static_cast<char>(cSSID.size());
+        lReturn.append(cSSID);
+        lReturn.append(std::string{Net_80211_Constants::cFixedParameterTypeSupportedRates, 4, 0x02, 0x04, 0x0b, 0x16});
+        lReturn.append(std::string{Net_80211_Constants::cFixedParameterTypeDSParameterSet, 1, 1});
+        lReturn.append(std::string{Net_80211_Constants::cFixedParameterTypeIBSS, 2, 0, 0});
+        return lReturn;
+    }
+
+    std::string MakeFrame(FrameKind aKind)
+    {
+        std::string lReturn{};
+        switch (aKind) {
+            case FrameKind::Management:
+                lReturn = MakeBeaconFrame();
+                break;
+            case FrameKind::Control:
+                lReturn = MakeAcknowledgementFrame();
+                break;
+            case FrameKind::Data:
+                lReturn = MakeDataFrame();
+                break;
+        }
+        return lReturn;
+    }
+
+    // All frames from the capture file, read once.
+    const std::vector<std::string>& GetCapturedFrames()
+    {
+        static std::vector<std::string> lFrames{[] {
+            std::vector<std::string>           lReturn{};
+            std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+            pcap_t*                            lHandler{pcap_open_offline(cCaptureFile.data(), lErrorBuffer.data())};
+
+            if (lHandler != nullptr) {
+                pcap_pkthdr*         lHeader{nullptr};
+                const unsigned char* lData{nullptr};
+                while (pcap_next_ex(lHandler, &lHeader, &lData) == 1) {
+                    lReturn.emplace_back(reinterpret_cast<const char*>(lData), lHeader->caplen);
+                }
+                pcap_close(lHandler);
+            }
+            return lReturn;
+        }()};
+
+        return lFrames;
+    }
+
+    // Ethernet frames XLink Kai sent in the recorded session, without e;e;, read once.
+    const std::vector<std::string>& GetRecordedFrames()
+    {
+        static std::vector<std::string> lFrames{[] {
+            std::vector<std::string> lReturn{};
+            const char*              lFileName{std::getenv(cKaiRecordingVariable.data())};
+            MappedCapture            lCapture{};
+
+            if (lCapture.Open((lFileName != nullptr) ? std::string_view(lFileName) : cKaiRecordingFile)) {
+                MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+                CapturedPacket        lPacket{};
+                while (lCursor.Next(lPacket)) {
+                    if (lPacket.mData.substr(0, cEthernetDataString.size()) == cEthernetDataString) {
+                        lReturn.emplace_back(lPacket.mData.substr(cEthernetDataString.size()));
+                    }
+                }
+            }
+            return lReturn;
+        }()};
+
+        return lFrames;
+    }
+
+    void SetUpHandler(Handler80211& aHandler)
+    {
+        std::vector<std::string> lSSIDFilter{std::string(cSSID)};
+        aHandler.SetSSIDFilterList(lSSIDFilter);
+        aHandler.SetBSSID(cBSSID);
+    }
+}  // namespace
+
+static void Handler80211Update(benchmark::State& aState)
+{
+    auto         lKind{static_cast<FrameKind>(aState.range(0))};
+    std::string  lFrame{MakeFrame(lKind)};
+    Handler80211 lHandler{PhysicalDeviceHeaderType::RadioTap};
+    SetUpHandler(lHandler);
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        lHandler.Update(lFrame);
+        benchmark::DoNotOptimize(lHandler.ShouldSend());
+    }
+    ReportPerFrame(aState, lAllocations, lFrame.size());
+    aState.SetLabel(cFrameKindTexts.at(static_cast<std::size_t>(lKind)).data());
+}
+BENCHMARK(Handler80211Update)->ArgName("frame")->DenseRange(0, 2);
+
+static void Handler80211UpdateCaptured(benchmark::State& aState)
+{
+    const std::vector<std::string>& lFrames{GetCapturedFrames()};
+    if (lFrames.empty()) {
+        aState.SkipWithError("Could not read capture file, run from the build directory");
+        return;
+    }
+
+    Handler80211 lHandler{PhysicalDeviceHeaderType::RadioTap};
+    std::size_t  lIndex{0};
+    std::size_t  lBytes{0};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        const std::string& lFrame{lFrames[lIndex]};
+        lHandler.Update(lFrame);
+        benchmark::DoNotOptimize(lHandler.ShouldSend());
+        lBytes += lFrame.size();
+        lIndex = (lIndex + 1) % lFrames.size();
+    }
+    ReportPerFrame(aState, lAllocations, (aState.iterations() > 0) ? lBytes / aState.iterations() : 0);
+}
+BENCHMARK(Handler80211UpdateCaptured);
+
+static void Handler80211UpdateGenerated(benchmark::State& aState)
+{
+    // A busy channel: several ad-hoc networks next to access points with their clients.
+    TrafficMix lMix{};
+    lMix.mPSPNetworks        = 3;
+    lMix.mForeignNetworks    = 5;
+    lMix.mStationsPerNetwork = 4;
+
+    TrafficGenerator            lGenerator{lMix};
+    std::vector<GeneratedFrame> lFrames{lGenerator.Generate(std::chrono::seconds(5))};
+    Handler80211                lHandler{PhysicalDeviceHeaderType::RadioTap};
+    std::vector<std::string>    lSSIDFilter{std::string(lGenerator.GetSSID(0))};
+    lHandler.SetSSIDFilterList(lSSIDFilter);
+
+    std::size_t lIndex{0};
+    std::size_t lBytes{0};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        const std::string& lFrame{lFrames[lIndex].mData};
+        lHandler.Update(lFrame);
+        if (lHandler.ShouldSend()) {
+            benchmark::DoNotOptimize(lHandler.ConvertPacket());
+        }
+        lBytes += lFrame.size();
+        lIndex = (lIndex + 1) % lFrames.size();
+    }
+    ReportPerFrame(aState, lAllocations, (aState.iterations() > 0) ? lBytes / aState.iterations() : 0);
+}
+BENCHMARK(Handler80211UpdateGenerated);
+
+static void Handler80211ConvertPacket(benchmark::State& aState)
+{
+    std::string  lFrame{MakeDataFrame()};
+    Handler80211 lHandler{PhysicalDeviceHeaderType::RadioTap};
+    SetUpHandler(lHandler);
+    lHandler.Update(lFrame);
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        benchmark::DoNotOptimize(lHandler.ConvertPacket());
+    }
+    ReportPerFrame(aState, lAllocations, lFrame.size());
+}
+BENCHMARK(Handler80211ConvertPacket);
+
+static void Handler8023Update(benchmark::State& aState)
+{
+    std::string lFrame{MakeEthernetFrame()};
+    Handler8023 lHandler{};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        lHandler.Update(lFrame);
+        benchmark::DoNotOptimize(lHandler.GetSourceMAC());
+    }
+    ReportPerFrame(aState, lAllocations, lFrame.size());
+}
+BENCHMARK(Handler8023Update);
+
+static void Handler8023ConvertPacket(benchmark::State& aState)
+{
+    std::string                              lFrame{MakeEthernetFrame()};
+    Handler8023                              lHandler{};
+    RadioTapReader::PhysicalDeviceParameters lParameters{};
+    lHandler.Update(lFrame);
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        benchmark::DoNotOptimize(lHandler.ConvertPacket(cBSSID, lParameters));
+    }
+    ReportPerFrame(aState, lAllocations, lFrame.size());
+}
+BENCHMARK(Handler8023ConvertPacket);
+
+static void Handler8023ConvertRecorded(benchmark::State& aState)
+{
+    const std::vector<std::string>& lFrames{GetRecordedFrames()};
+    if (lFrames.empty()) {
+        aState.SkipWithError("Could not read XLink Kai recording, run from the build directory");
+        return;
+    }
+
+    Handler8023                              lHandler{};
+    RadioTapReader::PhysicalDeviceParameters lParameters{};
+    std::size_t                              lIndex{0};
+    std::size_t                              lBytes{0};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        const std::string& lFrame{lFrames[lIndex]};
+        lHandler.Update(lFrame);
+        benchmark::DoNotOptimize(lHandler.ConvertPacket(cBSSID, lParameters));
+        lBytes += lFrame.size();
+        lIndex = (lIndex + 1) % lFrames.size();
+    }
+    ReportPerFrame(aState, lAllocations, (aState.iterations() > 0) ? lBytes / aState.iterations() : 0);
+}
+BENCHMARK(Handler8023ConvertRecorded);
+
+static void RadioTapReaderFillRadioTapParameters(benchmark::State& aState)
+{
+    std::string    lFrame{MakeDataFrame()};
+    RadioTapReader lReader{};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        lReader.FillRadioTapParameters(lFrame);
+        benchmark::DoNotOptimize(lReader.GetLength());
+    }
+    ReportPerFrame(aState, lAllocations, lFrame.size());
+}
+BENCHMARK(RadioTapReaderFillRadioTapParameters);
+
+static void Parameter80211ReaderUpdate(benchmark::State& aState)
+{
+    std::string                     lFrame{MakeBeaconFrame()};
+    std::shared_ptr<RadioTapReader> lRadioTapReader{std::make_shared<RadioTapReader>()};
+    Parameter80211Reader            lReader{lRadioTapReader};
+    lRadioTapReader->FillRadioTapParameters(lFrame);
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        lReader.Update(lFrame);
+        benchmark::DoNotOptimize(lReader.GetSSID());
+    }
+    ReportPerFrame(aState, lAllocations, lFrame.size());
+}
+BENCHMARK(Parameter80211ReaderUpdate);
+
+static void ConstructAcknowledgement(benchmark::State& aState)
+{
+    RadioTapReader::PhysicalDeviceParameters lParameters{};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        benchmark::DoNotOptimize(ConstructAcknowledgementFrame(cSourceMAC, lParameters));
+    }
+    ReportPerFrame(aState, lAllocations, RadioTap_Constants::cRadioTapSize + sizeof(AcknowledgementHeader));
+}
+BENCHMARK(ConstructAcknowledgement);
+
+static void MacToIntConversion(benchmark::State& aState)
+{
+    std::string lMac{"01:23:45:67:AB:CD"};
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        benchmark::DoNotOptimize(MacToInt(lMac));
+    }
+    ReportPerFrame(aState, lAllocations, lMac.size());
+}
+BENCHMARK(MacToIntConversion);
+
+static void IntToMacConversion(benchmark::State& aState)
+{
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        benchmark::DoNotOptimize(IntToMac(cSourceMAC));
+    }
+    ReportPerFrame(aState, lAllocations, sizeof(cSourceMAC));
+}
+BENCHMARK(IntToMacConversion);
+
+static void PrettyHexStringConversion(benchmark::State& aState)
+{
+    std::string lData(static_cast<std::size_t>(aState.range(0)), '\x5a');
+
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (auto lIteration : aState) {
+        benchmark::DoNotOptimize(PrettyHexString(lData));
+    }
+    ReportPerFrame(aState, lAllocations, lData.size());
+}
+BENCHMARK(PrettyHexStringConversion)->ArgName("bytes")->Arg(64)->Arg(512)->Arg(1500);
@@ -0,0 +1,165 @@
+/* Copyright (c) 2021 [Rick de Bondt] - XLHAAnalyze.cpp
+ *
+ * This file contains xlha-analyze, which gathers per network and per station statistics of a monitor mode capture,
+ * to tell a busy channel apart from a bad adapter and to see what the filters would do with the traffic.
+ **/
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../Includes/CaptureAnalyzer.h"
+#include "../Includes/MappedCapture.h"
+#include "../Includes/NetConversionFunctions.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+    std::string ToJson(const FrameStatistics& aStatistics)
+    {
+        std::stringstream lStream{};
+
+        lStream << "{\"frames\": " << aStatistics.mFrames << ", \"bytes\": " << aStatistics.mBytes
+                << ", \"retries\": " << aStatistics.mRetries << ", \"retry_rate\": " << aStatistics.GetRetryRate()
+                << ", \"forwarded\": " << aStatistics.mForwarded << ", \"dropped\": " << aStatistics.mDropped
+                << ", \"interarrival_mean_us\": " << aStatistics.mInterArrival.GetMean() / 1000.0
+                << ", \"interarrival_jitter_us\": " << aStatistics.mInterArrival.GetJitter() / 1000.0
+                << ", \"rates\": {";
+        bool lFirst{true};
+        for (const auto& [lRate, lFrames] : aStatistics.mRates) {
+            lStream << (lFirst ? "" : ", ") << "\"" << RateToText(lRate) << "\": " << lFrames;
+            lFirst = false;
+        }
+        lStream << "}}";
+
+        return lStream.str();
+    }
+
+    std::string ToJson(const CaptureStatistics& aStatistics)
+    {
+        std::stringstream lStream{};
+
+        lStream << "{\"total\": " << ToJson(aStatistics.mTotal);
+        for (const auto& [lName, lMap] :
+             {std::make_pair("bssids", &aStatistics.mBSSIDs), std::make_pair("stations", &aStatistics.mStations)}) {
+            lStream << ",\n \"" << lName << "\": {";
+            bool lFirst{true};
+            for (const auto& [lMAC, lStatistics] : *lMap) {
+                lStream << (lFirst ? "\n  " : ",\n  ") << "\"" << IntToMac(lMAC) << "\": " << ToJson(lStatistics);
+                lFirst = false;
+            }
+            lStream << "}";
+        }
+        lStream << "}" << std::endl;
+
+        return lStream.str();
+    }
+
+    std::string ToCsvRow(std::string_view aScope, std::string_view aAddress, const FrameStatistics& aStatistics)
+    {
+        std::stringstream lStream{};
+
+        lStream << aScope << "," << aAddress << "," << aStatistics.mFrames << "," << aStatistics.mBytes << ","
+                << aStatistics.mRetries << "," << aStatistics.GetRetryRate() << "," << aStatistics.mForwarded << ","
+                << aStatistics.mDropped << "," << aStatistics.mInterArrival.GetMean() / 1000.0 << ","
+                << aStatistics.mInterArrival.GetJitter() / 1000.0 << ",";
+
+        // Rates go in one column, so every row has the same columns.
+        bool lFirst{true};
+        for (const auto& [lRate, lFrames] : aStatistics.mRates) {
+            lStream << (lFirst ? "" : ";") << RateToText(lRate) << "=" << lFrames;
+            lFirst = false;
+        }
+        lStream << std::endl;
+
+        return lStream.str();
+    }
+
+    std::string ToCsv(const CaptureStatistics& aStatistics)
+    {
+        std::stringstream lStream{};
+
+        lStream << "scope,address,frames,bytes,retries,retry_rate,forwarded,dropped,interarrival_mean_us,"
+                   "interarrival_jitter_us,rates"
+                << std::endl;
+        lStream << ToCsvRow("total", "", aStatistics.mTotal);
+        for (const auto& [lBSSID, lStatistics] : aStatistics.mBSSIDs) {
+            lStream << ToCsvRow("bssid", IntToMac(lBSSID), lStatistics);
+        }
+        for (const auto& [lStation, lStatistics] : aStatistics.mStations) {
+            lStream << ToCsvRow("station", IntToMac(lStation), lStatistics);
+        }
+
+        return lStream.str();
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    ConvertOptions           lOptions{};
+    std::string              lInputFileName{};
+    std::string              lOutputFileName{};
+    std::string              lBSSID{};
+    std::vector<std::string> lBlackList{};
+
+    po::options_description lDescription{"xlha-analyze, gathers per network and per station statistics of a capture"};
+    lDescription.add_options()("help,h", "Shows this help")(
+        "input,i", po::value(&lInputFileName), "Radiotap capture to analyze (pcap or pcapng)")(
+        "output,o", po::value(&lOutputFileName), "File to write the statistics to instead of standard output")(
+        "csv", "Write CSV instead of JSON")(
+        "ssid", po::value(&lOptions.mSSIDFilter), "SSID the filters lock onto, can be given more than once")(
+        "blacklist", po::value(&lBlackList), "Source MAC the filters leave out, can be given more than once")(
+        "bssid", po::value(&lBSSID), "BSSID the filters lock onto before the first beacon")(
+        "threads,t", po::value(&lOptions.mThreads)->default_value(0), "Threads to analyze with, 0 uses all cores")(
+        "chunk-size",
+        po::value(&lOptions.mChunkSize)->default_value(cDefaultChunkSize),
+        "Packets analyzed in one go by a thread");
+
+    po::variables_map lVariables{};
+    try {
+        po::store(po::parse_command_line(argc, argv, lDescription), lVariables);
+        po::notify(lVariables);
+    } catch (const po::error& lException) {
+        std::cerr << lException.what() << std::endl << lDescription << std::endl;
+        return 1;
+    }
+
+    if ((lVariables.count("help") > 0) || lInputFileName.empty()) {
+        std::cout << lDescription << std::endl;
+        return (lVariables.count("help") > 0) ? 0 : 1;
+    }
+
+    for (const std::string& lMAC : lBlackList) {
+        lOptions.mBlackList.push_back(MacToInt(lMAC));
+    }
+    if (!lBSSID.empty()) {
+        lOptions.mBSSID = MacToInt(lBSSID);
+    }
+
+    MappedCapture   lInput{};
+    CaptureAnalyzer lAnalyzer{lOptions};
+    if (!lInput.Open(lInputFileName) || !lAnalyzer.Analyze(lInput)) {
+        std::cerr << "Could not analyze the capture" << std::endl;
+        return 1;
+    }
+
+    std::string lOutput{(lVariables.count("csv") > 0) ? ToCsv(lAnalyzer.GetStatistics()) :
+                                                       ToJson(lAnalyzer.GetStatistics())};
+    if (lOutputFileName.empty()) {
+        std::cout << lOutput;
+    } else {
+        std::ofstream lFile{lOutputFileName};
+        lFile << lOutput;
+        if (!lFile) {
+            std::cerr << "Could not write to the output file" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,712 @@
+/* Copyright (c) 2021 [Rick de Bondt] - XLHABench.cpp
+ *
+ * This file contains xlha-bench, which measures the program end-to-end on localhost.
+ *
+ * Forward: frames from a capture are replayed through PCapReader, as fast as possible, into the real
+ * XLinkKaiConnection which sends them to a fake XLink Kai engine. Reverse: the fake engine blasts e;e; frames into
+ * XLinkKaiConnection, which hands them to a sink that can write them to a capture file. Every frame carries a
+ * timestamp at its end, so latency is measured from the moment the frame entered the program until it came out.
+ *
+ * With --impairment the traffic goes through an ImpairedLink, which adds latency, jitter, loss, duplication,
+ * reordering and outages like the uplink of a venue would, to see how keepalives and reconnects hold up.
+ *
+ * With --kai-replay a session recorded by XLinkKaiConnection is played back by a KaiReplayer instead, as fast as
+ * possible or with --kai-replay-timing at the original pace, so the injection path sees real XLink Kai traffic.
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <pcap/pcap.h>
+
+#include "../Includes/IConnector.h"
+#include "../Includes/IPCapDevice.h"
+#include "../Includes/LatencyTrace.h"
+#include "../Includes/Logger.h"
+#include "../Includes/MappedCapture.h"
+#include "../Includes/Metrics.h"
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/PCapReader.h"
+#include "../Includes/XLinkKaiConnection.h"
+#include "FakeKaiEngine.h"
+#include "ImpairedLink.h"
+#include "KaiReplayer.h"
+
+using namespace std::chrono;
+namespace po = boost::program_options;
+
+namespace
+{
+    // Long enough for a lost connect or reply to time out and be retried on an impaired link.
+    constexpr seconds      cConnectTimeout{30};
+    constexpr seconds      cDrainTimeout{1};
+    constexpr milliseconds cPollInterval{10};
+    constexpr uint64_t     cSourceMAC{0x0000aa5a0c00};
+    constexpr unsigned int cSnapshotLength{65535};
+
+    constexpr std::array<double, 4> cPercentiles{50, 90, 99, 99.9};
+
+    /**
+     * Sits between PCapReader and XLinkKaiConnection and adds a timestamp to every converted frame.
+     */
+    class TimestampingConnector : public IConnector
+    {
+    public:
+        explicit TimestampingConnector(std::shared_ptr<IConnector> aConnector) : mConnector(std::move(aConnector)) {}
+
+        bool Open(std::string_view /*aArgument*/) override
+        {
+            return true;
+        }
+
+        void Close() override {}
+
+        bool ReadNextData() override
+        {
+            return false;
+        }
+
+        bool Send(std::string_view aData) override
+        {
+            mFrame.assign(aData);
+            FakeKaiEngine::AddTimestamp(mFrame, mOrigin);
+            mFramesSent++;
+            return mConnector->Send(mFrame);
+        }
+
+        void SetIncomingConnection(std::shared_ptr<IPCapDevice> /*aDevice*/) override {}
+
+        bool StartReceiverThread() override
+        {
+            return true;
+        }
+
+        /**
+         * Sets the time the frame that is handled next entered the program.
+         * @param aOrigin - Time since epoch.
+         */
+        void SetOrigin(nanoseconds aOrigin)
+        {
+            mOrigin = aOrigin;
+        }
+
+        uint64_t mFramesSent{0};
+
+    private:
+        std::shared_ptr<IConnector> mConnector;
+        std::string                 mFrame{};
+        nanoseconds                 mOrigin{0};
+    };
+
+    /**
+     * Stands in for the device injecting frames from XLink Kai, optionally writes them to a capture file.
+     */
+    class CaptureSink : public IPCapDevice
+    {
+    public:
+        ~CaptureSink()
+        {
+            Close();
+        }
+
+        void BlackList(uint64_t /*aMAC*/) override {}
+
+        void Close() override
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            if (mDumper != nullptr) {
+                pcap_dump_close(mDumper);
+                mDumper = nullptr;
+            }
+
+            if (mHandler != nullptr) {
+                pcap_close(mHandler);
+                mHandler = nullptr;
+            }
+        }
+
+        bool Open(std::string_view aName, const std::vector<std::string>& /*aSSIDFilter*/) override
+        {
+            bool lReturn{true};
+
+            mHandler = pcap_open_dead(DLT_EN10MB, cSnapshotLength);
+            if (mHandler != nullptr) {
+                mDumper = pcap_dump_open(mHandler, std::string(aName).c_str());
+            }
+
+            if (mDumper == nullptr) {
+                Logger::GetInstance().Log("Could not open " + std::string(aName) + " for writing",
+                                          Logger::Level::ERROR);
+                lReturn = false;
+            }
+
+            return lReturn;
+        }
+
+        std::string DataToString(const unsigned char* aData, const pcap_pkthdr* aHeader) override
+        {
+            return std::string(reinterpret_cast<const char*>(aData), aHeader->caplen);
+        }
+
+        const unsigned char* GetData() override
+        {
+            return nullptr;
+        }
+
+        const pcap_pkthdr* GetHeader() override
+        {
+            return nullptr;
+        }
+
+        bool Send(std::string_view aData) override
+        {
+            nanoseconds lNow{LatencyTrace::Now()};
+            nanoseconds lOrigin{FakeKaiEngine::GetTimestamp(aData)};
+            std::size_t lSize{(lOrigin.count() != 0) ? aData.size() - cTimestampLength : aData.size()};
+
+            std::lock_guard<std::mutex> lLock{mMutex};
+            mReceived.Record(lSize, lNow, lOrigin);
+
+            if (mDumper != nullptr) {
+                pcap_pkthdr lHeader{};
+                lHeader.ts.tv_sec  = duration_cast<seconds>(lNow).count();
+                lHeader.ts.tv_usec = duration_cast<microseconds>(lNow % seconds(1)).count();
+                lHeader.caplen     = lSize;
+                lHeader.len        = lSize;
+                pcap_dump(reinterpret_cast<u_char*>(mDumper), &lHeader, reinterpret_cast<const u_char*>(aData.data()));
+            }
+
+            return true;
+        }
+
+        void SetConnector(std::shared_ptr<IConnector> /*aDevice*/) override {}
+
+        bool StartReceiverThread() override
+        {
+            return true;
+        }
+
+        /**
+         * Gets statistics about the frames injected so far.
+         * @return copy of the statistics.
+         */
+        TrafficStatistics GetReceived()
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            return mReceived;
+        }
+
+    private:
+        pcap_dumper_t*    mDumper{nullptr};
+        pcap_t*           mHandler{nullptr};
+        std::mutex        mMutex{};
+        TrafficStatistics mReceived{};
+    };
+
+    /**
+     * Gives every copy of a frame its own source MAC address, by replacing the last two bytes of it.
+     * @param aFrame - Frame to rewrite.
+     * @param aMonitorCapture - True if the frame is radiotap + 802.11, false if it is ethernet.
+     * @param aCopy - Number of the copy, 0 leaves the frame as is.
+     */
+    void RewriteSourceMAC(std::string& aFrame, bool aMonitorCapture, unsigned int aCopy)
+    {
+        std::size_t lIndex{Net_8023_Constants::cSourceAddressIndex};
+        if (aMonitorCapture) {
+            uint16_t lRadioTapLength{0};
+            if (aFrame.size() >= RadioTap_Constants::cLengthIndex + sizeof(lRadioTapLength)) {
+                memcpy(&lRadioTapLength, aFrame.data() + RadioTap_Constants::cLengthIndex, sizeof(lRadioTapLength));
+            }
+            lIndex = lRadioTapLength + Net_80211_Constants::cSourceAddressIndex;
+        }
+
+        if ((aCopy > 0) && (aFrame.size() >= lIndex + Net_8023_Constants::cSourceAddressLength)) {
+            aFrame.at(lIndex + 4) = static_cast<char>(aCopy >> 8);
+            aFrame.at(lIndex + 5) = static_cast<char>(aCopy & 0xff);
+        }
+    }
+
+    /**
+     * Waits until the amount of frames received stops growing.
+     * @param aGetFrames - Function returning the amount of frames received so far.
+     * @param aExpected - Amount of frames that were sent, stops waiting when all arrived.
+     */
+    template<typename GetFrames> void WaitForDrain(GetFrames aGetFrames, uint64_t aExpected)
+    {
+        uint64_t lLastFrames{aGetFrames()};
+        auto     lLastProgress{steady_clock::now()};
+
+        while ((lLastFrames < aExpected) && (steady_clock::now() < lLastProgress + cDrainTimeout)) {
+            std::this_thread::sleep_for(cPollInterval);
+            uint64_t lFrames{aGetFrames()};
+            if (lFrames != lLastFrames) {
+                lLastFrames   = lFrames;
+                lLastProgress = steady_clock::now();
+            }
+        }
+    }
+
+    /**
+     * Results of one direction.
+     */
+    struct Result
+    {
+        std::string_view  mName{};
+        uint64_t          mOffered{0};
+        nanoseconds       mOfferedDuration{0};
+        nanoseconds       mStart{0};
+        TrafficStatistics mReceived{};
+    };
+
+    std::string ToText(const Result& aResult)
+    {
+        std::stringstream lStream{};
+        double            lSeconds{duration<double>(aResult.mReceived.mLast - aResult.mStart).count()};
+        uint64_t          lLost{aResult.mOffered - std::min(aResult.mOffered, aResult.mReceived.mFrames)};
+        double            lLostPercentage{
+            (aResult.mOffered > 0) ? 100.0 * static_cast<double>(lLost) / static_cast<double>(aResult.mOffered) : 0.0};
+
+        lStream << std::fixed << std::setprecision(1);
+        lStream << aResult.mName << ": " << aResult.mOffered << " frames offered in "
+                << duration<double>(aResult.mOfferedDuration).count() << " s, " << aResult.mReceived.mFrames
+                << " received (" << lLostPercentage << "% lost)" << std::endl;
+
+        if (lSeconds > 0) {
+            lStream << "  " << static_cast<double>(aResult.mReceived.mFrames) / lSeconds << " frames/s, "
+                    << static_cast<double>(aResult.mReceived.mBytes) / lSeconds << " bytes/s" << std::endl;
+        }
+
+        lStream << "  latency:";
+        for (double lPercentile : cPercentiles) {
+            lStream << " p" << std::defaultfloat << std::setprecision(4) << lPercentile << std::fixed
+                    << std::setprecision(1) << " "
+                    << duration<double, std::micro>(aResult.mReceived.mLatency.GetPercentile(lPercentile)).count()
+                    << " us,";
+        }
+        lStream << " max " << static_cast<double>(aResult.mReceived.mLatency.mMax) / 1000.0 << " us" << std::endl;
+
+        return lStream.str();
+    }
+
+    std::string ToJson(const Result& aResult)
+    {
+        std::stringstream lStream{};
+        double            lSeconds{duration<double>(aResult.mReceived.mLast - aResult.mStart).count()};
+
+        lStream << "\"" << aResult.mName << "\": {\"offered\": " << aResult.mOffered
+                << ", \"offered_seconds\": " << duration<double>(aResult.mOfferedDuration).count()
+                << ", \"received\": " << aResult.mReceived.mFrames << ", \"bytes\": " << aResult.mReceived.mBytes
+                << ", \"seconds\": " << lSeconds;
+
+        if (lSeconds > 0) {
+            lStream << ", \"frames_per_second\": " << static_cast<double>(aResult.mReceived.mFrames) / lSeconds
+                    << ", \"bytes_per_second\": " << static_cast<double>(aResult.mReceived.mBytes) / lSeconds;
+        }
+
+        lStream << ", \"latency_ns\": {";
+        for (double lPercentile : cPercentiles) {
+            lStream << "\"p" << lPercentile
+                    << "\": " << aResult.mReceived.mLatency.GetPercentile(lPercentile).count() << ", ";
+        }
+        lStream << "\"max\": " << aResult.mReceived.mLatency.mMax << "}}";
+
+        return lStream.str();
+    }
+
+    /**
+     * How the connection with XLink Kai held up, over the whole run.
+     */
+    struct LinkResult
+    {
+        std::string_view     mProfile{};
+        ImpairmentStatistics mToKai{};
+        ImpairmentStatistics mFromKai{};
+        uint64_t             mKeepAlives{0};
+        HistogramSnapshot    mKeepAliveInterval{};
+        uint64_t             mDisconnects{0};
+        HistogramSnapshot    mConnectRoundTrip{};
+        nanoseconds          mDowntime{0};
+    };
+
+    std::string ToText(const ImpairmentStatistics& aStatistics)
+    {
+        std::stringstream lStream{};
+
+        lStream << aStatistics.mOffered << " offered, " << aStatistics.mDelivered << " delivered, " << aStatistics.mLost
+                << " lost, " << aStatistics.mDuplicated << " duplicated, " << aStatistics.mReordered << " reordered, "
+                << aStatistics.mOutageDrops << " dropped in outages, " << aStatistics.mLimitDrops
+                << " dropped over the limit, peak queue " << aStatistics.mPeakQueue;
+
+        return lStream.str();
+    }
+
+    std::string ToText(const LinkResult& aResult)
+    {
+        std::stringstream lStream{};
+
+        lStream << std::fixed << std::setprecision(1);
+        lStream << "link (" << aResult.mProfile << "):" << std::endl;
+        lStream << "  to kai: " << ToText(aResult.mToKai) << std::endl;
+        lStream << "  from kai: " << ToText(aResult.mFromKai) << std::endl;
+        lStream << "  keepalives: " << aResult.mKeepAlives << ", interval p50 "
+                << duration<double, std::milli>(aResult.mKeepAliveInterval.GetPercentile(50)).count() << " ms, max "
+                << static_cast<double>(aResult.mKeepAliveInterval.mMax) / 1000000.0 << " ms" << std::endl;
+        lStream << "  connects: " << aResult.mConnectRoundTrip.mCount << ", round trip max "
+                << static_cast<double>(aResult.mConnectRoundTrip.mMax) / 1000000.0 << " ms, disconnects "
+                << aResult.mDisconnects << ", not connected for " << duration<double>(aResult.mDowntime).count()
+                << " s" << std::endl;
+
+        return lStream.str();
+    }
+
+    std::string ToJson(const ImpairmentStatistics& aStatistics)
+    {
+        std::stringstream lStream{};
+
+        lStream << "{\"offered\": " << aStatistics.mOffered << ", \"delivered\": " << aStatistics.mDelivered
+                << ", \"lost\": " << aStatistics.mLost << ", \"duplicated\": " << aStatistics.mDuplicated
+                << ", \"reordered\": " << aStatistics.mReordered << ", \"outage_drops\": " << aStatistics.mOutageDrops
+                << ", \"limit_drops\": " << aStatistics.mLimitDrops << ", \"peak_queue\": " << aStatistics.mPeakQueue
+                << "}";
+
+        return lStream.str();
+    }
+
+    std::string ToJson(const LinkResult& aResult)
+    {
+        std::stringstream lStream{};
+
+        lStream << "\"link\": {\"profile\": \"" << aResult.mProfile << "\", \"to_kai\": " << ToJson(aResult.mToKai)
+                << ", \"from_kai\": " << ToJson(aResult.mFromKai) << ", \"keepalives\": " << aResult.mKeepAlives
+                << ", \"keepalive_interval_ns\": {\"p50\": "
+                << aResult.mKeepAliveInterval.GetPercentile(50).count()
+                << ", \"max\": " << aResult.mKeepAliveInterval.mMax << "}, \"connects\": "
+                << aResult.mConnectRoundTrip.mCount << ", \"connect_round_trip_max_ns\": "
+                << aResult.mConnectRoundTrip.mMax << ", \"disconnects\": " << aResult.mDisconnects
+                << ", \"downtime_seconds\": " << duration<double>(aResult.mDowntime).count() << "}";
+
+        return lStream.str();
+    }
+
+    /**
+     * Replays a capture as fast as possible through PCapReader into XLink Kai.
+     * @param aFileName - Capture to replay.
+     * @param aSSIDFilter - SSIDs to lock onto, for monitor mode captures.
+     * @param aLoops - Times to replay the capture.
+     * @param aCopies - Copies of every frame, each with its own source MAC.
+     * @param aConnection - Connection to XLink Kai.
+     * @param aKai - The fake XLink Kai engine, to see what arrived.
+     * @param aResult - Result to fill in.
+     * @return true if the capture could be read.
+     */
+    bool ReplayCapture(const std::string&                 aFileName,
+                       std::vector<std::string>&          aSSIDFilter,
+                       unsigned int                       aLoops,
+                       unsigned int                       aCopies,
+                       const std::shared_ptr<IConnector>& aConnection,
+                       FakeKaiEngine&                     aKai,
+                       Result&                            aResult)
+    {
+        // Radiotap captures go through the monitor mode path, the rest is treated as a promiscuous capture.
+        MappedCapture lCapture{};
+        bool          lReturn{lCapture.Open(aFileName)};
+        bool          lMonitorCapture{lCapture.GetLinkType() == DLT_IEEE802_11_RADIO};
+        PCapReader    lReader{lMonitorCapture, false};
+        lReturn = lReturn && (lMonitorCapture ? lReader.Open(aFileName, aSSIDFilter) : lReader.Open(aFileName));
+
+        if (lReturn) {
+            // Frames are read straight from the mapping, read it once so loading the file is not part of the
+            // measurement.
+            MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+            CapturedPacket        lPacket{};
+            while (lCursor.Next(lPacket)) {}
+
+            auto lConnector{std::make_shared<TimestampingConnector>(aConnection)};
+            lReader.SetConnector(lConnector);
+
+            std::string lFrame{};
+            pcap_pkthdr lHeader{};
+            aResult.mStart = LatencyTrace::Now();
+            for (unsigned int lLoop = 0; lLoop < aLoops; lLoop++) {
+                lCursor.Rewind();
+                while (lCursor.Next(lPacket)) {
+                    lHeader.ts.tv_sec  = duration_cast<seconds>(lPacket.mTimestamp).count();
+                    lHeader.ts.tv_usec = duration_cast<microseconds>(lPacket.mTimestamp % seconds(1)).count();
+                    lHeader.caplen     = lPacket.mData.size();
+                    lHeader.len        = lPacket.mOriginalLength;
+
+                    for (unsigned int lCopy = 0; lCopy < aCopies; lCopy++) {
+                        // Only copies get their own source MAC, the original is used as is.
+                        const char* lData{lPacket.mData.data()};
+                        if (lCopy > 0) {
+                            lFrame.assign(lPacket.mData);
+                            RewriteSourceMAC(lFrame, lMonitorCapture, lCopy);
+                            lData = lFrame.data();
+                        }
+
+                        lConnector->SetOrigin(LatencyTrace::Now());
+                        lReader.ReadCallback(reinterpret_cast<const unsigned char*>(lData), &lHeader);
+                    }
+                }
+            }
+            aResult.mOfferedDuration = LatencyTrace::Now() - aResult.mStart;
+            aResult.mOffered         = lConnector->mFramesSent;
+
+            WaitForDrain([&] { return aKai.GetReceived().mFrames; }, aResult.mOffered);
+            aResult.mReceived = aKai.GetReceived();
+        }
+        lReader.Close();
+
+        return lReturn;
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string              lFileName{};
+    std::vector<std::string> lSSIDFilter{};
+    std::string              lSinkFileName{};
+    std::string              lLogLevel{};
+    unsigned int             lLoops{1};
+    unsigned int             lCopies{1};
+    uint64_t                 lReverseFrames{0};
+    uint64_t                 lReverseRate{0};
+    unsigned int             lFrameSize{256};
+    std::string              lImpairment{};
+    uint64_t                 lSeed{1};
+    unsigned int             lHold{0};
+    std::string              lKaiReplayFileName{};
+
+    po::options_description lDescription{"xlha-bench, measures throughput and latency of the program on localhost"};
+    lDescription.add_options()("help,h", "Shows this help")(
+        "file,f", po::value(&lFileName), "Capture to replay towards XLink Kai (pcap or pcapng)")(
+        "ssid,s", po::value(&lSSIDFilter), "SSID to lock onto when replaying a monitor mode capture, can be repeated")(
+        "loops,l", po::value(&lLoops)->default_value(1), "Times to replay the capture")(
+        "copies,c", po::value(&lCopies)->default_value(1), "Copies of every frame, each with its own source MAC")(
+        "reverse-frames,r", po::value(&lReverseFrames)->default_value(0), "Frames XLink Kai sends to the program")(
+        "reverse-rate", po::value(&lReverseRate)->default_value(0), "Frames per second from XLink Kai, 0 is unlimited")(
+        "frame-size", po::value(&lFrameSize)->default_value(256), "Size of the frames from XLink Kai in bytes")(
+        "sink", po::value(&lSinkFileName), "Capture file to write the frames injected by the program to")(
+        "impairment", po::value(&lImpairment), "Impairment profile of the link with XLink Kai, see the README")(
+        "seed", po::value(&lSeed)->default_value(1), "Seed for the random decisions of the impaired link")(
+        "hold", po::value(&lHold)->default_value(0), "Seconds to stay connected after the traffic, to see keepalives")(
+        "kai-replay", po::value(&lKaiReplayFileName), "Recorded XLink Kai session to play back instead of the engine")(
+        "kai-replay-timing", "Play the recorded session back with its original timing, not as fast as possible")(
+        "log-level", po::value(&lLogLevel), "Log level of the program, logs to screen")(
+        "json", "Print the results as JSON");
+
+    po::variables_map lVariables{};
+    try {
+        po::store(po::parse_command_line(argc, argv, lDescription), lVariables);
+        po::notify(lVariables);
+    } catch (const po::error& lException) {
+        std::cerr << lException.what() << std::endl << lDescription << std::endl;
+        return 1;
+    }
+
+    bool lReplaying{!lKaiReplayFileName.empty()};
+    if ((lVariables.count("help") > 0) ||
+        (lFileName.empty() && (lReverseFrames == 0) && (lHold == 0) && !lReplaying)) {
+        std::cout << lDescription << std::endl;
+        return (lVariables.count("help") > 0) ? 0 : 1;
+    }
+
+    if (lReplaying && (!lFileName.empty() || (lReverseFrames > 0))) {
+        std::cerr << "A recorded session can not be combined with --file or --reverse-frames" << std::endl;
+        return 1;
+    }
+
+    if (!lLogLevel.empty()) {
+        Logger::GetInstance().SetLogLevel(Logger::ConvertLogLevelStringToLevel(lLogLevel));
+        Logger::GetInstance().SetLogToScreen(true);
+    }
+
+    std::optional<ImpairmentProfile> lProfile{};
+    if (!lImpairment.empty()) {
+        lProfile = ImpairedLink::GetProfile(lImpairment);
+        if (!lProfile.has_value()) {
+            std::cerr << "Unknown impairment profile " << lImpairment << ", choose from:";
+            for (const ImpairmentProfile& lKnownProfile : cImpairmentProfiles) {
+                std::cerr << " " << lKnownProfile.mName;
+            }
+            std::cerr << std::endl;
+            return 1;
+        }
+    }
+
+    // Either the fake engine or the replayer plays XLink Kai.
+    FakeKaiEngine lKai{};
+    KaiReplayer   lReplayer{};
+    if (lReplaying) {
+        lReplayer.SetTimeAccurate(lVariables.count("kai-replay-timing") > 0);
+        if (!lReplayer.Open(lKaiReplayFileName) || !lReplayer.Start(0)) {
+            return 1;
+        }
+    } else if (!lKai.Start(0)) {
+        return 1;
+    }
+
+    // Without an impairment the program talks to the engine directly.
+    std::unique_ptr<ImpairedLink> lLink{nullptr};
+    unsigned int                  lEnginePort{lReplaying ? lReplayer.GetPort() : lKai.GetPort()};
+    unsigned int                  lKaiPort{lEnginePort};
+    if (lProfile.has_value()) {
+        lLink = std::make_unique<ImpairedLink>(*lProfile, lSeed);
+        if (!lLink->Start(lEnginePort)) {
+            return 1;
+        }
+        lKaiPort = lLink->GetPort();
+    }
+
+    auto lSink{std::make_shared<CaptureSink>()};
+    if (!lSinkFileName.empty() && !lSink->Open(lSinkFileName, lSSIDFilter)) {
+        return 1;
+    }
+
+    auto lConnection{std::make_shared<XLinkKaiConnection>()};
+    lConnection->Open(cIp, lKaiPort);
+    lConnection->SetIncomingConnection(lSink);
+    lConnection->StartReceiverThread();
+
+    // The replayer has no say in the connection, it confirms whatever connects.
+    auto lConnected{[&] {
+        return (lReplaying || lKai.IsConnected()) && (Metrics::GetInstance().GetSnapshot().Get(Gauge::KaiLinkState) ==
+                                                      static_cast<int64_t>(KaiLinkState::Connected));
+    }};
+
+    auto lConnectStart{steady_clock::now()};
+    while (!lConnected() && (steady_clock::now() < lConnectStart + cConnectTimeout)) {
+        std::this_thread::sleep_for(cPollInterval);
+    }
+
+    // Keeps track of how long the program was not connected, which is where the reconnect logic costs time.
+    std::atomic<bool>    lMonitoring{true};
+    std::atomic<int64_t> lDowntime{0};
+    std::thread          lLinkMonitor{[&] {
+        while (lMonitoring) {
+            std::this_thread::sleep_for(cPollInterval);
+            if (Metrics::GetInstance().GetSnapshot().Get(Gauge::KaiLinkState) !=
+                static_cast<int64_t>(KaiLinkState::Connected)) {
+                lDowntime += nanoseconds(cPollInterval).count();
+            }
+        }
+    }};
+
+    int                 lReturn{0};
+    std::vector<Result> lResults{};
+    if (lConnected()) {
+        if (!lFileName.empty()) {
+            Result lForward{"forward"};
+            if (ReplayCapture(lFileName, lSSIDFilter, lLoops, std::max(lCopies, 1U), lConnection, lKai, lForward)) {
+                lResults.push_back(lForward);
+            } else {
+                lReturn = 1;
+            }
+        }
+
+        if (lReverseFrames > 0) {
+            std::string lFrame(std::max<std::size_t>(lFrameSize, Net_8023_Constants::cHeaderLength), '\0');
+            memcpy(lFrame.data() + Net_8023_Constants::cDestinationAddressIndex,
+                   &Net_Constants::cBroadcastMac,
+                   Net_8023_Constants::cDestinationAddressLength);
+            memcpy(lFrame.data() + Net_8023_Constants::cSourceAddressIndex,
+                   &cSourceMAC,
+                   Net_8023_Constants::cSourceAddressLength);
+            memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex,
+                   &Net_Constants::cPSPEtherType,
+                   Net_8023_Constants::cEtherTypeLength);
+
+            Result lReverse{"reverse"};
+            lReverse.mStart = LatencyTrace::Now();
+            lKai.Blast(lFrame, lReverseFrames, lReverseRate, std::max(lCopies, 1U));
+            while (lKai.IsBlasting()) {
+                std::this_thread::sleep_for(cPollInterval);
+            }
+            lReverse.mOffered         = lReverseFrames;
+            lReverse.mOfferedDuration = lKai.GetBlastDuration();
+
+            WaitForDrain([&] { return lSink->GetReceived().mFrames; }, lReverseFrames);
+            lReverse.mReceived = lSink->GetReceived();
+            lResults.push_back(lReverse);
+        }
+
+        if (lReplaying) {
+            while (!lReplayer.IsDone()) {
+                std::this_thread::sleep_for(cPollInterval);
+            }
+
+            KaiReplayStatistics lStatistics{lReplayer.GetStatistics()};
+            Result              lReplay{"replay"};
+            lReplay.mStart           = lStatistics.mStart;
+            lReplay.mOffered         = lStatistics.mDataFrames;
+            lReplay.mOfferedDuration = lStatistics.mDuration;
+
+            WaitForDrain([&] { return lSink->GetReceived().mFrames; }, lReplay.mOffered);
+            lReplay.mReceived = lSink->GetReceived();
+            // Recorded frames carry no timestamp, so the latency comes from the trace the program keeps itself.
+            lReplay.mReceived.mLatency = Metrics::GetInstance().GetSnapshot().Get(Histogram::KaiToInject);
+            lResults.push_back(lReplay);
+        }
+
+        std::this_thread::sleep_for(seconds(lHold));
+    } else {
+        std::cerr << "The program did not connect to the fake XLink Kai engine" << std::endl;
+        lReturn = 1;
+    }
+
+    lMonitoring = false;
+    lLinkMonitor.join();
+
+    LinkResult lLinkResult{};
+    if (lLink != nullptr) {
+        MetricsSnapshot lSnapshot{Metrics::GetInstance().GetSnapshot()};
+        lLinkResult.mProfile           = lProfile->mName;
+        lLinkResult.mToKai             = lLink->GetToEngineStatistics();
+        lLinkResult.mFromKai           = lLink->GetToClientStatistics();
+        lLinkResult.mKeepAlives        = lSnapshot.Get(Counter::KaiKeepAlives);
+        lLinkResult.mKeepAliveInterval = lSnapshot.Get(Histogram::KaiKeepAliveInterval);
+        lLinkResult.mDisconnects       = lSnapshot.Get(Counter::KaiDisconnects);
+        lLinkResult.mConnectRoundTrip  = lSnapshot.Get(Histogram::KaiConnectRoundTrip);
+        lLinkResult.mDowntime          = nanoseconds(lDowntime.load());
+    }
+
+    lConnection->Close();
+    if (lLink != nullptr) {
+        lLink->Stop();
+    }
+    lKai.Stop();
+    lReplayer.Stop();
+    lSink->Close();
+
+    if (lVariables.count("json") > 0) {
+        std::cout << "{";
+        for (std::size_t lIndex = 0; lIndex < lResults.size(); lIndex++) {
+            std::cout << ((lIndex > 0) ? ", " : "") << ToJson(lResults.at(lIndex));
+        }
+        if (lLink != nullptr) {
+            std::cout << (lResults.empty() ? "" : ", ") << ToJson(lLinkResult);
+        }
+        std::cout << "}" << std::endl;
+    } else {
+        for (const Result& lResult : lResults) {
+            std::cout << ToText(lResult);
+        }
+        if (lLink != nullptr) {
+            std::cout << ToText(lLinkResult);
+        }
+    }
+
+    return lReturn;
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2021 [Rick de Bondt] - XLHAConvert.cpp
+ *
+ * This file contains xlha-convert, which converts a monitor mode capture into the promiscuous stream the program
+ * would send to XLink Kai, or a promiscuous capture into the monitor mode frames it would inject, on all cores.
+ **/
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../Includes/CaptureConverter.h"
+#include "../Includes/MappedCapture.h"
+#include "../Includes/NetConversionFunctions.h"
+#include "../Includes/PcapNgWriter.h"
+
+using namespace std::chrono;
+namespace po = boost::program_options;
+
+int main(int argc, char** argv)
+{
+    ConvertOptions           lOptions{};
+    std::string              lInputFileName{};
+    std::string              lOutputFileName{};
+    std::string              lReferenceFileName{};
+    std::string              lBSSID{};
+    std::vector<std::string> lBlackList{};
+    unsigned int             lFrequency{lOptions.mParameters.mFrequency};
+    unsigned int             lRate{lOptions.mParameters.mDataRate};
+
+    po::options_description lDescription{"xlha-convert, converts between monitor mode and promiscuous captures"};
+    lDescription.add_options()("help,h", "Shows this help")(
+        "input,i", po::value(&lInputFileName), "Radiotap or ethernet capture to convert (pcap or pcapng)")(
+        "output,o", po::value(&lOutputFileName), "Capture file to write the converted frames to (pcapng)")(
+        "ssid", po::value(&lOptions.mSSIDFilter), "SSID to lock onto, can be given more than once")(
+        "blacklist", po::value(&lBlackList), "Source MAC to leave out, can be given more than once")(
+        "bssid", po::value(&lBSSID), "BSSID to lock onto, or to give the frames of an ethernet capture")(
+        "reference,r",
+        po::value(&lReferenceFileName),
+        "Radiotap capture to take the BSSID and radiotap parameters for an ethernet capture from")(
+        "frequency", po::value(&lFrequency)->default_value(lFrequency), "Frequency in MHz for an ethernet capture")(
+        "rate", po::value(&lRate)->default_value(lRate), "Data rate in 500 kbps units for an ethernet capture")(
+        "threads,t", po::value(&lOptions.mThreads)->default_value(0), "Threads to convert with, 0 uses all cores")(
+        "chunk-size",
+        po::value(&lOptions.mChunkSize)->default_value(cDefaultChunkSize),
+        "Packets converted in one go by a thread");
+
+    po::variables_map lVariables{};
+    try {
+        po::store(po::parse_command_line(argc, argv, lDescription), lVariables);
+        po::notify(lVariables);
+    } catch (const po::error& lException) {
+        std::cerr << lException.what() << std::endl << lDescription << std::endl;
+        return 1;
+    }
+
+    if ((lVariables.count("help") > 0) || lInputFileName.empty() || lOutputFileName.empty()) {
+        std::cout << lDescription << std::endl;
+        return (lVariables.count("help") > 0) ? 0 : 1;
+    }
+
+    for (const std::string& lMAC : lBlackList) {
+        lOptions.mBlackList.push_back(MacToInt(lMAC));
+    }
+    if (!lBSSID.empty()) {
+        lOptions.mBSSID = MacToInt(lBSSID);
+    }
+    lOptions.mParameters.mFrequency = static_cast<uint16_t>(lFrequency);
+    lOptions.mParameters.mDataRate  = static_cast<uint8_t>(lRate);
+
+    CaptureConverter lConverter{lOptions};
+    if (!lReferenceFileName.empty()) {
+        MappedCapture lReference{};
+        if (!lReference.Open(lReferenceFileName) || !lConverter.TakeParametersFrom(lReference)) {
+            std::cerr << "Could not take the parameters from the reference capture" << std::endl;
+            return 1;
+        }
+        std::cout << "BSSID: " << IntToMac(lConverter.GetOptions().mBSSID) << std::endl;
+    }
+
+    MappedCapture lInput{};
+    PcapNgWriter  lOutput{};
+    if (!lInput.Open(lInputFileName) || !lOutput.Open(lOutputFileName)) {
+        std::cerr << "Could not open the input or output file" << std::endl;
+        return 1;
+    }
+
+    auto lStart{steady_clock::now()};
+    bool lSuccess{lConverter.Convert(lInput, lOutput)};
+    auto lElapsed{duration_cast<duration<double>>(steady_clock::now() - lStart)};
+    lOutput.Close();
+
+    if (!lSuccess) {
+        std::cerr << "Could not convert the capture" << std::endl;
+        return 1;
+    }
+
+    std::cout << "frames read: " << lConverter.GetFramesRead() << std::endl;
+    std::cout << "frames written: " << lConverter.GetFramesWritten() << std::endl;
+    std::cout << "seconds: " << lElapsed.count() << std::endl;
+
+    return 0;
+}
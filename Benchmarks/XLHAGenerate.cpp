@@ -0,0 +1,129 @@
+/* Copyright (c) 2021 [Rick de Bondt] - XLHAGenerate.cpp
+ *
+ * This file contains xlha-generate, which writes synthetic monitor mode traffic to a capture file, together with
+ * the frames the program is expected to send to XLink Kai for it.
+ **/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "../Includes/PcapNgWriter.h"
+#include "../Includes/TrafficGenerator.h"
+
+using namespace std::chrono;
+namespace po = boost::program_options;
+
+namespace
+{
+    constexpr uint32_t cSnapshotLength{65535};
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    TrafficMix   lMix{};
+    std::string  lFileName{};
+    std::string  lKaiFileName{};
+    double       lDuration{10};
+    unsigned int lMinimumPayload{lMix.mMinimumPayload};
+    unsigned int lMaximumPayload{lMix.mMaximumPayload};
+
+    po::options_description lDescription{"xlha-generate, writes synthetic monitor mode traffic to a capture file"};
+    lDescription.add_options()("help,h", "Shows this help")(
+        "output,o", po::value(&lFileName), "Capture file to write the radiotap + 802.11 frames to (pcapng)")(
+        "kai-output,k", po::value(&lKaiFileName), "Capture file to write the frames expected at XLink Kai to (pcapng)")(
+        "duration,d", po::value(&lDuration)->default_value(10), "Seconds of traffic to generate")(
+        "seed", po::value(&lMix.mSeed)->default_value(lMix.mSeed), "Seed, the same seed gives the same traffic")(
+        "psp-networks", po::value(&lMix.mPSPNetworks)->default_value(lMix.mPSPNetworks), "PSP ad-hoc networks")(
+        "vita-networks", po::value(&lMix.mVitaNetworks)->default_value(lMix.mVitaNetworks), "Vita ad-hoc networks")(
+        "foreign-networks",
+        po::value(&lMix.mForeignNetworks)->default_value(lMix.mForeignNetworks),
+        "Access points with unrelated SSIDs")(
+        "stations",
+        po::value(&lMix.mStationsPerNetwork)->default_value(lMix.mStationsPerNetwork),
+        "Players in every ad-hoc network")(
+        "foreign-rate",
+        po::value(&lMix.mForeignFrameRate)->default_value(lMix.mForeignFrameRate),
+        "Data frames per second in every foreign network")(
+        "qos-ratio", po::value(&lMix.mQoSRatio)->default_value(lMix.mQoSRatio), "Part of the frames sent as QoS")(
+        "null-ratio", po::value(&lMix.mNullRatio)->default_value(lMix.mNullRatio), "Part of the frames that are nulls")(
+        "retry-ratio", po::value(&lMix.mRetryRatio)->default_value(lMix.mRetryRatio), "Part of unicast frames retried")(
+        "ack-ratio",
+        po::value(&lMix.mAcknowledgementRatio)->default_value(lMix.mAcknowledgementRatio),
+        "Part of unicast frames of which the acknowledgement is captured")(
+        "fcs-ratio", po::value(&lMix.mFCSRatio)->default_value(lMix.mFCSRatio), "Part of the frames with an FCS")(
+        "min-payload", po::value(&lMinimumPayload)->default_value(lMinimumPayload), "Smallest game payload in bytes")(
+        "max-payload", po::value(&lMaximumPayload)->default_value(lMaximumPayload), "Largest game payload in bytes")(
+        "tsft-only", "Use the same radiotap layout for every station");
+
+    po::variables_map lVariables{};
+    try {
+        po::store(po::parse_command_line(argc, argv, lDescription), lVariables);
+        po::notify(lVariables);
+    } catch (const po::error& lException) {
+        std::cerr << lException.what() << std::endl << lDescription << std::endl;
+        return 1;
+    }
+
+    if ((lVariables.count("help") > 0) || lFileName.empty() || (lMix.mPSPNetworks == 0) ||
+        (lMinimumPayload > lMaximumPayload)) {
+        std::cout << lDescription << std::endl;
+        return (lVariables.count("help") > 0) ? 0 : 1;
+    }
+
+    lMix.mMinimumPayload = static_cast<uint16_t>(std::min(lMinimumPayload, 1500U));
+    lMix.mMaximumPayload = static_cast<uint16_t>(std::min(lMaximumPayload, 1500U));
+    lMix.mVariedRadioTap = (lVariables.count("tsft-only") == 0);
+
+    PcapNgWriter lWriter{};
+    PcapNgWriter lKaiWriter{};
+    if (!lWriter.Open(lFileName) || (!lKaiFileName.empty() && !lKaiWriter.Open(lKaiFileName))) {
+        std::cerr << "Could not open the output files" << std::endl;
+        return 1;
+    }
+    uint32_t lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeRadioTap, cSnapshotLength)};
+    uint32_t lKaiInterface{0};
+    if (lKaiWriter.IsOpen()) {
+        lKaiInterface = lKaiWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cSnapshotLength);
+    }
+
+    // Frames get written one by one, so long captures don't have to fit in memory.
+    TrafficGenerator                      lGenerator{lMix};
+    nanoseconds                           lEnd{cStartTime + duration_cast<nanoseconds>(duration<double>(lDuration))};
+    std::array<uint64_t, cFrameTypeCount> lCounts{};
+    uint64_t                              lKaiFrames{0};
+    bool                                  lSuccess{true};
+    GeneratedFrame                        lFrame{lGenerator.Next()};
+    while (lSuccess && !lFrame.mData.empty() && (lFrame.mTimestamp < lEnd)) {
+        lCounts.at(static_cast<std::size_t>(lFrame.mType))++;
+        lSuccess = lWriter.WritePacket(lInterface, lFrame.mTimestamp, lFrame.mData);
+
+        if (lSuccess && lKaiWriter.IsOpen() && !lFrame.mEthernet.empty()) {
+            lSuccess = lKaiWriter.WritePacket(lKaiInterface, lFrame.mTimestamp, lFrame.mEthernet);
+            lKaiFrames++;
+        }
+        lFrame = lGenerator.Next();
+    }
+    lWriter.Close();
+    lKaiWriter.Close();
+
+    if (!lSuccess) {
+        std::cerr << "Could not write to the output files" << std::endl;
+        return 1;
+    }
+
+    for (std::size_t lType = 0; lType < cFrameTypeCount; lType++) {
+        std::cout << cFrameTypeTexts.at(lType) << ": " << lCounts.at(lType) << std::endl;
+    }
+    if (!lKaiFileName.empty()) {
+        std::cout << "expected at XLink Kai: " << lKaiFrames << std::endl;
+    }
+    std::cout << "lock onto SSID: " << lGenerator.GetSSID(0) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureAnalyzer.h
+ *
+ * This file contains an analyzer that gathers per network and per station statistics of monitor mode captures, using
+ * all cores.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "CaptureConverter.h"
+
+namespace CaptureAnalyzer_Constants
+{
+    // Radiotap present flags of the fields the rate is taken from.
+    static constexpr uint32_t cRatePresentFlag{1U << 2U};
+    static constexpr uint32_t cMCSPresentFlag{1U << 19U};
+
+    // Rates are kept in 500 kbps units, MCS indexes get this added so they do not mix with them.
+    static constexpr uint16_t cMCSRate{0x100};
+    static constexpr uint16_t cUnknownRate{0xFFFF};
+
+    // Main types in the frame control field.
+    static constexpr uint8_t cManagementMainType{0b00};
+    static constexpr uint8_t cControlMainType{0b01};
+    static constexpr uint8_t cDataMainType{0b10};
+
+    // Flags in the frame control field telling where the BSSID is.
+    static constexpr uint8_t cToDistributionSystemFlag{0b01};
+    static constexpr uint8_t cFromDistributionSystemFlag{0b10};
+    static constexpr uint8_t cDistributionSystemFlags{cToDistributionSystemFlag | cFromDistributionSystemFlag};
+}  // namespace CaptureAnalyzer_Constants
+
+using namespace CaptureAnalyzer_Constants;
+
+/**
+ * Time between frames of the same sender, gathered so statistics of consecutive parts of a capture can be combined.
+ */
+struct InterArrivalStatistics
+{
+    /**
+     * Adds a frame, frames have to be added in capture order.
+     * @param aTimestamp - Time the frame has been captured at.
+     */
+    void Add(std::chrono::nanoseconds aTimestamp);
+
+    /**
+     * Adds the statistics of the part of the capture right after the part these statistics are of.
+     * @param aLater - Statistics to add.
+     */
+    void Merge(const InterArrivalStatistics& aLater);
+
+    /**
+     * Gets the average time between frames.
+     * @return the average time in nanoseconds, 0 if there were less than two frames.
+     */
+    [[nodiscard]] double GetMean() const;
+
+    /**
+     * Gets the jitter, the standard deviation of the time between frames.
+     * @return the jitter in nanoseconds, 0 if there were less than two frames.
+     */
+    [[nodiscard]] double GetJitter() const;
+
+    uint64_t                 mGaps{0};
+    double                   mMean{0};
+    double                   mSquaredDistance{0}; /**< Sum of squared distances to the mean, see Welford. */
+    std::chrono::nanoseconds mFirst{0};
+    std::chrono::nanoseconds mLast{0};
+    bool                     mEmpty{true};
+};
+
+/**
+ * Statistics of a set of frames: all of them, those of a network or those of a station.
+ */
+struct FrameStatistics
+{
+    /**
+     * Adds the statistics of the part of the capture right after the part these statistics are of.
+     * @param aLater - Statistics to add.
+     */
+    void Merge(const FrameStatistics& aLater);
+
+    /**
+     * Gets the part of the frames that were retries.
+     * @return the retry rate between 0 and 1.
+     */
+    [[nodiscard]] double GetRetryRate() const;
+
+    uint64_t                     mFrames{0};
+    uint64_t                     mBytes{0};
+    uint64_t                     mRetries{0};
+    uint64_t                     mForwarded{0}; /**< Frames the filters would send to XLink Kai. */
+    uint64_t                     mDropped{0};   /**< Frames the filters would not do anything with. */
+    std::map<uint16_t, uint64_t> mRates{};      /**< Frames per rate, see CaptureAnalyzer_Constants. */
+    InterArrivalStatistics       mInterArrival{};
+};
+
+/**
+ * Statistics of a whole capture.
+ */
+struct CaptureStatistics
+{
+    /**
+     * Adds the statistics of the part of the capture right after the part these statistics are of.
+     * @param aLater - Statistics to add.
+     */
+    void Merge(const CaptureStatistics& aLater);
+
+    FrameStatistics                     mTotal{};
+    std::map<uint64_t, FrameStatistics> mBSSIDs{};   /**< Data and management frames per network. */
+    std::map<uint64_t, FrameStatistics> mStations{}; /**< Data and management frames per source MAC. */
+};
+
+/**
+ * Gets a readable rate.
+ * @param aRate - Rate as kept in FrameStatistics.
+ * @return the rate in Mbps, "MCS <index>" or "unknown".
+ */
+std::string RateToText(uint16_t aRate);
+
+/**
+ * Runs the frames of a radiotap capture through the same parsers and filters the program uses, in chunks on all cores,
+ * and gathers statistics per network and per station. The chunks are split up like CaptureConverter does.
+ */
+class CaptureAnalyzer
+{
+public:
+    /**
+     * Sets up the analyzer.
+     * @param aOptions - Filters to see what would be forwarded or dropped, threads and chunk size.
+     */
+    explicit CaptureAnalyzer(ConvertOptions aOptions);
+
+    /**
+     * Analyzes a capture.
+     * @param aInput - Radiotap capture to analyze.
+     * @return true if successful.
+     */
+    bool Analyze(const MappedCapture& aInput);
+
+    /**
+     * Gets the statistics of the last analyzed capture.
+     * @return the statistics.
+     */
+    [[nodiscard]] const CaptureStatistics& GetStatistics() const;
+
+private:
+    [[nodiscard]] CaptureStatistics AnalyzeChunk(const CaptureConverter::Chunk& aChunk) const;
+
+    ConvertOptions    mOptions;
+    CaptureStatistics mStatistics{};
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureController.h
+ *
+ * This file contains a controller that adapts the capture buffer and filter to the amount of packets being dropped.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+
+namespace CaptureController_Constants
+{
+    // Linux' libpcap uses 2 MiB when no buffer size is set, so start from there.
+    static constexpr unsigned int         cInitialBufferSize{2 * 1024 * 1024};
+    static constexpr unsigned int         cMaximumBufferSize{64 * 1024 * 1024};
+    static constexpr std::chrono::seconds cRelaxFilterAfter{30};
+}  // namespace CaptureController_Constants
+
+using namespace CaptureController_Constants;
+
+/**
+ * Changes the controller wants to see applied to the capture handle.
+ */
+struct CaptureAdjustment
+{
+    bool mGrowBuffer{false};    /**< The handle should be re-activated with the new buffer size. */
+    bool mTightenFilter{false}; /**< The tight capture filter should be set. */
+    bool mRelaxFilter{false};   /**< The normal capture filter should be set again. */
+};
+
+/**
+ * Keeps track of the drop counters of a pcap handle and decides when to grow the capture buffer and when to tighten
+ * or relax the capture filter. Busy channels with dozens of access points easily overflow the default buffer.
+ *
+ * Whenever drops are seen the buffer is doubled up to a maximum and the filter is tightened, once no drops have been
+ * seen for a while the filter is relaxed again, the buffer keeps its size.
+ */
+class CaptureController
+{
+public:
+    CaptureController() = default;
+    ~CaptureController();
+
+    CaptureController(const CaptureController& aController) = delete;
+    CaptureController& operator=(const CaptureController& aController) = delete;
+
+    /**
+     * Feeds the latest drop counters from pcap_stats to the controller, also adds the changes since the last update to
+     * the metrics, so those add up over all devices.
+     * @param aKernelDrops - ps_drop from pcap_stats.
+     * @param aInterfaceDrops - ps_ifdrop from pcap_stats.
+     * @param aNow - Current time.
+     * @return the adjustments that should be made to the capture handle.
+     */
+    CaptureAdjustment Update(uint64_t                              aKernelDrops,
+                             uint64_t                              aInterfaceDrops,
+                             std::chrono::steady_clock::time_point aNow);
+
+    /**
+     * Tells the controller the handle has been re-activated, so the counters of pcap_stats start from zero again.
+     */
+    void Restarted();
+
+    /**
+     * Tells the controller the handle could not be re-activated with the current buffer size, so it should stop
+     * trying to grow it.
+     */
+    void RevertBufferSize();
+
+    /**
+     * Gets the buffer size that should be used for the capture handle.
+     * @return the buffer size in bytes.
+     */
+    [[nodiscard]] unsigned int GetBufferSize() const;
+
+    /**
+     * Gets whether the tight capture filter should be used.
+     * @return true if the filter is tightened.
+     */
+    [[nodiscard]] bool IsFilterTightened() const;
+
+    /**
+     * Gets the total amount of kernel drops, over all re-activations of the handle.
+     * @return the total amount of kernel drops.
+     */
+    [[nodiscard]] uint64_t GetKernelDrops() const;
+
+    /**
+     * Gets the total amount of interface drops, over all re-activations of the handle.
+     * @return the total amount of interface drops.
+     */
+    [[nodiscard]] uint64_t GetInterfaceDrops() const;
+
+private:
+    unsigned int                          mBufferSize{cInitialBufferSize};
+    unsigned int                          mMaximumBufferSize{cMaximumBufferSize};
+    bool                                  mFilterTightened{false};
+    uint64_t                              mInterfaceDrops{0};
+    uint64_t                              mKernelDrops{0};
+    std::chrono::steady_clock::time_point mLastDrop{};
+    uint64_t                              mLastInterfaceDrops{0};
+    uint64_t                              mLastKernelDrops{0};
+    // What this controller added to the buffer size and filter gauges, taken out again when it goes away.
+    int64_t                               mPublishedBufferSize{0};
+    int64_t                               mPublishedFilterTightened{0};
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureConverter.h
+ *
+ * This file contains a converter that turns monitor mode captures into promiscuous ones and back, using all cores.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedCapture.h"
+#include "RadioTapReader.h"
+
+class Handler80211;
+class PcapNgWriter;
+
+namespace CaptureConverter_Constants
+{
+    // Packets per chunk, large enough that starting a chunk costs nothing compared to converting it.
+    static constexpr std::size_t cDefaultChunkSize{65536};
+}  // namespace CaptureConverter_Constants
+
+using namespace CaptureConverter_Constants;
+
+/**
+ * How to convert a capture.
+ */
+struct ConvertOptions
+{
+    // For monitor mode captures: SSIDs to lock onto and source MACs to leave out.
+    std::vector<std::string> mSSIDFilter{};
+    std::vector<uint64_t>    mBlackList{};
+
+    // BSSID locked onto before the first beacon, or the BSSID the frames of an ethernet capture get.
+    uint64_t mBSSID{0};
+
+    // Radiotap parameters the frames of an ethernet capture get.
+    RadioTapReader::PhysicalDeviceParameters mParameters{};
+
+    // Threads to convert with, 0 uses all cores.
+    unsigned int mThreads{0};
+    std::size_t  mChunkSize{cDefaultChunkSize};
+};
+
+/**
+ * Converts a radiotap capture to the ethernet frames Handler80211 would send to XLink Kai, or an ethernet capture to
+ * the frames Handler8023 would inject. The capture gets split up in chunks that are converted in parallel; the state
+ * that carries over from one frame to the next, the BSSID locked onto from beacons, is worked out in a cheap pass over
+ * the beacons beforehand, so chunks do not depend on each other. The output keeps the order of the input.
+ */
+class CaptureConverter
+{
+public:
+    /**
+     * A part of a capture that can be handled without looking at the parts in front of it.
+     */
+    struct Chunk
+    {
+        MappedCapture::Cursor mStart{};
+        std::size_t           mPackets{0};
+        uint64_t              mLockedBSSID{0}; /**< BSSID locked onto when the chunk starts, 0 for none. */
+    };
+
+    /**
+     * Splits a capture up in chunks of the chunk size of the options. For radiotap captures the beacons get run through
+     * a handler with the filters of the options beforehand, to find what every chunk starts out locked onto.
+     * @param aInput - Capture to split up.
+     * @param aOptions - Chunk size and filters.
+     * @param aMonitorCapture - Whether the capture is a radiotap capture.
+     * @return the chunks, in capture order.
+     */
+    static std::vector<Chunk> Split(const MappedCapture& aInput, const ConvertOptions& aOptions, bool aMonitorCapture);
+
+    /**
+     * Makes a Handler80211 with the filters of the options.
+     * @param aOptions - Options to take the SSID filter and blacklist from.
+     * @param aBSSID - BSSID to lock onto before any beacon, 0 for none.
+     * @return the handler.
+     */
+    static std::unique_ptr<Handler80211> MakeHandler80211(const ConvertOptions& aOptions, uint64_t aBSSID);
+
+    /**
+     * Sets up the converter.
+     * @param aOptions - How to convert.
+     */
+    explicit CaptureConverter(ConvertOptions aOptions);
+
+    /**
+     * Converts a capture, the link type of the capture decides the direction.
+     * @param aInput - Radiotap or ethernet capture to convert.
+     * @param aOutput - Opened writer to write the converted frames to.
+     * @return true if successful.
+     */
+    bool Convert(const MappedCapture& aInput, PcapNgWriter& aOutput);
+
+    /**
+     * Takes the BSSID and the radiotap parameters of its data frames from a monitor mode capture, so an ethernet
+     * capture can be converted to look like it. Uses the SSID filter and blacklist of the options.
+     * @param aReference - Radiotap capture to take the parameters from.
+     * @return true if a data frame of the locked onto network has been found.
+     */
+    bool TakeParametersFrom(const MappedCapture& aReference);
+
+    /**
+     * Gets the options, including the parameters found by TakeParametersFrom.
+     * @return the options.
+     */
+    [[nodiscard]] const ConvertOptions& GetOptions() const;
+
+    /**
+     * Gets the amount of frames read by the last conversion.
+     * @return amount of frames.
+     */
+    [[nodiscard]] uint64_t GetFramesRead() const;
+
+    /**
+     * Gets the amount of frames written by the last conversion.
+     * @return amount of frames.
+     */
+    [[nodiscard]] uint64_t GetFramesWritten() const;
+
+private:
+    struct ConvertedFrame
+    {
+        std::chrono::nanoseconds mTimestamp{0};
+        std::string              mData{};
+    };
+
+    std::vector<ConvertedFrame> ConvertChunk(const Chunk& aChunk, bool aMonitorCapture) const;
+
+    ConvertOptions mOptions;
+    uint64_t       mFramesRead{0};
+    uint64_t       mFramesWritten{0};
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - FlightRecorder.h
+ *
+ * This file contains a flight recorder which keeps the last frames seen by the engine in memory, so they can be dumped
+ * to a file after something went wrong.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace FlightRecorder_Constants
+{
+    static constexpr std::size_t      cDefaultFrameCount{1024};
+    static constexpr std::size_t      cMaxFrameLength{2368};
+    static constexpr std::string_view cDumpFilePrefix{"flightrecorder_"};
+    static constexpr std::string_view cDumpFileExtension{".pcapng"};
+
+    /**
+     * Where in the engine the frame has been seen.
+     */
+    enum class Stage
+    {
+        MonitorReceived = 0, /**< Received from the monitor mode adapter. */
+        MonitorSent,         /**< Injected on the monitor mode adapter. */
+        PluginReceived,      /**< Received from the PSP plugin adapter. */
+        PluginSent,          /**< Sent on the PSP plugin adapter. */
+        KaiReceived,         /**< Received from XLink Kai. */
+        KaiSent              /**< Sent to XLink Kai. */
+    };
+
+    static constexpr std::array<std::string_view, 6> cStageTexts{
+        "MonitorReceived", "MonitorSent", "PluginReceived", "PluginSent", "KaiReceived", "KaiSent"};
+
+    /**
+     * What the engine decided to do with the frame.
+     */
+    enum class Verdict
+    {
+        Dropped = 0, /**< Frame has been filtered out. */
+        Accepted,    /**< Frame has been used internally, but not forwarded (for example a beacon). */
+        Forwarded,   /**< Frame has been forwarded to the other side. */
+        Sent,        /**< Frame has been sent successfully. */
+        Failed       /**< Sending the frame failed. */
+    };
+
+    static constexpr std::array<std::string_view, 5> cVerdictTexts{
+        "Dropped", "Accepted", "Forwarded", "Sent", "Failed"};
+}  // namespace FlightRecorder_Constants
+
+using namespace FlightRecorder_Constants;
+
+/**
+ * Keeps the last N frames in a fixed size ring in memory. Recording does no allocations and no I/O, the ring only gets
+ * written to disk (as pcapng) when Dump is called.
+ */
+class FlightRecorder
+{
+public:
+    FlightRecorder(const FlightRecorder& aFlightRecorder) = delete;
+    FlightRecorder& operator=(const FlightRecorder& aFlightRecorder) = delete;
+
+    FlightRecorder& operator=(FlightRecorder&& aFlightRecorder) = delete;
+    FlightRecorder(FlightRecorder&& aFlightRecorder)            = delete;
+
+    /**
+     * Gets the FlightRecorder singleton.
+     * @return The FlightRecorder object.
+     */
+    static FlightRecorder& GetInstance()
+    {
+        static FlightRecorder lInstance;
+        return lInstance;
+    }
+
+    /**
+     * Allocates the ring, until this is called nothing will be recorded.
+     * @note Call this before any thread starts recording.
+     * @param aFrameCount - Amount of frames to keep.
+     * @param aDumpDirectory - Directory to put the dumps in, including trailing separator.
+     */
+    void Init(std::size_t aFrameCount, std::string_view aDumpDirectory);
+
+    /**
+     * Records a frame, can be called from any thread.
+     * @param aStage - Where in the engine the frame has been seen.
+     * @param aVerdict - What the engine did with the frame.
+     * @param aData - The frame itself, truncated to cMaxFrameLength.
+     * @param aCaptureTime - Timestamp given by pcap since epoch, 0 if there is none.
+     */
+    void Record(Stage                    aStage,
+                Verdict                  aVerdict,
+                std::string_view         aData,
+                std::chrono::nanoseconds aCaptureTime = std::chrono::nanoseconds{0});
+
+    /**
+     * Dumps the ring to a pcapng file in the dump directory, named after the time and reason.
+     * @param aReason - Why the dump has been made, ends up in the filename.
+     * @return true if successful.
+     */
+    bool Dump(std::string_view aReason);
+
+    /**
+     * Dumps the ring to the given pcapng file. Recording continues while dumping, frames that are overwritten while
+     * being copied are skipped.
+     * @param aPath - Path of the file to dump to.
+     * @return true if successful.
+     */
+    bool DumpToFile(std::string_view aPath);
+
+    /**
+     * Gets the amount of frames the ring can hold.
+     * @return amount of frames, 0 if not initialized.
+     */
+    [[nodiscard]] std::size_t GetFrameCount() const;
+
+private:
+    FlightRecorder()  = default;
+    ~FlightRecorder() = default;
+
+    struct Slot
+    {
+        // Even when complete, odd while being written, 0 if never written.
+        std::atomic<uint64_t>             mSequence{0};
+        Stage                             mStage{Stage::MonitorReceived};
+        Verdict                           mVerdict{Verdict::Dropped};
+        uint32_t                          mLength{0};
+        uint32_t                          mCapturedLength{0};
+        int64_t                           mRecordTime{0};
+        int64_t                           mCaptureTime{0};
+        std::array<char, cMaxFrameLength> mData{};
+    };
+
+    std::unique_ptr<Slot[]> mSlots{nullptr};
+    std::size_t             mSlotCount{0};
+    std::atomic<uint64_t>   mHead{0};
+    std::mutex              mDumpMutex{};
+    std::string             mDumpDirectory{};
+};
@@ -6,15 +6,50 @@
  *
  **/
 
+#include <array>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "IHandler.h"
+#include "NetworkCache.h"
+#include "NetworkTable.h"
 #include "NetworkingHeaders.h"
 #include "Parameter80211Reader.h"
 #include "RadioTapReader.h"
 
+namespace Handler80211_Constants
+{
+    // Several game lobbies can share a channel at a tournament, a channel is saturated long before this many.
+    static constexpr std::size_t cMaxSessions{8};
+}  // namespace Handler80211_Constants
+
+using namespace Handler80211_Constants;
+
+/**
+ * State kept for every network the handler is locked onto.
+ */
+struct NetworkSession
+{
+    uint64_t                                 mBSSID{0};
+    std::string                              mSSID{};
+    bool                                     mConfirmed{false}; /**< A beacon of the network has been seen. */
+    bool                                     mIsAdhoc{true};
+    RadioTapReader::PhysicalDeviceParameters mParametersData{}; /**< What data frames were received with. */
+    std::vector<uint64_t>                    mPeers{};          /**< Stations that sent data in the network. */
+};
+
+/**
+ * Where a frame coming from XLink Kai has to be sent to.
+ */
+struct NetworkRoute
+{
+    uint64_t                                 mBSSID{0};
+    RadioTapReader::PhysicalDeviceParameters mParameters{};
+};
+
 /**
  * This class reads packets from a monitor format and converts to a promiscuous format.
  **/
@@ -37,9 +72,9 @@ public:
     /**
      * This function converts a monitor mode packet to a promiscuous mode packet, stripping the radiotap and
      * 802.11 header and adding an 802.3 header. Only converts data packets!
-     * @return converted packet data, empty string if failed.
+     * @return converted packet data, empty string if failed. Only valid until the next conversion.
      */
-    std::string ConvertPacket();
+    const std::string& ConvertPacket();
 
     /**
      * Gets parameters for a control packet type, for example used for constructing acknowledgement frames.
@@ -53,17 +88,51 @@ public:
      */
     const RadioTapReader::PhysicalDeviceParameters& GetDataPacketParameters();
 
+    /**
+     * Gets the BSSID of the last frame, for a frame that should be sent this is the network it came from.
+     * @return the BSSID.
+     */
+    [[nodiscard]] uint64_t GetBSSID() const;
+
     [[nodiscard]] uint64_t GetDestinationMAC() const override;
     [[nodiscard]] uint64_t GetSourceMAC() const override;
 
     /**
-     * Gets locked onto BSSID.
+     * Gets locked onto BSSID, with multiple networks this is the first one locked onto that is still there.
      * @return the locked onto BSSID.
      */
     [[nodiscard]] uint64_t GetLockedBSSID() const;
 
+    /**
+     * Gets the network locked onto, with the stations that sent data in it, so it can be cached for the next session.
+     * @return the network, with a BSSID of 0 if not locked onto any.
+     */
+    [[nodiscard]] CachedNetwork GetLockedNetwork() const;
+
     std::string_view GetPacket() override;
 
+    /**
+     * Gets where a frame for a station has to be sent to. A station that sent data in one of the networks gets it in
+     * that network, broadcasts and unknown stations get it in every network. Safe to call from another thread.
+     * @param aDestinationMAC - Station the frame is for.
+     * @param aRoutes - Filled in with the networks to send the frame in.
+     * @return the amount of routes filled in, 0 if not locked onto any network.
+     */
+    std::size_t GetRoutes(uint64_t aDestinationMAC, std::array<NetworkRoute, cMaxSessions>& aRoutes) const;
+
+    /**
+     * Counts the changes to the networks locked onto, whether they have been confirmed and the locked BSSID, so what
+     * has been built from them can be rebuilt when they change. Safe to call from another thread.
+     * @return the amount of changes so far.
+     */
+    [[nodiscard]] uint64_t GetSessionChanges() const;
+
+    /**
+     * Gets the networks locked onto. Safe to call from another thread.
+     * @return copy of the sessions, ordered by BSSID.
+     */
+    [[nodiscard]] std::vector<NetworkSession> GetSessions() const;
+
     /**
      * Checks if a packet is ackable.
      * @return true is packet is ackable.
@@ -122,15 +191,55 @@ public:
      */
     void SetMACWhiteList(std::vector<uint64_t>& aWhiteList);
 
+    /**
+     * Sets whether every network matching the SSID filter gets forwarded at once, instead of only the one locked onto.
+     * @param aMultiNetwork - true to lock onto up to cMaxSessions networks.
+     */
+    void SetMultiNetwork(bool aMultiNetwork);
+
+    /**
+     * Locks onto a network of an earlier session before any of its beacons has been seen, so frames get forwarded
+     * right away. Until a beacon confirms the lock, a data frame of a known peer moves the lock to the network that
+     * peer is in now, as adhoc networks get a new BSSID every session.
+     * @param aNetwork - Network to lock onto.
+     */
+    void SetCachedNetwork(const CachedNetwork& aNetwork);
+
+    /**
+     * Sets the table every beacon gets recorded in, whatever the filters. While the locked onto network is still in
+     * the table, other networks matching the SSID filter do not take over the lock.
+     * @param aNetworkTable - Table to record the networks in, nullptr to stop recording them.
+     */
+    void SetNetworkTable(std::shared_ptr<NetworkTable> aNetworkTable);
+
     /**
      * Sets the SSID to filter on.
      */
-    void SetSSIDFilterList(std::vector<std::string>& aSSIDList);
+    void SetSSIDFilterList(const std::vector<std::string>& aSSIDList);
 
     void Update(std::string_view aPacket) override;
 
 private:
+    /**
+     * Adds a session for a network, without multiple networks it replaces the one there was. mSessionMutex has to be
+     * held.
+     * @param aBSSID - BSSID of the network.
+     * @return the session, nullptr if there is no room for it.
+     */
+    NetworkSession* AddSession(uint64_t aBSSID);
+
+    /**
+     * Adds a station that sent data to a session, mSessionMutex has to be held.
+     * @param aSession - Session of the network the station is in.
+     * @param aMAC - MAC address of the station.
+     */
+    void AddPeer(NetworkSession& aSession, uint64_t aMAC);
+
+    void LockOnto(uint64_t aBSSID);
+    void MoveSession(uint64_t aFrom, uint64_t aTo);
+    void RemoveSession(uint64_t aBSSID);
     void UpdateBSSID();
+    void UpdateNetworkTable();
     void UpdateControlPacketType();
     void UpdateDataPacketType();
     void UpdateMainPacketType();
@@ -142,6 +251,7 @@ private:
 
     // Save last data in this class
     std::string mLastReceivedData{};
+    std::string mConvertedPacket{};
 
     std::vector<uint64_t>    mBlackList{};
     std::vector<std::string> mSSIDList{};
@@ -156,11 +266,21 @@ private:
     uint64_t mBSSID{0};
     uint64_t mDestinationMac{0};
     uint64_t mLockedBSSID{0};
+    bool     mMultiNetwork{false};
     bool     mRetry{false};
     bool     mShouldSend{false};
     uint64_t mSourceMac{0};
     bool     mIsDropped{false};
 
+    // Networks locked onto, and the network every station that sent data is in, so every frame is looked up in O(1).
+    std::unordered_map<uint64_t, NetworkSession> mSessions{};
+    std::unordered_map<uint64_t, uint64_t>       mStations{};
+    uint64_t                                     mSessionChanges{0};
+    // Guards changes to the sessions and to the parameters routes fall back on, XLink Kai looks routes up from its own
+    // thread.
+    mutable std::mutex                           mSessionMutex{};
+
+    std::shared_ptr<NetworkTable>         mNetworkTable{nullptr};
     std::shared_ptr<Parameter80211Reader> mParameter80211Reader{nullptr};
     std::shared_ptr<RadioTapReader>       mPhysicalDeviceHeaderReader{nullptr};
 
@@ -31,9 +31,9 @@ public:
      * 802.11 header and removing the 802.3 header.
      * @param aBSSID - BSSID to use when inserting the 80211 header.
      * @param aParameters - Parameters to use to convert to 80211.
-     * @return converted packet data, empty string if failed.
+     * @return converted packet data, empty string if failed. Only valid until the next conversion.
      */
-    std::string ConvertPacket(uint64_t aBSSID, RadioTapReader::PhysicalDeviceParameters aParameters);
+    const std::string& ConvertPacket(uint64_t aBSSID, RadioTapReader::PhysicalDeviceParameters aParameters);
 
     [[nodiscard]] uint64_t GetDestinationMAC() const override;
     std::string_view       GetPacket() override;
@@ -49,6 +49,7 @@ public:
 
 private:
     std::string mLastReceivedData{};
+    std::string mConvertedPacket{};
     uint64_t    mSourceMAC{0};
     uint64_t    mDestinationMAC{0};
 
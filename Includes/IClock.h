@@ -0,0 +1,39 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - IClock.h
+ *
+ * This file contains an interface for clocks, so timers and waits can run on real or on simulated time.
+ *
+ **/
+
+#include <chrono>
+
+/**
+ * Interface for clocks.
+ */
+class IClock
+{
+public:
+    /**
+     * Gets the current time of this clock.
+     * @return the current time.
+     */
+    virtual std::chrono::steady_clock::time_point Now() = 0;
+
+    /**
+     * Waits until the clock reaches a point in time, returns right away if it already has.
+     * @param aDeadline - Time to wait for.
+     */
+    virtual void SleepUntil(std::chrono::steady_clock::time_point aDeadline) = 0;
+
+    /**
+     * Waits for an amount of time on this clock.
+     * @param aDuration - Time to wait.
+     */
+    void SleepFor(std::chrono::steady_clock::duration aDuration)
+    {
+        SleepUntil(Now() + aDuration);
+    }
+
+    virtual ~IClock() = default;
+};
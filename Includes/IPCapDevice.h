@@ -51,7 +51,7 @@ public:
      * @param aSSIDFilter - The SSIDS to listen to.
      * @return true if successful.
      */
-    virtual bool Open(std::string_view aName, std::vector<std::string>& aSSIDFilter) = 0;
+    virtual bool Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter) = 0;
 
     /**
      * Returns data as string.
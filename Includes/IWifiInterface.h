@@ -2,6 +2,7 @@
 
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -27,6 +28,18 @@ public:
         bool                   isconnected;
     };
 
+    /**
+     * An adhoc network the adapter joined or left.
+     */
+    struct IBSSEvent
+    {
+        bool                   joined;
+        std::array<uint8_t, 6> bssid;
+    };
+
+    using ScanResultsCallback = std::function<void()>;
+    using IBSSCallback        = std::function<void(const IBSSEvent&)>;
+
     /**
      * Connects to a wireless network.
      * @param aConnection - Network to connect to.
@@ -48,8 +61,21 @@ public:
     virtual uint64_t GetAdapterMACAddress() = 0;
 
     /**
-     * Gets the adhoc networks the network adapter has found.
+     * Gets the adhoc networks the network adapter has found. Implementations that scan in the background return the
+     * last results right away and start a new scan when those are getting old.
      * @return a list of adhoc networks, an empty list if none found.
      */
     virtual std::vector<WifiInformation>& GetAdhocNetworks() = 0;
+
+    /**
+     * Sets the function that gets called when a background scan has new results for GetAdhocNetworks().
+     * @param aCallback - Function to call, nullptr to stop calling it.
+     */
+    virtual void SetScanResultsCallback(ScanResultsCallback aCallback) = 0;
+
+    /**
+     * Sets the function that gets called when the adapter joined or left an adhoc network.
+     * @param aCallback - Function to call, nullptr to stop calling it.
+     */
+    virtual void SetIBSSCallback(IBSSCallback aCallback) = 0;
 };
@@ -0,0 +1,123 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - LatencyTrace.h
+ *
+ * This file contains a per-frame latency trace, which follows a frame through the engine.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include <pcap/pcap.h>
+
+#include "Metrics.h"
+
+namespace LatencyTrace_Constants
+{
+    // Slow frames are logged at most this often, the others are only counted.
+    static constexpr std::chrono::seconds cSlowFrameLogInterval{1};
+
+    /**
+     * Which way the frame is going.
+     */
+    enum class Direction
+    {
+        AirToKai = 0,
+        KaiToAir
+    };
+
+    /**
+     * Points in time recorded for a frame.
+     */
+    enum class Point
+    {
+        Origin = 0, /**< Capture timestamp from pcap, or receipt from XLink Kai. */
+        Started,    /**< Engine started working on the frame, the read callback for captured frames. */
+        Converted,  /**< Frame has been converted. */
+        Sent,       /**< Sending the frame returned, send_to or pcap_sendpacket. */
+        Count       /**< Amount of points, not a point. */
+    };
+
+    static constexpr std::size_t cPointCount{static_cast<std::size_t>(Point::Count)};
+
+    static constexpr std::array<std::string_view, cPointCount> cPointTexts{"origin", "started", "converted", "sent"};
+
+    // Histogram per step ending at the point after Origin, Histogram::Count if the step is not recorded. Steps start at
+    // the last point that has been recorded.
+    static constexpr std::array<std::array<Histogram, cPointCount - 1>, 2> cStepHistograms{
+        {{Histogram::CaptureToCallback, Histogram::CallbackToConverted, Histogram::ConvertedToKaiSent},
+         {Histogram::Count, Histogram::KaiToConverted, Histogram::ConvertedToInject}}};
+
+    // Histogram from the origin until the frame has been sent.
+    static constexpr std::array<Histogram, 2> cTotalHistograms{Histogram::CaptureToKai, Histogram::KaiToInject};
+}  // namespace LatencyTrace_Constants
+
+using namespace LatencyTrace_Constants;
+
+/**
+ * Keeps the points in time a frame passes through, when finished the steps go into the histograms of the metrics
+ * registry, and frames exceeding the slow frame budget get their breakdown logged. All times are since epoch, so
+ * they can be compared with pcap timestamps. Only logging allocates, so this is fine to use per frame.
+ */
+class LatencyTrace
+{
+public:
+    /**
+     * Starts a trace.
+     * @param aDirection - Which way the frame is going.
+     * @param aOrigin - Time since epoch the frame originated, for example the pcap capture timestamp.
+     */
+    LatencyTrace(Direction aDirection, std::chrono::nanoseconds aOrigin);
+
+    /**
+     * Records the current time for the given point.
+     * @param aPoint - Point to record.
+     */
+    void Mark(Point aPoint);
+
+    /**
+     * Gets the time recorded for a point.
+     * @param aPoint - Point to get.
+     * @return the time since epoch, 0 if not recorded.
+     */
+    [[nodiscard]] std::chrono::nanoseconds Get(Point aPoint) const;
+
+    /**
+     * Puts the steps in the histograms, logs the breakdown if the frame took longer than the budget.
+     */
+    void Finish();
+
+    /**
+     * Sets the budget above which frames get logged, for all traces.
+     * @param aBudget - Budget from origin until sent, 0 to disable logging slow frames.
+     */
+    static void SetSlowFrameBudget(std::chrono::nanoseconds aBudget);
+
+    /**
+     * Gets the current time since epoch.
+     * @return the current time.
+     */
+    static std::chrono::nanoseconds Now();
+
+    /**
+     * Converts a pcap timestamp to time since epoch.
+     * @param aTimestamp - The timestamp from the pcap header.
+     * @param aNanoseconds - Whether the handle was set to nanosecond precision, tv_usec holds nanoseconds then.
+     * @return the time since epoch.
+     */
+    static std::chrono::nanoseconds FromTimestamp(const timeval& aTimestamp, bool aNanoseconds);
+
+private:
+    void LogSlowFrame(std::chrono::nanoseconds aTotal) const;
+
+    Direction                                         mDirection;
+    std::array<std::chrono::nanoseconds, cPointCount> mPoints{};
+
+    static std::atomic<int64_t>  mSlowFrameBudget;
+    static std::atomic<int64_t>  mLastSlowFrameLog;
+    static std::atomic<uint64_t> mSuppressedSlowFrames;
+};
@@ -17,6 +17,7 @@
 
 #include <sstream>
 #include <string>
+#include <string_view>
 
 
 /**
@@ -73,12 +74,21 @@ public:
      * @param aLocation - Source location (keep empty).
      */
 #if defined(__GNUC__) || defined(__GNUG__)
-    void Log(const std::string&                        aText,
+    void Log(std::string_view                          aText,
              Level                                     aLevel,
              const std::experimental::source_location& aLocation = std::experimental::source_location::current());
 #else
-    void Log(const std::string& aText, Level aLevel);
+    void Log(std::string_view aText, Level aLevel);
 #endif
+
+    /**
+     * Checks whether a message of this level ends up anywhere, so callers can skip building a message that would be
+     * thrown away.
+     * @param aLevel - Loglevel of the message.
+     * @return true if the message would be logged.
+     */
+    [[nodiscard]] bool ShouldLog(Level aLevel) const;
+
     /**
      * Gets the loglevel
      */
@@ -0,0 +1,112 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - MPSCQueue.h
+ *
+ * This file contains a bounded lock-free queue that multiple threads can push into and one thread pops from.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace MPSCQueue_Constants
+{
+    // Keeps the producer and consumer positions on their own cache lines, so they do not slow each other down.
+    static constexpr std::size_t cCacheLineSize{64};
+}  // namespace MPSCQueue_Constants
+
+using namespace MPSCQueue_Constants;
+
+/**
+ * Bounded multiple producer, single consumer queue on a ring of cells that each carry a sequence number. Producers
+ * claim a cell with a compare and swap on the push position, fill it in place and publish it by bumping its sequence,
+ * the consumer reads the cell once it has been published and hands it back the same way. Nothing gets allocated or
+ * locked after construction, a full queue makes TryPush fail instead of blocking.
+ * @tparam Type - Type of the cells, filled in place so big types do not get copied around.
+ * @tparam aCapacity - Amount of cells, has to be a power of two.
+ */
+template<typename Type, std::size_t aCapacity> class MPSCQueue
+{
+    static_assert((aCapacity >= 2) && ((aCapacity & (aCapacity - 1)) == 0), "Capacity has to be a power of two");
+
+public:
+    MPSCQueue()
+    {
+        for (std::size_t lIndex = 0; lIndex < aCapacity; lIndex++) {
+            mCells.at(lIndex).mSequence.store(lIndex, std::memory_order_relaxed);
+        }
+    }
+
+    MPSCQueue(const MPSCQueue& aQueue) = delete;
+    MPSCQueue& operator=(const MPSCQueue& aQueue) = delete;
+
+    /**
+     * Claims a cell and fills it, can be called from any thread.
+     * @param aFill - Called with a reference to the cell to fill in.
+     * @return false if the queue is full, aFill has not been called then.
+     */
+    template<typename Function> bool TryPush(Function&& aFill)
+    {
+        bool        lReturn{false};
+        bool        lDone{false};
+        std::size_t lPosition{mPushPosition.load(std::memory_order_relaxed)};
+        Cell*       lCell{nullptr};
+
+        while (!lDone) {
+            lCell = &mCells[lPosition & (aCapacity - 1)];
+            auto lDifference{static_cast<intptr_t>(lCell->mSequence.load(std::memory_order_acquire)) -
+                             static_cast<intptr_t>(lPosition)};
+
+            if (lDifference == 0) {
+                // The cell is free, claim it unless another producer got there first.
+                lReturn = mPushPosition.compare_exchange_weak(lPosition, lPosition + 1, std::memory_order_relaxed);
+                lDone   = lReturn;
+            } else if (lDifference < 0) {
+                // The consumer has not handed this cell back yet, so the queue is full.
+                lDone = true;
+            } else {
+                lPosition = mPushPosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        if (lReturn) {
+            aFill(lCell->mValue);
+            lCell->mSequence.store(lPosition + 1, std::memory_order_release);
+        }
+
+        return lReturn;
+    }
+
+    /**
+     * Takes the oldest cell out of the queue, may only be called from the consumer thread.
+     * @param aConsume - Called with a reference to the cell, which gets reused after aConsume returns.
+     * @return false if the queue is empty, aConsume has not been called then.
+     */
+    template<typename Function> bool TryPop(Function&& aConsume)
+    {
+        bool  lReturn{false};
+        Cell& lCell{mCells[mPopPosition & (aCapacity - 1)]};
+
+        if (lCell.mSequence.load(std::memory_order_acquire) == (mPopPosition + 1)) {
+            aConsume(lCell.mValue);
+            lCell.mSequence.store(mPopPosition + aCapacity, std::memory_order_release);
+            mPopPosition++;
+            lReturn = true;
+        }
+
+        return lReturn;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> mSequence{0};
+        Type                     mValue{};
+    };
+
+    std::array<Cell, aCapacity>                      mCells{};
+    alignas(cCacheLineSize) std::atomic<std::size_t> mPushPosition{0};
+    alignas(cCacheLineSize) std::size_t              mPopPosition{0};
+};
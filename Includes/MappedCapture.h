@@ -0,0 +1,233 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - MappedCapture.h
+ *
+ * This file contains a reader for pcap and pcapng files that maps the whole file into memory, so packets can be read
+ * without copying them, from any point in the capture.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MappedCapture_Constants
+{
+    static constexpr uint32_t cPcapMagicMicroseconds{0xA1B2C3D4};
+    static constexpr uint32_t cPcapMagicNanoseconds{0xA1B23C4D};
+    static constexpr uint32_t cPcapFileHeaderLength{24};
+    static constexpr uint32_t cPcapLinkTypeIndex{20};
+    static constexpr uint32_t cPcapRecordHeaderLength{16};
+
+    static constexpr uint32_t cSectionHeaderBlockType{0x0A0D0D0A};
+    static constexpr uint32_t cInterfaceDescriptionBlockType{0x00000001};
+    static constexpr uint32_t cObsoletePacketBlockType{0x00000002};
+    static constexpr uint32_t cSimplePacketBlockType{0x00000003};
+    static constexpr uint32_t cEnhancedPacketBlockType{0x00000006};
+    static constexpr uint32_t cByteOrderMagic{0x1A2B3C4D};
+
+    // Block type and block length in front, block length again at the end.
+    static constexpr uint32_t cBlockHeaderLength{8};
+    static constexpr uint32_t cBlockTrailerLength{4};
+    static constexpr uint32_t cSectionHeaderLength{24};
+
+    static constexpr uint16_t cOptionEndOfOptions{0};
+    static constexpr uint16_t cOptionTimestampResolution{9};
+    static constexpr uint16_t cOptionTimestampOffset{14};
+
+    // Interfaces without a timestamp resolution option use microseconds.
+    static constexpr uint8_t cDefaultTimestampResolution{6};
+}  // namespace MappedCapture_Constants
+
+/**
+ * A packet in a mapped capture. The data points into the mapping, so it stays valid until the capture gets closed.
+ */
+struct CapturedPacket
+{
+    std::chrono::nanoseconds mTimestamp{0};      /**< Time since epoch, 0 for simple packet blocks which have none. */
+    std::string_view         mData{};            /**< Captured bytes. */
+    uint32_t                 mOriginalLength{0}; /**< Length of the packet before it got truncated. */
+    uint32_t                 mInterface{0};      /**< Interface within the pcapng section, 0 for pcap files. */
+    uint16_t                 mLinkType{0};       /**< Link type of the interface, for example 127 for radiotap. */
+};
+
+/**
+ * Class that maps a pcap or pcapng file into memory. Packets are read through cursors, which are cheap to copy and
+ * independent of each other, so a capture can be read from multiple places at once. An optional index of timestamps
+ * makes seeking to a point in time O(log n).
+ */
+class MappedCapture
+{
+private:
+    struct Interface
+    {
+        uint16_t mLinkType{0};
+        uint32_t mSnapshotLength{0};
+        uint8_t  mResolution{MappedCapture_Constants::cDefaultTimestampResolution};
+        int64_t  mOffset{0};
+    };
+
+    // Everything needed to read the packets of a pcapng section, or of a whole pcap file.
+    struct Section
+    {
+        uint32_t               mNumber{0};
+        bool                   mSwapped{false};
+        std::vector<Interface> mInterfaces{};
+    };
+
+public:
+    /**
+     * Reads packets from a mapped capture, one after another in file order.
+     */
+    class Cursor
+    {
+    public:
+        Cursor() = default;
+
+        /**
+         * Creates a cursor pointing to the first packet of a capture.
+         * @param aCapture - Capture to read, has to stay open while the cursor gets used.
+         */
+        explicit Cursor(const MappedCapture& aCapture);
+
+        /**
+         * Reads the next packet and moves past it.
+         * @param aPacket - Packet to fill in.
+         * @return false at the end of the capture or when the rest of the file is malformed.
+         */
+        bool Next(CapturedPacket& aPacket);
+
+        /**
+         * Points the cursor to the first packet with a timestamp at or after the given time, in file order. Uses the
+         * index when it has been built, otherwise reads from the start.
+         * @param aTime - Time since epoch to seek to.
+         * @return true if there is such a packet, otherwise the cursor is at the end of the capture.
+         */
+        bool Seek(std::chrono::nanoseconds aTime);
+
+        /**
+         * Points the cursor back to the first packet.
+         */
+        void Rewind();
+
+        /**
+         * Gets the position of the cursor in the file.
+         * @return offset in bytes.
+         */
+        [[nodiscard]] std::size_t GetOffset() const;
+
+    private:
+        friend class MappedCapture;
+
+        bool NextPcap(CapturedPacket& aPacket);
+        bool NextPcapNg(CapturedPacket& aPacket);
+        void ReadSectionHeader();
+        void ReadInterface(uint32_t aLength);
+        bool SetPacket(CapturedPacket& aPacket,
+                       uint32_t        aInterface,
+                       uint64_t        aTimestamp,
+                       std::size_t     aDataOffset,
+                       uint32_t        aCapturedLength,
+                       uint32_t        aOriginalLength) const;
+
+        const MappedCapture* mCapture{nullptr};
+        std::size_t          mOffset{0};
+        std::size_t          mPacketOffset{0};
+        Section              mSection{};
+    };
+
+    MappedCapture() = default;
+    ~MappedCapture();
+
+    MappedCapture(const MappedCapture& aMappedCapture) = delete;
+    MappedCapture& operator=(const MappedCapture& aMappedCapture) = delete;
+
+    /**
+     * Maps a capture file into memory and checks whether it is a pcap or pcapng file.
+     * @param aPath - Path of the file to read.
+     * @return true if successful.
+     */
+    bool Open(std::string_view aPath);
+
+    /**
+     * Unmaps the file, cursors and packets read from it can no longer be used.
+     */
+    void Close();
+
+    /**
+     * Checks if a capture is mapped.
+     * @return true if open.
+     */
+    [[nodiscard]] bool IsOpen() const;
+
+    /**
+     * Checks if the capture is a pcapng file.
+     * @return true if pcapng, false if pcap.
+     */
+    [[nodiscard]] bool IsPcapNg() const;
+
+    /**
+     * Gets the link type of the capture, for pcapng files the one of the first interface.
+     * @return link type, for example 127 for radiotap.
+     */
+    [[nodiscard]] uint16_t GetLinkType() const;
+
+    /**
+     * Gets the whole file as it is mapped.
+     * @return the file contents.
+     */
+    [[nodiscard]] std::string_view GetContents() const;
+
+    /**
+     * Reads the whole capture once and remembers where the packets are, so cursors can seek in O(log n).
+     * @param aStride - Remember every this many packets, higher strides save memory but make seeking read more.
+     * @return true if the capture could be read until the end.
+     */
+    bool BuildIndex(std::size_t aStride = 1);
+
+    /**
+     * Checks if the index has been built.
+     * @return true if built.
+     */
+    [[nodiscard]] bool IsIndexed() const;
+
+    /**
+     * Gets the amount of packets found while building the index.
+     * @return amount of packets, 0 if there is no index.
+     */
+    [[nodiscard]] std::size_t GetPacketCount() const;
+
+    /**
+     * Creates a cursor pointing to the first packet.
+     * @return the cursor.
+     */
+    [[nodiscard]] Cursor GetCursor() const;
+
+private:
+    struct IndexEntry
+    {
+        // Highest timestamp seen up to and including this packet, so entries stay sorted in unsorted captures.
+        std::chrono::nanoseconds mMaximumTimestamp{0};
+        std::size_t              mOffset{0};
+        uint32_t                 mSection{0};
+    };
+
+    bool Map(std::string_view aPath);
+    void Unmap();
+
+    const char*             mData{nullptr};
+    std::size_t             mSize{0};
+    bool                    mPcapNg{false};
+    Section                 mFileSection{};
+    uint16_t                mLinkType{0};
+    std::vector<IndexEntry> mIndex{};
+    std::vector<Section>    mSections{};
+    std::size_t             mPacketCount{0};
+
+#if defined(_WIN32) || defined(_WIN64)
+    void* mFile{nullptr};
+    void* mMapping{nullptr};
+#endif
+};
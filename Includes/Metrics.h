@@ -0,0 +1,369 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - Metrics.h
+ *
+ * This file contains a metrics registry with counters and latency histograms that can be updated from the packet
+ * handling threads without those threads ever sharing a cache line.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Metrics_Constants
+{
+    /**
+     * Counters, every thread has its own copy of these which are summed up when taking a snapshot.
+     */
+    enum class Counter
+    {
+        AirFramesReceived = 0, /**< Frames received from the wireless adapter. */
+        AirBytesReceived,      /**< Bytes received from the wireless adapter. */
+        AirFramesSent,         /**< Frames injected on the wireless adapter. */
+        AirBytesSent,          /**< Bytes injected on the wireless adapter. */
+        AirSendFailures,       /**< Frames that could not be injected. */
+        KaiFramesReceived,     /**< Ethernet frames received from XLink Kai. */
+        KaiBytesReceived,      /**< Ethernet bytes received from XLink Kai. */
+        KaiFramesSent,         /**< Ethernet frames sent to XLink Kai. */
+        KaiBytesSent,          /**< Ethernet bytes sent to XLink Kai. */
+        KaiSendFailures,       /**< Messages that could not be sent to XLink Kai. */
+        KaiKeepAlives,         /**< Keepalives received from XLink Kai. */
+        KaiDisconnects,        /**< Times XLink Kai disconnected us or stopped responding. */
+        AcksSent,              /**< Acknowledgement frames injected. */
+        ConvertedToEthernet,   /**< 802.11 frames converted to 802.3. */
+        ConvertedToWireless,   /**< 802.3 frames converted to 802.11. */
+        DroppedBSSID,          /**< Data frames dropped because they are not from the locked BSSID. */
+        DroppedMACFilter,      /**< Frames dropped because of the MAC black- or whitelist. */
+        DroppedSSIDFilter,     /**< Beacons dropped because the SSID is not in the filter list. */
+        DroppedRetry,          /**< Data frames dropped because they are retransmissions. */
+        DroppedInvalidLength,  /**< Frames dropped because they are too short to convert. */
+        DroppedDeviceQueue,    /**< Frames dropped because the queue from the devices to XLink Kai was full. */
+        KernelDrops,           /**< Packets dropped by the kernel because the capture buffer was full (pcap_stats). */
+        InterfaceDrops,        /**< Packets dropped by the network interface or driver (pcap_stats). */
+        Count                  /**< Amount of counters, not a counter. */
+    };
+
+    static constexpr std::size_t cCounterCount{static_cast<std::size_t>(Counter::Count)};
+
+    static constexpr std::array<std::string_view, cCounterCount> cCounterTexts{"air_frames_received",
+                                                                               "air_bytes_received",
+                                                                               "air_frames_sent",
+                                                                               "air_bytes_sent",
+                                                                               "air_send_failures",
+                                                                               "kai_frames_received",
+                                                                               "kai_bytes_received",
+                                                                               "kai_frames_sent",
+                                                                               "kai_bytes_sent",
+                                                                               "kai_send_failures",
+                                                                               "kai_keepalives",
+                                                                               "kai_disconnects",
+                                                                               "acks_sent",
+                                                                               "converted_to_ethernet",
+                                                                               "converted_to_wireless",
+                                                                               "dropped_bssid",
+                                                                               "dropped_mac_filter",
+                                                                               "dropped_ssid_filter",
+                                                                               "dropped_retry",
+                                                                               "dropped_invalid_length",
+                                                                               "dropped_device_queue",
+                                                                               "kernel_drops",
+                                                                               "interface_drops"};
+
+    /**
+     * Latency histograms, all values are in nanoseconds.
+     */
+    enum class Histogram
+    {
+        CaptureToKai = 0,     /**< From the pcap capture timestamp until the frame has been sent to XLink Kai. */
+        KaiToInject,          /**< From receiving a frame from XLink Kai until it has been injected. */
+        KaiConnectRoundTrip,  /**< From sending connect until XLink Kai confirms the connection. */
+        KaiKeepAliveInterval, /**< Time between keepalives from XLink Kai. */
+        AckLatency,           /**< From the pcap capture timestamp until the acknowledgement has been injected. */
+        CaptureToCallback,    /**< From the pcap capture timestamp until the read callback starts (kernel, pcap). */
+        CallbackToConverted,  /**< From the start of the read callback until the frame has been converted. */
+        ConvertedToKaiSent,   /**< From the converted frame until sending it to XLink Kai returns. */
+        KaiToConverted,       /**< From receiving a frame from XLink Kai until it has been converted. */
+        ConvertedToInject,    /**< From the converted frame until pcap_sendpacket returns. */
+        ReplayScheduleError,  /**< How late a time accurate replay handed a frame over, compared to its deadline. */
+        Count                 /**< Amount of histograms, not a histogram. */
+    };
+
+    static constexpr std::size_t cHistogramCount{static_cast<std::size_t>(Histogram::Count)};
+
+    static constexpr std::array<std::string_view, cHistogramCount> cHistogramTexts{"capture_to_kai",
+                                                                                   "kai_to_inject",
+                                                                                   "kai_connect_round_trip",
+                                                                                   "kai_keepalive_interval",
+                                                                                   "ack_latency",
+                                                                                   "capture_to_callback",
+                                                                                   "callback_to_converted",
+                                                                                   "converted_to_kai_sent",
+                                                                                   "kai_to_converted",
+                                                                                   "converted_to_inject",
+                                                                                   "replay_schedule_error"};
+
+    /**
+     * Gauges, values that are set instead of added up, these are not sharded as they are rarely written. The capture
+     * gauges are summed over all capture devices, every device adds its own changes to them.
+     */
+    enum class Gauge
+    {
+        KaiLinkState = 0,       /**< State of the link with XLink Kai, see KaiLinkState. */
+        CaptureBufferSize,      /**< Size of the capture buffers in bytes, grown when the kernel drops packets. */
+        CaptureFilterTightened, /**< Amount of capture devices that tightened their filter because of drops. */
+        Count                   /**< Amount of gauges, not a gauge. */
+    };
+
+    static constexpr std::size_t cGaugeCount{static_cast<std::size_t>(Gauge::Count)};
+
+    static constexpr std::array<std::string_view, cGaugeCount> cGaugeTexts{
+        "kai_link_state", "capture_buffer_size_bytes", "capture_filter_tightened"};
+
+    /**
+     * Values of the KaiLinkState gauge.
+     */
+    enum class KaiLinkState
+    {
+        Disconnected = 0,
+        Connecting,
+        Connected
+    };
+
+    static constexpr std::array<std::string_view, 3> cKaiLinkStateTexts{"Disconnected", "Connecting", "Connected"};
+
+    /**
+     * Informational texts, like gauges these are set instead of added up.
+     */
+    enum class Info
+    {
+        LockedBSSID = 0, /**< BSSID the monitor device is locked onto. */
+        LockedSSID,      /**< SSID of the network the monitor device is locked onto. */
+        Count            /**< Amount of info texts, not an info text. */
+    };
+
+    static constexpr std::size_t cInfoCount{static_cast<std::size_t>(Info::Count)};
+
+    // 802.11 frame types (2 bits) times subtypes (4 bits).
+    static constexpr std::size_t                     cFrameTypeCount{4 * 16};
+    static constexpr std::array<std::string_view, 4> cFrameTypeTexts{"management", "control", "data", "extension"};
+
+    // Histogram buckets are log-linear: every power of two is split up in 2^cSubBucketBits buckets, which keeps the
+    // relative error below ~6%. Values above 2^cMaxExponent nanoseconds (about 18 minutes) end up in the last bucket.
+    static constexpr unsigned int cSubBucketBits{4};
+    static constexpr unsigned int cSubBucketCount{1U << cSubBucketBits};
+    static constexpr unsigned int cMaxExponent{40};
+    static constexpr std::size_t  cBucketCount{(cMaxExponent - cSubBucketBits + 1) * cSubBucketCount};
+}  // namespace Metrics_Constants
+
+using namespace Metrics_Constants;
+
+/**
+ * Aggregated copy of a histogram.
+ */
+class HistogramSnapshot
+{
+public:
+    /**
+     * Gets the value below which the given percentage of the samples fall.
+     * @param aPercentile - Percentile to get, 0-100.
+     * @return upper bound of the bucket the percentile is in, 0 if there are no samples.
+     */
+    [[nodiscard]] std::chrono::nanoseconds GetPercentile(double aPercentile) const;
+
+    /**
+     * Gets the average of all samples.
+     * @return the mean, 0 if there are no samples.
+     */
+    [[nodiscard]] std::chrono::nanoseconds GetMean() const;
+
+    /**
+     * Converts a bucket index to the highest value that falls into that bucket.
+     * @param aIndex - Bucket index.
+     * @return the upper bound of the bucket in nanoseconds.
+     */
+    static uint64_t GetBucketUpperBound(std::size_t aIndex);
+
+    /**
+     * Converts a value to the bucket it falls into.
+     * @param aValue - Value in nanoseconds.
+     * @return the bucket index.
+     */
+    static std::size_t GetBucketIndex(uint64_t aValue);
+
+    std::array<uint64_t, cBucketCount> mBuckets{};
+    uint64_t                           mCount{0};
+    uint64_t                           mSum{0};
+    uint64_t                           mMax{0};
+};
+
+/**
+ * Aggregated copy of all metrics at a single point in time.
+ */
+struct MetricsSnapshot
+{
+    /**
+     * Gets a counter from the snapshot.
+     * @param aCounter - Counter to get.
+     * @return value of the counter.
+     */
+    [[nodiscard]] uint64_t Get(Counter aCounter) const
+    {
+        return mCounters.at(static_cast<std::size_t>(aCounter));
+    }
+
+    /**
+     * Gets a gauge from the snapshot.
+     * @param aGauge - Gauge to get.
+     * @return value of the gauge.
+     */
+    [[nodiscard]] int64_t Get(Gauge aGauge) const
+    {
+        return mGauges.at(static_cast<std::size_t>(aGauge));
+    }
+
+    /**
+     * Gets an info text from the snapshot.
+     * @param aInfo - Info text to get.
+     * @return the text.
+     */
+    [[nodiscard]] const std::string& Get(Info aInfo) const
+    {
+        return mInfo.at(static_cast<std::size_t>(aInfo));
+    }
+
+    /**
+     * Gets a histogram from the snapshot.
+     * @param aHistogram - Histogram to get.
+     * @return the histogram.
+     */
+    [[nodiscard]] const HistogramSnapshot& Get(Histogram aHistogram) const
+    {
+        return mHistograms.at(static_cast<std::size_t>(aHistogram));
+    }
+
+    std::chrono::steady_clock::time_point          mTime{};
+    std::array<uint64_t, cCounterCount>            mCounters{};
+    std::array<uint64_t, cFrameTypeCount>          mFrameTypes{};
+    std::array<int64_t, cGaugeCount>               mGauges{};
+    std::array<std::string, cInfoCount>            mInfo{};
+    std::array<HistogramSnapshot, cHistogramCount> mHistograms{};
+};
+
+/**
+ * Registry for all metrics in the program. Every thread gets its own shard to write to, so updating a metric is just
+ * a couple of relaxed loads and stores; the shards are only summed up when a snapshot is taken.
+ */
+class Metrics
+{
+public:
+    Metrics(const Metrics& aMetrics) = delete;
+    Metrics& operator=(const Metrics& aMetrics) = delete;
+
+    Metrics& operator=(Metrics&& aMetrics) = delete;
+    Metrics(Metrics&& aMetrics)            = delete;
+
+    /**
+     * Gets the Metrics singleton.
+     * @return The Metrics object.
+     */
+    static Metrics& GetInstance()
+    {
+        static Metrics lInstance;
+        return lInstance;
+    }
+
+    /**
+     * Increments a counter.
+     * @param aCounter - Counter to increment.
+     * @param aAmount - Amount to add.
+     */
+    void Increment(Counter aCounter, uint64_t aAmount = 1);
+
+    /**
+     * Counts an 802.11 frame by its type and subtype.
+     * @param aFrameControl - First byte of the frame control field.
+     */
+    void CountFrameType(uint8_t aFrameControl);
+
+    /**
+     * Adds a sample to a latency histogram.
+     * @param aHistogram - Histogram to add the sample to.
+     * @param aLatency - The sample, negative samples are counted as 0.
+     */
+    void RecordLatency(Histogram aHistogram, std::chrono::nanoseconds aLatency);
+
+    /**
+     * Sets a gauge.
+     * @param aGauge - Gauge to set.
+     * @param aValue - Value to set it to.
+     */
+    void Set(Gauge aGauge, int64_t aValue);
+
+    /**
+     * Adds to a gauge, for gauges that are shared by multiple devices.
+     * @param aGauge - Gauge to add to.
+     * @param aValue - Value to add, can be negative.
+     */
+    void Add(Gauge aGauge, int64_t aValue);
+
+    /**
+     * Sets an info text, this takes a lock so only use it for things that rarely change.
+     * @param aInfo - Info text to set.
+     * @param aText - Text to set it to.
+     */
+    void Set(Info aInfo, std::string_view aText);
+
+    /**
+     * Sums up all shards.
+     * @return a snapshot of all metrics.
+     */
+    [[nodiscard]] MetricsSnapshot GetSnapshot();
+
+    /**
+     * Sets everything back to 0, so tests sharing the singleton do not see each other's samples. Only for tests, no
+     * other thread may be using the metrics while this runs.
+     */
+    void Reset();
+
+private:
+    Metrics()  = default;
+    ~Metrics() = default;
+
+    struct HistogramShard
+    {
+        std::array<std::atomic<uint64_t>, cBucketCount> mBuckets{};
+        std::atomic<uint64_t>                           mCount{0};
+        std::atomic<uint64_t>                           mSum{0};
+        std::atomic<uint64_t>                           mMax{0};
+    };
+
+    // Only the thread leasing the shard writes to it, so no read-modify-write atomics are needed.
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, cCounterCount>   mCounters{};
+        std::array<std::atomic<uint64_t>, cFrameTypeCount> mFrameTypes{};
+        std::array<HistogramShard, cHistogramCount>        mHistograms{};
+        bool                                               mInUse{false};
+    };
+
+    class ShardLease;
+
+    Shard& GetShard();
+    Shard& AcquireShard();
+    void   ReleaseShard(Shard& aShard);
+
+    // Shards are never freed, once a thread exits its shard is handed to the next new thread so the counts remain.
+    std::mutex                          mShardsMutex{};
+    std::vector<std::unique_ptr<Shard>> mShards{};
+
+    std::array<std::atomic<int64_t>, cGaugeCount> mGauges{};
+    std::mutex                                    mInfoMutex{};
+    std::array<std::string, cInfoCount>           mInfo{};
+};
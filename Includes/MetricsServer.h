@@ -0,0 +1,77 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - MetricsServer.h
+ *
+ * This file contains a small HTTP server that exposes the metrics registry in Prometheus text format.
+ *
+ **/
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include "Metrics.h"
+
+namespace MetricsServer_Constants
+{
+    static constexpr std::string_view cAddress{"127.0.0.1"};
+    static constexpr std::string_view cMetricPrefix{"xlha_"};
+    static constexpr unsigned int     cMaxRequestLength{8192};
+
+    // Bucket boundaries in seconds used for the Prometheus histograms, the registry itself has far finer buckets.
+    static constexpr std::array<double, 19> cHistogramBoundaries{
+        0.000001, 0.000002, 0.000005, 0.00001, 0.00002, 0.00005, 0.0001, 0.0002, 0.0005, 0.001,
+        0.002,    0.005,    0.01,     0.02,    0.05,    0.1,     0.2,    0.5,    1.0};
+}  // namespace MetricsServer_Constants
+
+using namespace MetricsServer_Constants;
+
+/**
+ * Serves the metrics on localhost from its own thread and io_context, so scrapes never touch the data path; the only
+ * interaction with the rest of the program is taking a metrics snapshot.
+ */
+class MetricsServer
+{
+public:
+    MetricsServer() = default;
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer& aMetricsServer) = delete;
+    MetricsServer& operator=(const MetricsServer& aMetricsServer) = delete;
+
+    /**
+     * Starts listening on localhost and serving metrics.
+     * @param aPort - Port to listen on, 0 to let the system pick one.
+     * @return true if successful.
+     */
+    bool Start(unsigned int aPort);
+
+    /**
+     * Stops serving metrics.
+     */
+    void Stop();
+
+    /**
+     * Gets the port the server is listening on.
+     * @return the port, 0 if not listening.
+     */
+    [[nodiscard]] unsigned int GetPort() const;
+
+    /**
+     * Converts a snapshot to Prometheus text format.
+     * @param aSnapshot - Snapshot to convert.
+     * @return the metrics as text.
+     */
+    static std::string FormatMetrics(const MetricsSnapshot& aSnapshot);
+
+private:
+    void Accept();
+
+    boost::asio::io_context                         mIoContext{};
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> mAcceptor{nullptr};
+    std::shared_ptr<std::thread>                    mServerThread{nullptr};
+};
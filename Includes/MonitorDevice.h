@@ -6,18 +6,42 @@
  *
  * */
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <thread>
 
+#include "CaptureController.h"
 #include "Handler80211.h"
 #include "IConnector.h"
 #include "IPCapDevice.h"
+#include "MPSCQueue.h"
+#include "PacketSocket.h"
 
 
 namespace WirelessMonitorDevice_Constants
 {
-    static constexpr unsigned int cSnapshotLength{65535};
-    static constexpr unsigned int cTimeout{1};
+    static constexpr unsigned int         cSnapshotLength{65535};
+    static constexpr unsigned int         cTimeout{1};
+    static constexpr std::chrono::seconds cStatisticsInterval{1};
+
+    // Filters used while packets are being dropped, only keeps what is needed to find and follow the networks. Beacons
+    // always get through, so new networks and networks that come back under another BSSID can still be locked onto.
+    // ACKs have no third address but are still needed, the parameters of injected control frames are taken from them.
+    // Until every network locked onto has been confirmed, all data gets through to follow peers to their new network.
+    static constexpr std::string_view cTightFilterBeacons{"type mgt subtype beacon"};
+    static constexpr std::string_view cTightFilterAcks{"type ctl subtype ack"};
+    static constexpr std::string_view cTightFilterLocked{"wlan addr3 "};
+    static constexpr std::string_view cTightFilterUnlocked{"type data"};
+
+    // A handle that only injects does not need anything captured, this filter lets nothing through.
+    static constexpr std::string_view cInjectionFilter{"less 1"};
+    // Frames waiting for the injection thread, and the biggest frame that can wait there.
+    static constexpr std::size_t               cInjectionQueueSize{256};
+    static constexpr std::size_t               cMaxInjectionLength{8192};
+    static constexpr std::chrono::microseconds cInjectionIdleSleep{10};
 }  // namespace WirelessMonitorDevice_Constants
 
 using namespace WirelessMonitorDevice_Constants;
@@ -50,25 +74,167 @@ public:
      */
     uint64_t GetLockedBSSID();
 
-    bool Open(std::string_view aName, std::vector<std::string>& aSSIDFilter) override;
+    /**
+     * Gets where a frame for a station has to be sent to, see Handler80211::GetRoutes.
+     * @param aDestinationMAC - Station the frame is for.
+     * @param aRoutes - Filled in with the networks to send the frame in.
+     * @return the amount of routes filled in, 0 if not locked onto any network.
+     */
+    std::size_t GetRoutes(uint64_t aDestinationMAC, std::array<NetworkRoute, cMaxSessions>& aRoutes);
+
+    bool Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter) override;
+
+    // Called for every captured frame, public so frames can be fed in without a capture handle.
+    bool ReadCallback(const unsigned char* aData, const pcap_pkthdr* aHeader);
+
     bool Send(std::string_view aData) override;
     void SetAcknowledgePackets(bool aAcknowledge);
     void SetConnector(std::shared_ptr<IConnector> aDevice) override;
+
+    /**
+     * Sets a separate adapter to inject frames on, so capturing and injecting do not wait on each other and an adapter
+     * that captures well can be paired with one that injects well. Frames to inject get queued and sent by a thread of
+     * their own. Set it before opening the device.
+     * @param aName - Name of the adapter, the capture adapter itself gets a handle of its own, empty to inject on the
+     * capture handle.
+     */
+    void SetInjectionAdapter(std::string_view aName);
+
+    /**
+     * Sets how frames get injected, the packet socket backends fall back to pcap if the socket cannot be opened. Set it
+     * before opening the device.
+     * @param aBackend - Backend to inject with.
+     */
+    void SetInjectionBackend(InjectionBackend aBackend);
+
+    /**
+     * Sets whether every network matching the SSID filter gets forwarded at once, instead of only the one locked onto.
+     * @param aMultiNetwork - true to forward multiple networks.
+     */
+    void SetMultiNetwork(bool aMultiNetwork);
+
+    /**
+     * Sets the cache of known networks, when opened the device locks onto the most recent network matching its SSID
+     * filter right away, when closed it stores the network it was in.
+     * @param aNetworkCache - Cache to use, nullptr to not use one.
+     */
+    void SetNetworkCache(std::shared_ptr<NetworkCache> aNetworkCache);
+
+    /**
+     * Sets the table the networks seen while capturing get recorded in.
+     * @param aNetworkTable - Table to record the networks in, nullptr to stop recording them.
+     */
+    void SetNetworkTable(std::shared_ptr<NetworkTable> aNetworkTable);
+
     void SetSourceMACToFilter(uint64_t aMac);
     bool StartReceiverThread() override;
 
+protected:
+    /**
+     * Creates and activates the handle to inject on when a separate injection adapter has been set.
+     * @return the handle, nullptr if it could not be activated.
+     */
+    virtual pcap_t* ActivateInjection();
+
+    /**
+     * Gets injecting ready after the capture handle has been opened: the injection adapter with the queue for its
+     * thread if one has been set, and the packet socket if another backend than pcap has been set.
+     * @return false if the injection adapter could not be activated.
+     */
+    bool OpenInjection();
+
+    /**
+     * Keeps the metrics and flight recorder up to date after injecting a frame.
+     * @param aData - The frame.
+     * @param aSent - Whether it has been sent.
+     */
+    void RecordSent(std::string_view aData, bool aSent);
+
+    /**
+     * Gets the packet handler ready for a new capture, warm starting it from the network cache.
+     * @param aSSIDFilter - The SSIDS to listen to.
+     */
+    void SetUpPacketHandler(const std::vector<std::string>& aSSIDFilter);
+
+    /**
+     * Starts the thread sending the frames in the injection queue, when injecting on a separate adapter. Frames left
+     * in the queue from before the device got closed are counted as failed.
+     */
+    void StartInjectionThread();
+
+    // Shared with devices that capture in another way, so the state of the device is the same for all of them.
+    std::string                  mAdapterName{};
+    std::atomic<bool>            mConnected{false};
+    std::shared_ptr<std::thread> mReceiverThread{nullptr};
+
 private:
-    bool ReadCallback(const unsigned char* aData, const pcap_pkthdr* aHeader);
+    /**
+     * Creates and activates a capture handle with the current buffer size and filter of the capture controller.
+     * @return the handle, nullptr if it could not be activated.
+     */
+    pcap_t* Activate();
+
+    /**
+     * Sends the frames in the injection queue until the device gets closed, runs on the injection thread.
+     */
+    void Inject();
+
+    /**
+     * Injects a frame, on the packet socket if it is open.
+     * @param aHandler - Handle to inject it on otherwise.
+     * @param aData - The frame.
+     * @param aFlush - false to leave the frame in the TX ring of the packet socket, to be sent along with the next
+     * frames. It is only counted as sent once the ring has been flushed, which is up to the caller.
+     * @return true if successful.
+     */
+    bool SendOnHandle(pcap_t* aHandler, std::string_view aData, bool aFlush = true);
+
     void ShowPacketStatistics(const pcap_pkthdr* aHeader) const;
 
-    bool                         mAcknowledgePackets{false};
-    bool                         mConnected{false};
-    std::shared_ptr<IConnector>  mConnector{nullptr};
-    const unsigned char*         mData{nullptr};
-    pcap_t*                      mHandler{nullptr};
-    const pcap_pkthdr*           mHeader{nullptr};
-    unsigned int                 mPacketCount{0};
-    Handler80211                 mPacketHandler{PhysicalDeviceHeaderType::RadioTap};
-    std::shared_ptr<std::thread> mReceiverThread{nullptr};
-    bool                         mSendReceivedData{false};
+    /**
+     * Reads the drop counters from pcap_stats and lets the capture controller adapt the handle to them.
+     */
+    void SampleCaptureStatistics();
+
+    /**
+     * Sets the capture filter on a handle, tight or open depending on the capture controller. The tight filter is
+     * built from the networks locked onto, see mFilterSessionChanges.
+     * @param aHandler - Handle to set the filter on.
+     */
+    void SetFilter(pcap_t* aHandler);
+
+    /**
+     * A frame waiting in the queue to be injected.
+     */
+    struct InjectionFrame
+    {
+        std::size_t                           mLength{0};
+        std::array<char, cMaxInjectionLength> mData{};
+    };
+
+    bool                                               mAcknowledgePackets{false};
+    CaptureController                                  mCaptureController{};
+    std::shared_ptr<IConnector>                        mConnector{nullptr};
+    const unsigned char*                               mData{nullptr};
+    // Session changes of the handler the tight filter has been built for.
+    uint64_t                                           mFilterSessionChanges{0};
+    pcap_t*                                            mHandler{nullptr};
+    // Guards swapping the handle while other threads send on it.
+    std::mutex                                         mHandlerMutex{};
+    const pcap_pkthdr*                                 mHeader{nullptr};
+    std::string                                        mInjectionAdapterName{};
+    InjectionBackend                                   mInjectionBackend{InjectionBackend::PCap};
+    pcap_t*                                            mInjectionHandler{nullptr};
+    std::atomic<bool>                                  mInjecting{false};
+    std::shared_ptr<std::thread>                       mInjectionThread{nullptr};
+    std::chrono::time_point<std::chrono::steady_clock> mLastStatisticsSample{};
+    std::shared_ptr<NetworkCache>                      mNetworkCache{nullptr};
+    unsigned int                                       mPacketCount{0};
+    bool                                               mNanosecondTimestamps{false};
+    Handler80211                                       mPacketHandler{PhysicalDeviceHeaderType::RadioTap};
+    PacketSocket                                       mPacketSocket{};
+    bool                                               mSendReceivedData{false};
+
+    // Only allocated once a separate injection adapter gets used.
+    std::unique_ptr<MPSCQueue<InjectionFrame, cInjectionQueueSize>> mInjectionQueue{nullptr};
 };
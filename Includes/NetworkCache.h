@@ -0,0 +1,100 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - NetworkCache.h
+ *
+ * This file contains a cache of recently used networks, kept on disk so the engine can reconnect right away.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "RadioTapReader.h"
+
+namespace NetworkCache_Constants
+{
+    static constexpr std::string_view cNetworkCacheFileName{"networks.txt"};
+
+    static constexpr std::string_view cSaveNetwork{"Network"};
+    static constexpr std::string_view cSaveBSSID{"BSSID"};
+    static constexpr std::string_view cSaveFrequency{"Frequency"};
+    static constexpr std::string_view cSaveAdhoc{"Adhoc"};
+    static constexpr std::string_view cSaveParameters{"Parameters"};
+    static constexpr std::string_view cSavePeers{"Peers"};
+    static constexpr std::string_view cSaveLastUsed{"LastUsed"};
+
+    static constexpr std::size_t cMaxCachedNetworks{16};
+    static constexpr std::size_t cMaxCachedPeers{16};
+    // Games get played in sessions, a network that has not been used for this long is not worth trying anymore.
+    static constexpr std::chrono::hours cMaxCachedNetworkAge{24 * 7};
+}  // namespace NetworkCache_Constants
+
+using namespace NetworkCache_Constants;
+
+/**
+ * A network the engine has been in, with what is needed to get back into it.
+ */
+struct CachedNetwork
+{
+    std::string                              mSSID{};
+    uint64_t                                 mBSSID{0};
+    int                                      mFrequency{0}; /**< In MHz, 0 if unknown. */
+    bool                                     mIsAdhoc{true};
+    bool                                     mHasParameters{false};
+    RadioTapReader::PhysicalDeviceParameters mParameters{}; /**< What data frames were received with. */
+    std::vector<uint64_t>                    mPeers{};      /**< Stations that sent data in the network. */
+    std::chrono::system_clock::time_point    mLastUsed{};
+};
+
+/**
+ * Remembers the networks the engine has been in, most recently used first. The devices look up a network matching
+ * their SSID filter when opened, so they can join or lock onto it without waiting for a scan or beacon, and store
+ * the network they are in when closed. Safe to use from multiple threads.
+ */
+class NetworkCache
+{
+public:
+    /**
+     * Adds a network or replaces the one with the same BSSID, and makes it the most recently used one.
+     * @param aNetwork - Network to store, the last used time gets set to now.
+     */
+    void Store(CachedNetwork aNetwork);
+
+    /**
+     * Finds the most recently used network matching an SSID filter.
+     * @param aSSIDFilter - Parts of SSIDs to look for, any network matches if empty.
+     * @param aNetwork - Filled in with the network if found.
+     * @return true if a network has been found.
+     */
+    bool Find(const std::vector<std::string>& aSSIDFilter, CachedNetwork& aNetwork) const;
+
+    /**
+     * Gets the networks in the cache.
+     * @return copy of the networks, most recently used first.
+     */
+    [[nodiscard]] std::vector<CachedNetwork> GetNetworks() const;
+
+    /**
+     * Saves the cache to a file.
+     * @param aPath - Path to save it in.
+     * @return true if successful.
+     */
+    bool SaveToFile(std::string_view aPath) const;
+
+    /**
+     * Loads the cache from a file, networks that are too old are left out.
+     * @param aPath - Path to load it from.
+     * @return true if successful.
+     */
+    bool LoadFromFile(std::string_view aPath);
+
+private:
+    void Add(CachedNetwork aNetwork);
+
+    mutable std::mutex         mMutex{};
+    std::vector<CachedNetwork> mNetworks{};
+};
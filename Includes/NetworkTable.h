@@ -0,0 +1,100 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - NetworkTable.h
+ *
+ * This file contains a table of the wireless networks seen in captured beacon frames.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "IClock.h"
+#include "SystemClock.h"
+
+namespace NetworkTable_Constants
+{
+    // Beacons are sent about 10 times a second, a network that has not sent one for this long is gone.
+    static constexpr std::chrono::seconds cNetworkMaxAge{10};
+    // Keeps the table from growing without bounds in busy places, new networks are ignored when full.
+    static constexpr std::size_t          cMaxNetworks{256};
+}  // namespace NetworkTable_Constants
+
+using namespace NetworkTable_Constants;
+
+/**
+ * A network as seen in its last beacon frame.
+ */
+struct DiscoveredNetwork
+{
+    uint64_t                              mBSSID{0};
+    std::string                           mSSID{};
+    uint8_t                               mChannel{0};
+    uint8_t                               mMaxRate{0};
+    bool                                  mIsAdhoc{false};
+    int8_t                                mSignal{0}; /**< In dBm, 0 if unknown. */
+    std::chrono::steady_clock::time_point mLastSeen{};
+    uint64_t                              mBeacons{0};
+};
+
+/**
+ * Keeps track of the networks in range by looking at the beacon frames that get captured anyway, so no scan is needed
+ * to find them and capturing does not have to stop for it. Networks that stop sending beacons age out. Safe to use
+ * from multiple threads, the receiver thread fills it while the user interface reads it.
+ */
+class NetworkTable
+{
+public:
+    /**
+     * Sets the clock the networks are timestamped and aged with.
+     * @param aClock - Clock to use.
+     */
+    void SetClock(std::shared_ptr<IClock> aClock);
+
+    /**
+     * Adds or updates a network with what was in one of its beacons.
+     * @param aBSSID - BSSID of the network.
+     * @param aSSID - SSID of the network.
+     * @param aChannel - Channel the network is on, 0 if unknown.
+     * @param aMaxRate - Highest rate the network supports.
+     * @param aIsAdhoc - Whether it is an adhoc network.
+     * @param aSignal - Signal strength the beacon was received with in dBm, 0 if unknown.
+     */
+    void Update(uint64_t         aBSSID,
+                std::string_view aSSID,
+                uint8_t          aChannel,
+                uint8_t          aMaxRate,
+                bool             aIsAdhoc,
+                int8_t           aSignal);
+
+    /**
+     * Checks if a network has sent a beacon recently.
+     * @param aBSSID - BSSID of the network.
+     * @return true if the network is in the table and has not aged out.
+     */
+    [[nodiscard]] bool IsPresent(uint64_t aBSSID);
+
+    /**
+     * Removes the networks that aged out and gets the rest.
+     * @return copy of the networks, strongest signal first.
+     */
+    [[nodiscard]] std::vector<DiscoveredNetwork> GetNetworks();
+
+    /**
+     * Removes all networks.
+     */
+    void Clear();
+
+private:
+    void RemoveAged(std::chrono::steady_clock::time_point aNow);
+
+    std::shared_ptr<IClock>                         mClock{std::make_shared<SystemClock>()};
+    std::mutex                                      mMutex{};
+    std::unordered_map<uint64_t, DiscoveredNetwork> mNetworks{};
+};
@@ -0,0 +1,178 @@
+#pragma once
+#if not defined(_WIN32) && not defined(_WIN64)
+
+/* Copyright (c) 2021 [Rick de Bondt] - Nl80211Control.h
+ *
+ * This file contains an asynchronous nl80211 control plane, which scans in the background and keeps the results.
+ *
+ **/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <linux/netlink.h>
+
+#include "IClock.h"
+#include "IWifiInterface.h"
+#include "SystemClock.h"
+
+struct nl_msg;
+struct nlattr;
+
+namespace Nl80211Control_Constants
+{
+    static constexpr std::string_view cFamilyName{"nl80211"};
+    static constexpr std::string_view cScanGroupName{"scan"};
+    static constexpr std::string_view cMlmeGroupName{"mlme"};
+
+    // Scan dumps come in messages of up to a page each, this fits a few of them per read.
+    static constexpr std::size_t               cReceiveBufferSize{65536};
+    // The event thread checks this often whether it should stop.
+    static constexpr std::chrono::milliseconds cEventPollInterval{100};
+    static constexpr std::chrono::seconds      cResolveTimeout{2};
+    // A scan that has not finished after this long is considered lost, so a new one can be triggered.
+    static constexpr std::chrono::seconds      cScanLostTimeout{30};
+}  // namespace Nl80211Control_Constants
+
+using namespace Nl80211Control_Constants;
+
+/**
+ * The results of the last scan that finished. Connected networks come first.
+ */
+struct ScanResults
+{
+    std::vector<IWifiInterface::WifiInformation> mNetworks{};
+    std::chrono::steady_clock::time_point        mTime{};
+    uint64_t                                     mGeneration{0};
+};
+
+/**
+ * Keeps a netlink socket open that is subscribed to the scan and mlme events of nl80211. Scans are only triggered,
+ * whoever triggered them, the results get dumped when the kernel reports them and are swapped in as a whole, so
+ * readers never see half a scan and can hold on to the results they got for as long as they like. Joining and leaving
+ * adhoc networks is reported through a callback. Callbacks run on the event thread.
+ */
+class Nl80211Control
+{
+public:
+    using ScanResultsCallback = std::function<void(const std::shared_ptr<const ScanResults>&)>;
+
+    Nl80211Control() = default;
+    ~Nl80211Control();
+    Nl80211Control(const Nl80211Control& aNl80211Control) = delete;
+    Nl80211Control& operator=(const Nl80211Control& aNl80211Control) = delete;
+
+    /**
+     * Opens a generic netlink socket to the kernel, subscribes to the nl80211 events and starts the event thread.
+     * @param aInterfaceIndex - Index of the network adapter to control, events of other adapters are ignored.
+     * @return true if successful.
+     */
+    bool Open(unsigned int aInterfaceIndex);
+
+    /**
+     * Resolves nl80211 over an already connected socket and starts the event thread, takes ownership of the socket.
+     * Multicast groups are not joined, whatever is on the other side decides what gets sent.
+     * @param aSocket - Socket that talks netlink.
+     * @param aInterfaceIndex - Index of the network adapter to control, events of other adapters are ignored.
+     * @return true if successful.
+     */
+    bool Open(int aSocket, unsigned int aInterfaceIndex);
+
+    /**
+     * Stops the event thread and closes the socket.
+     */
+    void Close();
+
+    /**
+     * Sets the clock the scan results are timestamped with.
+     * @param aClock - Clock to use.
+     */
+    void SetClock(std::shared_ptr<IClock> aClock);
+
+    /**
+     * Sets the function that gets called with new scan results.
+     * @param aCallback - Function to call, nullptr to stop calling it.
+     */
+    void SetScanResultsCallback(ScanResultsCallback aCallback);
+
+    /**
+     * Sets the function that gets called when the adapter joined or left an adhoc network.
+     * @param aCallback - Function to call, nullptr to stop calling it.
+     */
+    void SetIBSSCallback(IWifiInterface::IBSSCallback aCallback);
+
+    /**
+     * Asks the kernel to scan, does not wait for the scan. Nothing gets sent while a scan is running already.
+     * @return true if a scan is running now.
+     */
+    bool TriggerScan();
+
+    /**
+     * Checks whether a scan has been triggered that has not finished yet.
+     * @return true if scanning.
+     */
+    [[nodiscard]] bool IsScanning() const;
+
+    /**
+     * Gets the results of the last scan that finished.
+     * @return the results, nullptr if no scan finished yet.
+     */
+    [[nodiscard]] std::shared_ptr<const ScanResults> GetScanResults() const;
+
+    /**
+     * Gets the time since the last scan finished.
+     * @return the age of the results, max if there are none.
+     */
+    [[nodiscard]] std::chrono::steady_clock::duration GetScanResultsAge() const;
+
+private:
+    /**
+     * Creates an nl80211 request for the adapter, with the next sequence number.
+     * @param aCommand - nl80211 command.
+     * @param aFlags - Netlink flags.
+     * @return the message, nullptr if it could not be allocated.
+     */
+    nl_msg* CreateMessage(uint8_t aCommand, uint16_t aFlags);
+    void    HandleBSS(nlattr* aBSS);
+    void    HandleEvent(const nlmsghdr* aHeader);
+    void    HandleMessage(const nlmsghdr* aHeader);
+    void    PublishScanResults();
+    void    RequestScanResults();
+    bool    ResolveFamily();
+    void    Run();
+    bool    Send(nl_msg* aMessage);
+    bool    Subscribe();
+
+    std::vector<IWifiInterface::WifiInformation> mBackNetworks{};
+    std::mutex                                   mCallbackMutex{};
+    std::shared_ptr<IClock>                      mClock{std::make_shared<SystemClock>()};
+    bool                                         mDumpPending{false};
+    uint32_t                                     mDumpSequence{0};
+    uint16_t                                     mFamilyId{0};
+    uint64_t                                     mGeneration{0};
+    IWifiInterface::IBSSCallback                 mIBSSCallback{nullptr};
+    unsigned int                                 mInterfaceIndex{0};
+    uint32_t                                     mMlmeGroup{0};
+    std::array<char, cReceiveBufferSize>         mReceiveBuffer{};
+    std::shared_ptr<const ScanResults>           mResults{nullptr};
+    mutable std::mutex                           mResultsMutex{};
+    std::atomic<bool>                            mRunning{false};
+    ScanResultsCallback                          mScanResultsCallback{nullptr};
+    std::atomic<bool>                            mScanning{false};
+    uint32_t                                     mScanGroup{0};
+    std::mutex                                   mScanMutex{};
+    std::atomic<uint32_t>                        mScanSequence{0};
+    std::chrono::steady_clock::time_point        mScanStart{};
+    std::atomic<uint32_t>                        mSequence{1};
+    int                                          mSocket{-1};
+    std::thread                                  mThread{};
+};
+#endif
@@ -7,13 +7,32 @@
  *
  **/
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <thread>
 
 #include "Handler80211.h"
 #include "Handler8023.h"
+#include "IClock.h"
 #include "IConnector.h"
 #include "IPCapDevice.h"
+#include "SystemClock.h"
+
+namespace PCapReader_Constants
+{
+    // While sleeping for long gaps, check this often whether the replay has been stopped.
+    static constexpr std::chrono::milliseconds cStopCheckInterval{100};
+
+    // Captures without gaps between frames, like a single frame, start a new loop after at least this long in capture
+    // time, so looping them does not turn into a busy loop.
+    static constexpr std::chrono::milliseconds cMinimumLoopGap{1};
+
+    static constexpr double cMinimumReplaySpeed{0.5};
+    static constexpr double cMaximumReplaySpeed{100};
+}  // namespace PCapReader_Constants
+
+using namespace PCapReader_Constants;
 
 /**
  * This class contains the necessary components to read a PCap file.
@@ -24,6 +43,7 @@ public:
     /**
      * Construct a new PCapReader object.
      * @param aMonitorCapture - Tells the PCapReader whether it's a monitor mode device or a promiscuous mode device.
+     * @param aTimeAccurate - Replay frames at the time they have been captured at instead of as fast as possible.
      */
     explicit PCapReader(bool aMonitorCapture, bool aTimeAccurate);
     ~PCapReader() = default;
@@ -62,7 +82,7 @@ public:
 
     [[nodiscard]] bool IsDoneReceiving() const;
     bool               Open(std::string_view aArgument) override;
-    bool               Open(std::string_view aName, std::vector<std::string>& aSSIDFilter) override;
+    bool               Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter) override;
     // PCapReader should still be able to manually read next data, way too useful to private.
     bool ReadCallback(const unsigned char* aData, const pcap_pkthdr* aHeader);
     bool ReadNextData() override;
@@ -77,21 +97,43 @@ public:
      */
     void SetBSSID(uint64_t aBSSID);
 
+    /**
+     * Sets the clock a time accurate replay runs on, set it before starting the receiver thread.
+     * @param aClock - Clock to use, a VirtualClock replays at CPU speed with the timing of the capture.
+     */
+    void SetClock(std::shared_ptr<IClock> aClock);
+
     /**
      * Sets the Parameters to use when pretending to be XLink Kai sending out to a monitor device.
      * @param aParameters - Parameters to use.
      */
     void SetParameters(std::shared_ptr<RadioTapReader::PhysicalDeviceParameters> aParameters);
 
+    /**
+     * Sets how many times the receiver thread replays the capture.
+     * @param aLoops - Amount of times, 0 replays until the reader gets closed.
+     */
+    void SetReplayLoops(unsigned int aLoops);
+
+    /**
+     * Sets how fast a time accurate replay goes, for example 2 replays a minute of capture in 30 seconds.
+     * @param aSpeed - Speed multiplier, between cMinimumReplaySpeed and cMaximumReplaySpeed.
+     */
+    void SetReplaySpeed(double aSpeed);
+
     void SetSourceMACToFilter(uint64_t aMac);
     // In this case tries to simulate a real device
     bool StartReceiverThread() override;
 
 private:
+    bool OpenFile(std::string_view aName);
+    void Replay();
     void ShowPacketStatistics(const pcap_pkthdr* aHeader) const;
+    void WaitUntil(std::chrono::steady_clock::time_point aDeadline) const;
 
     bool                                                      mAcknowledgePackets{false};
     uint64_t                                                  mBSSID{0};
+    std::shared_ptr<IClock>                                   mClock{std::make_shared<SystemClock>()};
     bool                                                      mConnected{false};
     std::shared_ptr<IConnector>                               mConnector{nullptr};
     const unsigned char*                                      mData{nullptr};
@@ -99,11 +141,15 @@ private:
     pcap_t*                                                   mHandler{nullptr};
     pcap_pkthdr*                                              mHeader{nullptr};
     std::shared_ptr<IPCapDevice>                              mIncomingConnection{nullptr};
-    bool                                                      mDoneReceiving{false};
+    std::atomic<bool>                                         mDoneReceiving{false};
+    std::string                                               mFileName{};
     bool                                                      mMonitorCapture{false};
     bool                                                      mTimeAccurate{false};
     std::shared_ptr<IHandler>                                 mPacketHandler{nullptr};
+    unsigned int                                              mReplayLoops{1};
+    double                                                    mReplaySpeed{1};
     std::shared_ptr<std::thread>                              mReplayThread{nullptr};
     std::vector<std::string>                                  mSSIDFilter{};
     unsigned int                                              mPacketCount{0};
+    std::atomic<bool>                                         mStopReplay{false};
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - PacketSocket.h
+ *
+ * This file contains a raw packet socket to inject frames on, as an alternative to pcap_sendpacket.
+ *
+ **/
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace PacketSocket_Constants
+{
+    // Every slot of the TX ring fits any frame the program sends. Blocks of the ring are a page or more, so on kernels
+    // with bigger pages a block holds multiple slots.
+    static constexpr std::size_t cRingFrameSize{4096};
+    static constexpr std::size_t cRingFrameCount{64};
+}  // namespace PacketSocket_Constants
+
+using namespace PacketSocket_Constants;
+
+/**
+ * Ways frames can be injected.
+ */
+enum class InjectionBackend
+{
+    PCap = 0,
+    Packet,
+    PacketRing
+};
+
+static constexpr std::array<std::string_view, 3> cInjectionBackendTexts{"pcap", "packet", "packet_ring"};
+
+/**
+ * AF_PACKET socket bound to an adapter that only sends. Frames skip the qdisc layer and go straight to the driver,
+ * which takes a step out of every injection compared to pcap_sendpacket. With a TX ring, frames get copied into memory
+ * shared with the kernel and a single system call sends everything that has been queued. Only available on Linux, Open
+ * fails elsewhere. Not thread safe, callers have to make sure only one thread uses it at a time.
+ */
+class PacketSocket
+{
+public:
+    PacketSocket() = default;
+    ~PacketSocket();
+    PacketSocket(const PacketSocket& aPacketSocket) = delete;
+    PacketSocket& operator=(const PacketSocket& aPacketSocket) = delete;
+
+    /**
+     * Converts the text of a backend, as used in the config file, to the backend.
+     * @param aText - Text of the backend.
+     * @return the backend, InjectionBackend::PCap if the text is unknown.
+     */
+    static InjectionBackend ConvertStringToBackend(std::string_view aText);
+
+    /**
+     * Opens the socket on an adapter.
+     * @param aAdapter - Name of the adapter to inject on.
+     * @param aUseRing - Queue frames in a TX ring, so they are only sent on Flush. If the ring cannot be set up, the
+     *                   socket sends every frame right away instead, see UsesRing.
+     * @return true if successful.
+     */
+    bool Open(std::string_view aAdapter, bool aUseRing);
+
+    void Close();
+
+    /**
+     * @return true if the socket has been opened.
+     */
+    [[nodiscard]] bool IsOpen() const;
+
+    /**
+     * @return true if frames are queued in a TX ring, so Queue only sends them on Flush.
+     */
+    [[nodiscard]] bool UsesRing() const;
+
+    /**
+     * Queues a frame in the TX ring, or sends it right away without a ring. Kicks the ring if it is full, frames that
+     * do not fit in a slot of the ring cannot be sent with a ring.
+     * @param aData - The frame.
+     * @return true if the frame has been queued or sent.
+     */
+    bool Queue(std::string_view aData);
+
+    /**
+     * Has the kernel send every frame queued in the TX ring, without waiting for them to be sent.
+     * @return true if successful, also when there was nothing to send.
+     */
+    bool Flush();
+
+    /**
+     * Sends a frame right away.
+     * @param aData - The frame.
+     * @return true if successful.
+     */
+    bool Send(std::string_view aData);
+
+private:
+    /**
+     * Sends a frame with a system call of its own, only works without a ring.
+     * @param aData - The frame.
+     * @return true if successful.
+     */
+    bool SendDirect(std::string_view aData);
+
+    /**
+     * Sets up the TX ring and maps it.
+     * @return true if successful.
+     */
+    bool SetUpRing();
+
+    /**
+     * Kicks the ring and waits until the kernel is done with it.
+     */
+    void WaitForRing();
+
+    int         mSocket{-1};
+    char*       mRing{nullptr};
+    std::size_t mRingFrameCount{0};
+    std::size_t mRingPosition{0};
+    std::size_t mRingSize{0};
+    std::size_t mQueued{0};
+};
@@ -20,11 +20,17 @@ public:
      */
     explicit Parameter80211Reader(std::shared_ptr<RadioTapReader> aPhysicalDeviceHeaderReader);
 
+    /**
+     * Gets the last obtained channel.
+     * @return channel of last updated packet, 0 if unsuccessful.
+     */
+    [[nodiscard]] uint8_t GetChannel() const;
+
     /**
      * Gets the last obtained frequency.
-     * @return frequency of last updated packet, 0 if unsuccessful.
+     * @return frequency in MHz of last updated packet, 0 if unsuccessful.
      */
-    [[nodiscard]] uint8_t GetFrequency() const;
+    [[nodiscard]] uint16_t GetFrequency() const;
 
     /**
      * Returns if network is an Adhoc network.
@@ -63,7 +69,8 @@ private:
 
     std::shared_ptr<RadioTapReader> mPhysicalDeviceHeaderReader{nullptr};
 
-    uint8_t          mFrequency{0};
+    uint8_t          mChannel{0};
+    uint16_t         mFrequency{0};
     std::string_view mLastReceivedPacket{};
     uint8_t          mMaxRate{0};
     bool             mIsAdhoc{false};
@@ -0,0 +1,96 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - PcapNgWriter.h
+ *
+ * This file contains a small writer for pcapng files, used for dumping frames without needing a live pcap handle.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PcapNgWriter_Constants
+{
+    static constexpr uint32_t cSectionHeaderBlockType{0x0A0D0D0A};
+    static constexpr uint32_t cInterfaceDescriptionBlockType{0x00000001};
+    static constexpr uint32_t cEnhancedPacketBlockType{0x00000006};
+    static constexpr uint32_t cByteOrderMagic{0x1A2B3C4D};
+
+    static constexpr uint16_t cOptionEndOfOptions{0};
+    static constexpr uint16_t cOptionComment{1};
+    static constexpr uint16_t cOptionTimestampResolution{9};
+
+    // Timestamps are always written with nanosecond resolution (10^-9).
+    static constexpr uint8_t cTimestampResolutionNanoseconds{9};
+
+    static constexpr uint16_t cLinkTypeEthernet{1};
+    static constexpr uint16_t cLinkTypeRadioTap{127};
+    // Reserved for private use, holds the datagrams exchanged with XLink Kai as they are.
+    static constexpr uint16_t cLinkTypeUser0{147};
+}  // namespace PcapNgWriter_Constants
+
+/**
+ * Class that writes packets to a pcapng file. Every interface added to the file gets nanosecond timestamps, so multiple
+ * link types (for example radiotap and ethernet) can be stored in the same file.
+ */
+class PcapNgWriter
+{
+public:
+    PcapNgWriter() = default;
+    ~PcapNgWriter();
+
+    PcapNgWriter(const PcapNgWriter& aPcapNgWriter) = delete;
+    PcapNgWriter& operator=(const PcapNgWriter& aPcapNgWriter) = delete;
+
+    /**
+     * Opens the file and writes the section header.
+     * @param aPath - Path of the file to write to, will be overwritten.
+     * @return true if successful.
+     */
+    bool Open(std::string_view aPath);
+
+    /**
+     * Closes the file.
+     */
+    void Close();
+
+    /**
+     * Checks if the file is open and writable.
+     * @return true if open.
+     */
+    [[nodiscard]] bool IsOpen() const;
+
+    /**
+     * Adds an interface description to the file, packets refer to this interface by the returned index.
+     * @param aLinkType - Link type of the interface, for example PcapNgWriter_Constants::cLinkTypeRadioTap.
+     * @param aSnapshotLength - Maximum length of the captured packets.
+     * @return the index of the interface.
+     */
+    uint32_t AddInterface(uint16_t aLinkType, uint32_t aSnapshotLength);
+
+    /**
+     * Writes a packet to the file.
+     * @param aInterface - Index of the interface as returned by AddInterface.
+     * @param aTimestamp - Time since epoch the packet has been seen.
+     * @param aData - Packet data.
+     * @param aOriginalLength - Length of the packet before it was truncated, 0 if not truncated.
+     * @param aComment - Optional comment to add to the packet.
+     * @return true if successful.
+     */
+    bool WritePacket(uint32_t                 aInterface,
+                     std::chrono::nanoseconds aTimestamp,
+                     std::string_view         aData,
+                     uint32_t                 aOriginalLength = 0,
+                     std::string_view         aComment        = "");
+
+private:
+    void AppendOption(std::string& aBody, uint16_t aCode, std::string_view aValue);
+    bool WriteBlock(uint32_t aType, std::string_view aBody);
+
+    std::ofstream mFile{};
+    uint32_t      mInterfaceCount{0};
+};
@@ -112,6 +112,14 @@ public:
      */
     [[nodiscard]] uint8_t GetMCSInfo() const;
 
+    /**
+     * Gets the signal strength the packet was received with. Not part of the parameters, those are used for sending.
+     * @note Has to be called after running FillRadioTapParameters.
+     * @return the antenna signal in dBm, 0 if the radiotap header does not have it.
+     */
+    [[nodiscard]] int8_t GetAntennaSignal() const;
+
 private:
+    int8_t                   mAntennaSignal{0};
     PhysicalDeviceParameters mParameters;
 };
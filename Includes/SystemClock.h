@@ -0,0 +1,34 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - SystemClock.h
+ *
+ * This file contains the clock that runs on real time.
+ *
+ **/
+
+#include <chrono>
+
+#include "IClock.h"
+
+namespace SystemClock_Constants
+{
+    // Sleeping overshoots by tens of microseconds, so the last part before a deadline gets spun away instead.
+    static constexpr std::chrono::microseconds cSpinThreshold{100};
+}  // namespace SystemClock_Constants
+
+using namespace SystemClock_Constants;
+
+/**
+ * Clock on the monotonic system time, what everything runs on outside of simulations.
+ */
+class SystemClock : public IClock
+{
+public:
+    std::chrono::steady_clock::time_point Now() override;
+
+    /**
+     * Sleeps until shortly before the deadline and spins the rest, so the deadline is met to a few microseconds.
+     * @param aDeadline - Time to wait for.
+     */
+    void SleepUntil(std::chrono::steady_clock::time_point aDeadline) override;
+};
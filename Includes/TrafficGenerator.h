@@ -0,0 +1,192 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - TrafficGenerator.h
+ *
+ * This file contains a generator for synthetic monitor mode traffic, used for stress testing the packet handling.
+ *
+ **/
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TrafficGenerator_Constants
+{
+    /**
+     * Kinds of frames the generator makes.
+     */
+    enum class FrameType
+    {
+        Beacon = 0,
+        Data,
+        QoSData,
+        Null,
+        QoSNull,
+        Acknowledgement,
+        Count
+    };
+
+    static constexpr std::size_t cFrameTypeCount{static_cast<std::size_t>(FrameType::Count)};
+
+    static constexpr std::array<std::string_view, cFrameTypeCount> cFrameTypeTexts{
+        "beacon", "data", "qos data", "null", "qos null", "ack"};
+
+    /**
+     * Radiotap headers as different drivers make them.
+     */
+    enum class RadioTapLayout
+    {
+        Injection = 0,  /**< Flags, rate, channel and TX flags, like the program sends. */
+        TSFT,           /**< TSFT, flags, rate, channel, antenna signal and RX flags. */
+        MCS,            /**< Flags, channel, antenna signal, RX flags and MCS instead of a rate. */
+        ExtendedBitmap, /**< Like TSFT but with a second present bitmap and per antenna fields. */
+        Count
+    };
+
+    static constexpr std::size_t cRadioTapLayoutCount{static_cast<std::size_t>(RadioTapLayout::Count)};
+
+    // Capture start of generated traffic, fixed so the output only depends on the seed.
+    static constexpr std::chrono::seconds cStartTime{1600000000};
+
+    // Beacon interval of 100 time units of 1024 microseconds, what PSPs and most access points use.
+    static constexpr std::chrono::microseconds cBeaconInterval{102400};
+
+    // PSP games usually send their state every frame, 60 times per second.
+    static constexpr std::chrono::microseconds cGameFrameInterval{16667};
+
+    // Time between a frame and its acknowledgement or retry.
+    static constexpr std::chrono::microseconds cAcknowledgementDelay{44};
+    static constexpr std::chrono::microseconds cRetryDelay{320};
+
+    static constexpr uint16_t cFrequency{2437};
+}  // namespace TrafficGenerator_Constants
+
+using namespace TrafficGenerator_Constants;
+
+/**
+ * What traffic to generate. Ratios are between 0 and 1.
+ */
+struct TrafficMix
+{
+    unsigned int mPSPNetworks{1};            /**< Ad-hoc networks with a PSP_ SSID, the first one gets locked on. */
+    unsigned int mVitaNetworks{0};           /**< Ad-hoc networks with a SCE_ SSID. */
+    unsigned int mForeignNetworks{3};        /**< Access points with unrelated SSIDs and their clients. */
+    unsigned int mStationsPerNetwork{2};     /**< Players in every ad-hoc network. */
+    double       mForeignFrameRate{200};     /**< Data frames per second in every foreign network. */
+    double       mQoSRatio{0.1};             /**< Data and null frames sent as QoS. */
+    double       mNullRatio{0.02};           /**< Game frames replaced by a null frame. */
+    double       mRetryRatio{0.05};          /**< Unicast frames that get retried. */
+    double       mAcknowledgementRatio{0.9}; /**< Unicast frames of which the acknowledgement gets captured. */
+    double       mFCSRatio{0.5};             /**< Frames captured with a frame check sequence at the end. */
+    bool         mVariedRadioTap{true};      /**< Every station gets its own radiotap layout instead of TSFT only. */
+    uint16_t     mMinimumPayload{64};        /**< Smallest game payload in bytes. */
+    uint16_t     mMaximumPayload{512};       /**< Largest game payload in bytes. */
+    uint32_t     mSeed{1};                   /**< Same seed and mix give the same traffic. */
+};
+
+/**
+ * A generated frame, with what the program is expected to do with it.
+ */
+struct GeneratedFrame
+{
+    std::chrono::nanoseconds mTimestamp{0};
+    FrameType                mType{FrameType::Data};
+    std::string              mData{};     /**< Radiotap + 802.11 frame, with FCS if captured with one. */
+    std::string              mEthernet{}; /**< Frame forwarded to XLink Kai when locked on the first PSP network. */
+};
+
+/**
+ * Generates monitor mode traffic in capture order: beacons of all networks, PSP ad-hoc game traffic with realistic
+ * sizes and timing, foreign infrastructure traffic, nulls, retries and acknowledgements.
+ */
+class TrafficGenerator
+{
+public:
+    /**
+     * Sets up the networks and stations.
+     * @param aMix - What traffic to generate.
+     */
+    explicit TrafficGenerator(const TrafficMix& aMix);
+
+    /**
+     * Generates the next frame in time.
+     * @return the frame.
+     */
+    GeneratedFrame Next();
+
+    /**
+     * Generates frames until a point in time.
+     * @param aDuration - Time since the start of the traffic to stop at.
+     * @return the frames.
+     */
+    std::vector<GeneratedFrame> Generate(std::chrono::nanoseconds aDuration);
+
+    /**
+     * Gets the SSID of a network, the PSP networks come first, then the Vita networks and then the foreign ones.
+     * @param aNetwork - Index of the network.
+     * @return the SSID.
+     */
+    [[nodiscard]] std::string_view GetSSID(unsigned int aNetwork) const;
+
+    /**
+     * Gets the BSSID of a network.
+     * @param aNetwork - Index of the network.
+     * @return the BSSID.
+     */
+    [[nodiscard]] uint64_t GetBSSID(unsigned int aNetwork) const;
+
+    /**
+     * Turns an ethernet frame into the datagram XLink Kai exchanges with the program.
+     * @param aEthernet - Ethernet frame.
+     * @return e;e; followed by the frame.
+     */
+    static std::string ToKaiDatagram(std::string_view aEthernet);
+
+private:
+    struct Network
+    {
+        std::string  mSSID{};
+        uint64_t     mBSSID{0};
+        bool         mAdhoc{true};
+        bool         mTarget{false};
+        unsigned int mFirstStation{0};
+        unsigned int mStationCount{0};
+    };
+
+    struct Station
+    {
+        unsigned int   mNetwork{0};
+        uint64_t       mMAC{0};
+        RadioTapLayout mLayout{RadioTapLayout::TSFT};
+        uint16_t       mTypicalPayload{0};
+        uint16_t       mSequence{0};
+    };
+
+    // Something that sends frames on its own: a beacon of a network or a station.
+    struct Source
+    {
+        std::chrono::nanoseconds mNextTime{0};
+        unsigned int             mNetwork{0};
+        int                      mStation{-1};
+    };
+
+    void AddRadioTapHeader(std::string& aFrame, RadioTapLayout aLayout, bool aFCS);
+    void AddFCS(std::string& aFrame, std::size_t aStart);
+    GeneratedFrame MakeBeacon(const Network& aNetwork, std::chrono::nanoseconds aTime);
+    GeneratedFrame MakeData(Station& aStation, std::chrono::nanoseconds aTime);
+    void           Schedule(Source& aSource);
+
+    bool     Chance(double aRatio);
+    uint32_t Uniform(uint32_t aMinimum, uint32_t aMaximum);
+
+    TrafficMix                  mMix;
+    std::vector<Network>        mNetworks{};
+    std::vector<GeneratedFrame> mPending{};
+    std::mt19937                mRandom;
+    std::vector<Source>         mSources{};
+    std::vector<Station>        mStations{};
+};
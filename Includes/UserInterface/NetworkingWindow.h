@@ -17,6 +17,7 @@ namespace
     static constexpr std::string_view cEnableAcknowledgeDataFrames{"EXPERIMENTAL: Acknowledge data frames"};
     static constexpr std::string_view cOnlyAcceptMac{"Only accept data from the following MAC"};
     static constexpr std::string_view cTakeHintsFromXlinkKai{"Take hints from XLink Kai"};
+    static constexpr std::string_view cSearchNetworks{"Show networks in range"};
 }  // namespace
 
 /**
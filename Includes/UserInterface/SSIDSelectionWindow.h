@@ -0,0 +1,51 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - SSIDSelectionWindow.h
+ *
+ * This file contains an class for a userinterface window listing the networks in range.
+ *
+ **/
+
+#include <chrono>
+
+#include "Window.h"
+
+namespace SSIDSelectionWindow_Constants
+{
+    // The table is only read and the list redrawn at this rate, no matter how many beacons come by.
+    static constexpr std::chrono::seconds cNetworksRefreshInterval{1};
+    static constexpr int                  cShownNetworks{16};
+
+    static constexpr std::string_view cNetworksHeader{"BSSID              Ch  Rate  Signal   Mode   SSID"};
+    static constexpr std::string_view cNoNetworksMessage{"No networks found, start the engine in monitor mode"};
+    static constexpr std::string_view cCloseMessage{"Close"};
+}  // namespace SSIDSelectionWindow_Constants
+
+using namespace SSIDSelectionWindow_Constants;
+
+/**
+ * Class that will setup and draw a window with the networks found in captured beacons, strongest signal first.
+ **/
+class SSIDSelectionWindow : public Window
+{
+public:
+    SSIDSelectionWindow(WindowModel& aModel, std::string_view aTitle, const std::function<Dimensions()>& aCalculation);
+
+    void SetUp() override;
+    void Draw() override;
+
+private:
+    /**
+     * Reads the networks from the table and updates the lines with them.
+     */
+    void Sample();
+
+    /**
+     * Sets the text of a line, padded so leftovers of the previous text get cleared.
+     * @param aLine - Line to set, 0 is the header.
+     * @param aText - Text to put on the line.
+     */
+    void SetLine(int aLine, std::string_view aText);
+
+    std::chrono::steady_clock::time_point mLastSample{};
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - StatisticsWindow.h
+ *
+ * This file contains an class for a userinterface statistics window.
+ *
+ **/
+
+#include <chrono>
+#include <deque>
+
+#include "../Metrics.h"
+#include "Window.h"
+
+namespace StatisticsWindow_Constants
+{
+    // Statistics are only sampled and redrawn at this rate, no matter how many packets come by.
+    static constexpr std::chrono::seconds cRefreshInterval{1};
+    static constexpr std::size_t          cHistoryLength{60};
+
+    // Characters used for sparklines, from low to high.
+    static constexpr std::string_view cSparkLineCharacters{" _.-~=*#"};
+
+    static constexpr std::string_view cAirToKaiMessage{"Air -> Kai: "};
+    static constexpr std::string_view cKaiToAirMessage{"Kai -> Air: "};
+    static constexpr std::string_view cDropsMessage{"Drops: "};
+    static constexpr std::string_view cKernelDropsMessage{"Kernel drops: "};
+    static constexpr std::string_view cAckLatencyMessage{"ACK latency p50/p90/p99: "};
+    static constexpr std::string_view cKaiLinkMessage{"Kai link: "};
+
+    /**
+     * Lines in the statistics window, one String object each.
+     */
+    enum class Line
+    {
+        AirToKai = 0,
+        AirToKaiHistory,
+        KaiToAir,
+        KaiToAirHistory,
+        Drops,
+        KernelDrops,
+        AckLatency,
+        KaiLink,
+        KaiLinkHistory,
+        Count
+    };
+}  // namespace StatisticsWindow_Constants
+
+using namespace StatisticsWindow_Constants;
+
+/**
+ * Class that will setup and draw a window with live statistics of the engine.
+ **/
+class StatisticsWindow : public Window
+{
+public:
+    StatisticsWindow(WindowModel& aModel, std::string_view aTitle, const std::function<Dimensions()>& aCalculation);
+
+    void SetUp() override;
+    void Draw() override;
+
+private:
+    /**
+     * Takes a new snapshot from the metrics registry and updates the lines with it.
+     */
+    void Sample();
+
+    /**
+     * Sets the text of a line, padded so leftovers of the previous text get cleared.
+     * @param aLine - Line to set.
+     * @param aText - Text to put on the line.
+     */
+    void SetLine(Line aLine, std::string_view aText);
+
+    /**
+     * Converts the history to a sparkline, scaled to the highest value in the history.
+     * @param aHistory - History to convert.
+     * @return the sparkline, the newest value on the right.
+     */
+    [[nodiscard]] std::string ToSparkLine(const std::deque<double>& aHistory) const;
+
+    MetricsSnapshot                       mLastSnapshot{};
+    std::chrono::steady_clock::time_point mLastSample{};
+    std::deque<double>                    mAirToKaiHistory{};
+    std::deque<double>                    mKaiToAirHistory{};
+    std::deque<double>                    mKaiLinkHistory{};
+};
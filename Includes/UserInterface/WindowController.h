@@ -59,6 +59,12 @@ public:
 private:
     void AdvanceWindow();
 
+    /**
+     * Moves the selection to a window.
+     * @param aIndex - Index of the window to select.
+     */
+    void SelectWindow(int aIndex);
+
     NCursesWindow                            mMainCanvas;
     int                                      mHeight;
     int                                      mWidth;
@@ -66,5 +72,6 @@ private:
     WindowList                               mWindows;
     bool                                     mExclusiveWindow;
     std::pair<int, std::shared_ptr<IWindow>> mWindowSelector;
+    int                                      mSSIDSelectionWindowIndex;
     WindowModel&                             mModel;
 };
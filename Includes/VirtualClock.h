@@ -0,0 +1,104 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - VirtualClock.h
+ *
+ * This file contains a clock on simulated time, with a scheduler for discrete-event simulations.
+ *
+ **/
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "IClock.h"
+
+/**
+ * Clock that only moves when it is told to, so hours of timeouts and traffic can be simulated in seconds with the same
+ * outcome every run. Events are scheduled at points in time and run in order of time, events at the same time run in
+ * the order they have been scheduled in. Waiting on the clock runs the events due before the deadline and then jumps
+ * to the deadline, so code that waits simply lets the simulation continue.
+ *
+ * For reproducible results drive the simulation from one thread. Waits on other threads move the clock as well.
+ */
+class VirtualClock : public IClock
+{
+public:
+    /**
+     * Sets up the clock.
+     * @param aStart - Time the simulation starts at.
+     */
+    explicit VirtualClock(std::chrono::steady_clock::time_point aStart = {});
+
+    std::chrono::steady_clock::time_point Now() override;
+
+    /**
+     * Runs the events due up to the deadline, then moves the clock to the deadline.
+     * @param aDeadline - Time to move to.
+     */
+    void SleepUntil(std::chrono::steady_clock::time_point aDeadline) override;
+
+    /**
+     * Schedules an event, an event in the past runs at the current time.
+     * @param aTime - Time to run the event at.
+     * @param aEvent - Function to run, may schedule more events and wait on the clock.
+     */
+    void Schedule(std::chrono::steady_clock::time_point aTime, std::function<void()> aEvent);
+
+    /**
+     * Schedules an event an amount of time from now.
+     * @param aDelay - Time from now to run the event at.
+     * @param aEvent - Function to run, may schedule more events and wait on the clock.
+     */
+    void ScheduleIn(std::chrono::steady_clock::duration aDelay, std::function<void()> aEvent);
+
+    /**
+     * Moves the clock to the first event and runs it.
+     * @return false if there were no events left.
+     */
+    bool RunNext();
+
+    /**
+     * Runs all events, including the ones they schedule, until there are none left.
+     * @param aLimit - Time to stop at if events keep scheduling new ones.
+     */
+    void Run(std::chrono::steady_clock::time_point aLimit = std::chrono::steady_clock::time_point::max());
+
+    /**
+     * Gets the amount of events that have not run yet.
+     * @return amount of events.
+     */
+    [[nodiscard]] std::size_t GetPendingEvents() const;
+
+private:
+    struct Event
+    {
+        std::chrono::steady_clock::time_point mTime{};
+        uint64_t                              mSequence{0};
+        std::function<void()>                 mFunction{};
+    };
+
+    struct EventOrder
+    {
+        bool operator()(const Event& aFirst, const Event& aSecond) const
+        {
+            return (aFirst.mTime != aSecond.mTime) ? (aFirst.mTime > aSecond.mTime) :
+                                                     (aFirst.mSequence > aSecond.mSequence);
+        }
+    };
+
+    /**
+     * Takes the first event out of the queue if it is due at or before a point in time, and moves the clock to it.
+     * @param aTime - Latest time of the event.
+     * @param aEvent - Filled in with the event.
+     * @return true if an event has been taken out.
+     */
+    bool TakeNext(std::chrono::steady_clock::time_point aTime, Event& aEvent);
+
+    mutable std::mutex                                         mMutex{};
+    std::chrono::steady_clock::time_point                      mNow{};
+    std::priority_queue<Event, std::vector<Event>, EventOrder> mEvents{};
+    uint64_t                                                   mSequence{0};
+};
@@ -8,10 +8,8 @@
  *
  **/
 
-#include <array>
 #include <chrono>
 #include <string_view>
-#include <utility>
 
 #include <linux/nl80211.h>
 
@@ -20,37 +18,21 @@
 #include <netlink/genl/genl.h>
 #include <netlink/netlink.h>
 
+#include "Nl80211Control.h"
+
 struct nl_sock;
 
-/**
- * Class that manages WiFi adapters.
- */
 namespace WifiInterface_Constants
 {
-    static constexpr std::string_view cDriverName{"nl80211"};
-    static constexpr std::string_view cScanCommand{"scan"};
-    static constexpr std::string_view cControlCommand{"nlctrl"};
-    struct TriggerResults
-    {
-        int done;
-        int aborted;
-    };
-
-    struct HandlerArguments
-    {  // For FamilyHandler() and nl_get_multicast_id().
-        std::string group;
-        int         id;
-    };
-
-    struct DumpResultArgument
-    {
-        std::array<nla_policy, NL80211_BSS_MAX + 1>&  bssserviceinfo;
-        std::vector<IWifiInterface::WifiInformation>& adhocnetworks;
-    };
-
-    static constexpr std::chrono::seconds cScanTimeout{30};
-
+    static constexpr std::string_view     cDriverName{"nl80211"};
+    // Scan results older than this get refreshed in the background when they are asked for.
+    static constexpr std::chrono::seconds cScanInterval{5};
 }  // namespace WifiInterface_Constants
+
+/**
+ * Class that manages WiFi adapters. Scanning happens in the background through Nl80211Control, joining and leaving
+ * adhoc networks is done right away.
+ */
 class WifiInterface : public IWifiInterface
 {
 public:
@@ -61,15 +43,12 @@ public:
     bool                                          LeaveIBSS() override;
     uint64_t                                      GetAdapterMACAddress() override;
     std::vector<IWifiInterface::WifiInformation>& GetAdhocNetworks() override;
+    void                                          SetScanResultsCallback(ScanResultsCallback aCallback) override;
+    void                                          SetIBSSCallback(IBSSCallback aCallback) override;
 
 private:
-    void ClearSocket();
-    bool ScanTrigger();
-    int  GetMulticastId();
-    void SetBSSPolicy();
-
     std::string                                  mAdapterName{};
-    std::array<nla_policy, NL80211_BSS_MAX + 1>  mBSSPolicy{};
+    Nl80211Control                               mControl{};
     nl_sock*                                     mSocket{nullptr};
     int                                          mDriverId{0};
     unsigned int                                 mNetworkAdapterIndex{0};
@@ -27,8 +27,12 @@ public:
     uint64_t                      GetAdapterMACAddress() override;
     std::vector<WifiInformation>& GetAdhocNetworks() override;
     bool                          LeaveIBSS() override;
+    void                          SetScanResultsCallback(ScanResultsCallback aCallback) override;
+    void                          SetIBSSCallback(IBSSCallback aCallback) override;
 
 private:
+    // Scans block until they are done, so only joining and leaving is reported.
+    IBSSCallback                 mIBSSCallback{nullptr};
     std::vector<WifiInformation> mLastReceivedScanInformation;
     std::string                  mAdapterName;
     GUID                         mGUID{};
@@ -2,9 +2,11 @@
 
 #include <array>
 #include <chrono>
+#include <memory>
 #include <string>
 
 #include "../Includes/Logger.h"
+#include "../Includes/NetworkTable.h"
 
 namespace WindowModel_Constants
 {
@@ -21,6 +23,12 @@ namespace WindowModel_Constants
     static constexpr std::string_view cSaveXLinkPort{"XLinkPort"};
     static constexpr std::string_view cSaveAcknowledgeDataFrames{"AckDataFrames"};
     static constexpr std::string_view cSaveOnlyAcceptFromMac{"OnlyAcceptFromMac"};
+    static constexpr std::string_view cSaveMetricsPort{"MetricsPort"};
+    static constexpr std::string_view cSaveSlowFrameBudget{"SlowFrameBudgetUs"};
+    static constexpr std::string_view cSaveKaiRecording{"KaiRecording"};
+    static constexpr std::string_view cSaveMultiNetwork{"MultiNetwork"};
+    static constexpr std::string_view cSaveInjectionAdapter{"InjectionAdapter"};
+    static constexpr std::string_view cSaveInjectionBackend{"InjectionBackend"};
 
     static constexpr Logger::Level    cDefaultLogLevel{Logger::Level::ERROR};
     static constexpr bool             cDefaultAutoDiscoverPSPVita{false};
@@ -33,6 +41,18 @@ namespace WindowModel_Constants
     static constexpr std::string_view cDefaultXLinkPort{"34523"};
     static constexpr bool             cDefaultAcknowledgeDataFrames{false};
     static constexpr std::string_view cDefaultOnlyAcceptFromMac{""};
+    // Empty means the metrics endpoint is disabled.
+    static constexpr std::string_view cDefaultMetricsPort{""};
+    // Frames taking longer than this amount of microseconds get logged, 0 disables it.
+    static constexpr std::string_view cDefaultSlowFrameBudget{"10000"};
+    // Empty means the traffic from XLink Kai is not recorded.
+    static constexpr std::string_view cDefaultKaiRecording{""};
+    // Forward every network matching the SSID filter at once, for multiple game lobbies on one channel.
+    static constexpr bool             cDefaultMultiNetwork{false};
+    // Empty means frames get injected on the adapter they are captured on.
+    static constexpr std::string_view cDefaultInjectionAdapter{""};
+    // pcap, packet for a raw socket that skips the qdisc layer, or packet_ring to also batch frames in a TX ring.
+    static constexpr std::string_view cDefaultInjectionBackend{"pcap"};
 
     enum class EngineStatus
     {
@@ -64,17 +84,27 @@ public:
     bool          mAutoDiscoverXLinkKaiInstance{WindowModel_Constants::cDefaultAutoDiscoverXLinkKai};
     bool          mXLinkKaiHints{WindowModel_Constants::cDefaultUseXLinkKaiHints};
     std::string   mWifiAdapter{WindowModel_Constants::cDefaultWifiAdapter};
+    std::string   mInjectionAdapter{WindowModel_Constants::cDefaultInjectionAdapter};
+    std::string   mInjectionBackend{WindowModel_Constants::cDefaultInjectionBackend};
     bool          mUsePSPPlugin{WindowModel_Constants::cDefaultPSPPlugin};
     bool          mAcknowledgeDataFrames{WindowModel_Constants::cDefaultAcknowledgeDataFrames};
     std::string   mOnlyAcceptFromMac{WindowModel_Constants::cDefaultOnlyAcceptFromMac};
+    bool          mMultiNetwork{WindowModel_Constants::cDefaultMultiNetwork};
 
     // Channel as a string because of the textfield this is bound to.
     std::string mChannel{WindowModel_Constants::cDefaultChannel};
     std::string mXLinkIp{WindowModel_Constants::cDefaultXLinkIp};
     std::string mXLinkPort{WindowModel_Constants::cDefaultXLinkPort};
+    std::string mMetricsPort{WindowModel_Constants::cDefaultMetricsPort};
+    std::string mSlowFrameBudget{WindowModel_Constants::cDefaultSlowFrameBudget};
+    std::string mKaiRecording{WindowModel_Constants::cDefaultKaiRecording};
 
     // Statuses
     WindowModel_Constants::EngineStatus mEngineStatus{WindowModel_Constants::EngineStatus::Idle};
+    bool                                mSearchingNetworks{false};
+
+    // Networks seen in the beacons captured by the engine.
+    std::shared_ptr<NetworkTable> mNetworkTable{std::make_shared<NetworkTable>()};
 
     // Commands
     WindowModel_Constants::Command mCommand{WindowModel_Constants::Command::NoCommand};
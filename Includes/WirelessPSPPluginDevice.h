@@ -6,13 +6,20 @@
  *
  * */
 
+#include <atomic>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <thread>
 
+#include "CaptureController.h"
 #include "Handler80211.h"
+#include "IClock.h"
 #include "IConnector.h"
 #include "IPCapDevice.h"
+#include "NetworkCache.h"
+#include "PacketSocket.h"
+#include "SystemClock.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include "WifiInterfaceWindows.h"
@@ -25,6 +32,10 @@ namespace WirelessPSPPluginDevice_Constants
     static constexpr unsigned int         cSnapshotLength{65535};
     static constexpr unsigned int         cPCAPTimeoutMs{1};
     static constexpr std::chrono::seconds cReadWatchdogTimeout{5};
+    static constexpr std::chrono::seconds cStatisticsInterval{1};
+
+    // Filter used while packets are being dropped, the plugin only ever sends frames with the PSP EtherType.
+    static constexpr std::string_view cTightFilter{"ether proto 0x88c8"};
 }  // namespace WirelessPSPPluginDevice_Constants
 
 using namespace WirelessPSPPluginDevice_Constants;
@@ -50,32 +61,133 @@ public:
      */
     uint64_t GetLockedBSSID();
 
-    bool Open(std::string_view aName, std::vector<std::string>& aSSIDFilter) override;
+    bool Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter) override;
     bool Send(std::string_view aData, bool aModifyData);
     bool Send(std::string_view aData) override;
+
+    /**
+     * Sets the clock the read watchdog runs on.
+     * @param aClock - Clock to use.
+     */
+    void SetClock(std::shared_ptr<IClock> aClock);
+
     void SetConnector(std::shared_ptr<IConnector> aDevice) override;
+
+    /**
+     * Sets how frames get injected, the packet socket backends fall back to pcap if the socket cannot be opened. Set it
+     * before opening the device.
+     * @param aBackend - Backend to inject with.
+     */
+    void SetInjectionBackend(InjectionBackend aBackend);
+
+    /**
+     * Sets the cache of known networks, when opened the device joins the most recent adhoc network matching its SSID
+     * filter right away instead of waiting for a scan, when closed it stores the network it was in.
+     * @param aNetworkCache - Cache to use, nullptr to not use one.
+     */
+    void SetNetworkCache(std::shared_ptr<NetworkCache> aNetworkCache);
+
     bool StartReceiverThread() override;
 
 private:
+    /**
+     * Creates and activates a capture handle with the current buffer size and filter of the capture controller.
+     * @return the handle, nullptr if it could not be activated.
+     */
+    pcap_t* Activate();
+
+    /**
+     * Joins an adhoc network matching the SSID filter from the scan results there are, does not wait for a scan.
+     * @return true if a network got joined.
+     */
     bool ConnectToAdhoc();
+
+    /**
+     * Joins the most recent adhoc network in the network cache matching the SSID filter. The background scan and the
+     * read watchdog move on to another network if it turns out to be gone.
+     * @return true if a network got joined.
+     */
+    bool ConnectToCached();
+
+    /**
+     * Checks whether nothing has been received from the joined network for longer than cReadWatchdogTimeout.
+     * @return true if the read watchdog expired.
+     */
+    [[nodiscard]] bool IsReadWatchdogExpired() const;
+
+    /**
+     * Joins an adhoc network and remembers it for the network cache, mWifiMutex has to be held.
+     * @param aNetwork - Network to join.
+     * @return true if the network got joined.
+     */
+    bool JoinNetwork(const IWifiInterface::WifiInformation& aNetwork);
+
+    /**
+     * Called on new scan results, switches networks if the current one is not delivering.
+     */
+    void HandleScanResults();
+
+    /**
+     * Called when the adapter joined or left an adhoc network.
+     * @param aEvent - What happened.
+     */
+    void HandleIBSSEvent(const IWifiInterface::IBSSEvent& aEvent);
+
     bool ReadCallback(const unsigned char* aData, const pcap_pkthdr* aHeader);
+
+    /**
+     * Restarts the read watchdog, so the network gets the full timeout again.
+     */
+    void ResetReadWatchdog();
+
     void ShowPacketStatistics(const pcap_pkthdr* aHeader) const;
 
-    std::vector<uint64_t>           mBlackList{};
-    bool                            mConnected{false};
-    std::shared_ptr<IConnector>     mConnector{nullptr};
-    const unsigned char*            mData{nullptr};
-    pcap_t*                         mHandler{nullptr};
-    uint64_t                        mAdapterMACAddress{};
-    const pcap_pkthdr*              mHeader{nullptr};
-    unsigned int                    mPacketCount{0};
-    std::shared_ptr<std::thread>    mReceiverThread{nullptr};
-    bool                            mSendReceivedData{false};
-    std::vector<std::string>        mSSIDFilter{};
-    std::shared_ptr<IWifiInterface> mWifiInterface{nullptr};
-    std::shared_ptr<std::thread>    mWifiTimeoutThread{nullptr};
+    /**
+     * Reads the drop counters from pcap_stats and lets the capture controller adapt the handle to them.
+     */
+    void SampleCaptureStatistics();
+
+    /**
+     * Sets the capture filter on a handle, tight or open depending on the capture controller.
+     * @param aHandler - Handle to set the filter on.
+     */
+    void SetFilter(pcap_t* aHandler);
+
+    std::string                                        mAdapterName{};
+    std::vector<uint64_t>                              mBlackList{};
+    CaptureController                                  mCaptureController{};
+    std::shared_ptr<IClock>                            mClock{std::make_shared<SystemClock>()};
+    bool                                               mConnected{false};
+    std::shared_ptr<IConnector>                        mConnector{nullptr};
+    const unsigned char*                               mData{nullptr};
+    pcap_t*                                            mHandler{nullptr};
+    // Guards swapping the handle while other threads send on it.
+    std::mutex                                         mHandlerMutex{};
+    uint64_t                                           mAdapterMACAddress{};
+    const pcap_pkthdr*                                 mHeader{nullptr};
+    InjectionBackend                                   mInjectionBackend{InjectionBackend::PCap};
+    // Set while the adapter is in an adhoc network.
+    std::atomic<bool>                                  mJoinedAdhoc{false};
+    // Last network joined, guarded by mWifiMutex.
+    CachedNetwork                                      mJoinedNetwork{};
+    std::chrono::time_point<std::chrono::steady_clock> mLastStatisticsSample{};
+    bool                                               mNanosecondTimestamps{false};
+    std::shared_ptr<NetworkCache>                      mNetworkCache{nullptr};
+    unsigned int                                       mPacketCount{0};
+    // Used to inject on instead of the handle when open, guarded by mHandlerMutex.
+    PacketSocket                                       mPacketSocket{};
+    // PSPs that sent data, only touched by the receiver thread until it has stopped.
+    std::vector<uint64_t>                              mPeers{};
+    std::shared_ptr<std::thread>                       mReceiverThread{nullptr};
+    bool                                               mSendReceivedData{false};
+    std::vector<std::string>                           mSSIDFilter{};
+    std::shared_ptr<IWifiInterface>                    mWifiInterface{nullptr};
+    // Guards the wifi interface, it gets used from the watchdog and from scan results coming in.
+    std::mutex                                         mWifiMutex{};
+    std::shared_ptr<std::thread>                       mWifiTimeoutThread{nullptr};
     /**
      * This timer checks if any data has been received from the connected to network, if not it will try to reconnect.
+     * Kept as the time since the epoch of the clock, as the receiver, watchdog and nl80211 event threads all use it.
      */
-    std::chrono::time_point<std::chrono::system_clock> mReadWatchdog{std::chrono::seconds(0)};
+    std::atomic<std::chrono::steady_clock::rep>        mReadWatchdog{0};
 };
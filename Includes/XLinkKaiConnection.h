@@ -6,13 +6,23 @@
  *
  * */
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/asio.hpp>
 
+#include "Handler80211.h"
 #include "Handler8023.h"
+#include "IClock.h"
 #include "IConnector.h"
+#include "MPSCQueue.h"
+#include "PcapNgWriter.h"
+#include "SystemClock.h"
 
 namespace XLinkKai_Constants
 {
@@ -31,6 +41,17 @@ namespace XLinkKai_Constants
     static constexpr std::chrono::seconds cConnectionTimeout{10};
     static constexpr std::chrono::seconds cKeepAliveTimeout{60};
 
+    static constexpr uint32_t             cRecordingSnapshotLength{cMaxLength};
+
+    // Frames the capture devices can have waiting for the receiver thread to send them to XLink Kai.
+    static constexpr std::size_t cDeviceQueueSize{256};
+    // Stations remembered for sending frames from XLink Kai out on the device they have been heard on.
+    static constexpr std::size_t cMaxLearnedStations{256};
+
+    // Time between attempts to reconnect, and to wait after XLink Kai did not answer a connect in time.
+    static constexpr std::chrono::seconds cReconnectDelay{1};
+    static constexpr std::chrono::seconds cConnectRetryDelay{10};
+
     static const std::string cConnectString{std::string(cConnectFormat) + cSeparator.data() +
                                             cLocallyUniqueName.data() + cSeparator.data() + cEmulatorName.data() +
                                             cSeparator.data()};
@@ -51,6 +72,8 @@ namespace XLinkKai_Constants
 
 using namespace XLinkKai_Constants;
 
+class LatencyTrace;
+
 /**
  * Class that connects to XLink Kai and sends and receives data from and to XLink Kai.
  */
@@ -78,6 +101,13 @@ public:
      */
     bool Connect();
 
+    /**
+     * Reconnects when the connection has been lost and handles the connection and keepalive timeouts, the receiver
+     * thread does this in between handling data. Call it directly to drive the connection from a simulation.
+     * @return time to wait before calling it again, 0 when it can be called again right away.
+     */
+    std::chrono::steady_clock::duration HandleTimers();
+
     /**
      * Synchronous receive of network messages from XLink Kai, may hang if nothing received!.
      * @return True if successful.
@@ -109,9 +139,106 @@ public:
      */
     void SetPort(unsigned int aPort);
 
+    /**
+     * Sets the clock the connection and keepalive timers run on.
+     * @param aClock - Clock to use.
+     */
+    void SetClock(std::shared_ptr<IClock> aClock);
+
+    /**
+     * Makes a device the only one frames from XLink Kai get sent out on, the device sends its frames straight to this
+     * connection.
+     * @param aDevice - Device to use.
+     */
     void SetIncomingConnection(std::shared_ptr<IPCapDevice> aDevice) override;
 
+    /**
+     * Adds one of multiple devices feeding this connection, for example monitor devices on different channels. Every
+     * device captures on its own thread and hands its frames to the returned connector, which queues them for the
+     * receiver thread to send to XLink Kai. The stations in those frames are remembered, so frames from XLink Kai for
+     * them go out on the device they have been heard on, anything else goes out on every device. Add the devices
+     * before starting the receiver thread.
+     * @param aDevice - Device to add.
+     * @return the connector to set on the device, only valid for as long as this connection exists.
+     */
+    std::shared_ptr<IConnector> AddIncomingConnection(std::shared_ptr<IPCapDevice> aDevice);
+
+    /**
+     * Sends the frames queued by the devices added with AddIncomingConnection() to XLink Kai, the receiver thread does
+     * this in between handling data. Call it directly to drive the connection from a simulation.
+     * @return amount of frames that have been taken out of the queue.
+     */
+    std::size_t ProcessDeviceFrames();
+
+    /**
+     * Starts recording every datagram received from XLink Kai to a pcapng file, so the session can be replayed later.
+     * Datagrams are stored as they came in, including keepalives and (dis)connect messages, with a timestamp.
+     * Keeps recording across reconnects.
+     * @param aPath - Path of the file to record to, will be overwritten.
+     * @return true if the file could be opened.
+     */
+    bool StartRecording(std::string_view aPath);
+
+    /**
+     * Stops recording and closes the file.
+     */
+    void StopRecording();
+
 private:
+    /**
+     * A frame captured by one of the devices, waiting in the queue to be sent to XLink Kai.
+     */
+    struct DeviceFrame
+    {
+        std::size_t                  mDevice{0};
+        std::size_t                  mLength{0};
+        std::array<char, cMaxLength> mData{};
+    };
+
+    /**
+     * Connector handed to the devices added with AddIncomingConnection(), queues their frames tagged with the device.
+     */
+    class DevicePort : public IConnector
+    {
+    public:
+        DevicePort(XLinkKaiConnection& aConnection, std::size_t aDevice);
+
+        void Close() override {}
+        bool Open(std::string_view /*aArgument*/) override
+        {
+            return true;
+        }
+        bool ReadNextData() override
+        {
+            return false;
+        }
+        bool Send(std::string_view aData) override;
+        void SetIncomingConnection(std::shared_ptr<IPCapDevice> /*aDevice*/) override {}
+        bool StartReceiverThread() override
+        {
+            return true;
+        }
+
+    private:
+        XLinkKaiConnection& mConnection;
+        std::size_t         mDevice;
+    };
+
+    /**
+     * Queues a frame captured by a device, called from the capture thread of that device.
+     * @param aDevice - Index of the device in mIncomingConnections.
+     * @param aData - Ethernet frame to send to XLink Kai.
+     * @return false if the frame has been dropped because the queue is full or the frame too big.
+     */
+    bool Enqueue(std::size_t aDevice, std::string_view aData);
+
+    /**
+     * Sends the frame from XLink Kai in mPacketHandler out on a device, converted if it is a monitor device.
+     * @param aDevice - Device to send it out on.
+     * @param aTrace - Latency trace of the frame.
+     */
+    void SendToDevice(IPCapDevice& aDevice, LatencyTrace& aTrace);
+
     /**
      * Handles traffic from XLink Kai.
      */
@@ -123,20 +250,39 @@ private:
      */
     bool HandleKeepAlive();
 
-    bool                                               mConnected{false};
-    bool                                               mConnectInitiated{false};
-    std::chrono::time_point<std::chrono::system_clock> mConnectionTimerStart{std::chrono::seconds{0}};
-    std::chrono::time_point<std::chrono::system_clock> mKeepAliveTimerStart{std::chrono::seconds{0}};
+    /**
+     * Writes a datagram received from XLink Kai to the recording.
+     * @param aData - The datagram.
+     */
+    void Record(std::string_view aData);
+
+    std::shared_ptr<IClock>               mClock{std::make_shared<SystemClock>()};
+    bool                                  mConnected{false};
+    bool                                  mConnectInitiated{false};
+    std::chrono::steady_clock::time_point mConnectionTimerStart{};
+    std::chrono::steady_clock::time_point mKeepAliveTimerStart{};
+    std::chrono::steady_clock::time_point mLastKeepAlive{};
 
     std::array<char, cMaxLength> mData{};
+    // Frames from the devices added with AddIncomingConnection(), too big to keep on the stack with the connection.
+    std::unique_ptr<MPSCQueue<DeviceFrame, cDeviceQueueSize>> mDeviceQueue{
+        std::make_unique<MPSCQueue<DeviceFrame, cDeviceQueueSize>>()};
     // Raw ethernet data received from XLink Kai
-    std::string                    mEthernetData{};
-    std::shared_ptr<IPCapDevice>   mIncomingConnection{nullptr};
-    std::string                    mIp{cIp};
-    boost::asio::io_service        mIoService{};
-    Handler8023                    mPacketHandler{};
-    unsigned int                   mPort{cPort};
-    std::shared_ptr<std::thread>   mReceiverThread{nullptr};
-    boost::asio::ip::udp::endpoint mRemote{};
-    boost::asio::ip::udp::socket   mSocket{mIoService};
+    std::string                               mEthernetData{};
+    std::vector<std::shared_ptr<IPCapDevice>> mIncomingConnections{};
+    std::string                               mIp{cIp};
+    boost::asio::io_service                   mIoService{};
+    Handler8023                               mPacketHandler{};
+    unsigned int                              mPort{cPort};
+    std::shared_ptr<std::thread>              mReceiverThread{nullptr};
+    std::unique_ptr<PcapNgWriter>             mRecorder{nullptr};
+    // Networks the last frame got sent in, kept between frames so looking them up does not allocate.
+    std::array<NetworkRoute, cMaxSessions> mRoutes{};
+    uint32_t                               mRecorderInterface{0};
+    std::mutex                             mRecorderMutex{};
+    std::atomic<bool>                      mRecording{false};
+    boost::asio::ip::udp::endpoint         mRemote{};
+    boost::asio::ip::udp::socket           mSocket{mIoService};
+    // Station MAC to the index of the device it has been heard on, only used from the receiver thread.
+    std::unordered_map<uint64_t, std::size_t> mStationDevices{};
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - XdpMonitorDevice.h
+ *
+ * This file contains functions to capture data from a wireless device in monitor mode over an AF_XDP socket.
+ *
+ **/
+
+#include <chrono>
+
+#include "MonitorDevice.h"
+#include "XdpSocket.h"
+
+namespace XdpMonitorDevice_Constants
+{
+    // How long the receiver thread waits for frames before checking whether it should stop.
+    static constexpr std::chrono::milliseconds cReceiveTimeout{10};
+}  // namespace XdpMonitorDevice_Constants
+
+using namespace XdpMonitorDevice_Constants;
+
+/**
+ * Monitor device that captures and injects over an AF_XDP socket instead of pcap. Frames go through the same handler as
+ * they do for MonitorDevice, but are read straight from memory shared with the kernel, without a system call per frame.
+ * Takes over the whole adapter and does not filter in the kernel, so it needs an adapter of its own. The injection
+ * adapter and backend do not apply, frames are sent on the socket.
+ */
+class XdpMonitorDevice : public MonitorDevice
+{
+public:
+    void Close() override;
+    bool Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter) override;
+    bool Send(std::string_view aData) override;
+    bool StartReceiverThread() override;
+
+private:
+    // Header of the frame being handled, AF_XDP does not timestamp frames so they get timestamped when read.
+    pcap_pkthdr mFrameHeader{};
+    XdpSocket   mSocket{};
+};
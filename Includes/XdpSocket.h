@@ -0,0 +1,149 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - XdpSocket.h
+ *
+ * This file contains an AF_XDP socket to capture and inject frames on, as an alternative to pcap.
+ *
+ **/
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+
+namespace XdpSocket_Constants
+{
+    // Every frame of the UMEM is a page, which fits any frame the program captures or sends. The first half of the
+    // frames is received into, the second half is sent from.
+    static constexpr std::size_t cUmemFrameSize{4096};
+    static constexpr std::size_t cUmemFrameCount{512};
+    static constexpr std::size_t cReceiveFrameCount{cUmemFrameCount / 2};
+    static constexpr std::size_t cSendFrameCount{cUmemFrameCount - cReceiveFrameCount};
+    // Every ring can hold all frames it could ever get, so none of them can overflow.
+    static constexpr uint32_t    cXdpRingSize{256};
+    static constexpr uint32_t    cDefaultQueue{0};
+    // Queues of the adapter that can be bound to.
+    static constexpr uint32_t    cMaxQueues{64};
+}  // namespace XdpSocket_Constants
+
+using namespace XdpSocket_Constants;
+
+/**
+ * AF_XDP socket bound to a queue of an adapter. An XDP program hands every frame received on that queue to the socket
+ * before the network stack gets to it, and the kernel copies it into memory shared with the program (the UMEM), so
+ * frames can be read without a system call per frame. Frames to send get copied into the same UMEM and are sent with
+ * one system call for everything queued. Runs in generic mode, which works on any adapter, but copies every frame.
+ * Only available on Linux 5.9 and up, Open fails elsewhere. One thread can receive while others send.
+ */
+class XdpSocket
+{
+public:
+    XdpSocket() = default;
+    ~XdpSocket();
+    XdpSocket(const XdpSocket& aXdpSocket) = delete;
+    XdpSocket& operator=(const XdpSocket& aXdpSocket) = delete;
+
+    /**
+     * Opens the socket on a queue of an adapter and attaches the XDP program to the adapter. Everything received on
+     * the queue goes to the socket from then on, so the adapter should not be used by anything else.
+     * @param aAdapter - Name of the adapter.
+     * @param aQueue - Queue of the adapter to bind to.
+     * @return true if successful.
+     */
+    bool Open(std::string_view aAdapter, uint32_t aQueue = cDefaultQueue);
+
+    /**
+     * Closes the socket, which detaches the XDP program as well.
+     */
+    void Close();
+
+    /**
+     * @return true if the socket has been opened.
+     */
+    [[nodiscard]] bool IsOpen() const;
+
+    /**
+     * Waits for frames to come in and hands all of them to a callback, the frames are only valid during the call.
+     * @param aCallback - Called for every frame received.
+     * @param aTimeout - Time to wait for frames to come in.
+     * @return the amount of frames received.
+     */
+    std::size_t Receive(const std::function<void(std::string_view)>& aCallback, std::chrono::milliseconds aTimeout);
+
+    /**
+     * Copies a frame into the UMEM and queues it to be sent on Flush. Kicks the kernel if all frames to send from are
+     * in use.
+     * @param aData - The frame.
+     * @return true if the frame has been queued.
+     */
+    bool Queue(std::string_view aData);
+
+    /**
+     * Has the kernel send every frame queued.
+     * @return true if successful, also when there was nothing to send.
+     */
+    bool Flush();
+
+    /**
+     * Sends a frame right away.
+     * @param aData - The frame.
+     * @return true if successful.
+     */
+    bool Send(std::string_view aData);
+
+private:
+    /**
+     * A ring shared with the kernel, the program produces to the fill and TX rings and consumes from the RX and
+     * completion rings.
+     */
+    struct Ring
+    {
+        char*       mMap{nullptr};
+        std::size_t mMapSize{0};
+        uint32_t*   mProducer{nullptr};
+        uint32_t*   mConsumer{nullptr};
+        char*       mDescriptors{nullptr};
+    };
+
+    /**
+     * Loads the XDP program that redirects frames to the socket and attaches it to the adapter.
+     * @param aAdapterIndex - Index of the adapter.
+     * @param aQueue - Queue the socket is bound to.
+     * @return true if successful.
+     */
+    bool AttachProgram(unsigned int aAdapterIndex, uint32_t aQueue);
+
+    /**
+     * Sends everything in the TX ring, the kernel only sends part of it per system call.
+     * @return true if successful.
+     */
+    bool Kick();
+
+    /**
+     * Maps the rings shared with the kernel, after their sizes have been set.
+     * @return true if successful.
+     */
+    bool MapRings();
+
+    /**
+     * Takes back the frames the kernel is done sending, so they can be sent from again.
+     */
+    void Reclaim();
+
+    int                                   mSocket{-1};
+    // Keeps the XDP program attached, closing it detaches the program.
+    int                                   mLink{-1};
+    char*                                 mUmem{nullptr};
+    Ring                                  mFillRing{};
+    Ring                                  mCompletionRing{};
+    Ring                                  mReceiveRing{};
+    Ring                                  mSendRing{};
+    std::array<uint64_t, cSendFrameCount> mFreeFrames{};
+    std::size_t                           mFreeFrameCount{0};
+    std::size_t                           mQueued{0};
+    // Guards the TX side, which gets used by every thread that sends.
+    std::mutex                            mSendMutex{};
+};
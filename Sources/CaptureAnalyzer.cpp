@@ -0,0 +1,222 @@
+#include "../Includes/CaptureAnalyzer.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureAnalyzer.cpp */
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <thread>
+
+#include "../Includes/Handler80211.h"
+#include "../Includes/Logger.h"
+#include "../Includes/NetConversionFunctions.h"
+#include "../Includes/PcapNgWriter.h"
+
+using namespace std::chrono;
+
+void InterArrivalStatistics::Add(nanoseconds aTimestamp)
+{
+    if (mEmpty) {
+        mFirst = aTimestamp;
+        mEmpty = false;
+    } else {
+        // Welford's online algorithm, so the jitter can be calculated in one pass without losing precision.
+        auto lGap{static_cast<double>((aTimestamp - mLast).count())};
+        mGaps++;
+        double lDistance{lGap - mMean};
+        mMean += lDistance / static_cast<double>(mGaps);
+        mSquaredDistance += lDistance * (lGap - mMean);
+    }
+    mLast = aTimestamp;
+}
+
+void InterArrivalStatistics::Merge(const InterArrivalStatistics& aLater)
+{
+    if (mEmpty) {
+        *this = aLater;
+    } else if (!aLater.mEmpty) {
+        // The gap between the last frame of this part and the first of the next one belongs to neither.
+        Add(aLater.mFirst);
+
+        // Chan et al., combining the means and squared distances of both parts.
+        uint64_t lGaps{mGaps + aLater.mGaps};
+        if (aLater.mGaps > 0) {
+            double lDistance{aLater.mMean - mMean};
+            double lOwnWeight{static_cast<double>(mGaps)};
+            double lLaterWeight{static_cast<double>(aLater.mGaps)};
+            mMean += lDistance * lLaterWeight / static_cast<double>(lGaps);
+            mSquaredDistance += aLater.mSquaredDistance +
+                                lDistance * lDistance * lOwnWeight * lLaterWeight / static_cast<double>(lGaps);
+        }
+        mGaps = lGaps;
+        mLast = aLater.mLast;
+    }
+}
+
+double InterArrivalStatistics::GetMean() const
+{
+    return mMean;
+}
+
+double InterArrivalStatistics::GetJitter() const
+{
+    return (mGaps > 0) ? std::sqrt(mSquaredDistance / static_cast<double>(mGaps)) : 0;
+}
+
+void FrameStatistics::Merge(const FrameStatistics& aLater)
+{
+    mFrames += aLater.mFrames;
+    mBytes += aLater.mBytes;
+    mRetries += aLater.mRetries;
+    mForwarded += aLater.mForwarded;
+    mDropped += aLater.mDropped;
+    for (const auto& [lRate, lFrames] : aLater.mRates) {
+        mRates[lRate] += lFrames;
+    }
+    mInterArrival.Merge(aLater.mInterArrival);
+}
+
+double FrameStatistics::GetRetryRate() const
+{
+    return (mFrames > 0) ? static_cast<double>(mRetries) / static_cast<double>(mFrames) : 0;
+}
+
+void CaptureStatistics::Merge(const CaptureStatistics& aLater)
+{
+    mTotal.Merge(aLater.mTotal);
+    for (const auto& [lBSSID, lStatistics] : aLater.mBSSIDs) {
+        mBSSIDs[lBSSID].Merge(lStatistics);
+    }
+    for (const auto& [lStation, lStatistics] : aLater.mStations) {
+        mStations[lStation].Merge(lStatistics);
+    }
+}
+
+std::string RateToText(uint16_t aRate)
+{
+    std::string lReturn{"unknown"};
+
+    if (aRate == cUnknownRate) {
+        // Neither a rate nor MCS info in the radiotap header.
+    } else if (aRate >= cMCSRate) {
+        lReturn = "MCS " + std::to_string(aRate - cMCSRate);
+    } else {
+        // In 500 kbps units, so only ever a half to show.
+        lReturn = std::to_string(aRate / 2) + ((aRate % 2 != 0) ? ".5" : "");
+    }
+
+    return lReturn;
+}
+
+CaptureAnalyzer::CaptureAnalyzer(ConvertOptions aOptions) : mOptions(std::move(aOptions)) {}
+
+bool CaptureAnalyzer::Analyze(const MappedCapture& aInput)
+{
+    bool lReturn{false};
+
+    mStatistics = {};
+
+    if (aInput.IsOpen() && (aInput.GetLinkType() == PcapNgWriter_Constants::cLinkTypeRadioTap)) {
+        unsigned int lThreads{(mOptions.mThreads > 0) ? mOptions.mThreads :
+                                                        std::max(std::thread::hardware_concurrency(), 1U)};
+
+        // Statistics get merged in capture order, so the gaps between chunks end up where they belong.
+        std::deque<std::future<CaptureStatistics>> lPending{};
+        for (const CaptureConverter::Chunk& lChunk : CaptureConverter::Split(aInput, mOptions, true)) {
+            if (lPending.size() >= 2 * lThreads) {
+                mStatistics.Merge(lPending.front().get());
+                lPending.pop_front();
+            }
+            lPending.push_back(std::async(std::launch::async, [this, lChunk]() { return AnalyzeChunk(lChunk); }));
+        }
+
+        while (!lPending.empty()) {
+            mStatistics.Merge(lPending.front().get());
+            lPending.pop_front();
+        }
+        lReturn = true;
+    } else {
+        Logger::GetInstance().Log("Can only analyze radiotap captures, link type " +
+                                      std::to_string(aInput.GetLinkType()),
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+CaptureStatistics CaptureAnalyzer::AnalyzeChunk(const CaptureConverter::Chunk& aChunk) const
+{
+    CaptureStatistics lReturn{};
+
+    std::unique_ptr<Handler80211> lHandler{CaptureConverter::MakeHandler80211(mOptions, aChunk.mLockedBSSID)};
+    RadioTapReader                lRadioTapReader{};
+    MappedCapture::Cursor         lCursor{aChunk.mStart};
+    CapturedPacket                lPacket{};
+
+    for (std::size_t lCount = 0; (lCount < aChunk.mPackets) && lCursor.Next(lPacket); lCount++) {
+        lHandler->Update(lPacket.mData);
+        lRadioTapReader.FillRadioTapParameters(lPacket.mData);
+
+        RadioTapReader::PhysicalDeviceParameters lParameters{lRadioTapReader.ExportRadioTapParameters()};
+        uint16_t                                 lRate{cUnknownRate};
+        if ((lParameters.mPresentFlags & cMCSPresentFlag) != 0) {
+            lRate = cMCSRate + lParameters.mMCSInfo;
+        } else if ((lParameters.mPresentFlags & cRatePresentFlag) != 0) {
+            lRate = lParameters.mDataRate;
+        }
+
+        uint16_t lLength{lRadioTapReader.GetLength()};
+        bool     lComplete{lPacket.mData.size() >= lLength + Net_80211_Constants::c80211DataHeaderLength};
+        uint8_t  lFrameControl{lComplete ? GetRawData<uint8_t>(lPacket.mData, lLength) : uint8_t{0}};
+        uint8_t  lFlags{lComplete ? GetRawData<uint8_t>(lPacket.mData, lLength + 1) : uint8_t{0}};
+        bool     lRetry{(lFlags & Net_80211_Constants::cDataRetryFlag) != 0};
+
+        auto lCountFrame = [&](FrameStatistics& aStatistics) {
+            aStatistics.mFrames++;
+            aStatistics.mBytes += lPacket.mData.size();
+            aStatistics.mRetries += lRetry ? 1 : 0;
+            aStatistics.mForwarded += lHandler->ShouldSend() ? 1 : 0;
+            aStatistics.mDropped += lHandler->IsDropped() ? 1 : 0;
+            aStatistics.mRates[lRate]++;
+            aStatistics.mInterArrival.Add(lPacket.mTimestamp);
+        };
+
+        lCountFrame(lReturn.mTotal);
+
+        // Control frames do not carry a BSSID or the MAC of who sent them, so only count those in the total.
+        uint8_t lMainType{static_cast<uint8_t>(lFrameControl >> 2U & 0b11U)};
+        if (lComplete && ((lMainType == cManagementMainType) || (lMainType == cDataMainType))) {
+            // Where the BSSID is depends on whether the frame goes to or comes from the distribution system.
+            unsigned int lBSSIDIndex{0};
+            switch (lFlags & cDistributionSystemFlags) {
+                case cToDistributionSystemFlag:
+                    lBSSIDIndex = Net_80211_Constants::cDestinationAddressIndex;
+                    break;
+                case cFromDistributionSystemFlag:
+                    lBSSIDIndex = Net_80211_Constants::cSourceAddressIndex;
+                    break;
+                case cDistributionSystemFlags:
+                    // Between access points, there is no single BSSID to count it under.
+                    break;
+                default:
+                    lBSSIDIndex = Net_80211_Constants::cBSSIDIndex;
+            }
+
+            if (lBSSIDIndex != 0) {
+                uint64_t lBSSID{GetRawData<uint64_t>(lPacket.mData, lLength + lBSSIDIndex)};
+                lCountFrame(lReturn.mBSSIDs[lBSSID & Net_Constants::cBroadcastMac]);
+            }
+
+            uint64_t lSource{GetRawData<uint64_t>(lPacket.mData, lLength + Net_80211_Constants::cSourceAddressIndex)};
+            lCountFrame(lReturn.mStations[lSource & Net_Constants::cBroadcastMac]);
+        }
+    }
+
+    return lReturn;
+}
+
+const CaptureStatistics& CaptureAnalyzer::GetStatistics() const
+{
+    return mStatistics;
+}
@@ -0,0 +1,107 @@
+#include "../Includes/CaptureController.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureController.cpp */
+
+#include <algorithm>
+#include <string>
+
+#include "../Includes/Logger.h"
+#include "../Includes/Metrics.h"
+
+namespace
+{
+    // Counters going down means they have been reset, the new value is all new drops then.
+    uint64_t GetIncrease(uint64_t aValue, uint64_t aLastValue)
+    {
+        return (aValue >= aLastValue) ? (aValue - aLastValue) : aValue;
+    }
+}  // namespace
+
+CaptureController::~CaptureController()
+{
+    // The drops stay counted, but this buffer and filter are no longer in use.
+    Metrics::GetInstance().Add(Gauge::CaptureBufferSize, -mPublishedBufferSize);
+    Metrics::GetInstance().Add(Gauge::CaptureFilterTightened, -mPublishedFilterTightened);
+}
+
+CaptureAdjustment CaptureController::Update(uint64_t                              aKernelDrops,
+                                            uint64_t                              aInterfaceDrops,
+                                            std::chrono::steady_clock::time_point aNow)
+{
+    CaptureAdjustment lReturn{};
+
+    uint64_t lNewKernelDrops{GetIncrease(aKernelDrops, mLastKernelDrops)};
+    uint64_t lNewInterfaceDrops{GetIncrease(aInterfaceDrops, mLastInterfaceDrops)};
+    mKernelDrops += lNewKernelDrops;
+    mInterfaceDrops += lNewInterfaceDrops;
+    mLastKernelDrops    = aKernelDrops;
+    mLastInterfaceDrops = aInterfaceDrops;
+
+    if (lNewKernelDrops > 0) {
+        // Only the kernel drops say something about the buffer, the interface drops happen before it.
+        if (mBufferSize < mMaximumBufferSize) {
+            mBufferSize         = std::min(mBufferSize * 2, mMaximumBufferSize);
+            lReturn.mGrowBuffer = true;
+            Logger::GetInstance().Log("Kernel dropped " + std::to_string(lNewKernelDrops) +
+                                          " packets, growing capture buffer to " + std::to_string(mBufferSize),
+                                      Logger::Level::INFO);
+        }
+    }
+
+    if ((lNewKernelDrops > 0) || (lNewInterfaceDrops > 0)) {
+        mLastDrop = aNow;
+        if (!mFilterTightened) {
+            mFilterTightened       = true;
+            lReturn.mTightenFilter = true;
+            Logger::GetInstance().Log("Packets are being dropped, tightening capture filter", Logger::Level::INFO);
+        }
+    } else if (mFilterTightened && (aNow > (mLastDrop + cRelaxFilterAfter))) {
+        mFilterTightened     = false;
+        lReturn.mRelaxFilter = true;
+        Logger::GetInstance().Log("No more packets dropped, relaxing capture filter", Logger::Level::INFO);
+    }
+
+    Metrics::GetInstance().Increment(Counter::KernelDrops, lNewKernelDrops);
+    Metrics::GetInstance().Increment(Counter::InterfaceDrops, lNewInterfaceDrops);
+
+    // Other capture devices share these gauges, so only add what changed for this one.
+    int64_t lFilterTightened{mFilterTightened ? 1 : 0};
+    Metrics::GetInstance().Add(Gauge::CaptureBufferSize, mBufferSize - mPublishedBufferSize);
+    Metrics::GetInstance().Add(Gauge::CaptureFilterTightened, lFilterTightened - mPublishedFilterTightened);
+    mPublishedBufferSize      = mBufferSize;
+    mPublishedFilterTightened = lFilterTightened;
+
+    return lReturn;
+}
+
+void CaptureController::Restarted()
+{
+    mLastKernelDrops    = 0;
+    mLastInterfaceDrops = 0;
+}
+
+void CaptureController::RevertBufferSize()
+{
+    mBufferSize        = std::max(mBufferSize / 2, cInitialBufferSize);
+    mMaximumBufferSize = mBufferSize;
+}
+
+unsigned int CaptureController::GetBufferSize() const
+{
+    return mBufferSize;
+}
+
+bool CaptureController::IsFilterTightened() const
+{
+    return mFilterTightened;
+}
+
+uint64_t CaptureController::GetKernelDrops() const
+{
+    return mKernelDrops;
+}
+
+uint64_t CaptureController::GetInterfaceDrops() const
+{
+    return mInterfaceDrops;
+}
@@ -0,0 +1,223 @@
+#include "../Includes/CaptureConverter.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureConverter.cpp */
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include "../Includes/Handler80211.h"
+#include "../Includes/Handler8023.h"
+#include "../Includes/Logger.h"
+#include "../Includes/PcapNgWriter.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    /**
+     * Gets the first byte of the frame control field of a radiotap + 802.11 frame.
+     * @param aData - The frame.
+     * @param aFrameControl - Filled in with the byte.
+     * @return true if the frame is long enough.
+     */
+    bool GetFrameControl(std::string_view aData, uint8_t& aFrameControl)
+    {
+        bool     lReturn{false};
+        uint16_t lRadioTapLength{0};
+
+        if (aData.size() >= RadioTap_Constants::cLengthIndex + sizeof(lRadioTapLength)) {
+            memcpy(&lRadioTapLength, aData.data() + RadioTap_Constants::cLengthIndex, sizeof(lRadioTapLength));
+            if (aData.size() > lRadioTapLength) {
+                aFrameControl = static_cast<uint8_t>(aData.at(lRadioTapLength));
+                lReturn       = true;
+            }
+        }
+
+        return lReturn;
+    }
+}  // namespace
+
+CaptureConverter::CaptureConverter(ConvertOptions aOptions) : mOptions(std::move(aOptions)) {}
+
+std::unique_ptr<Handler80211> CaptureConverter::MakeHandler80211(const ConvertOptions& aOptions, uint64_t aBSSID)
+{
+    auto lHandler{std::make_unique<Handler80211>(PhysicalDeviceHeaderType::RadioTap)};
+
+    // The handler takes the lists over, so give it copies.
+    std::vector<std::string> lSSIDFilter{aOptions.mSSIDFilter};
+    std::vector<uint64_t>    lBlackList{aOptions.mBlackList};
+    lHandler->SetSSIDFilterList(lSSIDFilter);
+    lHandler->SetMACBlackList(lBlackList);
+    if (aBSSID != 0) {
+        lHandler->SetBSSID(aBSSID);
+    }
+
+    return lHandler;
+}
+
+bool CaptureConverter::Convert(const MappedCapture& aInput, PcapNgWriter& aOutput)
+{
+    bool lReturn{false};
+
+    mFramesRead    = 0;
+    mFramesWritten = 0;
+
+    uint16_t lLinkType{aInput.GetLinkType()};
+    bool     lMonitorCapture{lLinkType == PcapNgWriter_Constants::cLinkTypeRadioTap};
+    if (aInput.IsOpen() && aOutput.IsOpen() &&
+        (lMonitorCapture || (lLinkType == PcapNgWriter_Constants::cLinkTypeEthernet))) {
+        uint32_t lInterface{aOutput.AddInterface(
+            lMonitorCapture ? PcapNgWriter_Constants::cLinkTypeEthernet : PcapNgWriter_Constants::cLinkTypeRadioTap,
+            std::numeric_limits<uint16_t>::max())};
+
+        unsigned int lThreads{(mOptions.mThreads > 0) ? mOptions.mThreads :
+                                                        std::max(std::thread::hardware_concurrency(), 1U)};
+
+        // Keep a couple of chunks more in flight than there are threads, so a slow chunk at the front of the queue
+        // does not leave cores idle while the output is written in order.
+        std::deque<std::future<std::vector<ConvertedFrame>>> lPending{};
+        lReturn         = true;
+        auto lWriteNext = [&]() {
+            for (const ConvertedFrame& lFrame : lPending.front().get()) {
+                lReturn = aOutput.WritePacket(lInterface, lFrame.mTimestamp, lFrame.mData) && lReturn;
+                mFramesWritten++;
+            }
+            lPending.pop_front();
+        };
+
+        for (const Chunk& lChunk : Split(aInput, mOptions, lMonitorCapture)) {
+            if (lPending.size() >= 2 * lThreads) {
+                lWriteNext();
+            }
+            lPending.push_back(std::async(std::launch::async, [this, lChunk, lMonitorCapture]() {
+                return ConvertChunk(lChunk, lMonitorCapture);
+            }));
+            mFramesRead += lChunk.mPackets;
+        }
+
+        while (!lPending.empty()) {
+            lWriteNext();
+        }
+    } else {
+        Logger::GetInstance().Log("Can only convert radiotap and ethernet captures, link type " +
+                                      std::to_string(lLinkType),
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+std::vector<CaptureConverter::Chunk> CaptureConverter::Split(const MappedCapture&  aInput,
+                                                             const ConvertOptions& aOptions,
+                                                             bool                  aMonitorCapture)
+{
+    std::vector<Chunk> lReturn{};
+
+    // Only beacons change what the handler is locked onto, so the pass only has to look at those.
+    std::unique_ptr<Handler80211> lHandler{MakeHandler80211(aOptions, aOptions.mBSSID)};
+    std::size_t                   lChunkSize{std::max<std::size_t>(aOptions.mChunkSize, 1)};
+    MappedCapture::Cursor         lCursor{aInput.GetCursor()};
+    MappedCapture::Cursor         lStart{lCursor};
+    CapturedPacket                lPacket{};
+    std::size_t                   lPackets{0};
+
+    while (lCursor.Next(lPacket)) {
+        if ((lPackets % lChunkSize) == 0) {
+            lReturn.push_back({lStart, 0, lHandler->GetLockedBSSID()});
+        }
+        lReturn.back().mPackets++;
+        lPackets++;
+
+        uint8_t lFrameControl{0};
+        if (aMonitorCapture && GetFrameControl(lPacket.mData, lFrameControl) &&
+            (lFrameControl == Net_80211_Constants::cBeaconType)) {
+            lHandler->Update(lPacket.mData);
+        }
+
+        // The start of the next chunk, before any blocks in front of its first packet have been read.
+        lStart = lCursor;
+    }
+
+    return lReturn;
+}
+
+std::vector<CaptureConverter::ConvertedFrame> CaptureConverter::ConvertChunk(const Chunk& aChunk,
+                                                                             bool         aMonitorCapture) const
+{
+    std::vector<ConvertedFrame> lReturn{};
+
+    std::unique_ptr<Handler80211> lHandler80211{aMonitorCapture ? MakeHandler80211(mOptions, aChunk.mLockedBSSID) :
+                                                                  nullptr};
+    Handler8023                   lHandler8023{};
+    MappedCapture::Cursor         lCursor{aChunk.mStart};
+    CapturedPacket                lPacket{};
+
+    for (std::size_t lCount = 0; (lCount < aChunk.mPackets) && lCursor.Next(lPacket); lCount++) {
+        if (aMonitorCapture) {
+            lHandler80211->Update(lPacket.mData);
+            if (lHandler80211->ShouldSend()) {
+                const std::string& lConverted{lHandler80211->ConvertPacket()};
+                if (!lConverted.empty()) {
+                    lReturn.push_back({lPacket.mTimestamp, lConverted});
+                }
+            }
+        } else {
+            lHandler8023.Update(lPacket.mData);
+            const std::string& lConverted{lHandler8023.ConvertPacket(mOptions.mBSSID, mOptions.mParameters)};
+            if (!lConverted.empty()) {
+                lReturn.push_back({lPacket.mTimestamp, lConverted});
+            }
+        }
+    }
+
+    return lReturn;
+}
+
+bool CaptureConverter::TakeParametersFrom(const MappedCapture& aReference)
+{
+    bool lReturn{false};
+
+    std::unique_ptr<Handler80211> lHandler{MakeHandler80211(mOptions, mOptions.mBSSID)};
+    MappedCapture::Cursor         lCursor{aReference.GetCursor()};
+    CapturedPacket                lPacket{};
+
+    // The handler only keeps the parameters of plain data frames.
+    while (!lReturn && (aReference.GetLinkType() == PcapNgWriter_Constants::cLinkTypeRadioTap) &&
+           lCursor.Next(lPacket)) {
+        lHandler->Update(lPacket.mData);
+
+        uint8_t lFrameControl{0};
+        lReturn = lHandler->ShouldSend() && GetFrameControl(lPacket.mData, lFrameControl) &&
+                  (lFrameControl == Net_80211_Constants::cDataType);
+    }
+
+    if (lReturn) {
+        mOptions.mBSSID      = lHandler->GetLockedBSSID();
+        mOptions.mParameters = lHandler->GetDataPacketParameters();
+    } else {
+        Logger::GetInstance().Log("No data frames of a network to lock onto in the reference capture",
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+const ConvertOptions& CaptureConverter::GetOptions() const
+{
+    return mOptions;
+}
+
+uint64_t CaptureConverter::GetFramesRead() const
+{
+    return mFramesRead;
+}
+
+uint64_t CaptureConverter::GetFramesWritten() const
+{
+    return mFramesWritten;
+}
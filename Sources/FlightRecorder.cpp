@@ -0,0 +1,149 @@
+#include "../Includes/FlightRecorder.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - FlightRecorder.cpp */
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "../Includes/Logger.h"
+#include "../Includes/PcapNgWriter.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    // Copy of a slot taken while dumping, so the ring can keep being written to.
+    struct FrameCopy
+    {
+        uint64_t    sequence;
+        Stage       stage;
+        Verdict     verdict;
+        uint32_t    length;
+        int64_t     recordtime;
+        int64_t     capturetime;
+        std::string data;
+    };
+
+    bool IsEthernetStage(Stage aStage)
+    {
+        return (aStage != Stage::MonitorReceived) && (aStage != Stage::MonitorSent);
+    }
+}  // namespace
+
+void FlightRecorder::Init(std::size_t aFrameCount, std::string_view aDumpDirectory)
+{
+    mSlots         = std::make_unique<Slot[]>(aFrameCount);
+    mSlotCount     = aFrameCount;
+    mDumpDirectory = aDumpDirectory;
+    mHead.store(0);
+}
+
+void FlightRecorder::Record(Stage aStage, Verdict aVerdict, std::string_view aData, nanoseconds aCaptureTime)
+{
+    if (mSlotCount > 0) {
+        uint64_t lTicket{mHead.fetch_add(1, std::memory_order_relaxed)};
+        Slot&    lSlot{mSlots[lTicket % mSlotCount]};
+
+        // Odd sequence tells the dumper this slot is being written to.
+        lSlot.mSequence.store((lTicket * 2) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        lSlot.mStage          = aStage;
+        lSlot.mVerdict        = aVerdict;
+        lSlot.mLength         = static_cast<uint32_t>(aData.size());
+        lSlot.mCapturedLength = static_cast<uint32_t>(std::min(aData.size(), cMaxFrameLength));
+        lSlot.mRecordTime     = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+        lSlot.mCaptureTime    = aCaptureTime.count();
+        memcpy(lSlot.mData.data(), aData.data(), lSlot.mCapturedLength);
+
+        lSlot.mSequence.store((lTicket * 2) + 2, std::memory_order_release);
+    }
+}
+
+bool FlightRecorder::Dump(std::string_view aReason)
+{
+    auto lTime{system_clock::to_time_t(system_clock::now())};
+
+    std::stringstream lFileName;
+    lFileName << mDumpDirectory << cDumpFilePrefix << std::put_time(std::gmtime(&lTime), "%Y%m%d_%H%M%S") << "_"
+              << aReason << cDumpFileExtension;
+
+    return DumpToFile(lFileName.str());
+}
+
+bool FlightRecorder::DumpToFile(std::string_view aPath)
+{
+    bool lReturn{false};
+
+    if (mSlotCount > 0) {
+        std::lock_guard<std::mutex> lLock{mDumpMutex};
+
+        std::vector<FrameCopy> lFrames{};
+        lFrames.reserve(mSlotCount);
+
+        for (std::size_t lCount = 0; lCount < mSlotCount; lCount++) {
+            Slot&    lSlot{mSlots[lCount]};
+            uint64_t lSequence{lSlot.mSequence.load(std::memory_order_acquire)};
+
+            if ((lSequence != 0) && ((lSequence % 2) == 0)) {
+                FrameCopy lCopy{lSequence,
+                                lSlot.mStage,
+                                lSlot.mVerdict,
+                                lSlot.mLength,
+                                lSlot.mRecordTime,
+                                lSlot.mCaptureTime,
+                                std::string(lSlot.mData.data(), lSlot.mCapturedLength)};
+
+                // If the sequence changed while copying, a writer got in between, skip it.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (lSlot.mSequence.load(std::memory_order_relaxed) == lSequence) {
+                    lFrames.emplace_back(std::move(lCopy));
+                }
+            }
+        }
+
+        std::sort(lFrames.begin(), lFrames.end(), [](const FrameCopy& aFirst, const FrameCopy& aSecond) {
+            return aFirst.sequence < aSecond.sequence;
+        });
+
+        PcapNgWriter lWriter{};
+        if (lWriter.Open(aPath)) {
+            uint32_t lRadioTapInterface{
+                lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeRadioTap, cMaxFrameLength)};
+            uint32_t lEthernetInterface{
+                lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cMaxFrameLength)};
+
+            lReturn = true;
+            for (auto& lFrame : lFrames) {
+                std::string lComment{"stage=" + std::string(cStageTexts.at(static_cast<unsigned long>(lFrame.stage))) +
+                                     " verdict=" +
+                                     std::string(cVerdictTexts.at(static_cast<unsigned long>(lFrame.verdict)))};
+                if (lFrame.capturetime != 0) {
+                    lComment += " capture_to_record_ns=" + std::to_string(lFrame.recordtime - lFrame.capturetime);
+                }
+
+                lReturn &= lWriter.WritePacket(IsEthernetStage(lFrame.stage) ? lEthernetInterface : lRadioTapInterface,
+                                               nanoseconds(lFrame.recordtime),
+                                               lFrame.data,
+                                               lFrame.length,
+                                               lComment);
+            }
+            lWriter.Close();
+
+            Logger::GetInstance().Log("Flight recorder dumped " + std::to_string(lFrames.size()) +
+                                          " frames to: " + std::string(aPath),
+                                      Logger::Level::INFO);
+        }
+    }
+
+    return lReturn;
+}
+
+std::size_t FlightRecorder::GetFrameCount() const
+{
+    return mSlotCount;
+}
@@ -2,7 +2,10 @@
 
 /* Copyright (c) 2020 [Rick de Bondt] - Handler80211.cpp */
 
+#include <utility>
+
 #include "../Includes/Logger.h"
+#include "../Includes/Metrics.h"
 #include "../Includes/NetConversionFunctions.h"
 
 Handler80211::Handler80211(PhysicalDeviceHeaderType aType)
@@ -12,6 +15,58 @@ Handler80211::Handler80211(PhysicalDeviceHeaderType aType)
     }
 
     mParameter80211Reader = std::make_shared<Parameter80211Reader>(mPhysicalDeviceHeaderReader);
+
+    // Reserved up front, so frames of the networks and stations that are known do not allocate.
+    mSessions.reserve(cMaxSessions);
+    mStations.reserve(cMaxSessions * cMaxCachedPeers);
+}
+
+NetworkSession* Handler80211::AddSession(uint64_t aBSSID)
+{
+    NetworkSession* lReturn{nullptr};
+
+    if (!mMultiNetwork) {
+        mSessions.clear();
+        mStations.clear();
+    } else if ((mSessions.size() >= cMaxSessions) && (mNetworkTable != nullptr)) {
+        // Make room by dropping a network that stopped sending beacons, if there is none this one does not fit.
+        auto lGone{std::find_if(mSessions.begin(), mSessions.end(), [&](const auto& aSession) {
+            return !mNetworkTable->IsPresent(aSession.first);
+        })};
+        if (lGone != mSessions.end()) {
+            RemoveSession(lGone->first);
+        }
+    }
+
+    if (mSessions.size() < cMaxSessions) {
+        lReturn         = &mSessions[aBSSID];
+        lReturn->mBSSID = aBSSID;
+        lReturn->mPeers.reserve(cMaxCachedPeers);
+        mSessionChanges++;
+
+        if ((mLockedBSSID == 0) || (mSessions.find(mLockedBSSID) == mSessions.end())) {
+            mLockedBSSID = aBSSID;
+            Metrics::GetInstance().Set(Info::LockedBSSID, IntToMac(aBSSID));
+        }
+    }
+
+    return lReturn;
+}
+
+void Handler80211::AddPeer(NetworkSession& aSession, uint64_t aMAC)
+{
+    if ((aSession.mPeers.size() < cMaxCachedPeers) &&
+        (std::find(aSession.mPeers.begin(), aSession.mPeers.end(), aMAC) == aSession.mPeers.end())) {
+        aSession.mPeers.push_back(aMAC);
+    }
+
+    // A station that moved to another network gets its frames from XLink Kai there.
+    auto lStation{mStations.find(aMAC)};
+    if (lStation != mStations.end()) {
+        lStation->second = aSession.mBSSID;
+    } else if (mStations.size() < cMaxSessions * cMaxCachedPeers) {
+        mStations.emplace(aMAC, aSession.mBSSID);
+    }
 }
 
 void Handler80211::AddToMACBlackList(uint64_t aMAC)
@@ -38,9 +93,10 @@ void Handler80211::ClearMACWhiteList()
     mWhiteList.clear();
 }
 
-std::string Handler80211::ConvertPacket()
+const std::string& Handler80211::ConvertPacket()
 {
-    std::string lConvertedPacket{};
+    // Reuse the buffer of the previous frame, so no memory gets allocated once it is large enough.
+    mConvertedPacket.clear();
 
     // Only important if Data type
     if ((mPhysicalDeviceHeaderReader != nullptr) && (mMainPacketType == Main80211PacketType::Data)) {
@@ -74,23 +130,25 @@ std::string Handler80211::ConvertPacket()
                 if (mLastReceivedData.size() >
                     Net_80211_Constants::cDataHeaderLength + mPhysicalDeviceHeaderReader->GetLength()) {
                     // Strip framecheck sequence as well.
-                    lConvertedPacket.reserve(mLastReceivedData.size() - Net_80211_Constants::cDataIndex -
+                    mConvertedPacket.reserve(mLastReceivedData.size() - Net_80211_Constants::cDataIndex -
                                              mPhysicalDeviceHeaderReader->GetLength() - lFCSLength);
 
-                    lConvertedPacket.append(mLastReceivedData.substr(lDestinationAddressIndex,
-                                                                     Net_80211_Constants::cDestinationAddressLength));
+                    mConvertedPacket.append(
+                        mLastReceivedData, lDestinationAddressIndex, Net_80211_Constants::cDestinationAddressLength);
+
+                    mConvertedPacket.append(
+                        mLastReceivedData, lSourceAddressIndex, Net_80211_Constants::cSourceAddressLength);
 
-                    lConvertedPacket.append(
-                        mLastReceivedData.substr(lSourceAddressIndex, Net_80211_Constants::cSourceAddressLength));
+                    mConvertedPacket.append(mLastReceivedData, lTypeIndex, Net_80211_Constants::cEtherTypeLength);
 
-                    lConvertedPacket.append(
-                        mLastReceivedData.substr(lTypeIndex, Net_80211_Constants::cEtherTypeLength));
+                    mConvertedPacket.append(
+                        mLastReceivedData, lDataIndex, mLastReceivedData.size() - lDataIndex - lFCSLength);
 
-                    lConvertedPacket.append(
-                        mLastReceivedData.substr(lDataIndex, mLastReceivedData.size() - lDataIndex - lFCSLength));
+                    Metrics::GetInstance().Increment(Counter::ConvertedToEthernet);
                 } else {
                     Logger::GetInstance().Log("The header has an invalid length, cannot convert the packet",
                                               Logger::Level::WARNING);
+                    Metrics::GetInstance().Increment(Counter::DroppedInvalidLength);
                 }
             default:
                 break;
@@ -98,7 +156,7 @@ std::string Handler80211::ConvertPacket()
     }
 
     // [ Destination MAC | Source MAC | EtherType ] [ Payload ]
-    return lConvertedPacket;
+    return mConvertedPacket;
 }
 
 const RadioTapReader::PhysicalDeviceParameters& Handler80211::GetControlPacketParameters()
@@ -116,6 +174,11 @@ std::string_view Handler80211::GetPacket()
     return mLastReceivedData;
 }
 
+uint64_t Handler80211::GetBSSID() const
+{
+    return mBSSID;
+}
+
 uint64_t Handler80211::GetDestinationMAC() const
 {
     return mDestinationMac;
@@ -126,6 +189,74 @@ uint64_t Handler80211::GetLockedBSSID() const
     return mLockedBSSID;
 }
 
+CachedNetwork Handler80211::GetLockedNetwork() const
+{
+    CachedNetwork lReturn{};
+
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+    auto                        lSession{mSessions.find(mLockedBSSID)};
+    if (lSession != mSessions.end()) {
+        lReturn.mSSID          = lSession->second.mSSID;
+        lReturn.mBSSID         = lSession->second.mBSSID;
+        lReturn.mFrequency     = lSession->second.mParametersData.mFrequency;
+        lReturn.mIsAdhoc       = lSession->second.mIsAdhoc;
+        lReturn.mHasParameters = lSession->second.mParametersData.mLength != 0;
+        lReturn.mParameters    = lSession->second.mParametersData;
+        lReturn.mPeers         = lSession->second.mPeers;
+    }
+
+    return lReturn;
+}
+
+std::size_t Handler80211::GetRoutes(uint64_t aDestinationMAC, std::array<NetworkRoute, cMaxSessions>& aRoutes) const
+{
+    std::size_t lReturn{0};
+
+    auto lAddRoute{[&](const NetworkSession& aSession) {
+        // Until a data frame of the network came in, what the last one was received with is the best guess.
+        aRoutes.at(lReturn).mBSSID = aSession.mBSSID;
+        aRoutes.at(lReturn).mParameters =
+            (aSession.mParametersData.mLength != 0) ? aSession.mParametersData : mPhysicalDeviceParametersData;
+        lReturn++;
+    }};
+
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+    auto                        lStation{mStations.find(aDestinationMAC)};
+    if (lStation != mStations.end()) {
+        lAddRoute(mSessions.at(lStation->second));
+    } else {
+        for (const auto& lSession : mSessions) {
+            lAddRoute(lSession.second);
+        }
+    }
+
+    return lReturn;
+}
+
+uint64_t Handler80211::GetSessionChanges() const
+{
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+    return mSessionChanges;
+}
+
+std::vector<NetworkSession> Handler80211::GetSessions() const
+{
+    std::vector<NetworkSession> lReturn{};
+
+    {
+        std::lock_guard<std::mutex> lLock{mSessionMutex};
+        for (const auto& lSession : mSessions) {
+            lReturn.push_back(lSession.second);
+        }
+    }
+
+    std::sort(lReturn.begin(), lReturn.end(), [](const NetworkSession& aFirst, const NetworkSession& aSecond) {
+        return aFirst.mBSSID < aSecond.mBSSID;
+    });
+
+    return lReturn;
+}
+
 uint64_t Handler80211::GetSourceMAC() const
 {
     return mSourceMac;
@@ -138,7 +269,7 @@ bool Handler80211::IsAckable() const
 
 bool Handler80211::IsBSSIDAllowed(uint64_t aBSSID) const
 {
-    return mLockedBSSID == aBSSID;
+    return (aBSSID == mLockedBSSID) || (mSessions.find(aBSSID) != mSessions.end());
 }
 
 bool Handler80211::ShouldSend() const
@@ -203,9 +334,85 @@ void Handler80211::SavePhysicalDeviceParameters(RadioTapReader::PhysicalDevicePa
     }
 }
 
+void Handler80211::LockOnto(uint64_t aBSSID)
+{
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+    AddSession(aBSSID);
+}
+
+void Handler80211::MoveSession(uint64_t aFrom, uint64_t aTo)
+{
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+
+    // Moving the node over keeps the session as it is, without allocating.
+    auto lSession{mSessions.extract(aFrom)};
+    if (!lSession.empty() && (mSessions.find(aTo) == mSessions.end())) {
+        lSession.key()           = aTo;
+        lSession.mapped().mBSSID = aTo;
+        mSessions.insert(std::move(lSession));
+        mSessionChanges++;
+
+        for (auto& lStation : mStations) {
+            if (lStation.second == aFrom) {
+                lStation.second = aTo;
+            }
+        }
+
+        if (mLockedBSSID == aFrom) {
+            mLockedBSSID = aTo;
+            Metrics::GetInstance().Set(Info::LockedBSSID, IntToMac(aTo));
+        }
+    }
+}
+
+void Handler80211::RemoveSession(uint64_t aBSSID)
+{
+    mSessions.erase(aBSSID);
+    mSessionChanges++;
+    for (auto lStation = mStations.begin(); lStation != mStations.end();) {
+        if (lStation->second == aBSSID) {
+            lStation = mStations.erase(lStation);
+        } else {
+            lStation++;
+        }
+    }
+}
+
 void Handler80211::SetBSSID(uint64_t aBSSID)
 {
-    mLockedBSSID = aBSSID;
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+    NetworkSession*             lSession{AddSession(aBSSID)};
+    if (lSession != nullptr) {
+        lSession->mConfirmed = true;
+        mSessionChanges++;
+    }
+}
+
+void Handler80211::SetCachedNetwork(const CachedNetwork& aNetwork)
+{
+    std::lock_guard<std::mutex> lLock{mSessionMutex};
+    NetworkSession*             lSession{AddSession(aNetwork.mBSSID)};
+
+    if (lSession != nullptr) {
+        lSession->mConfirmed = false;
+        lSession->mSSID      = aNetwork.mSSID;
+        lSession->mIsAdhoc   = aNetwork.mIsAdhoc;
+        Metrics::GetInstance().Set(Info::LockedSSID, aNetwork.mSSID);
+
+        // Sending to the network works before a frame of it has been received.
+        if (aNetwork.mHasParameters) {
+            lSession->mParametersData     = aNetwork.mParameters;
+            mPhysicalDeviceParametersData = aNetwork.mParameters;
+        }
+
+        for (uint64_t lPeer : aNetwork.mPeers) {
+            AddPeer(*lSession, lPeer);
+        }
+
+        Logger::GetInstance().Log(
+            "Locked onto cached network: " + aNetwork.mSSID + ", BSSID: " + IntToMac(aNetwork.mBSSID),
+            Logger::Level::DEBUG);
+    }
 }
 
 void Handler80211::SetMACBlackList(std::vector<uint64_t>& aBlackList)
@@ -218,9 +425,19 @@ void Handler80211::SetMACWhiteList(std::vector<uint64_t>& aWhiteList)
     mWhiteList = std::move(aWhiteList);
 }
 
-void Handler80211::SetSSIDFilterList(std::vector<std::string>& aSSIDList)
+void Handler80211::SetMultiNetwork(bool aMultiNetwork)
+{
+    mMultiNetwork = aMultiNetwork;
+}
+
+void Handler80211::SetNetworkTable(std::shared_ptr<NetworkTable> aNetworkTable)
 {
-    mSSIDList = std::move(aSSIDList);
+    mNetworkTable = std::move(aNetworkTable);
+}
+
+void Handler80211::SetSSIDFilterList(const std::vector<std::string>& aSSIDList)
+{
+    mSSIDList = aSSIDList;
 }
 
 void Handler80211::Update(std::string_view aPacket)
@@ -234,6 +451,11 @@ void Handler80211::Update(std::string_view aPacket)
 
     if (mPhysicalDeviceHeaderReader != nullptr) {
         mPhysicalDeviceHeaderReader->FillRadioTapParameters(aPacket);
+
+        if (aPacket.size() > mPhysicalDeviceHeaderReader->GetLength()) {
+            Metrics::GetInstance().CountFrameType(
+                GetRawData<uint8_t>(aPacket, mPhysicalDeviceHeaderReader->GetLength()));
+        }
     }
 
     UpdateMainPacketType();
@@ -257,6 +479,18 @@ void Handler80211::Update(std::string_view aPacket)
             // Only do something with the data frame if we care about this network
             UpdateSourceMac();
             UpdateBSSID();
+
+            // A cached network may be gone, follow its peers to where they are now.
+            if ((mBSSID != 0) && (mSessions.find(mBSSID) == mSessions.end())) {
+                auto lStation{mStations.find(mSourceMac)};
+                if ((lStation != mStations.end()) && !mSessions.at(lStation->second).mConfirmed) {
+                    Logger::GetInstance().Log(
+                        "Following peer: " + IntToMac(mSourceMac) + " to BSSID: " + IntToMac(mBSSID),
+                        Logger::Level::DEBUG);
+                    MoveSession(lStation->second, mBSSID);
+                }
+            }
+
             if (IsMACAllowed(mSourceMac) && IsBSSIDAllowed(mBSSID)) {
                 UpdateDestinationMac();
                 UpdateAckable();
@@ -266,44 +500,95 @@ void Handler80211::Update(std::string_view aPacket)
                 // Only save parameters on normal data types.
                 if (!mRetry) {
                     switch (mDataPacketType) {
-                        case Data80211PacketType::Data:
+                        case Data80211PacketType::Data: {
                             Logger::GetInstance().Log("Saving parameters for a Data packet type", Logger::Level::TRACE);
+                            // GetRoutes falls back on these from the XLink Kai thread.
+                            std::lock_guard<std::mutex> lLock{mSessionMutex};
                             SavePhysicalDeviceParameters(mPhysicalDeviceParametersData);
                             mShouldSend = true;
                             break;
+                        }
                         case Data80211PacketType::QoSData:
                             mShouldSend = true;
                             break;
                         default:
                             break;
                     }
+
+                    auto lSession{mSessions.find(mBSSID)};
+                    if (mShouldSend && (lSession != mSessions.end())) {
+                        std::lock_guard<std::mutex> lLock{mSessionMutex};
+                        if (mDataPacketType == Data80211PacketType::Data) {
+                            lSession->second.mParametersData = mPhysicalDeviceParametersData;
+                        }
+                        AddPeer(lSession->second, mSourceMac);
+                    }
                     mIsDropped = false;
                 } else {
                     Logger::GetInstance().Log("Packet Retry blocked", Logger::Level::TRACE);
+                    Metrics::GetInstance().Increment(Counter::DroppedRetry);
                 }
+            } else if (!IsBSSIDAllowed(mBSSID)) {
+                Metrics::GetInstance().Increment(Counter::DroppedBSSID);
+            } else {
+                Metrics::GetInstance().Increment(Counter::DroppedMACFilter);
             }
             break;
         case Main80211PacketType::Management:
             UpdateSourceMac();
 
+            // Networks are discovered from every beacon, the filters only decide what to lock onto.
+            if (mNetworkTable != nullptr) {
+                UpdateNetworkTable();
+            }
+
             if (IsMACAllowed(mSourceMac)) {
                 UpdateManagementPacketType();
 
                 if (mManagementPacketType == Management80211PacketType::Beacon) {
-                    mParameter80211Reader->Update(mLastReceivedData);
+                    if (mNetworkTable == nullptr) {
+                        mParameter80211Reader->Update(mLastReceivedData);
+                    }
                     if (IsSSIDAllowed(mParameter80211Reader->GetSSID())) {
                         UpdateBSSID();
-                        if (mBSSID != mLockedBSSID) {
-                            mLockedBSSID = mBSSID;
-                            Logger::GetInstance().Log(std::string("SSID switched:") +
-                                                          mParameter80211Reader->GetSSID().data() +
-                                                          ", BSSID: " + IntToMac(mBSSID),
-                                                      Logger::Level::DEBUG);
-
-                            mIsDropped = false;
+                        // With multiple networks every one matching the filter gets a session. Otherwise keep
+                        // following the network locked onto while it is around, instead of flapping between every
+                        // network that matches the filter.
+                        auto lSession{mSessions.find(mBSSID)};
+                        if ((lSession == mSessions.end()) &&
+                            (mMultiNetwork || (mNetworkTable == nullptr) || (mLockedBSSID == 0) ||
+                             !mNetworkTable->IsPresent(mLockedBSSID))) {
+                            LockOnto(mBSSID);
+
+                            // There may not have been room for it.
+                            lSession = mSessions.find(mBSSID);
+                            if (lSession != mSessions.end()) {
+                                std::string_view lAction{mMultiNetwork ? "SSID added:" : "SSID switched:"};
+                                Logger::GetInstance().Log(std::string(lAction) +
+                                                              mParameter80211Reader->GetSSID().data() +
+                                                              ", BSSID: " + IntToMac(mBSSID),
+                                                          Logger::Level::DEBUG);
+                                if (mLockedBSSID == mBSSID) {
+                                    Metrics::GetInstance().Set(Info::LockedSSID, mParameter80211Reader->GetSSID());
+                                }
+                                mIsDropped = false;
+                            }
                         }
+
+                        // A beacon of a network locked onto confirms it is really there.
+                        if ((lSession != mSessions.end()) && !lSession->second.mConfirmed) {
+                            std::lock_guard<std::mutex> lLock{mSessionMutex};
+                            lSession->second.mConfirmed = true;
+                            lSession->second.mSSID.assign(mParameter80211Reader->GetSSID());
+                            lSession->second.mIsAdhoc = mParameter80211Reader->GetIsAdhoc();
+                            mSessionChanges++;
+                        }
+                    } else {
+                        Metrics::GetInstance().Increment(Counter::DroppedSSIDFilter);
                     }
                 }
+            } else {
+                Metrics::GetInstance().Increment(Counter::DroppedMACFilter);
             }
             break;
         default:
@@ -332,6 +617,22 @@ void Handler80211::UpdateBSSID()
     }
 }
 
+void Handler80211::UpdateNetworkTable()
+{
+    UpdateManagementPacketType();
+
+    if (mManagementPacketType == Management80211PacketType::Beacon) {
+        mParameter80211Reader->Update(mLastReceivedData);
+        UpdateBSSID();
+        mNetworkTable->Update(mBSSID,
+                              mParameter80211Reader->GetSSID(),
+                              mParameter80211Reader->GetChannel(),
+                              mParameter80211Reader->GetMaxRate(),
+                              mParameter80211Reader->GetIsAdhoc(),
+                              mPhysicalDeviceHeaderReader->GetAntennaSignal());
+    }
+}
+
 void Handler80211::UpdateControlPacketType()
 {
     Control80211PacketType lResult{Control80211PacketType::None};
@@ -346,7 +647,7 @@ void Handler80211::UpdateControlPacketType()
             lResult = Control80211PacketType::BlockAck;
         } else if ((lControlType & 0b1111U) == 0b1101U) {
             lResult = Control80211PacketType::ACK;
-        } else {
+        } else if (Logger::GetInstance().ShouldLog(Logger::Level::DEBUG)) {
             Logger::GetInstance().Log("Could not determine control packet type: " + std::to_string(lControlType),
                                       Logger::Level::DEBUG);
         }
@@ -372,7 +673,7 @@ void Handler80211::UpdateDataPacketType()
             lResult = Data80211PacketType::QoSData;
         } else if ((lDataType & 0b1111U) == 0b1100U) {
             lResult = Data80211PacketType::QoSNull;
-        } else {
+        } else if (Logger::GetInstance().ShouldLog(Logger::Level::DEBUG)) {
             Logger::GetInstance().Log("Could not determine data packet type: " + std::to_string(lDataType),
                                       Logger::Level::DEBUG);
         }
@@ -435,7 +736,7 @@ void Handler80211::UpdateManagementPacketType()
             lResult = Management80211PacketType::Action;
         } else if ((lManagementType & 0b1111U) == 0b1110U) {
             lResult = Management80211PacketType::ActionNoAck;
-        } else {
+        } else if (Logger::GetInstance().ShouldLog(Logger::Level::DEBUG)) {
             Logger::GetInstance().Log("Could not determine management packet type: " + std::to_string(lManagementType),
                                       Logger::Level::DEBUG);
         }
@@ -3,6 +3,7 @@
 /* Copyright (c) 2020 [Rick de Bondt] - Handler8023.cpp */
 
 #include "../Includes/Logger.h"
+#include "../Includes/Metrics.h"
 #include "../Includes/NetConversionFunctions.h"
 
 void Handler8023::AddToMACBlackList(uint64_t aMAC)
@@ -29,9 +30,11 @@ void Handler8023::ClearMACWhiteList()
     mWhiteList.clear();
 }
 
-std::string Handler8023::ConvertPacket(uint64_t aBSSID, RadioTapReader::PhysicalDeviceParameters aParameters)
+const std::string& Handler8023::ConvertPacket(uint64_t aBSSID, RadioTapReader::PhysicalDeviceParameters aParameters)
 {
-    std::string lReturn;
+    // Reuse the buffer of the previous frame, so no memory gets allocated once it is large enough.
+    mConvertedPacket.clear();
+
     if (mLastReceivedData.size() > Net_8023_Constants::cHeaderLength) {
         unsigned int lIeee80211HeaderSize{sizeof(ieee80211_hdr)};
         unsigned int lLLCHeaderSize{sizeof(uint64_t)};
@@ -40,21 +43,19 @@ std::string Handler8023::ConvertPacket(uint64_t aBSSID, RadioTapReader::Physical
 
         unsigned int lReserveSize{lIeee80211HeaderSize + lLLCHeaderSize + lDataSize};
 
-        std::vector<char> lFullPacket;
-        lFullPacket.reserve(lReserveSize);
-        lFullPacket.resize(lReserveSize);
+        // Make room for the largest possible RadioTap header, the size is known after it has been written.
+        mConvertedPacket.resize(RadioTap_Constants::cMaxLength + lReserveSize);
 
         unsigned int lIndex{0};
 
         // RadioTap Header
-        int lRadioTapSize = InsertRadioTapHeader(&lFullPacket[0], aParameters);
+        int lRadioTapSize = InsertRadioTapHeader(mConvertedPacket.data(), aParameters);
         lIndex += lRadioTapSize;
 
-        lFullPacket.reserve(lReserveSize + lRadioTapSize);
-        lFullPacket.resize(lReserveSize + lRadioTapSize);
+        mConvertedPacket.resize(lReserveSize + lRadioTapSize);
 
         // IEEE80211 Header
-        InsertIEEE80211Header(&lFullPacket[0], mSourceMAC, mDestinationMAC, aBSSID, lIndex);
+        InsertIEEE80211Header(mConvertedPacket.data(), mSourceMAC, mDestinationMAC, aBSSID, lIndex);
         lIndex += lIeee80211HeaderSize;
 
         // Logical Link Control (LLC) header
@@ -66,21 +67,22 @@ std::string Handler8023::ConvertPacket(uint64_t aBSSID, RadioTapReader::Physical
 
         lLLC |= lEtherType << 48LLU;
 
-        memcpy(&lFullPacket[0] + lIndex, &lLLC, sizeof(lLLC));
+        memcpy(mConvertedPacket.data() + lIndex, &lLLC, sizeof(lLLC));
         lIndex += lLLCHeaderSize;
 
         // Data, without header included
-        memcpy(&lFullPacket[0] + lIndex,
+        memcpy(mConvertedPacket.data() + lIndex,
                mLastReceivedData.data() + (Net_8023_Constants::cHeaderLength * (sizeof(char))),
                mLastReceivedData.size() - (Net_8023_Constants::cHeaderLength * (sizeof(char))));
 
-        lReturn = std::string(lFullPacket.begin(), lFullPacket.end());
+        Metrics::GetInstance().Increment(Counter::ConvertedToWireless);
     } else {
         Logger::GetInstance().Log("The header has an invalid length, cannot convert the packet",
                                   Logger::Level::WARNING);
+        Metrics::GetInstance().Increment(Counter::DroppedInvalidLength);
     }
 
-    return lReturn;
+    return mConvertedPacket;
 }
 
 uint64_t Handler8023::GetDestinationMAC() const
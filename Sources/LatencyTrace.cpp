@@ -0,0 +1,104 @@
+#include "../Includes/LatencyTrace.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - LatencyTrace.cpp */
+
+#include <string>
+
+#include "../Includes/Logger.h"
+
+using namespace std::chrono;
+
+std::atomic<int64_t>  LatencyTrace::mSlowFrameBudget{0};
+std::atomic<int64_t>  LatencyTrace::mLastSlowFrameLog{0};
+std::atomic<uint64_t> LatencyTrace::mSuppressedSlowFrames{0};
+
+LatencyTrace::LatencyTrace(Direction aDirection, nanoseconds aOrigin) : mDirection(aDirection)
+{
+    mPoints.at(static_cast<std::size_t>(Point::Origin)) = aOrigin;
+}
+
+void LatencyTrace::Mark(Point aPoint)
+{
+    mPoints.at(static_cast<std::size_t>(aPoint)) = Now();
+}
+
+nanoseconds LatencyTrace::Get(Point aPoint) const
+{
+    return mPoints.at(static_cast<std::size_t>(aPoint));
+}
+
+void LatencyTrace::Finish()
+{
+    auto lDirection{static_cast<std::size_t>(mDirection)};
+
+    // Points that have not been recorded are skipped, the next step is measured from the last recorded point then.
+    std::size_t lPrevious{0};
+    for (std::size_t lPoint = 1; lPoint < cPointCount; lPoint++) {
+        if (mPoints.at(lPoint).count() != 0) {
+            Histogram lHistogram{cStepHistograms.at(lDirection).at(lPoint - 1)};
+            if ((lHistogram != Histogram::Count) && (mPoints.at(lPrevious).count() != 0)) {
+                Metrics::GetInstance().RecordLatency(lHistogram, mPoints.at(lPoint) - mPoints.at(lPrevious));
+            }
+            lPrevious = lPoint;
+        }
+    }
+
+    nanoseconds lTotal{Get(Point::Sent) - Get(Point::Origin)};
+    if ((Get(Point::Origin).count() != 0) && (Get(Point::Sent).count() != 0)) {
+        Metrics::GetInstance().RecordLatency(cTotalHistograms.at(lDirection), lTotal);
+
+        int64_t lBudget{mSlowFrameBudget.load(std::memory_order_relaxed)};
+        if ((lBudget > 0) && (lTotal.count() > lBudget)) {
+            LogSlowFrame(lTotal);
+        }
+    }
+}
+
+void LatencyTrace::LogSlowFrame(nanoseconds aTotal) const
+{
+    int64_t lNow{Now().count()};
+    int64_t lLastLog{mLastSlowFrameLog.load(std::memory_order_relaxed)};
+
+    // Sample the slow frames, a burst of them would otherwise slow everything down even more.
+    if (((lNow - lLastLog) >= duration_cast<nanoseconds>(cSlowFrameLogInterval).count()) &&
+        mLastSlowFrameLog.compare_exchange_strong(lLastLog, lNow, std::memory_order_relaxed)) {
+        std::string lBreakdown{(mDirection == Direction::AirToKai) ? "Slow frame air -> Kai: " :
+                                                                     "Slow frame Kai -> air: "};
+        lBreakdown += std::to_string(aTotal.count() / 1000) + " us total";
+
+        std::size_t lPrevious{0};
+        for (std::size_t lPoint = 1; lPoint < cPointCount; lPoint++) {
+            if (mPoints.at(lPoint).count() != 0) {
+                lBreakdown += ", " + std::string(cPointTexts.at(lPrevious)) + " -> " +
+                              std::string(cPointTexts.at(lPoint)) + " " +
+                              std::to_string((mPoints.at(lPoint) - mPoints.at(lPrevious)).count() / 1000) + " us";
+                lPrevious = lPoint;
+            }
+        }
+
+        uint64_t lSuppressed{mSuppressedSlowFrames.exchange(0, std::memory_order_relaxed)};
+        if (lSuppressed > 0) {
+            lBreakdown += " (" + std::to_string(lSuppressed) + " more slow frames since last report)";
+        }
+
+        Logger::GetInstance().Log(lBreakdown, Logger::Level::WARNING);
+    } else {
+        mSuppressedSlowFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void LatencyTrace::SetSlowFrameBudget(nanoseconds aBudget)
+{
+    mSlowFrameBudget.store(aBudget.count(), std::memory_order_relaxed);
+}
+
+nanoseconds LatencyTrace::Now()
+{
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch());
+}
+
+nanoseconds LatencyTrace::FromTimestamp(const timeval& aTimestamp, bool aNanoseconds)
+{
+    return seconds(aTimestamp.tv_sec) +
+           (aNanoseconds ? nanoseconds(aTimestamp.tv_usec) : nanoseconds(microseconds(aTimestamp.tv_usec)));
+}
@@ -75,15 +75,20 @@ void Logger::SetLogToScreen(bool aLoggingToScreenEnabled)
     mLogToScreen = aLoggingToScreenEnabled;
 }
 
+bool Logger::ShouldLog(Level aLevel) const
+{
+    return (aLevel >= mLogLevel) && (mLogToScreen || (mLogToDisk && mLogOutputStream.is_open()));
+}
+
 #if defined(__GNUC__) || defined(__GNUG__)
-void Logger::Log(const std::string& aText, Level aLevel, const std::experimental::source_location& aLocation)
+void Logger::Log(std::string_view aText, Level aLevel, const std::experimental::source_location& aLocation)
 #else
-void Logger::Log(const std::string& aText, Level aLevel)
+void Logger::Log(std::string_view aText, Level aLevel)
 #endif
 {
-    std::stringstream lLogEntry;
+    if (ShouldLog(aLevel)) {
+        std::stringstream lLogEntry;
 
-    if (aLevel >= mLogLevel) {
         auto lTime        = std::chrono::system_clock::now();
         auto lTimeAsTimeT = std::chrono::system_clock::to_time_t(lTime);
         auto lTimeMs      = std::chrono::duration_cast<std::chrono::milliseconds>(lTime.time_since_epoch()) % 1000;
@@ -0,0 +1,514 @@
+#include "../Includes/MappedCapture.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - MappedCapture.cpp */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../Includes/Logger.h"
+
+using namespace MappedCapture_Constants;
+using namespace std::chrono;
+
+namespace
+{
+    // Largest power of ten that fits in 64 bits.
+    constexpr uint8_t cMaximumDecimalResolution{19};
+    constexpr uint8_t cBinaryResolutionFlag{0x80};
+    constexpr uint8_t cMaximumBinaryResolution{63};
+
+    template<typename Type> Type Read(const char* aData, bool aSwapped)
+    {
+        std::array<char, sizeof(Type)> lBytes{};
+        memcpy(lBytes.data(), aData, sizeof(Type));
+        if (aSwapped) {
+            std::reverse(lBytes.begin(), lBytes.end());
+        }
+
+        Type lReturn{};
+        memcpy(&lReturn, lBytes.data(), sizeof(Type));
+        return lReturn;
+    }
+
+    uint64_t PowerOfTen(uint8_t aExponent)
+    {
+        uint64_t lReturn{1};
+        for (uint8_t lCount = 0; lCount < aExponent; lCount++) {
+            lReturn *= 10;
+        }
+        return lReturn;
+    }
+
+    /**
+     * Converts a timestamp to nanoseconds.
+     * @param aTimestamp - Timestamp in units of the resolution.
+     * @param aResolution - pcapng if_tsresol, 10^-value or 2^-value when the highest bit is set.
+     * @return the timestamp in nanoseconds, 0 when the resolution is not supported.
+     */
+    nanoseconds ToNanoseconds(uint64_t aTimestamp, uint8_t aResolution)
+    {
+        uint64_t lReturn{0};
+        uint8_t  lExponent{static_cast<uint8_t>(aResolution & ~cBinaryResolutionFlag)};
+
+        if ((aResolution & cBinaryResolutionFlag) != 0) {
+            if (lExponent <= cMaximumBinaryResolution) {
+                uint64_t lFraction{aTimestamp & ((uint64_t{1} << lExponent) - 1)};
+                lReturn = (aTimestamp >> lExponent) * PowerOfTen(9) +
+                          static_cast<uint64_t>(std::ldexp(static_cast<double>(lFraction), -lExponent) * 1e9);
+            }
+        } else if (lExponent <= 9) {
+            lReturn = aTimestamp * PowerOfTen(9 - lExponent);
+        } else if (lExponent <= cMaximumDecimalResolution) {
+            lReturn = aTimestamp / PowerOfTen(lExponent - 9);
+        }
+
+        return nanoseconds(lReturn);
+    }
+}  // namespace
+
+MappedCapture::Cursor::Cursor(const MappedCapture& aCapture) : mCapture(&aCapture)
+{
+    Rewind();
+}
+
+bool MappedCapture::Cursor::Next(CapturedPacket& aPacket)
+{
+    bool lReturn{false};
+
+    if ((mCapture != nullptr) && mCapture->IsOpen()) {
+        lReturn = mCapture->mPcapNg ? NextPcapNg(aPacket) : NextPcap(aPacket);
+    }
+
+    return lReturn;
+}
+
+bool MappedCapture::Cursor::NextPcap(CapturedPacket& aPacket)
+{
+    bool lReturn{false};
+
+    if (mOffset + cPcapRecordHeaderLength <= mCapture->mSize) {
+        const char* lRecord{mCapture->mData + mOffset};
+        uint32_t    lSeconds{Read<uint32_t>(lRecord, mSection.mSwapped)};
+        uint32_t    lFraction{Read<uint32_t>(lRecord + 4, mSection.mSwapped)};
+        uint32_t    lCapturedLength{Read<uint32_t>(lRecord + 8, mSection.mSwapped)};
+        uint32_t    lOriginalLength{Read<uint32_t>(lRecord + 12, mSection.mSwapped)};
+
+        if (mOffset + cPcapRecordHeaderLength + lCapturedLength <= mCapture->mSize) {
+            uint64_t lTimestamp{lSeconds * PowerOfTen(mSection.mInterfaces.front().mResolution) + lFraction};
+            lReturn = SetPacket(
+                aPacket, 0, lTimestamp, mOffset + cPcapRecordHeaderLength, lCapturedLength, lOriginalLength);
+            if (lReturn) {
+                mPacketOffset = mOffset;
+                mOffset += cPcapRecordHeaderLength + lCapturedLength;
+            }
+        } else {
+            Logger::GetInstance().Log("Truncated packet in capture", Logger::Level::DEBUG);
+        }
+    }
+
+    return lReturn;
+}
+
+bool MappedCapture::Cursor::NextPcapNg(CapturedPacket& aPacket)
+{
+    bool lReturn{false};
+    bool lDone{false};
+
+    while (!lReturn && !lDone && (mOffset + cBlockHeaderLength <= mCapture->mSize)) {
+        const char* lBlock{mCapture->mData + mOffset};
+
+        // The byte order of a section is only known after reading its header.
+        if (Read<uint32_t>(lBlock, false) == cSectionHeaderBlockType) {
+            ReadSectionHeader();
+        }
+
+        uint32_t lType{Read<uint32_t>(lBlock, mSection.mSwapped)};
+        uint32_t lLength{Read<uint32_t>(lBlock + 4, mSection.mSwapped)};
+        if ((lLength < cBlockHeaderLength + cBlockTrailerLength) || ((lLength % 4) != 0) ||
+            (mOffset + lLength > mCapture->mSize)) {
+            Logger::GetInstance().Log("Malformed block in capture", Logger::Level::DEBUG);
+            lDone = true;
+        } else {
+            uint32_t    lBodyLength{lLength - cBlockHeaderLength - cBlockTrailerLength};
+            const char* lBody{lBlock + cBlockHeaderLength};
+            std::size_t lBodyOffset{mOffset + cBlockHeaderLength};
+
+            if (lType == cInterfaceDescriptionBlockType) {
+                ReadInterface(lLength);
+            } else if ((lType == cEnhancedPacketBlockType) || (lType == cObsoletePacketBlockType)) {
+                // The obsolete packet block has a 16 bit interface followed by 16 bits of drops, otherwise the same.
+                constexpr uint32_t cPacketHeaderLength{20};
+                if (lBodyLength >= cPacketHeaderLength) {
+                    uint32_t lInterface{(lType == cEnhancedPacketBlockType) ?
+                                            Read<uint32_t>(lBody, mSection.mSwapped) :
+                                            Read<uint16_t>(lBody, mSection.mSwapped)};
+                    uint64_t lTimestamp{(uint64_t{Read<uint32_t>(lBody + 4, mSection.mSwapped)} << 32U) |
+                                        Read<uint32_t>(lBody + 8, mSection.mSwapped)};
+                    uint32_t lCapturedLength{Read<uint32_t>(lBody + 12, mSection.mSwapped)};
+                    uint32_t lOriginalLength{Read<uint32_t>(lBody + 16, mSection.mSwapped)};
+
+                    lReturn = (lCapturedLength <= lBodyLength - cPacketHeaderLength) &&
+                              SetPacket(aPacket,
+                                        lInterface,
+                                        lTimestamp,
+                                        lBodyOffset + cPacketHeaderLength,
+                                        lCapturedLength,
+                                        lOriginalLength);
+                }
+                lDone = !lReturn;
+            } else if (lType == cSimplePacketBlockType) {
+                if ((lBodyLength >= sizeof(uint32_t)) && !mSection.mInterfaces.empty()) {
+                    uint32_t lOriginalLength{Read<uint32_t>(lBody, mSection.mSwapped)};
+                    uint32_t lSnapshotLength{mSection.mInterfaces.front().mSnapshotLength};
+                    uint32_t lCapturedLength{std::min<uint32_t>(lOriginalLength, lBodyLength - sizeof(uint32_t))};
+                    if (lSnapshotLength > 0) {
+                        lCapturedLength = std::min(lCapturedLength, lSnapshotLength);
+                    }
+
+                    lReturn = SetPacket(
+                        aPacket, 0, 0, lBodyOffset + sizeof(uint32_t), lCapturedLength, lOriginalLength);
+                    aPacket.mTimestamp = nanoseconds(0);
+                }
+                lDone = !lReturn;
+            }
+
+            if (!lDone) {
+                mPacketOffset = mOffset;
+                mOffset += lLength;
+            } else if (!lReturn) {
+                Logger::GetInstance().Log("Malformed packet in capture", Logger::Level::DEBUG);
+            }
+        }
+    }
+
+    return lReturn;
+}
+
+void MappedCapture::Cursor::ReadSectionHeader()
+{
+    if (mOffset + cSectionHeaderLength <= mCapture->mSize) {
+        const char* lBody{mCapture->mData + mOffset + cBlockHeaderLength};
+
+        mSection.mNumber  = (mOffset == 0) ? 0 : mSection.mNumber + 1;
+        mSection.mSwapped = (Read<uint32_t>(lBody, false) != cByteOrderMagic);
+        mSection.mInterfaces.clear();
+    }
+}
+
+void MappedCapture::Cursor::ReadInterface(uint32_t aLength)
+{
+    constexpr uint32_t cInterfaceHeaderLength{8};
+    const char*        lBody{mCapture->mData + mOffset + cBlockHeaderLength};
+    uint32_t           lBodyLength{aLength - cBlockHeaderLength - cBlockTrailerLength};
+
+    Interface lInterface{};
+    if (lBodyLength >= cInterfaceHeaderLength) {
+        lInterface.mLinkType       = Read<uint16_t>(lBody, mSection.mSwapped);
+        lInterface.mSnapshotLength = Read<uint32_t>(lBody + 4, mSection.mSwapped);
+
+        uint32_t lIndex{cInterfaceHeaderLength};
+        bool     lEnd{false};
+        while (!lEnd && (lIndex + 2 * sizeof(uint16_t) <= lBodyLength)) {
+            uint16_t lCode{Read<uint16_t>(lBody + lIndex, mSection.mSwapped)};
+            uint16_t lLength{Read<uint16_t>(lBody + lIndex + 2, mSection.mSwapped)};
+            uint32_t lValue{lIndex + 2 * static_cast<uint32_t>(sizeof(uint16_t))};
+
+            if ((lCode == cOptionEndOfOptions) || (lValue + lLength > lBodyLength)) {
+                lEnd = true;
+            } else if ((lCode == cOptionTimestampResolution) && (lLength >= sizeof(uint8_t))) {
+                lInterface.mResolution = static_cast<uint8_t>(lBody[lValue]);
+            } else if ((lCode == cOptionTimestampOffset) && (lLength >= sizeof(int64_t))) {
+                lInterface.mOffset = Read<int64_t>(lBody + lValue, mSection.mSwapped);
+            }
+
+            // Option values are padded to 32 bits.
+            lIndex = lValue + ((lLength + 3U) & ~3U);
+        }
+    }
+
+    // Interfaces are numbered in the order they appear in, so malformed ones still take up a number.
+    mSection.mInterfaces.push_back(lInterface);
+}
+
+bool MappedCapture::Cursor::SetPacket(CapturedPacket& aPacket,
+                                      uint32_t        aInterface,
+                                      uint64_t        aTimestamp,
+                                      std::size_t     aDataOffset,
+                                      uint32_t        aCapturedLength,
+                                      uint32_t        aOriginalLength) const
+{
+    bool lReturn{false};
+
+    if (aInterface < mSection.mInterfaces.size()) {
+        const Interface& lInterface{mSection.mInterfaces.at(aInterface)};
+
+        aPacket.mTimestamp      = ToNanoseconds(aTimestamp, lInterface.mResolution) + seconds(lInterface.mOffset);
+        aPacket.mData           = std::string_view(mCapture->mData + aDataOffset, aCapturedLength);
+        aPacket.mOriginalLength = aOriginalLength;
+        aPacket.mInterface      = aInterface;
+        aPacket.mLinkType       = lInterface.mLinkType;
+        lReturn                 = true;
+    }
+
+    return lReturn;
+}
+
+bool MappedCapture::Cursor::Seek(nanoseconds aTime)
+{
+    bool lReturn{false};
+
+    Rewind();
+    if ((mCapture != nullptr) && mCapture->IsIndexed()) {
+        // Start at the last remembered packet before the time, at most a stride of packets has to be read from there.
+        const std::vector<IndexEntry>& lIndex{mCapture->mIndex};
+        auto                           lEntry{std::partition_point(
+            lIndex.begin(), lIndex.end(), [&](const IndexEntry& aEntry) { return aEntry.mMaximumTimestamp < aTime; })};
+
+        if (lEntry != lIndex.begin()) {
+            lEntry--;
+            mOffset  = lEntry->mOffset;
+            mSection = mCapture->mSections.at(lEntry->mSection);
+        }
+    }
+
+    CapturedPacket lPacket{};
+    while (!lReturn && Next(lPacket)) {
+        lReturn = (lPacket.mTimestamp >= aTime);
+    }
+
+    // Step back onto the packet, the section and interfaces it needs have been read by now.
+    if (lReturn) {
+        mOffset = mPacketOffset;
+    }
+
+    return lReturn;
+}
+
+void MappedCapture::Cursor::Rewind()
+{
+    if (mCapture != nullptr) {
+        mOffset       = mCapture->mPcapNg ? 0 : cPcapFileHeaderLength;
+        mPacketOffset = mOffset;
+        mSection      = mCapture->mFileSection;
+    }
+}
+
+std::size_t MappedCapture::Cursor::GetOffset() const
+{
+    return mOffset;
+}
+
+MappedCapture::~MappedCapture()
+{
+    Close();
+}
+
+bool MappedCapture::Open(std::string_view aPath)
+{
+    bool lReturn{false};
+
+    Close();
+    if (Map(aPath)) {
+        uint32_t lMagic{(mSize >= sizeof(uint32_t)) ? Read<uint32_t>(mData, false) : 0};
+        uint32_t lSwappedMagic{Read<uint32_t>(reinterpret_cast<const char*>(&lMagic), true)};
+        bool     lSwapped{(lSwappedMagic == cPcapMagicMicroseconds) || (lSwappedMagic == cPcapMagicNanoseconds)};
+        uint32_t lPcapMagic{lSwapped ? lSwappedMagic : lMagic};
+
+        if ((mSize >= cPcapFileHeaderLength) &&
+            ((lPcapMagic == cPcapMagicMicroseconds) || (lPcapMagic == cPcapMagicNanoseconds))) {
+            // The upper bits of the link type field hold FCS information.
+            Interface lInterface{};
+            lInterface.mSnapshotLength = Read<uint32_t>(mData + cPcapLinkTypeIndex - 4, lSwapped);
+            lInterface.mLinkType       = static_cast<uint16_t>(Read<uint32_t>(mData + cPcapLinkTypeIndex, lSwapped));
+            lInterface.mResolution     = (lPcapMagic == cPcapMagicNanoseconds) ? 9 : 6;
+
+            mFileSection = {0, lSwapped, {lInterface}};
+            mLinkType    = lInterface.mLinkType;
+            lReturn      = true;
+        } else if ((mSize >= cSectionHeaderLength) && (lMagic == cSectionHeaderBlockType)) {
+            mPcapNg = true;
+
+            // The link type comes from the interface of the first packet.
+            CapturedPacket lPacket{};
+            if (GetCursor().Next(lPacket)) {
+                mLinkType = lPacket.mLinkType;
+            }
+            lReturn = true;
+        } else {
+            Logger::GetInstance().Log("Not a pcap or pcapng file: " + std::string(aPath), Logger::Level::ERROR);
+            Close();
+        }
+    }
+
+    return lReturn;
+}
+
+void MappedCapture::Close()
+{
+    Unmap();
+    mPcapNg      = false;
+    mFileSection = {};
+    mLinkType    = 0;
+    mIndex.clear();
+    mSections.clear();
+    mPacketCount = 0;
+}
+
+bool MappedCapture::IsOpen() const
+{
+    return mData != nullptr;
+}
+
+bool MappedCapture::IsPcapNg() const
+{
+    return mPcapNg;
+}
+
+uint16_t MappedCapture::GetLinkType() const
+{
+    return mLinkType;
+}
+
+std::string_view MappedCapture::GetContents() const
+{
+    return {mData, mSize};
+}
+
+bool MappedCapture::BuildIndex(std::size_t aStride)
+{
+    mIndex.clear();
+    mSections.clear();
+    mPacketCount = 0;
+
+    Cursor         lCursor{GetCursor()};
+    CapturedPacket lPacket{};
+    nanoseconds    lMaximumTimestamp{0};
+    std::size_t    lStride{std::max<std::size_t>(aStride, 1)};
+    while (lCursor.Next(lPacket)) {
+        lMaximumTimestamp = std::max(lMaximumTimestamp, lPacket.mTimestamp);
+
+        if ((mPacketCount % lStride) == 0) {
+            // Only remember the section again when something has been added to it.
+            if (mSections.empty() || (mSections.back().mNumber != lCursor.mSection.mNumber) ||
+                (mSections.back().mInterfaces.size() != lCursor.mSection.mInterfaces.size())) {
+                mSections.push_back(lCursor.mSection);
+            }
+            mIndex.push_back({lMaximumTimestamp, lCursor.mPacketOffset, static_cast<uint32_t>(mSections.size() - 1)});
+        }
+        mPacketCount++;
+    }
+
+    return IsOpen() && (lCursor.GetOffset() == mSize);
+}
+
+bool MappedCapture::IsIndexed() const
+{
+    return !mIndex.empty();
+}
+
+std::size_t MappedCapture::GetPacketCount() const
+{
+    return mPacketCount;
+}
+
+MappedCapture::Cursor MappedCapture::GetCursor() const
+{
+    return Cursor(*this);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+bool MappedCapture::Map(std::string_view aPath)
+{
+    bool lReturn{false};
+
+    mFile = CreateFileA(std::string(aPath).c_str(),
+                        GENERIC_READ,
+                        FILE_SHARE_READ,
+                        nullptr,
+                        OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                        nullptr);
+    LARGE_INTEGER lSize{};
+    if ((mFile != INVALID_HANDLE_VALUE) && GetFileSizeEx(mFile, &lSize) && (lSize.QuadPart > 0)) {
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping != nullptr) {
+            mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+            mSize = static_cast<std::size_t>(lSize.QuadPart);
+        }
+    }
+
+    lReturn = (mData != nullptr);
+    if (!lReturn) {
+        Logger::GetInstance().Log("Could not map capture: " + std::string(aPath), Logger::Level::ERROR);
+        Unmap();
+    }
+
+    return lReturn;
+}
+
+void MappedCapture::Unmap()
+{
+    if (mData != nullptr) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping != nullptr) {
+        CloseHandle(mMapping);
+    }
+    if ((mFile != nullptr) && (mFile != INVALID_HANDLE_VALUE)) {
+        CloseHandle(mFile);
+    }
+
+    mData    = nullptr;
+    mSize    = 0;
+    mMapping = nullptr;
+    mFile    = nullptr;
+}
+#else
+bool MappedCapture::Map(std::string_view aPath)
+{
+    bool lReturn{false};
+
+    int         lFile{open(std::string(aPath).c_str(), O_RDONLY)};
+    struct stat lStatus{};
+    if ((lFile >= 0) && (fstat(lFile, &lStatus) == 0) && (lStatus.st_size > 0)) {
+        void* lData{mmap(nullptr, static_cast<std::size_t>(lStatus.st_size), PROT_READ, MAP_PRIVATE, lFile, 0)};
+        if (lData != MAP_FAILED) {
+            mData   = static_cast<const char*>(lData);
+            mSize   = static_cast<std::size_t>(lStatus.st_size);
+            lReturn = true;
+        }
+    }
+
+    // The mapping stays valid after closing the file.
+    if (lFile >= 0) {
+        close(lFile);
+    }
+
+    if (!lReturn) {
+        Logger::GetInstance().Log("Could not map capture: " + std::string(aPath), Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+void MappedCapture::Unmap()
+{
+    if (mData != nullptr) {
+        munmap(const_cast<char*>(mData), mSize);
+    }
+
+    mData = nullptr;
+    mSize = 0;
+}
+#endif
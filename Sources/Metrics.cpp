@@ -0,0 +1,236 @@
+#include "../Includes/Metrics.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - Metrics.cpp */
+
+#include <algorithm>
+#include <bit>
+
+using namespace std::chrono;
+
+namespace
+{
+    // Adds to a value only this thread writes to, a plain load and store is enough.
+    inline void AddRelaxed(std::atomic<uint64_t>& aValue, uint64_t aAmount)
+    {
+        aValue.store(aValue.load(std::memory_order_relaxed) + aAmount, std::memory_order_relaxed);
+    }
+}  // namespace
+
+/**
+ * Leases a shard to a thread for as long as the thread lives.
+ */
+class Metrics::ShardLease
+{
+public:
+    explicit ShardLease(Metrics& aMetrics) : mMetrics(aMetrics), mShard(aMetrics.AcquireShard()) {}
+
+    ~ShardLease()
+    {
+        mMetrics.ReleaseShard(mShard);
+    }
+
+    ShardLease(const ShardLease& aShardLease) = delete;
+    ShardLease& operator=(const ShardLease& aShardLease) = delete;
+
+    Metrics& mMetrics;
+    Shard&   mShard;
+};
+
+std::size_t HistogramSnapshot::GetBucketIndex(uint64_t aValue)
+{
+    std::size_t lReturn{0};
+
+    if (aValue < cSubBucketCount) {
+        lReturn = aValue;
+    } else {
+        unsigned int lExponent{static_cast<unsigned int>(std::bit_width(aValue) - 1)};
+        if (lExponent >= cMaxExponent) {
+            lReturn = cBucketCount - 1;
+        } else {
+            uint64_t lSubBucket{(aValue >> (lExponent - cSubBucketBits)) & (cSubBucketCount - 1)};
+            lReturn = ((lExponent - cSubBucketBits + 1) * cSubBucketCount) + lSubBucket;
+        }
+    }
+
+    return lReturn;
+}
+
+uint64_t HistogramSnapshot::GetBucketUpperBound(std::size_t aIndex)
+{
+    uint64_t lReturn{aIndex};
+
+    if (aIndex >= cSubBucketCount) {
+        unsigned int lExponent{static_cast<unsigned int>(aIndex / cSubBucketCount) + cSubBucketBits - 1};
+        uint64_t     lSubBucket{aIndex % cSubBucketCount};
+        unsigned int lShift{lExponent - cSubBucketBits};
+        lReturn = (((cSubBucketCount + lSubBucket) << lShift) + (1LLU << lShift)) - 1;
+    }
+
+    return lReturn;
+}
+
+nanoseconds HistogramSnapshot::GetPercentile(double aPercentile) const
+{
+    uint64_t lReturn{0};
+
+    if (mCount > 0) {
+        auto lTarget{static_cast<uint64_t>((std::clamp(aPercentile, 0.0, 100.0) / 100.0) * mCount)};
+        lTarget = std::max<uint64_t>(lTarget, 1);
+
+        uint64_t lSeen{0};
+        for (std::size_t lCount = 0; lCount < mBuckets.size(); lCount++) {
+            lSeen += mBuckets.at(lCount);
+            if (lSeen >= lTarget) {
+                // The highest bucket has no real upper bound, the maximum is the best guess we have.
+                lReturn = std::min(GetBucketUpperBound(lCount), mMax);
+                break;
+            }
+        }
+    }
+
+    return nanoseconds(lReturn);
+}
+
+nanoseconds HistogramSnapshot::GetMean() const
+{
+    return nanoseconds((mCount > 0) ? mSum / mCount : 0);
+}
+
+Metrics::Shard& Metrics::GetShard()
+{
+    thread_local ShardLease lLease{*this};
+    return lLease.mShard;
+}
+
+Metrics::Shard& Metrics::AcquireShard()
+{
+    std::lock_guard<std::mutex> lLock{mShardsMutex};
+
+    auto lFreeShard{std::find_if(mShards.begin(), mShards.end(), [](auto& aShard) { return !aShard->mInUse; })};
+    if (lFreeShard == mShards.end()) {
+        mShards.emplace_back(std::make_unique<Shard>());
+        lFreeShard = mShards.end() - 1;
+    }
+    (*lFreeShard)->mInUse = true;
+
+    return **lFreeShard;
+}
+
+void Metrics::ReleaseShard(Shard& aShard)
+{
+    std::lock_guard<std::mutex> lLock{mShardsMutex};
+    aShard.mInUse = false;
+}
+
+void Metrics::Increment(Counter aCounter, uint64_t aAmount)
+{
+    AddRelaxed(GetShard().mCounters[static_cast<std::size_t>(aCounter)], aAmount);
+}
+
+void Metrics::CountFrameType(uint8_t aFrameControl)
+{
+    // Frame control: [ subtype (4 bits) | type (2 bits) | version (2 bits) ], index is type * 16 + subtype.
+    std::size_t lIndex{((static_cast<std::size_t>(aFrameControl >> 2U) & 0b11U) * 16) + (aFrameControl >> 4U)};
+    AddRelaxed(GetShard().mFrameTypes[lIndex], 1);
+}
+
+void Metrics::RecordLatency(Histogram aHistogram, nanoseconds aLatency)
+{
+    HistogramShard& lHistogram{GetShard().mHistograms[static_cast<std::size_t>(aHistogram)]};
+    auto            lValue{static_cast<uint64_t>(std::max<int64_t>(aLatency.count(), 0))};
+
+    AddRelaxed(lHistogram.mBuckets[HistogramSnapshot::GetBucketIndex(lValue)], 1);
+    AddRelaxed(lHistogram.mCount, 1);
+    AddRelaxed(lHistogram.mSum, lValue);
+    if (lValue > lHistogram.mMax.load(std::memory_order_relaxed)) {
+        lHistogram.mMax.store(lValue, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::Set(Gauge aGauge, int64_t aValue)
+{
+    mGauges[static_cast<std::size_t>(aGauge)].store(aValue, std::memory_order_relaxed);
+}
+
+void Metrics::Add(Gauge aGauge, int64_t aValue)
+{
+    mGauges[static_cast<std::size_t>(aGauge)].fetch_add(aValue, std::memory_order_relaxed);
+}
+
+void Metrics::Set(Info aInfo, std::string_view aText)
+{
+    std::lock_guard<std::mutex> lLock{mInfoMutex};
+    mInfo.at(static_cast<std::size_t>(aInfo)) = aText;
+}
+
+MetricsSnapshot Metrics::GetSnapshot()
+{
+    MetricsSnapshot lSnapshot{};
+    lSnapshot.mTime = steady_clock::now();
+
+    for (std::size_t lCount = 0; lCount < cGaugeCount; lCount++) {
+        lSnapshot.mGauges.at(lCount) = mGauges.at(lCount).load(std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lInfoLock{mInfoMutex};
+        lSnapshot.mInfo = mInfo;
+    }
+
+    std::lock_guard<std::mutex> lLock{mShardsMutex};
+    for (auto& lShard : mShards) {
+        for (std::size_t lCount = 0; lCount < cCounterCount; lCount++) {
+            lSnapshot.mCounters.at(lCount) += lShard->mCounters.at(lCount).load(std::memory_order_relaxed);
+        }
+
+        for (std::size_t lCount = 0; lCount < cFrameTypeCount; lCount++) {
+            lSnapshot.mFrameTypes.at(lCount) += lShard->mFrameTypes.at(lCount).load(std::memory_order_relaxed);
+        }
+
+        for (std::size_t lCount = 0; lCount < cHistogramCount; lCount++) {
+            HistogramShard&    lSource{lShard->mHistograms.at(lCount)};
+            HistogramSnapshot& lDestination{lSnapshot.mHistograms.at(lCount)};
+
+            for (std::size_t lBucket = 0; lBucket < cBucketCount; lBucket++) {
+                lDestination.mBuckets.at(lBucket) += lSource.mBuckets.at(lBucket).load(std::memory_order_relaxed);
+            }
+            lDestination.mCount += lSource.mCount.load(std::memory_order_relaxed);
+            lDestination.mSum += lSource.mSum.load(std::memory_order_relaxed);
+            lDestination.mMax = std::max(lDestination.mMax, lSource.mMax.load(std::memory_order_relaxed));
+        }
+    }
+
+    return lSnapshot;
+}
+
+void Metrics::Reset()
+{
+    for (auto& lGauge : mGauges) {
+        lGauge.store(0, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lInfoLock{mInfoMutex};
+        mInfo = {};
+    }
+
+    std::lock_guard<std::mutex> lLock{mShardsMutex};
+    for (auto& lShard : mShards) {
+        for (auto& lCounter : lShard->mCounters) {
+            lCounter.store(0, std::memory_order_relaxed);
+        }
+
+        for (auto& lFrameType : lShard->mFrameTypes) {
+            lFrameType.store(0, std::memory_order_relaxed);
+        }
+
+        for (auto& lHistogram : lShard->mHistograms) {
+            for (auto& lBucket : lHistogram.mBuckets) {
+                lBucket.store(0, std::memory_order_relaxed);
+            }
+            lHistogram.mCount.store(0, std::memory_order_relaxed);
+            lHistogram.mSum.store(0, std::memory_order_relaxed);
+            lHistogram.mMax.store(0, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,214 @@
+#include "../Includes/MetricsServer.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - MetricsServer.cpp */
+
+#include <sstream>
+
+#include "../Includes/Logger.h"
+
+// Filled in by CMake, see CMakeLists.txt.
+#ifndef XLHA_GIT_REVISION
+#define XLHA_GIT_REVISION "unknown"
+#endif
+
+#ifndef XLHA_COMPILER
+#define XLHA_COMPILER "unknown"
+#endif
+
+using namespace boost::asio;
+using namespace std::chrono;
+
+namespace
+{
+    /**
+     * A single scrape, keeps itself alive until the response has been written.
+     */
+    class Session : public std::enable_shared_from_this<Session>
+    {
+    public:
+        explicit Session(ip::tcp::socket aSocket) : mSocket(std::move(aSocket)), mRequest(cMaxRequestLength) {}
+
+        void Start()
+        {
+            async_read_until(mSocket,
+                             mRequest,
+                             "\r\n\r\n",
+                             [lThis = shared_from_this()](const boost::system::error_code& aError, std::size_t) {
+                                 if (!aError) {
+                                     lThis->Respond();
+                                 }
+                             });
+        }
+
+    private:
+        void Respond()
+        {
+            std::istream lRequestStream{&mRequest};
+            std::string  lMethod{};
+            std::string  lPath{};
+            lRequestStream >> lMethod >> lPath;
+
+            if ((lMethod == "GET") && ((lPath == "/metrics") || (lPath == "/"))) {
+                std::string lBody{MetricsServer::FormatMetrics(Metrics::GetInstance().GetSnapshot())};
+                mResponse = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                            std::to_string(lBody.size()) + "\r\nConnection: close\r\n\r\n" + lBody;
+            } else {
+                mResponse = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+
+            async_write(mSocket,
+                        buffer(mResponse),
+                        [lThis = shared_from_this()](const boost::system::error_code& /*aError*/, std::size_t) {
+                            boost::system::error_code lError{};
+                            lThis->mSocket.shutdown(ip::tcp::socket::shutdown_both, lError);
+                        });
+        }
+
+        ip::tcp::socket mSocket;
+        streambuf       mRequest;
+        std::string     mResponse{};
+    };
+
+    std::string EscapeLabel(std::string_view aLabel)
+    {
+        std::string lReturn{};
+        for (char lCharacter : aLabel) {
+            if (lCharacter == '\\' || lCharacter == '"') {
+                lReturn += '\\';
+                lReturn += lCharacter;
+            } else if (lCharacter == '\n') {
+                lReturn += "\\n";
+            } else {
+                lReturn += lCharacter;
+            }
+        }
+        return lReturn;
+    }
+
+    void AddHeader(std::stringstream& aStream, std::string_view aName, std::string_view aType)
+    {
+        aStream << "# TYPE " << cMetricPrefix << aName << " " << aType << "\n";
+    }
+}  // namespace
+
+MetricsServer::~MetricsServer()
+{
+    Stop();
+}
+
+bool MetricsServer::Start(unsigned int aPort)
+{
+    bool lReturn{true};
+
+    try {
+        mIoContext.restart();
+        mAcceptor = std::make_unique<ip::tcp::acceptor>(
+            mIoContext, ip::tcp::endpoint(ip::make_address(cAddress.data()), static_cast<unsigned short>(aPort)));
+        Accept();
+
+        mServerThread = std::make_shared<std::thread>([&] { mIoContext.run(); });
+        Logger::GetInstance().Log("Serving metrics on port " + std::to_string(GetPort()), Logger::Level::INFO);
+    } catch (const boost::system::system_error& lException) {
+        Logger::GetInstance().Log("Could not start metrics server: " + std::string(lException.what()),
+                                  Logger::Level::ERROR);
+        mAcceptor = nullptr;
+        lReturn   = false;
+    }
+
+    return lReturn;
+}
+
+void MetricsServer::Stop()
+{
+    mIoContext.stop();
+
+    if (mServerThread != nullptr && mServerThread->joinable()) {
+        mServerThread->join();
+    }
+
+    mServerThread = nullptr;
+    mAcceptor     = nullptr;
+}
+
+unsigned int MetricsServer::GetPort() const
+{
+    return (mAcceptor != nullptr) ? mAcceptor->local_endpoint().port() : 0;
+}
+
+void MetricsServer::Accept()
+{
+    mAcceptor->async_accept([&](const boost::system::error_code& aError, ip::tcp::socket aSocket) {
+        if (!aError) {
+            std::make_shared<Session>(std::move(aSocket))->Start();
+        }
+
+        if (mAcceptor != nullptr && mAcceptor->is_open()) {
+            Accept();
+        }
+    });
+}
+
+std::string MetricsServer::FormatMetrics(const MetricsSnapshot& aSnapshot)
+{
+    std::stringstream lStream{};
+
+    AddHeader(lStream, "build_info", "gauge");
+    lStream << cMetricPrefix << "build_info{revision=\"" << EscapeLabel(XLHA_GIT_REVISION) << "\",compiler=\""
+            << EscapeLabel(XLHA_COMPILER) << "\"} 1\n";
+
+    AddHeader(lStream, "locked_network_info", "gauge");
+    lStream << cMetricPrefix << "locked_network_info{bssid=\"" << EscapeLabel(aSnapshot.Get(Info::LockedBSSID))
+            << "\",ssid=\"" << EscapeLabel(aSnapshot.Get(Info::LockedSSID)) << "\"} 1\n";
+
+    for (std::size_t lCount = 0; lCount < cCounterCount; lCount++) {
+        std::string lName{std::string(cCounterTexts.at(lCount)) + "_total"};
+        AddHeader(lStream, lName, "counter");
+        lStream << cMetricPrefix << lName << " " << aSnapshot.mCounters.at(lCount) << "\n";
+    }
+
+    AddHeader(lStream, "frames_total", "counter");
+    for (std::size_t lCount = 0; lCount < cFrameTypeCount; lCount++) {
+        if (aSnapshot.mFrameTypes.at(lCount) > 0) {
+            lStream << cMetricPrefix << "frames_total{type=\"" << cFrameTypeTexts.at(lCount / 16) << "\",subtype=\""
+                    << (lCount % 16) << "\"} " << aSnapshot.mFrameTypes.at(lCount) << "\n";
+        }
+    }
+
+    for (std::size_t lCount = 0; lCount < cGaugeCount; lCount++) {
+        if (static_cast<Gauge>(lCount) == Gauge::KaiLinkState) {
+            // Enumerations are exposed as one series per state, like Prometheus' own exporters do.
+            AddHeader(lStream, cGaugeTexts.at(lCount), "gauge");
+            for (std::size_t lState = 0; lState < cKaiLinkStateTexts.size(); lState++) {
+                lStream << cMetricPrefix << cGaugeTexts.at(lCount) << "{state=\"" << cKaiLinkStateTexts.at(lState)
+                        << "\"} " << ((aSnapshot.mGauges.at(lCount) == static_cast<int64_t>(lState)) ? 1 : 0) << "\n";
+            }
+        } else {
+            AddHeader(lStream, cGaugeTexts.at(lCount), "gauge");
+            lStream << cMetricPrefix << cGaugeTexts.at(lCount) << " " << aSnapshot.mGauges.at(lCount) << "\n";
+        }
+    }
+
+    for (std::size_t lCount = 0; lCount < cHistogramCount; lCount++) {
+        const HistogramSnapshot& lHistogram{aSnapshot.mHistograms.at(lCount)};
+        std::string              lName{std::string(cHistogramTexts.at(lCount)) + "_seconds"};
+        AddHeader(lStream, lName, "histogram");
+
+        // Prometheus buckets are cumulative, walk through the fine buckets once while going through the boundaries.
+        uint64_t    lCumulative{0};
+        std::size_t lBucket{0};
+        for (double lBoundary : cHistogramBoundaries) {
+            auto lBoundaryNanoseconds{static_cast<uint64_t>(lBoundary * 1e9)};
+            while (lBucket < cBucketCount && HistogramSnapshot::GetBucketUpperBound(lBucket) <= lBoundaryNanoseconds) {
+                lCumulative += lHistogram.mBuckets.at(lBucket);
+                lBucket++;
+            }
+            lStream << cMetricPrefix << lName << "_bucket{le=\"" << lBoundary << "\"} " << lCumulative << "\n";
+        }
+        lStream << cMetricPrefix << lName << "_bucket{le=\"+Inf\"} " << lHistogram.mCount << "\n";
+        lStream << cMetricPrefix << lName << "_sum " << duration<double>(nanoseconds(lHistogram.mSum)).count()
+                << "\n";
+        lStream << cMetricPrefix << lName << "_count " << lHistogram.mCount << "\n";
+    }
+
+    return lStream.str();
+}
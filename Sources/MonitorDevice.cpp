@@ -2,38 +2,158 @@
 
 /* Copyright (c) 2020 [Rick de Bondt] - MonitorDevice.cpp */
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <string>
 #include <thread>
+#include <utility>
 
+#include "../Includes/FlightRecorder.h"
+#include "../Includes/LatencyTrace.h"
+#include "../Includes/Metrics.h"
 #include "../Includes/NetConversionFunctions.h"
 
 using namespace std::chrono;
 
-bool MonitorDevice::Open(std::string_view aName, std::vector<std::string>& aSSIDFilter)
+namespace
+{
+    /**
+     * Compiles a capture filter and sets it on a handle.
+     * @param aHandler - Handle to set the filter on.
+     * @param aFilter - Filter in pcap syntax, empty lets everything through.
+     */
+    void ApplyFilter(pcap_t* aHandler, const std::string& aFilter)
+    {
+        bpf_program lProgram{};
+        if (pcap_compile(aHandler, &lProgram, aFilter.c_str(), 1, PCAP_NETMASK_UNKNOWN) == 0) {
+            if (pcap_setfilter(aHandler, &lProgram) != 0) {
+                Logger::GetInstance().Log("pcap_setfilter failed, " + std::string(pcap_geterr(aHandler)),
+                                          Logger::Level::ERROR);
+            }
+            pcap_freecode(&lProgram);
+        } else {
+            Logger::GetInstance().Log("pcap_compile failed, " + std::string(pcap_geterr(aHandler)),
+                                      Logger::Level::ERROR);
+        }
+    }
+}  // namespace
+
+bool MonitorDevice::Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter)
+{
+    bool lReturn{true};
+
+    SetUpPacketHandler(aSSIDFilter);
+    mAdapterName = aName;
+    mHandler     = Activate();
+
+    if (mHandler != nullptr) {
+        mConnected = true;
+        lReturn    = OpenInjection();
+    } else {
+        lReturn = false;
+    }
+    return lReturn;
+}
+
+bool MonitorDevice::OpenInjection()
 {
     bool lReturn{true};
 
+    if (!mInjectionAdapterName.empty()) {
+        mInjectionHandler = ActivateInjection();
+        lReturn           = (mInjectionHandler != nullptr);
+        if (lReturn && (mInjectionQueue == nullptr)) {
+            mInjectionQueue = std::make_unique<MPSCQueue<InjectionFrame, cInjectionQueueSize>>();
+        }
+    }
+
+    if (lReturn && (mInjectionBackend != InjectionBackend::PCap)) {
+        std::string_view lAdapter{mInjectionAdapterName.empty() ? mAdapterName : mInjectionAdapterName};
+        if (!mPacketSocket.Open(lAdapter, mInjectionBackend == InjectionBackend::PacketRing)) {
+            Logger::GetInstance().Log("Could not open packet socket, injecting with pcap", Logger::Level::WARNING);
+        }
+    }
+
+    return lReturn;
+}
+
+void MonitorDevice::SetUpPacketHandler(const std::vector<std::string>& aSSIDFilter)
+{
+    // Look the network up before the filter gets handed over to the handler.
+    CachedNetwork lCachedNetwork{};
+    if ((mNetworkCache != nullptr) && mNetworkCache->Find(aSSIDFilter, lCachedNetwork)) {
+        mPacketHandler.SetCachedNetwork(lCachedNetwork);
+        Logger::GetInstance().Log("Warm start on cached network: " + lCachedNetwork.mSSID, Logger::Level::INFO);
+    }
+
     mPacketHandler.SetSSIDFilterList(aSSIDFilter);
+}
 
+pcap_t* MonitorDevice::Activate()
+{
     std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
 
-    mHandler = pcap_create(aName.data(), lErrorBuffer.data());
-    pcap_set_snaplen(mHandler, cSnapshotLength);
-    pcap_set_timeout(mHandler, cTimeout);
-    // TODO: Test without immediate mode, see if it helps
-    // pcap_set_immediate_mode(mHandler, 1);
+    pcap_t* lReturn{pcap_create(mAdapterName.c_str(), lErrorBuffer.data())};
+
+    if (lReturn != nullptr) {
+        pcap_set_snaplen(lReturn, cSnapshotLength);
+        pcap_set_timeout(lReturn, cTimeout);
+        pcap_set_buffer_size(lReturn, static_cast<int>(mCaptureController.GetBufferSize()));
+        // Falls back to microseconds if the device does not support it.
+        mNanosecondTimestamps = (pcap_set_tstamp_precision(lReturn, PCAP_TSTAMP_PRECISION_NANO) == 0);
+        // TODO: Test without immediate mode, see if it helps
+        // pcap_set_immediate_mode(lReturn, 1);
+
+        int lStatus{pcap_activate(lReturn)};
+
+        if (lStatus == 0) {
+            SetFilter(lReturn);
+        } else {
+            Logger::GetInstance().Log("pcap_activate failed, " + std::string(pcap_statustostr(lStatus)),
+                                      Logger::Level::ERROR);
+            pcap_close(lReturn);
+            lReturn = nullptr;
+        }
+    } else {
+        Logger::GetInstance().Log("pcap_create failed, " + std::string(lErrorBuffer.data()), Logger::Level::ERROR);
+    }
 
-    int lStatus{pcap_activate(mHandler)};
+    return lReturn;
+}
 
-    if (lStatus == 0) {
-        mConnected = true;
+pcap_t* MonitorDevice::ActivateInjection()
+{
+    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+
+    pcap_t* lReturn{pcap_create(mInjectionAdapterName.c_str(), lErrorBuffer.data())};
+
+    if (lReturn != nullptr) {
+        pcap_set_snaplen(lReturn, cSnapshotLength);
+
+        int lStatus{pcap_activate(lReturn)};
+
+        if ((lStatus == 0) && (pcap_datalink(lReturn) != DLT_IEEE802_11_RADIO)) {
+            // Like the capture adapter, it has to be put in monitor mode beforehand, otherwise frames get mangled.
+            Logger::GetInstance().Log("Injection adapter " + mInjectionAdapterName +
+                                          " is not in monitor mode, put it in monitor mode first",
+                                      Logger::Level::ERROR);
+            pcap_close(lReturn);
+            lReturn = nullptr;
+        } else if (lStatus == 0) {
+            ApplyFilter(lReturn, std::string(cInjectionFilter));
+        } else {
+            Logger::GetInstance().Log("pcap_activate failed on injection adapter, " +
+                                          std::string(pcap_statustostr(lStatus)),
+                                      Logger::Level::ERROR);
+            pcap_close(lReturn);
+            lReturn = nullptr;
+        }
     } else {
-        lReturn = false;
-        Logger::GetInstance().Log("pcap_activate failed, " + std::string(pcap_statustostr(lStatus)),
+        Logger::GetInstance().Log("pcap_create failed on injection adapter, " + std::string(lErrorBuffer.data()),
                                   Logger::Level::ERROR);
     }
+
     return lReturn;
 }
 
@@ -46,22 +166,44 @@ void MonitorDevice::Close()
 {
     mConnected = false;
 
-    if (mHandler != nullptr) {
-        pcap_breakloop(mHandler);
+    {
+        std::lock_guard<std::mutex> lLock{mHandlerMutex};
+        if (mHandler != nullptr) {
+            pcap_breakloop(mHandler);
+        }
     }
 
     if (mReceiverThread != nullptr && mReceiverThread->joinable()) {
         mReceiverThread->join();
     }
 
+    mInjecting = false;
+    if (mInjectionThread != nullptr && mInjectionThread->joinable()) {
+        mInjectionThread->join();
+    }
+
     if (mHandler != nullptr) {
         pcap_close(mHandler);
     }
 
+    if (mInjectionHandler != nullptr) {
+        pcap_close(mInjectionHandler);
+    }
+
+    mPacketSocket.Close();
+
+    // The receiver thread has stopped, so the handler can be read safely.
+    CachedNetwork lLockedNetwork{mPacketHandler.GetLockedNetwork()};
+    if ((mNetworkCache != nullptr) && (lLockedNetwork.mBSSID != 0)) {
+        mNetworkCache->Store(std::move(lLockedNetwork));
+    }
+
     mHandler            = nullptr;
+    mInjectionHandler   = nullptr;
     mData               = nullptr;
     mHeader             = nullptr;
     mReceiverThread     = nullptr;
+    mInjectionThread    = nullptr;
     mAcknowledgePackets = false;
 }
 
@@ -69,12 +211,19 @@ bool MonitorDevice::ReadCallback(const unsigned char* aData, const pcap_pkthdr*
 {
     bool lReturn{false};
 
-    // Load all needed information into the handler
-    std::string lData{DataToString(aData, aHeader)};
+    // The capture timestamp is the origin for all latency measurements of this frame.
+    LatencyTrace lTrace{Direction::AirToKai, LatencyTrace::FromTimestamp(aHeader->ts, mNanosecondTimestamps)};
+    lTrace.Mark(Point::Started);
+
+    // Load all needed information into the handler, the handler copies it into a buffer it keeps between frames.
+    std::string_view lData{reinterpret_cast<const char*>(aData), aHeader->caplen};
+
+    Metrics::GetInstance().Increment(Counter::AirFramesReceived);
+    Metrics::GetInstance().Increment(Counter::AirBytesReceived, aHeader->caplen);
 
     mPacketHandler.Update(lData);
 
-    if (!mPacketHandler.IsDropped()) {
+    if (!mPacketHandler.IsDropped() && Logger::GetInstance().ShouldLog(Logger::Level::TRACE)) {
         ShowPacketStatistics(aHeader);
         Logger::GetInstance().Log("Received: " + PrettyHexString(lData), Logger::Level::TRACE);
     }
@@ -84,13 +233,27 @@ bool MonitorDevice::ReadCallback(const unsigned char* aData, const pcap_pkthdr*
             ConstructAcknowledgementFrame(mPacketHandler.GetSourceMAC(), mPacketHandler.GetControlPacketParameters());
 
         Logger::GetInstance().Log("Sent ACK", Logger::Level::TRACE);
-        Send(lAcknowledgementFrame);
+        if (Send(lAcknowledgementFrame)) {
+            Metrics::GetInstance().Increment(Counter::AcksSent);
+            Metrics::GetInstance().RecordLatency(Histogram::AckLatency,
+                                                 LatencyTrace::Now() - lTrace.Get(Point::Origin));
+        }
     }
 
     // If this packet is convertible to something XLink can understand, send
     if (mPacketHandler.ShouldSend()) {
-        std::string lPacket{mPacketHandler.ConvertPacket()};
+        FlightRecorder::GetInstance().Record(
+            Stage::MonitorReceived, Verdict::Forwarded, lData, lTrace.Get(Point::Origin));
+        const std::string& lPacket{mPacketHandler.ConvertPacket()};
+        lTrace.Mark(Point::Converted);
         mConnector->Send(lPacket);
+        lTrace.Mark(Point::Sent);
+        lTrace.Finish();
+    } else {
+        FlightRecorder::GetInstance().Record(Stage::MonitorReceived,
+                                             mPacketHandler.IsDropped() ? Verdict::Dropped : Verdict::Accepted,
+                                             lData,
+                                             lTrace.Get(Point::Origin));
     }
 
     mData   = aData;
@@ -119,6 +282,64 @@ void MonitorDevice::ShowPacketStatistics(const pcap_pkthdr* aHeader) const
     }
 }
 
+void MonitorDevice::SampleCaptureStatistics()
+{
+    pcap_stat lStatistics{};
+
+    if ((mHandler != nullptr) && (pcap_stats(mHandler, &lStatistics) == 0)) {
+        CaptureAdjustment lAdjustment{
+            mCaptureController.Update(lStatistics.ps_drop, lStatistics.ps_ifdrop, steady_clock::now())};
+        bool lReactivated{false};
+
+        if (lAdjustment.mGrowBuffer) {
+            // The buffer size can only be set before activating, so the handle has to be replaced.
+            pcap_t* lHandler{Activate()};
+            if (lHandler != nullptr) {
+                pcap_t* lOldHandler{nullptr};
+                {
+                    std::lock_guard<std::mutex> lLock{mHandlerMutex};
+                    lOldHandler = std::exchange(mHandler, lHandler);
+                }
+                pcap_close(lOldHandler);
+                mCaptureController.Restarted();
+                lReactivated = true;
+            } else {
+                mCaptureController.RevertBufferSize();
+            }
+        }
+
+        if (!lReactivated && (lAdjustment.mTightenFilter || lAdjustment.mRelaxFilter)) {
+            SetFilter(mHandler);
+        }
+    }
+
+    mLastStatisticsSample = steady_clock::now();
+}
+
+void MonitorDevice::SetFilter(pcap_t* aHandler)
+{
+    // An empty filter lets everything through.
+    std::string lFilter{};
+
+    if (mCaptureController.IsFilterTightened()) {
+        mFilterSessionChanges = mPacketHandler.GetSessionChanges();
+        lFilter               = std::string(cTightFilterBeacons) + " or " + std::string(cTightFilterAcks);
+
+        // Every network locked onto has to get through.
+        std::vector<NetworkSession> lSessions{mPacketHandler.GetSessions()};
+        bool                        lConfirmed{!lSessions.empty()};
+        for (const NetworkSession& lSession : lSessions) {
+            lFilter += " or " + std::string(cTightFilterLocked) + IntToMac(lSession.mBSSID);
+            lConfirmed = lConfirmed && lSession.mConfirmed;
+        }
+        if (!lConfirmed) {
+            lFilter += " or " + std::string(cTightFilterUnlocked);
+        }
+    }
+
+    ApplyFilter(aHandler, lFilter);
+}
+
 const unsigned char* MonitorDevice::GetData()
 {
     return mData;
@@ -139,6 +360,11 @@ uint64_t MonitorDevice::GetLockedBSSID()
     return mPacketHandler.GetLockedBSSID();
 }
 
+std::size_t MonitorDevice::GetRoutes(uint64_t aDestinationMAC, std::array<NetworkRoute, cMaxSessions>& aRoutes)
+{
+    return mPacketHandler.GetRoutes(aDestinationMAC, aRoutes);
+}
+
 std::string MonitorDevice::DataToString(const unsigned char* aData, const pcap_pkthdr* aHeader)
 {
     // Convert from char* to string
@@ -157,30 +383,140 @@ std::string MonitorDevice::DataToString(const unsigned char* aData, const pcap_p
 bool MonitorDevice::Send(std::string_view aData)
 {
     bool lReturn{false};
-    if (mHandler != nullptr) {
-        if (!aData.empty()) {
+
+    if (mInjecting) {
+        // The injection thread sends it, so whoever hands the frame over does not have to wait for the driver.
+        if (!aData.empty() && (aData.size() <= cMaxInjectionLength)) {
+            lReturn = mInjectionQueue->TryPush([&](InjectionFrame& aFrame) {
+                aFrame.mLength = aData.size();
+                std::copy(aData.begin(), aData.end(), aFrame.mData.begin());
+            });
+
+            if (!lReturn) {
+                Metrics::GetInstance().Increment(Counter::AirSendFailures);
+                FlightRecorder::GetInstance().Record(Stage::MonitorSent, Verdict::Failed, aData);
+            }
+        }
+    } else {
+        std::lock_guard<std::mutex> lLock{mHandlerMutex};
+        if (mHandler != nullptr) {
+            lReturn = SendOnHandle(mHandler, aData);
+        } else {
+            Logger::GetInstance().Log("Cannot send packets on a device that has not been opened yet!",
+                                      Logger::Level::ERROR);
+        }
+    }
+
+    return lReturn;
+}
+
+bool MonitorDevice::SendOnHandle(pcap_t* aHandler, std::string_view aData, bool aFlush)
+{
+    bool lReturn{false};
+
+    if (!aData.empty()) {
+        if (Logger::GetInstance().ShouldLog(Logger::Level::TRACE)) {
             Logger::GetInstance().Log(std::string("Sent: ") + PrettyHexString(aData), Logger::Level::TRACE);
+        }
 
-            if (pcap_sendpacket(mHandler, reinterpret_cast<const unsigned char*>(aData.data()), aData.size()) == 0) {
-                lReturn = true;
-            } else {
-                Logger::GetInstance().Log("pcap_sendpacket failed, " + std::string(pcap_geterr(mHandler)),
+        bool lQueued{!aFlush && mPacketSocket.UsesRing()};
+        if (mPacketSocket.IsOpen()) {
+            lReturn = aFlush ? mPacketSocket.Send(aData) : mPacketSocket.Queue(aData);
+        } else {
+            const auto* lData{reinterpret_cast<const unsigned char*>(aData.data())};
+            lReturn = (pcap_sendpacket(aHandler, lData, aData.size()) == 0);
+            if (!lReturn) {
+                Logger::GetInstance().Log("pcap_sendpacket failed, " + std::string(pcap_geterr(aHandler)),
                                           Logger::Level::ERROR);
             }
         }
-    } else {
-        Logger::GetInstance().Log("Cannot send packets on a device that has not been opened yet!",
-                                  Logger::Level::ERROR);
+
+        if (lQueued && lReturn) {
+            // Only in the TX ring so far, it gets counted once the ring has been flushed, see Inject.
+            FlightRecorder::GetInstance().Record(Stage::MonitorSent, Verdict::Forwarded, aData);
+        } else {
+            RecordSent(aData, lReturn);
+        }
     }
 
     return lReturn;
 }
 
+void MonitorDevice::RecordSent(std::string_view aData, bool aSent)
+{
+    if (aSent) {
+        Metrics::GetInstance().Increment(Counter::AirFramesSent);
+        Metrics::GetInstance().Increment(Counter::AirBytesSent, aData.size());
+        FlightRecorder::GetInstance().Record(Stage::MonitorSent, Verdict::Sent, aData);
+    } else {
+        Metrics::GetInstance().Increment(Counter::AirSendFailures);
+        FlightRecorder::GetInstance().Record(Stage::MonitorSent, Verdict::Failed, aData);
+    }
+}
+
+void MonitorDevice::Inject()
+{
+    while (mInjecting) {
+        // Everything waiting gets queued in the TX ring first, so it can all be sent with one system call. No more
+        // than fits in the ring, so queueing never has to kick the ring for frames that have not been counted yet.
+        std::size_t lInjected{0};
+        std::size_t lQueuedFrames{0};
+        std::size_t lQueuedBytes{0};
+        while ((lInjected < cRingFrameCount) && mInjectionQueue->TryPop([&](const InjectionFrame& aFrame) {
+            std::string_view lData{aFrame.mData.data(), aFrame.mLength};
+            if (SendOnHandle(mInjectionHandler, lData, false) && mPacketSocket.UsesRing()) {
+                lQueuedFrames++;
+                lQueuedBytes += lData.size();
+            }
+        })) {
+            lInjected++;
+        }
+
+        if (lInjected == 0) {
+            // Very small delay to make the computer happy, this gives up the CPU rather than timing.
+            std::this_thread::sleep_for(cInjectionIdleSleep);
+        } else if (lQueuedFrames > 0) {
+            // Frames in the ring have only been sent once the kernel accepted the kick.
+            if (mPacketSocket.Flush()) {
+                Metrics::GetInstance().Increment(Counter::AirFramesSent, lQueuedFrames);
+                Metrics::GetInstance().Increment(Counter::AirBytesSent, lQueuedBytes);
+            } else {
+                Metrics::GetInstance().Increment(Counter::AirSendFailures, lQueuedFrames);
+            }
+        }
+    }
+}
+
 void MonitorDevice::SetConnector(std::shared_ptr<IConnector> aDevice)
 {
     mConnector = aDevice;
 }
 
+void MonitorDevice::SetInjectionAdapter(std::string_view aName)
+{
+    mInjectionAdapterName = aName;
+}
+
+void MonitorDevice::SetInjectionBackend(InjectionBackend aBackend)
+{
+    mInjectionBackend = aBackend;
+}
+
+void MonitorDevice::SetMultiNetwork(bool aMultiNetwork)
+{
+    mPacketHandler.SetMultiNetwork(aMultiNetwork);
+}
+
+void MonitorDevice::SetNetworkCache(std::shared_ptr<NetworkCache> aNetworkCache)
+{
+    mNetworkCache = std::move(aNetworkCache);
+}
+
+void MonitorDevice::SetNetworkTable(std::shared_ptr<NetworkTable> aNetworkTable)
+{
+    mPacketHandler.SetNetworkTable(std::move(aNetworkTable));
+}
+
 bool MonitorDevice::StartReceiverThread()
 {
     bool lReturn{true};
@@ -206,11 +542,23 @@ bool MonitorDevice::StartReceiverThread()
                             "Error occurred while reading packet: " + std::string(pcap_geterr(mHandler)),
                             Logger::Level::DEBUG);
                     }
+
+                    if (std::chrono::steady_clock::now() > (mLastStatisticsSample + cStatisticsInterval)) {
+                        SampleCaptureStatistics();
+                    }
+
+                    // Networks locked onto after the filter got tightened have to get through it as well.
+                    if (mCaptureController.IsFilterTightened() &&
+                        (mPacketHandler.GetSessionChanges() != mFilterSessionChanges)) {
+                        SetFilter(mHandler);
+                    }
                 }
 
                 mSendReceivedData = lSendReceivedDataOld;
             });
         }
+
+        StartInjectionThread();
     } else {
         Logger::GetInstance().Log("Can't start receiving without a handler!", Logger::Level::ERROR);
         lReturn = false;
@@ -219,6 +567,21 @@ bool MonitorDevice::StartReceiverThread()
     return lReturn;
 }
 
+void MonitorDevice::StartInjectionThread()
+{
+    if ((mInjectionHandler != nullptr) && (mInjectionThread == nullptr)) {
+        // Frames queued while the device was being closed last time are of no use anymore, they never got sent.
+        uint64_t lStaleFrames{0};
+        while (mInjectionQueue->TryPop([](const InjectionFrame& /*aFrame*/) {})) {
+            lStaleFrames++;
+        }
+        Metrics::GetInstance().Increment(Counter::AirSendFailures, lStaleFrames);
+
+        mInjecting       = true;
+        mInjectionThread = std::make_shared<std::thread>([&] { Inject(); });
+    }
+}
+
 void MonitorDevice::SetSourceMACToFilter(uint64_t aMac)
 {
     if (aMac != 0) {
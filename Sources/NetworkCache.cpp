@@ -0,0 +1,230 @@
+#include "../Includes/NetworkCache.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - NetworkCache.cpp */
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "../Includes/Logger.h"
+#include "../Includes/NetConversionFunctions.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    std::string Unquote(std::string_view aValue)
+    {
+        std::string lReturn{aValue};
+
+        if ((lReturn.size() >= 2) && (lReturn.front() == '"') && (lReturn.back() == '"')) {
+            lReturn = lReturn.substr(1, lReturn.size() - 2);
+        }
+
+        return lReturn;
+    }
+
+    std::string ParametersToString(const RadioTapReader::PhysicalDeviceParameters& aParameters)
+    {
+        std::ostringstream lOutput{};
+        lOutput << aParameters.mLength << " " << aParameters.mPresentFlags << " "
+                << static_cast<unsigned int>(aParameters.mFlags) << " "
+                << static_cast<unsigned int>(aParameters.mDataRate) << " " << aParameters.mFrequency << " "
+                << aParameters.mChannelFlags << " " << static_cast<unsigned int>(aParameters.mKnownMCSInfo) << " "
+                << static_cast<unsigned int>(aParameters.mMCSFlags) << " "
+                << static_cast<unsigned int>(aParameters.mMCSInfo);
+        return lOutput.str();
+    }
+
+    bool StringToParameters(std::string_view aString, RadioTapReader::PhysicalDeviceParameters& aParameters)
+    {
+        std::istringstream          lInput{std::string(aString)};
+        std::array<unsigned int, 9> lValues{};
+
+        for (unsigned int& lValue : lValues) {
+            lInput >> lValue;
+        }
+
+        if (!lInput.fail()) {
+            aParameters.mLength       = static_cast<uint16_t>(lValues.at(0));
+            aParameters.mPresentFlags = lValues.at(1);
+            aParameters.mFlags        = static_cast<uint8_t>(lValues.at(2));
+            aParameters.mDataRate     = static_cast<uint8_t>(lValues.at(3));
+            aParameters.mFrequency    = static_cast<uint16_t>(lValues.at(4));
+            aParameters.mChannelFlags = static_cast<uint16_t>(lValues.at(5));
+            aParameters.mKnownMCSInfo = static_cast<uint8_t>(lValues.at(6));
+            aParameters.mMCSFlags     = static_cast<uint8_t>(lValues.at(7));
+            aParameters.mMCSInfo      = static_cast<uint8_t>(lValues.at(8));
+        }
+
+        return !lInput.fail();
+    }
+}  // namespace
+
+void NetworkCache::Store(CachedNetwork aNetwork)
+{
+    aNetwork.mLastUsed = system_clock::now();
+    if (aNetwork.mPeers.size() > cMaxCachedPeers) {
+        aNetwork.mPeers.resize(cMaxCachedPeers);
+    }
+
+    std::lock_guard<std::mutex> lLock{mMutex};
+    Add(std::move(aNetwork));
+}
+
+void NetworkCache::Add(CachedNetwork aNetwork)
+{
+    mNetworks.erase(std::remove_if(mNetworks.begin(),
+                                   mNetworks.end(),
+                                   [&](const CachedNetwork& aCached) { return aCached.mBSSID == aNetwork.mBSSID; }),
+                    mNetworks.end());
+
+    // Most recently used first, so the oldest falls off the end.
+    auto lPosition{std::find_if(mNetworks.begin(), mNetworks.end(), [&](const CachedNetwork& aCached) {
+        return aCached.mLastUsed < aNetwork.mLastUsed;
+    })};
+    mNetworks.insert(lPosition, std::move(aNetwork));
+
+    if (mNetworks.size() > cMaxCachedNetworks) {
+        mNetworks.resize(cMaxCachedNetworks);
+    }
+}
+
+bool NetworkCache::Find(const std::vector<std::string>& aSSIDFilter, CachedNetwork& aNetwork) const
+{
+    bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mMutex};
+    for (const auto& lNetwork : mNetworks) {
+        bool lMatches{aSSIDFilter.empty()};
+        for (const auto& lFilter : aSSIDFilter) {
+            lMatches = lMatches || (lNetwork.mSSID.find(lFilter) != std::string::npos);
+        }
+
+        if (!lReturn && lMatches) {
+            aNetwork = lNetwork;
+            lReturn  = true;
+        }
+    }
+
+    return lReturn;
+}
+
+std::vector<CachedNetwork> NetworkCache::GetNetworks() const
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    return mNetworks;
+}
+
+bool NetworkCache::SaveToFile(std::string_view aPath) const
+{
+    bool          lReturn{false};
+    std::ofstream lFile;
+    lFile.open(aPath.data());
+
+    if (lFile.is_open() && lFile.good()) {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        for (const auto& lNetwork : mNetworks) {
+            std::string lPeers{};
+            for (uint64_t lPeer : lNetwork.mPeers) {
+                lPeers += (lPeers.empty() ? "" : ",") + IntToMac(lPeer);
+            }
+
+            lFile << cSaveNetwork << ": \"" << lNetwork.mSSID << "\"" << std::endl;
+            lFile << cSaveBSSID << ": \"" << IntToMac(lNetwork.mBSSID) << "\"" << std::endl;
+            lFile << cSaveFrequency << ": " << lNetwork.mFrequency << std::endl;
+            lFile << cSaveAdhoc << ": " << (lNetwork.mIsAdhoc ? "true" : "false") << std::endl;
+            if (lNetwork.mHasParameters) {
+                lFile << cSaveParameters << ": \"" << ParametersToString(lNetwork.mParameters) << "\"" << std::endl;
+            }
+            lFile << cSavePeers << ": \"" << lPeers << "\"" << std::endl;
+            lFile << cSaveLastUsed << ": "
+                  << duration_cast<seconds>(lNetwork.mLastUsed.time_since_epoch()).count() << std::endl;
+        }
+        lFile.close();
+
+        if (lFile.good()) {
+            lReturn = true;
+        } else {
+            Logger::GetInstance().Log("Could not save network cache", Logger::Level::ERROR);
+        }
+    } else {
+        Logger::GetInstance().Log(std::string("Could not open/create network cache file: ") + aPath.data(),
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+bool NetworkCache::LoadFromFile(std::string_view aPath)
+{
+    bool          lReturn{false};
+    std::ifstream lFile;
+    lFile.open(aPath.data());
+
+    if (lFile.is_open() && lFile.good()) {
+        std::vector<CachedNetwork> lNetworks{};
+        std::string                lLine{};
+
+        while (getline(lFile, lLine)) {
+            size_t lUntilDelimiter{lLine.find(": ")};
+            if (lUntilDelimiter != std::string::npos) {
+                std::string lOption{lLine.substr(0, lUntilDelimiter)};
+                std::string lResult{Unquote(lLine.substr(lUntilDelimiter + 2))};
+
+                try {
+                    // Every network starts with its SSID, the rest belongs to the last one started.
+                    if (lOption == cSaveNetwork) {
+                        lNetworks.emplace_back().mSSID = lResult;
+                    } else if (lNetworks.empty()) {
+                        Logger::GetInstance().Log(std::string("Option:") + lOption + " outside of a network",
+                                                  Logger::Level::DEBUG);
+                    } else if (lOption == cSaveBSSID) {
+                        lNetworks.back().mBSSID = MacToInt(lResult);
+                    } else if (lOption == cSaveFrequency) {
+                        lNetworks.back().mFrequency = std::stoi(lResult);
+                    } else if (lOption == cSaveAdhoc) {
+                        lNetworks.back().mIsAdhoc = (lResult == "true");
+                    } else if (lOption == cSaveParameters) {
+                        lNetworks.back().mHasParameters = StringToParameters(lResult, lNetworks.back().mParameters);
+                    } else if (lOption == cSavePeers) {
+                        std::istringstream lPeers{lResult};
+                        std::string        lPeer{};
+                        while (getline(lPeers, lPeer, ',')) {
+                            lNetworks.back().mPeers.push_back(MacToInt(lPeer));
+                        }
+                    } else if (lOption == cSaveLastUsed) {
+                        lNetworks.back().mLastUsed = system_clock::time_point(seconds(std::stoll(lResult)));
+                    } else {
+                        Logger::GetInstance().Log(std::string("Option:") + lOption + " unknown",
+                                                  Logger::Level::DEBUG);
+                    }
+                } catch (std::exception& aException) {
+                    Logger::GetInstance().Log(std::string("Network cache option could not be read: ") +
+                                                  aException.what(),
+                                              Logger::Level::ERROR);
+                }
+            }
+        }
+        lFile.close();
+
+        std::lock_guard<std::mutex> lLock{mMutex};
+        mNetworks.clear();
+        for (auto& lNetwork : lNetworks) {
+            if ((lNetwork.mBSSID != 0) && ((system_clock::now() - lNetwork.mLastUsed) <= cMaxCachedNetworkAge)) {
+                if (lNetwork.mPeers.size() > cMaxCachedPeers) {
+                    lNetwork.mPeers.resize(cMaxCachedPeers);
+                }
+                Add(std::move(lNetwork));
+            }
+        }
+        lReturn = true;
+    } else {
+        Logger::GetInstance().Log(std::string("Could not open network cache file: ") + aPath.data(),
+                                  Logger::Level::DEBUG);
+    }
+
+    return lReturn;
+}
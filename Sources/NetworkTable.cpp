@@ -0,0 +1,101 @@
+#include "../Includes/NetworkTable.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - NetworkTable.cpp */
+
+#include <algorithm>
+#include <utility>
+
+using namespace std::chrono;
+
+void NetworkTable::SetClock(std::shared_ptr<IClock> aClock)
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    mClock = std::move(aClock);
+}
+
+void NetworkTable::Update(
+    uint64_t aBSSID, std::string_view aSSID, uint8_t aChannel, uint8_t aMaxRate, bool aIsAdhoc, int8_t aSignal)
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    steady_clock::time_point    lNow{mClock->Now()};
+
+    auto lNetwork{mNetworks.find(aBSSID)};
+    if (lNetwork == mNetworks.end() && mNetworks.size() >= cMaxNetworks) {
+        // Make room by throwing out the networks that are gone, if there are none this one does not fit.
+        RemoveAged(lNow);
+    }
+
+    if (lNetwork != mNetworks.end() || mNetworks.size() < cMaxNetworks) {
+        DiscoveredNetwork& lEntry{mNetworks[aBSSID]};
+        lEntry.mBSSID = aBSSID;
+        // Assigning in place keeps the buffer of the previous SSID, a new string would be allocated every beacon.
+        lEntry.mSSID.assign(aSSID);
+        lEntry.mMaxRate = aMaxRate;
+        lEntry.mIsAdhoc = aIsAdhoc;
+
+        // Not every beacon or radiotap header has these, keep what was known before.
+        if (aChannel != 0) {
+            lEntry.mChannel = aChannel;
+        }
+        if (aSignal != 0) {
+            lEntry.mSignal = aSignal;
+        }
+
+        lEntry.mLastSeen = lNow;
+        lEntry.mBeacons++;
+    }
+}
+
+bool NetworkTable::IsPresent(uint64_t aBSSID)
+{
+    bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mMutex};
+    auto                        lNetwork{mNetworks.find(aBSSID)};
+    if (lNetwork != mNetworks.end()) {
+        lReturn = (mClock->Now() - lNetwork->second.mLastSeen) <= cNetworkMaxAge;
+    }
+
+    return lReturn;
+}
+
+std::vector<DiscoveredNetwork> NetworkTable::GetNetworks()
+{
+    std::vector<DiscoveredNetwork> lReturn{};
+
+    {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        RemoveAged(mClock->Now());
+
+        lReturn.reserve(mNetworks.size());
+        for (const auto& lNetwork : mNetworks) {
+            lReturn.push_back(lNetwork.second);
+        }
+    }
+
+    // Unknown signal strengths are 0, which would otherwise be the strongest.
+    std::sort(lReturn.begin(), lReturn.end(), [](const DiscoveredNetwork& aFirst, const DiscoveredNetwork& aSecond) {
+        int lFirstSignal{aFirst.mSignal != 0 ? aFirst.mSignal : INT8_MIN - 1};
+        int lSecondSignal{aSecond.mSignal != 0 ? aSecond.mSignal : INT8_MIN - 1};
+        return (lFirstSignal != lSecondSignal) ? (lFirstSignal > lSecondSignal) : (aFirst.mBSSID < aSecond.mBSSID);
+    });
+
+    return lReturn;
+}
+
+void NetworkTable::Clear()
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    mNetworks.clear();
+}
+
+void NetworkTable::RemoveAged(steady_clock::time_point aNow)
+{
+    for (auto lNetwork = mNetworks.begin(); lNetwork != mNetworks.end();) {
+        if ((aNow - lNetwork->second.mLastSeen) > cNetworkMaxAge) {
+            lNetwork = mNetworks.erase(lNetwork);
+        } else {
+            lNetwork++;
+        }
+    }
+}
@@ -0,0 +1,546 @@
+#include "../Includes/Nl80211Control.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - Nl80211Control.cpp */
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <linux/genetlink.h>
+#include <linux/nl80211.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <netlink/attr.h>
+#include <netlink/msg.h>
+#include <netlink/netlink.h>
+
+#include "../Includes/Logger.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    const std::array<nla_policy, NL80211_BSS_MAX + 1>& GetBSSPolicy()
+    {
+        static const std::array<nla_policy, NL80211_BSS_MAX + 1> lPolicy{[] {
+            std::array<nla_policy, NL80211_BSS_MAX + 1> lReturn{};
+            lReturn[NL80211_BSS_TSF]                  = {NLA_U64, 0, 0};
+            lReturn[NL80211_BSS_FREQUENCY]            = {NLA_U32, 0, 0};
+            lReturn[NL80211_BSS_BSSID]                = {NLA_UNSPEC, 0, 0};
+            lReturn[NL80211_BSS_BEACON_INTERVAL]      = {NLA_U16, 0, 0};
+            lReturn[NL80211_BSS_CAPABILITY]           = {NLA_U16, 0, 0};
+            lReturn[NL80211_BSS_INFORMATION_ELEMENTS] = {NLA_UNSPEC, 0, 0};
+            lReturn[NL80211_BSS_SIGNAL_MBM]           = {NLA_U32, 0, 0};
+            lReturn[NL80211_BSS_SIGNAL_UNSPEC]        = {NLA_U8, 0, 0};
+            lReturn[NL80211_BSS_STATUS]               = {NLA_U32, 0, 0};
+            lReturn[NL80211_BSS_SEEN_MS_AGO]          = {NLA_U32, 0, 0};
+            lReturn[NL80211_BSS_BEACON_IES]           = {NLA_UNSPEC, 0, 0};
+            return lReturn;
+        }()};
+
+        return lPolicy;
+    }
+
+    /**
+     * Grabs the SSID from Information Elements.
+     * @param aElements - The IE-fields.
+     * @param aLength - The length of the IE-fields.
+     * @return The SSID found.
+     */
+    std::string GetSSIDFromIE(const unsigned char* aElements, int aLength)
+    {
+        std::string lSSID{};
+
+        while ((aLength >= 2) && (aLength >= aElements[1] + 2)) {
+            // Index 1 contains the length, the element itself starts at index 2
+            int lElementLength{aElements[1]};
+            if ((aElements[0] == 0) && (lElementLength <= 32)) {
+                lSSID = std::string(reinterpret_cast<const char*>(aElements + 2), lElementLength);
+                break;
+            }
+            aLength -= lElementLength + 2;
+            aElements += lElementLength + 2;
+        }
+
+        return lSSID;
+    }
+
+    std::array<nlattr*, NL80211_ATTR_MAX + 1> ParseAttributes(const nlmsghdr* aHeader)
+    {
+        std::array<nlattr*, NL80211_ATTR_MAX + 1> lReturn{};
+        nla_parse(lReturn.data(),
+                  NL80211_ATTR_MAX,
+                  nlmsg_attrdata(aHeader, GENL_HDRLEN),
+                  nlmsg_attrlen(aHeader, GENL_HDRLEN),
+                  nullptr);
+        return lReturn;
+    }
+}  // namespace
+
+Nl80211Control::~Nl80211Control()
+{
+    Close();
+}
+
+bool Nl80211Control::Open(unsigned int aInterfaceIndex)
+{
+    bool lReturn{false};
+    int  lSocket{socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC)};
+
+    if (lSocket >= 0) {
+        sockaddr_nl lAddress{};
+        lAddress.nl_family = AF_NETLINK;
+        if (bind(lSocket, reinterpret_cast<sockaddr*>(&lAddress), sizeof(lAddress)) == 0) {
+            lReturn = Open(lSocket, aInterfaceIndex) && Subscribe();
+        } else {
+            Logger::GetInstance().Log("Could not bind netlink socket: " + std::string(strerror(errno)),
+                                      Logger::Level::ERROR);
+            close(lSocket);
+        }
+    } else {
+        Logger::GetInstance().Log("Could not create netlink socket: " + std::string(strerror(errno)),
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+bool Nl80211Control::Open(int aSocket, unsigned int aInterfaceIndex)
+{
+    bool lReturn{false};
+
+    Close();
+    mSocket         = aSocket;
+    mInterfaceIndex = aInterfaceIndex;
+
+    if (ResolveFamily()) {
+        // Whatever the kernel still has from earlier scans is there right away.
+        RequestScanResults();
+        mRunning = true;
+        mThread  = std::thread([&] { Run(); });
+        lReturn  = true;
+    } else {
+        Logger::GetInstance().Log("Could not resolve " + std::string(cFamilyName), Logger::Level::ERROR);
+        Close();
+    }
+
+    return lReturn;
+}
+
+void Nl80211Control::Close()
+{
+    mRunning = false;
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+
+    mScanning     = false;
+    mDumpPending  = false;
+    mDumpSequence = 0;
+    mBackNetworks.clear();
+}
+
+void Nl80211Control::SetClock(std::shared_ptr<IClock> aClock)
+{
+    mClock = std::move(aClock);
+}
+
+void Nl80211Control::SetScanResultsCallback(ScanResultsCallback aCallback)
+{
+    std::lock_guard<std::mutex> lLock{mCallbackMutex};
+    mScanResultsCallback = std::move(aCallback);
+}
+
+void Nl80211Control::SetIBSSCallback(IWifiInterface::IBSSCallback aCallback)
+{
+    std::lock_guard<std::mutex> lLock{mCallbackMutex};
+    mIBSSCallback = std::move(aCallback);
+}
+
+bool Nl80211Control::TriggerScan()
+{
+    bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mScanMutex};
+    if (mSocket < 0) {
+        Logger::GetInstance().Log("Can't scan without an opened netlink socket!", Logger::Level::ERROR);
+    } else if (mScanning && (mClock->Now() < (mScanStart + cScanLostTimeout))) {
+        lReturn = true;
+    } else {
+        nl_msg* lMessage{CreateMessage(NL80211_CMD_TRIGGER_SCAN, NLM_F_REQUEST | NLM_F_ACK)};
+        if (lMessage != nullptr) {
+            // A wildcard SSID, so every network answers.
+            nlattr* lSSIDs{nla_nest_start(lMessage, NL80211_ATTR_SCAN_SSIDS)};
+            nla_put(lMessage, 1, 0, "");
+            nla_nest_end(lMessage, lSSIDs);
+
+            mScanSequence = nlmsg_hdr(lMessage)->nlmsg_seq;
+            mScanStart    = mClock->Now();
+            mScanning     = true;
+            lReturn       = Send(lMessage);
+            mScanning     = lReturn;
+            nlmsg_free(lMessage);
+        }
+    }
+
+    return lReturn;
+}
+
+bool Nl80211Control::IsScanning() const
+{
+    return mScanning;
+}
+
+std::shared_ptr<const ScanResults> Nl80211Control::GetScanResults() const
+{
+    std::lock_guard<std::mutex> lLock{mResultsMutex};
+    return mResults;
+}
+
+steady_clock::duration Nl80211Control::GetScanResultsAge() const
+{
+    steady_clock::duration             lReturn{steady_clock::duration::max()};
+    std::shared_ptr<const ScanResults> lResults{GetScanResults()};
+
+    if (lResults != nullptr) {
+        lReturn = mClock->Now() - lResults->mTime;
+    }
+
+    return lReturn;
+}
+
+nl_msg* Nl80211Control::CreateMessage(uint8_t aCommand, uint16_t aFlags)
+{
+    nl_msg* lReturn{nlmsg_alloc_simple(mFamilyId, aFlags)};
+
+    if (lReturn != nullptr) {
+        genlmsghdr lHeader{aCommand, 0, 0};
+        nlmsg_hdr(lReturn)->nlmsg_seq = mSequence++;
+        nlmsg_append(lReturn, &lHeader, sizeof(lHeader), NLMSG_ALIGNTO);
+        nla_put_u32(lReturn, NL80211_ATTR_IFINDEX, mInterfaceIndex);
+    } else {
+        Logger::GetInstance().Log("Failed to allocate netlink message", Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+bool Nl80211Control::Send(nl_msg* aMessage)
+{
+    bool      lReturn{false};
+    nlmsghdr* lHeader{nlmsg_hdr(aMessage)};
+
+    if (send(mSocket, lHeader, lHeader->nlmsg_len, 0) == static_cast<ssize_t>(lHeader->nlmsg_len)) {
+        lReturn = true;
+    } else {
+        Logger::GetInstance().Log("Could not send netlink message: " + std::string(strerror(errno)),
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+bool Nl80211Control::ResolveFamily()
+{
+    // https://git.kernel.org/pub/scm/linux/kernel/git/jberg/iw.git/tree/genl.c used as reference.
+    bool    lReturn{false};
+    bool    lAnswered{false};
+    nl_msg* lMessage{nlmsg_alloc_simple(GENL_ID_CTRL, NLM_F_REQUEST)};
+
+    if (lMessage != nullptr) {
+        genlmsghdr lHeader{CTRL_CMD_GETFAMILY, 1, 0};
+        uint32_t   lSequence{mSequence++};
+        nlmsg_hdr(lMessage)->nlmsg_seq = lSequence;
+        nlmsg_append(lMessage, &lHeader, sizeof(lHeader), NLMSG_ALIGNTO);
+        nla_put_string(lMessage, CTRL_ATTR_FAMILY_NAME, cFamilyName.data());
+
+        steady_clock::time_point lDeadline{steady_clock::now() + cResolveTimeout};
+        bool                     lSent{Send(lMessage)};
+        nlmsg_free(lMessage);
+
+        while (lSent && !lAnswered && (steady_clock::now() < lDeadline)) {
+            pollfd lPoll{mSocket, POLLIN, 0};
+            auto   lRemaining{duration_cast<milliseconds>(lDeadline - steady_clock::now())};
+            if ((poll(&lPoll, 1, static_cast<int>(lRemaining.count())) > 0) && ((lPoll.revents & POLLIN) != 0)) {
+                ssize_t lLength{recv(mSocket, mReceiveBuffer.data(), mReceiveBuffer.size(), 0)};
+                int     lRemainingLength{static_cast<int>(lLength)};
+                auto*   lHeader{reinterpret_cast<nlmsghdr*>(mReceiveBuffer.data())};
+
+                while ((lLength > 0) && nlmsg_ok(lHeader, lRemainingLength) && !lAnswered) {
+                    if (lHeader->nlmsg_seq == lSequence) {
+                        lAnswered = true;
+                        if (lHeader->nlmsg_type == GENL_ID_CTRL) {
+                            std::array<nlattr*, CTRL_ATTR_MAX + 1> lAttributes{};
+                            nla_parse(lAttributes.data(),
+                                      CTRL_ATTR_MAX,
+                                      nlmsg_attrdata(lHeader, GENL_HDRLEN),
+                                      nlmsg_attrlen(lHeader, GENL_HDRLEN),
+                                      nullptr);
+
+                            if (lAttributes.at(CTRL_ATTR_FAMILY_ID) != nullptr) {
+                                mFamilyId = nla_get_u16(lAttributes.at(CTRL_ATTR_FAMILY_ID));
+                                lReturn   = true;
+                            }
+
+                            if (lAttributes.at(CTRL_ATTR_MCAST_GROUPS) != nullptr) {
+                                nlattr* lGroup{nullptr};
+                                int     lGroupsRemaining{0};
+                                nla_for_each_nested(lGroup, lAttributes.at(CTRL_ATTR_MCAST_GROUPS), lGroupsRemaining)
+                                {
+                                    std::array<nlattr*, CTRL_ATTR_MCAST_GRP_MAX + 1> lGroupAttributes{};
+                                    nla_parse(lGroupAttributes.data(),
+                                              CTRL_ATTR_MCAST_GRP_MAX,
+                                              reinterpret_cast<nlattr*>(nla_data(lGroup)),
+                                              nla_len(lGroup),
+                                              nullptr);
+
+                                    if ((lGroupAttributes.at(CTRL_ATTR_MCAST_GRP_NAME) != nullptr) &&
+                                        (lGroupAttributes.at(CTRL_ATTR_MCAST_GRP_ID) != nullptr)) {
+                                        std::string_view lName{reinterpret_cast<char*>(
+                                            nla_data(lGroupAttributes.at(CTRL_ATTR_MCAST_GRP_NAME)))};
+                                        uint32_t         lId{nla_get_u32(lGroupAttributes.at(CTRL_ATTR_MCAST_GRP_ID))};
+                                        mScanGroup = (lName == cScanGroupName) ? lId : mScanGroup;
+                                        mMlmeGroup = (lName == cMlmeGroupName) ? lId : mMlmeGroup;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    lHeader = nlmsg_next(lHeader, &lRemainingLength);
+                }
+            }
+        }
+    }
+
+    return lReturn;
+}
+
+bool Nl80211Control::Subscribe()
+{
+    bool lReturn{true};
+
+    for (uint32_t lGroup : {mScanGroup, mMlmeGroup}) {
+        if ((lGroup == 0) || (setsockopt(mSocket, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &lGroup, sizeof(lGroup)) != 0)) {
+            Logger::GetInstance().Log("Could not join nl80211 multicast group " + std::to_string(lGroup),
+                                      Logger::Level::ERROR);
+            lReturn = false;
+        }
+    }
+
+    return lReturn;
+}
+
+void Nl80211Control::Run()
+{
+    while (mRunning) {
+        pollfd lPoll{mSocket, POLLIN, 0};
+        if ((poll(&lPoll, 1, static_cast<int>(cEventPollInterval.count())) > 0) && ((lPoll.revents & POLLIN) != 0)) {
+            ssize_t lLength{recv(mSocket, mReceiveBuffer.data(), mReceiveBuffer.size(), 0)};
+            if (lLength > 0) {
+                int   lRemaining{static_cast<int>(lLength)};
+                auto* lHeader{reinterpret_cast<nlmsghdr*>(mReceiveBuffer.data())};
+                while (nlmsg_ok(lHeader, lRemaining)) {
+                    HandleMessage(lHeader);
+                    lHeader = nlmsg_next(lHeader, &lRemaining);
+                }
+            } else if ((lLength < 0) && (errno == ENOBUFS)) {
+                // Events got lost because they were not read in time, one of them could have been the scan finishing.
+                Logger::GetInstance().Log("nl80211 events were lost, getting the scan results again",
+                                          Logger::Level::WARNING);
+                RequestScanResults();
+            } else if ((lLength == 0) || ((errno != EINTR) && (errno != EAGAIN))) {
+                Logger::GetInstance().Log("Netlink socket closed, no more nl80211 events", Logger::Level::ERROR);
+                mRunning  = false;
+                mScanning = false;
+            }
+        }
+    }
+}
+
+void Nl80211Control::HandleMessage(const nlmsghdr* aHeader)
+{
+    if (aHeader->nlmsg_type == NLMSG_ERROR) {
+        auto* lError{reinterpret_cast<nlmsgerr*>(nlmsg_data(aHeader))};
+        if ((aHeader->nlmsg_len >= NLMSG_LENGTH(sizeof(int))) && (lError->error != 0)) {
+            if (aHeader->nlmsg_seq == mScanSequence) {
+                if (lError->error == -EBUSY) {
+                    // Someone else is scanning, those results are just as good.
+                    Logger::GetInstance().Log("A scan is running already", Logger::Level::DEBUG);
+                } else {
+                    Logger::GetInstance().Log("Could not trigger scan: " + std::string(strerror(-lError->error)),
+                                              Logger::Level::ERROR);
+                    mScanning = false;
+                }
+            } else if ((mDumpSequence != 0) && (aHeader->nlmsg_seq == mDumpSequence)) {
+                Logger::GetInstance().Log("Could not get scan results: " + std::string(strerror(-lError->error)),
+                                          Logger::Level::ERROR);
+                mDumpSequence = 0;
+                mBackNetworks.clear();
+            }
+        }
+    } else if (aHeader->nlmsg_type == NLMSG_DONE) {
+        if ((mDumpSequence != 0) && (aHeader->nlmsg_seq == mDumpSequence)) {
+            PublishScanResults();
+        }
+    } else if ((aHeader->nlmsg_type == mFamilyId) && (aHeader->nlmsg_len >= NLMSG_LENGTH(GENL_HDRLEN))) {
+        HandleEvent(aHeader);
+    }
+}
+
+void Nl80211Control::HandleEvent(const nlmsghdr* aHeader)
+{
+    auto* lGenlHeader{reinterpret_cast<genlmsghdr*>(nlmsg_data(aHeader))};
+    std::array<nlattr*, NL80211_ATTR_MAX + 1> lAttributes{ParseAttributes(aHeader)};
+
+    // Events for other adapters are not interesting.
+    if ((lAttributes.at(NL80211_ATTR_IFINDEX) == nullptr) ||
+        (nla_get_u32(lAttributes.at(NL80211_ATTR_IFINDEX)) == mInterfaceIndex)) {
+        switch (lGenlHeader->cmd) {
+            case NL80211_CMD_TRIGGER_SCAN: {
+                std::lock_guard<std::mutex> lLock{mScanMutex};
+                mScanStart = mClock->Now();
+                mScanning  = true;
+                break;
+            }
+            case NL80211_CMD_NEW_SCAN_RESULTS:
+                if (lAttributes.at(NL80211_ATTR_BSS) != nullptr) {
+                    if ((mDumpSequence != 0) && (aHeader->nlmsg_seq == mDumpSequence)) {
+                        HandleBSS(lAttributes.at(NL80211_ATTR_BSS));
+                    }
+                } else {
+                    // The scan is done, the results still have to be asked for.
+                    mScanning = false;
+                    RequestScanResults();
+                }
+                break;
+            case NL80211_CMD_SCAN_ABORTED:
+                Logger::GetInstance().Log("Kernel aborted scan", Logger::Level::WARNING);
+                mScanning = false;
+                break;
+            case NL80211_CMD_JOIN_IBSS:
+            case NL80211_CMD_LEAVE_IBSS:
+            case NL80211_CMD_DISCONNECT: {
+                IWifiInterface::IBSSEvent lEvent{lGenlHeader->cmd == NL80211_CMD_JOIN_IBSS, {}};
+                nlattr*                   lMAC{lAttributes.at(NL80211_ATTR_MAC)};
+                if ((lMAC != nullptr) && (nla_len(lMAC) >= static_cast<int>(lEvent.bssid.size()))) {
+                    memcpy(lEvent.bssid.data(), nla_data(lMAC), lEvent.bssid.size());
+                }
+
+                std::lock_guard<std::mutex> lLock{mCallbackMutex};
+                if (mIBSSCallback != nullptr) {
+                    mIBSSCallback(lEvent);
+                }
+                break;
+            }
+            default:
+                // Probably an uninteresting multicast message.
+                break;
+        }
+    }
+}
+
+void Nl80211Control::HandleBSS(nlattr* aBSS)
+{
+    std::array<nlattr*, NL80211_BSS_MAX + 1> lBSS{};
+
+    if (nla_parse_nested(lBSS.data(), NL80211_BSS_MAX, aBSS, GetBSSPolicy().data()) == 0) {
+        // Probe responses carry the SSID as well as beacons do, so either will do.
+        nlattr* lElements{(lBSS.at(NL80211_BSS_BEACON_IES) != nullptr) ? lBSS.at(NL80211_BSS_BEACON_IES)
+                                                                        : lBSS.at(NL80211_BSS_INFORMATION_ELEMENTS)};
+        nlattr* lBSSID{lBSS.at(NL80211_BSS_BSSID)};
+
+        if ((lBSSID != nullptr) && (nla_len(lBSSID) >= 6) && (lElements != nullptr)) {
+            std::string lSSID{
+                GetSSIDFromIE(reinterpret_cast<const unsigned char*>(nla_data(lElements)), nla_len(lElements))};
+
+            // Hidden SSIDs (" ") are filtered as well
+            if (!lSSID.empty() && lSSID != " ") {
+                Logger::GetInstance().Log(lSSID, Logger::Level::TRACE);
+
+                IWifiInterface::WifiInformation lInformation{};
+                lInformation.ssid = lSSID;
+                memcpy(lInformation.bssid.data(), nla_data(lBSSID), lInformation.bssid.size());
+
+                if (lBSS.at(NL80211_BSS_STATUS) != nullptr) {
+                    uint32_t lStatus{nla_get_u32(lBSS.at(NL80211_BSS_STATUS))};
+                    lInformation.isconnected =
+                        (lStatus == NL80211_BSS_STATUS_ASSOCIATED) || (lStatus == NL80211_BSS_STATUS_IBSS_JOINED);
+                }
+
+                if (lBSS.at(NL80211_BSS_FREQUENCY) != nullptr) {
+                    lInformation.frequency = static_cast<int>(nla_get_u32(lBSS.at(NL80211_BSS_FREQUENCY)));
+                }
+
+                // Using the Capability field, index 0, field ESS, if this is 0, the network is an adhoc network.
+                if ((lBSS.at(NL80211_BSS_CAPABILITY) != nullptr) &&
+                    ((nla_get_u16(lBSS.at(NL80211_BSS_CAPABILITY)) & 0b1U) == 0U)) {
+                    lInformation.isadhoc = true;
+                }
+
+                mBackNetworks.emplace_back(lInformation);
+
+                // Associated info will always be put at the beginning
+                if (lInformation.isconnected) {
+                    std::swap(mBackNetworks.back(), mBackNetworks.front());
+                }
+            }
+        }
+    } else {
+        Logger::GetInstance().Log("Parsing basic service set info failed!", Logger::Level::ERROR);
+    }
+}
+
+void Nl80211Control::RequestScanResults()
+{
+    if (mDumpSequence != 0) {
+        // One dump at a time, the next one starts when this one is done.
+        mDumpPending = true;
+    } else {
+        nl_msg* lMessage{CreateMessage(NL80211_CMD_GET_SCAN, NLM_F_REQUEST | NLM_F_DUMP)};
+        if (lMessage != nullptr) {
+            mBackNetworks.clear();
+            mDumpSequence = nlmsg_hdr(lMessage)->nlmsg_seq;
+            if (!Send(lMessage)) {
+                mDumpSequence = 0;
+            }
+            nlmsg_free(lMessage);
+        }
+    }
+}
+
+void Nl80211Control::PublishScanResults()
+{
+    auto lResults{std::make_shared<ScanResults>()};
+    lResults->mNetworks   = std::exchange(mBackNetworks, {});
+    lResults->mTime       = mClock->Now();
+    lResults->mGeneration = ++mGeneration;
+    mDumpSequence         = 0;
+
+    Logger::GetInstance().Log("Scan results: " + std::to_string(lResults->mNetworks.size()) + " networks",
+                              Logger::Level::DEBUG);
+
+    {
+        std::lock_guard<std::mutex> lLock{mResultsMutex};
+        mResults = lResults;
+    }
+
+    {
+        std::lock_guard<std::mutex> lLock{mCallbackMutex};
+        if (mScanResultsCallback != nullptr) {
+            mScanResultsCallback(lResults);
+        }
+    }
+
+    if (mDumpPending) {
+        mDumpPending = false;
+        RequestScanResults();
+    }
+}
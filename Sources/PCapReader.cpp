@@ -2,10 +2,12 @@
 
 /* Copyright (c) 2020 [Rick de Bondt] - PCapReader.cpp */
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
 #include "../Includes/Logger.h"
+#include "../Includes/Metrics.h"
 #include "../Includes/NetConversionFunctions.h"
 
 using namespace std::chrono;
@@ -26,9 +28,11 @@ void PCapReader::BlackList(uint64_t aMAC)
 
 void PCapReader::Close()
 {
+    mStopReplay = true;
     if ((mReplayThread != nullptr) && mReplayThread->joinable()) {
         mReplayThread->join();
     }
+    mStopReplay = false;
 
     if (mHandler != nullptr) {
         pcap_close(mHandler);
@@ -111,34 +115,36 @@ bool PCapReader::Open(std::string_view aArgument)
     // Create an 8023 handler, this is going to be a promiscuous capture
     mPacketHandler = std::make_shared<Handler8023>();
 
-    bool                               lReturn{true};
-    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
-    mHandler = pcap_open_offline(aArgument.data(), lErrorBuffer.data());
-
-    if (mHandler == nullptr) {
-        lReturn = false;
-        Logger::GetInstance().Log("pcap_open_offline failed, " + std::string(lErrorBuffer.data()),
-                                  Logger::Level::ERROR);
-    }
-
-    return lReturn;
+    return OpenFile(aArgument);
 }
 
 
-bool PCapReader::Open(std::string_view aName, std::vector<std::string>& aSSIDFilter)
+bool PCapReader::Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter)
 {
     mMonitorCapture = true;
     // Create an 80211 handler, this is going to ge a monitor capture
     mPacketHandler = std::make_shared<Handler80211>();
 
-    bool                               lReturn{true};
-    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
-    mHandler = pcap_open_offline(aName.data(), lErrorBuffer.data());
-    if (mHandler != nullptr) {
+    bool lReturn{OpenFile(aName)};
+    if (lReturn) {
         // If we have a monitor device we want the 80211 handler.
         auto lHandler{std::dynamic_pointer_cast<Handler80211>(mPacketHandler)};
         lHandler->SetSSIDFilterList(aSSIDFilter);
-    } else {
+    }
+
+    return lReturn;
+}
+
+bool PCapReader::OpenFile(std::string_view aName)
+{
+    bool lReturn{true};
+
+    // Kept so the capture can be opened again for every loop of the replay.
+    mFileName = aName;
+
+    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+    mHandler = pcap_open_offline(mFileName.c_str(), lErrorBuffer.data());
+    if (mHandler == nullptr) {
         lReturn = false;
         Logger::GetInstance().Log("pcap_open_offline failed, " + std::string(lErrorBuffer.data()),
                                   Logger::Level::ERROR);
@@ -199,9 +205,13 @@ bool PCapReader::ReadNextData()
 {
     bool lReturn = true;
 
-    if (pcap_next_ex(mHandler, &mHeader, &mData) < 0) {
-        Logger::GetInstance().Log("Reading offline capture failed: " + std::string(pcap_geterr(mHandler)),
-                                  Logger::Level::ERROR);
+    int lResult{pcap_next_ex(mHandler, &mHeader, &mData)};
+    if (lResult < 0) {
+        // The end of the file is not an error.
+        if (lResult != PCAP_ERROR_BREAK) {
+            Logger::GetInstance().Log("Reading offline capture failed: " + std::string(pcap_geterr(mHandler)),
+                                      Logger::Level::ERROR);
+        }
         lReturn = false;
     }
 
@@ -228,6 +238,25 @@ void PCapReader::SetBSSID(uint64_t aBSSID)
     mBSSID = aBSSID;
 }
 
+void PCapReader::SetClock(std::shared_ptr<IClock> aClock)
+{
+    mClock = std::move(aClock);
+}
+
+void PCapReader::SetReplayLoops(unsigned int aLoops)
+{
+    mReplayLoops = aLoops;
+}
+
+void PCapReader::SetReplaySpeed(double aSpeed)
+{
+    mReplaySpeed = std::clamp(aSpeed, cMinimumReplaySpeed, cMaximumReplaySpeed);
+    if (mReplaySpeed != aSpeed) {
+        Logger::GetInstance().Log("Replay speed out of range, using " + std::to_string(mReplaySpeed),
+                                  Logger::Level::WARNING);
+    }
+}
+
 void PCapReader::SetParameters(std::shared_ptr<RadioTapReader::PhysicalDeviceParameters> aParameters)
 {
     mParameters = std::move(aParameters);
@@ -262,42 +291,80 @@ void PCapReader::ShowPacketStatistics(const pcap_pkthdr* aHeader) const
     }
 }
 
-bool PCapReader::StartReceiverThread()
+void PCapReader::Replay()
 {
-    bool lReturn{true};
-    if (mHandler != nullptr) {
-        // Run
-        if (mReplayThread == nullptr) {
-            mReplayThread = std::make_shared<std::thread>([&] {
-                if (ReadNextData()) {
-                    microseconds lTimeStamp{mHeader->ts.tv_sec * 1000000 + mHeader->ts.tv_usec};
-
-                    ReadCallback(mData, mHeader);
-
-                    while (ReadNextData()) {
-                        // Get time offset.
-                        microseconds lSleepFor{mHeader->ts.tv_sec * 1000000 + mHeader->ts.tv_usec - lTimeStamp.count()};
-                        lTimeStamp = microseconds(mHeader->ts.tv_sec * 1000000 + mHeader->ts.tv_usec);
-
-                        if (mTimeAccurate) {
-                            // Wait for next send.
-                            std::this_thread::sleep_for(lSleepFor);
-                        }
-
-                        // Wait for next send.
-                        ReadCallback(mData, mHeader);
-                    }
-                }
-                mDoneReceiving = true;
-            });
-        } else {
-            Logger::GetInstance().Log("Can't start receiving without a handler!", Logger::Level::ERROR);
-            lReturn = false;
+    steady_clock::time_point lStart{mClock->Now()};
+    nanoseconds              lLoopOffset{0};
+    unsigned int             lLoop{0};
+    bool                     lContinue{true};
+
+    while (lContinue) {
+        unsigned int lFrames{0};
+        nanoseconds  lFirstTimestamp{0};
+        nanoseconds  lLastTimestamp{0};
+
+        while (!mStopReplay && ReadNextData()) {
+            nanoseconds lTimestamp{seconds(mHeader->ts.tv_sec) + microseconds(mHeader->ts.tv_usec)};
+            if (lFrames == 0) {
+                lFirstTimestamp = lTimestamp;
+            }
+            lLastTimestamp = std::max(lLastTimestamp, lTimestamp);
+
+            if (mTimeAccurate) {
+                // Every frame gets a deadline relative to the start, so time spent handling frames and oversleeping
+                // does not add up over the replay.
+                duration<double, std::nano> lOffset{(lLoopOffset + lTimestamp - lFirstTimestamp) / mReplaySpeed};
+                steady_clock::time_point    lDeadline{lStart + duration_cast<steady_clock::duration>(lOffset)};
+
+                WaitUntil(lDeadline);
+                Metrics::GetInstance().RecordLatency(Histogram::ReplayScheduleError, mClock->Now() - lDeadline);
+            }
+
+            ReadCallback(mData, mHeader);
+            lFrames++;
+        }
+
+        // The next loop starts an average gap after the last frame, instead of on top of it.
+        nanoseconds lDuration{lLastTimestamp - lFirstTimestamp};
+        nanoseconds lGap{(lFrames > 1) ? (lDuration / (lFrames - 1)) : nanoseconds(0)};
+        lLoopOffset += lDuration + std::max<nanoseconds>(lGap, cMinimumLoopGap);
+
+        lLoop++;
+        lContinue = !mStopReplay && (lFrames > 0) && ((mReplayLoops == 0) || (lLoop < mReplayLoops));
+        if (lContinue) {
+            pcap_close(mHandler);
+            lContinue = OpenFile(mFileName);
         }
     }
+
+    mDoneReceiving = true;
+}
+
+bool PCapReader::StartReceiverThread()
+{
+    bool lReturn{false};
+
+    if (mHandler == nullptr) {
+        Logger::GetInstance().Log("Can't start receiving without a handler!", Logger::Level::ERROR);
+    } else if (mReplayThread == nullptr) {
+        mDoneReceiving = false;
+        mReplayThread  = std::make_shared<std::thread>([&] { Replay(); });
+        lReturn        = true;
+    }
+
     return lReturn;
 }
 
+void PCapReader::WaitUntil(steady_clock::time_point aDeadline) const
+{
+    // Long gaps get waited in parts, so closing the reader does not have to wait for the next frame.
+    steady_clock::time_point lNow{mClock->Now()};
+    while (!mStopReplay && (lNow < aDeadline)) {
+        mClock->SleepUntil(std::min(aDeadline, lNow + cStopCheckInterval));
+        lNow = mClock->Now();
+    }
+}
+
 void PCapReader::SetSourceMACToFilter(uint64_t aMac)
 {
     if (aMac != 0) {
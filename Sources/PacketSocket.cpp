@@ -0,0 +1,283 @@
+#include "../Includes/PacketSocket.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - PacketSocket.cpp */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "../Includes/Logger.h"
+
+#if defined(__linux__)
+namespace
+{
+    // Frame data follows the header of a slot, aligned the way the kernel expects it.
+    constexpr std::size_t cRingDataOffset{TPACKET_ALIGN(sizeof(tpacket2_hdr))};
+
+    std::string ErrorString()
+    {
+        return std::string(strerror(errno));
+    }
+
+    // The kernel hands slots back by changing their status, so it has to be read and written atomically.
+    std::atomic_ref<uint32_t> GetStatus(tpacket2_hdr& aHeader)
+    {
+        return std::atomic_ref<uint32_t>(aHeader.tp_status);
+    }
+}  // namespace
+#endif
+
+PacketSocket::~PacketSocket()
+{
+    Close();
+}
+
+InjectionBackend PacketSocket::ConvertStringToBackend(std::string_view aText)
+{
+    InjectionBackend lReturn{InjectionBackend::PCap};
+
+    auto lText{std::find(cInjectionBackendTexts.begin(), cInjectionBackendTexts.end(), aText)};
+    if (lText != cInjectionBackendTexts.end()) {
+        lReturn = static_cast<InjectionBackend>(std::distance(cInjectionBackendTexts.begin(), lText));
+    } else {
+        Logger::GetInstance().Log("Unknown injection backend: " + std::string(aText) + ", using pcap",
+                                  Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+#if defined(__linux__)
+bool PacketSocket::Open(std::string_view aAdapter, bool aUseRing)
+{
+    bool lReturn{false};
+
+    Close();
+
+    sockaddr_ll lAddress{};
+    lAddress.sll_family  = AF_PACKET;
+    lAddress.sll_ifindex = static_cast<int>(if_nametoindex(std::string(aAdapter).c_str()));
+
+    // Protocol 0 keeps the kernel from handing this socket anything it receives.
+    mSocket = socket(AF_PACKET, SOCK_RAW, 0);
+
+    if (mSocket == -1) {
+        Logger::GetInstance().Log("Could not create packet socket, " + ErrorString(), Logger::Level::ERROR);
+    } else if (lAddress.sll_ifindex == 0) {
+        Logger::GetInstance().Log("Could not find adapter " + std::string(aAdapter) + " to inject on",
+                                  Logger::Level::ERROR);
+    } else if (bind(mSocket, reinterpret_cast<sockaddr*>(&lAddress), sizeof(lAddress)) != 0) {
+        Logger::GetInstance().Log("Could not bind packet socket, " + ErrorString(), Logger::Level::ERROR);
+    } else {
+        lReturn = true;
+
+        int lBypass{1};
+        if (setsockopt(mSocket, SOL_PACKET, PACKET_QDISC_BYPASS, &lBypass, sizeof(lBypass)) != 0) {
+            // Only makes it slower, older kernels do not have it.
+            Logger::GetInstance().Log("Could not bypass qdisc layer, " + ErrorString(), Logger::Level::WARNING);
+        }
+
+        if (aUseRing && !SetUpRing()) {
+            // A ring can only be requested once per socket, so start over without one.
+            Logger::GetInstance().Log("Injecting without TX ring", Logger::Level::WARNING);
+            lReturn = Open(aAdapter, false);
+        }
+    }
+
+    if (!lReturn) {
+        Close();
+    }
+
+    return lReturn;
+}
+
+bool PacketSocket::SetUpRing()
+{
+    bool lReturn{false};
+
+    // Blocks have to be a multiple of the page size, which is bigger than a slot on some architectures.
+    auto        lPageSize{static_cast<std::size_t>(getpagesize())};
+    std::size_t lBlockSize{((cRingFrameSize + lPageSize - 1) / lPageSize) * lPageSize};
+    std::size_t lFramesPerBlock{lBlockSize / cRingFrameSize};
+    std::size_t lBlockCount{(cRingFrameCount + lFramesPerBlock - 1) / lFramesPerBlock};
+
+    int         lVersion{TPACKET_V2};
+    tpacket_req lRequest{};
+    lRequest.tp_block_size = static_cast<unsigned int>(lBlockSize);
+    lRequest.tp_block_nr   = static_cast<unsigned int>(lBlockCount);
+    lRequest.tp_frame_size = static_cast<unsigned int>(cRingFrameSize);
+    lRequest.tp_frame_nr   = static_cast<unsigned int>(lBlockCount * lFramesPerBlock);
+
+    if ((setsockopt(mSocket, SOL_PACKET, PACKET_VERSION, &lVersion, sizeof(lVersion)) != 0) ||
+        (setsockopt(mSocket, SOL_PACKET, PACKET_TX_RING, &lRequest, sizeof(lRequest)) != 0)) {
+        Logger::GetInstance().Log("Could not set up TX ring, " + ErrorString(), Logger::Level::ERROR);
+    } else {
+        // Slots fill up their blocks exactly, so they follow each other in memory.
+        std::size_t lRingSize{lBlockSize * lBlockCount};
+        void*       lRing{mmap(nullptr, lRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, mSocket, 0)};
+        if (lRing != MAP_FAILED) {
+            mRing           = static_cast<char*>(lRing);
+            mRingFrameCount = lRequest.tp_frame_nr;
+            mRingSize       = lRingSize;
+            lReturn         = true;
+        } else {
+            Logger::GetInstance().Log("Could not map TX ring, " + ErrorString(), Logger::Level::ERROR);
+        }
+    }
+
+    return lReturn;
+}
+
+void PacketSocket::Close()
+{
+    if (mRing != nullptr) {
+        munmap(mRing, mRingSize);
+    }
+
+    if (mSocket != -1) {
+        close(mSocket);
+    }
+
+    mSocket         = -1;
+    mRing           = nullptr;
+    mRingFrameCount = 0;
+    mRingPosition   = 0;
+    mRingSize       = 0;
+    mQueued         = 0;
+}
+
+bool PacketSocket::Queue(std::string_view aData)
+{
+    bool lReturn{false};
+
+    if (mSocket == -1) {
+        Logger::GetInstance().Log("Cannot send packets on a socket that has not been opened yet!",
+                                  Logger::Level::ERROR);
+    } else if (mRing == nullptr) {
+        lReturn = SendDirect(aData);
+    } else if (aData.size() > (cRingFrameSize - cRingDataOffset)) {
+        // Once there is a ring, the kernel only sends from the ring.
+        Logger::GetInstance().Log("Frame too big for TX ring: " + std::to_string(aData.size()), Logger::Level::ERROR);
+    } else {
+        auto* lHeader{reinterpret_cast<tpacket2_hdr*>(mRing + mRingPosition * cRingFrameSize)};
+
+        // All slots are waiting on the kernel, so wait for it to catch up.
+        if (GetStatus(*lHeader).load(std::memory_order_acquire) != TP_STATUS_AVAILABLE) {
+            WaitForRing();
+        }
+
+        uint32_t lStatus{GetStatus(*lHeader).load(std::memory_order_acquire)};
+        if (lStatus == TP_STATUS_WRONG_FORMAT) {
+            // The kernel refused the frame that was in this slot, which is lost by now.
+            Logger::GetInstance().Log("TX ring frame refused by the kernel", Logger::Level::ERROR);
+            lStatus = TP_STATUS_AVAILABLE;
+        }
+
+        if (lStatus == TP_STATUS_AVAILABLE) {
+            std::copy(aData.begin(), aData.end(), reinterpret_cast<char*>(lHeader) + cRingDataOffset);
+            lHeader->tp_len     = static_cast<uint32_t>(aData.size());
+            lHeader->tp_snaplen = static_cast<uint32_t>(aData.size());
+            GetStatus(*lHeader).store(TP_STATUS_SEND_REQUEST, std::memory_order_release);
+
+            mRingPosition = (mRingPosition + 1) % mRingFrameCount;
+            mQueued++;
+            lReturn = true;
+        } else {
+            Logger::GetInstance().Log("TX ring is full", Logger::Level::ERROR);
+        }
+    }
+
+    return lReturn;
+}
+
+bool PacketSocket::Flush()
+{
+    bool lReturn{true};
+
+    if ((mSocket != -1) && (mQueued > 0)) {
+        mQueued = 0;
+        // Sends everything queued, without waiting for the driver to be done with it.
+        if (send(mSocket, nullptr, 0, MSG_DONTWAIT) == -1) {
+            Logger::GetInstance().Log("Could not kick TX ring, " + ErrorString(), Logger::Level::ERROR);
+            lReturn = false;
+        }
+    }
+
+    return lReturn;
+}
+
+void PacketSocket::WaitForRing()
+{
+    mQueued = 0;
+    if (send(mSocket, nullptr, 0, 0) == -1) {
+        Logger::GetInstance().Log("Could not kick TX ring, " + ErrorString(), Logger::Level::ERROR);
+    }
+}
+
+bool PacketSocket::SendDirect(std::string_view aData)
+{
+    bool lReturn{send(mSocket, aData.data(), aData.size(), 0) == static_cast<ssize_t>(aData.size())};
+
+    if (!lReturn) {
+        Logger::GetInstance().Log("Could not send on packet socket, " + ErrorString(), Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+#else
+bool PacketSocket::Open(std::string_view /*aAdapter*/, bool /*aUseRing*/)
+{
+    Logger::GetInstance().Log("Packet sockets are only available on Linux", Logger::Level::ERROR);
+    return false;
+}
+
+void PacketSocket::Close() {}
+
+bool PacketSocket::Queue(std::string_view /*aData*/)
+{
+    return false;
+}
+
+bool PacketSocket::Flush()
+{
+    return true;
+}
+
+bool PacketSocket::SetUpRing()
+{
+    return false;
+}
+
+void PacketSocket::WaitForRing() {}
+
+bool PacketSocket::SendDirect(std::string_view /*aData*/)
+{
+    return false;
+}
+#endif
+
+bool PacketSocket::IsOpen() const
+{
+    return mSocket != -1;
+}
+
+bool PacketSocket::UsesRing() const
+{
+    return mRing != nullptr;
+}
+
+bool PacketSocket::Send(std::string_view aData)
+{
+    return Queue(aData) && Flush();
+}
@@ -10,7 +10,12 @@ Parameter80211Reader::Parameter80211Reader(std::shared_ptr<RadioTapReader> aPhys
     mPhysicalDeviceHeaderReader(std::move(aPhysicalDeviceHeaderReader))
 {}
 
-uint8_t Parameter80211Reader::GetFrequency() const
+uint8_t Parameter80211Reader::GetChannel() const
+{
+    return mChannel;
+}
+
+uint16_t Parameter80211Reader::GetFrequency() const
 {
     return mFrequency;
 }
@@ -35,8 +40,10 @@ void Parameter80211Reader::Update(std::string_view aData)
     mLastReceivedPacket = aData;
 
     // Re-obtain this
-    mMaxRate = 0;
-    mIsAdhoc = false;
+    mChannel   = 0;
+    mFrequency = 0;
+    mMaxRate   = 0;
+    mIsAdhoc   = false;
 
     // If there is an FCS remove 4 bytes from total length
     unsigned int lFCSLength =
@@ -56,31 +63,30 @@ void Parameter80211Reader::Update(std::string_view aData)
     uint8_t lParameterLength{UpdateSSID(lIndex)};
     lIndex++;
 
-    if (lParameterLength > 0) {
-        // Then go fill out all the others, always adding +1 to skip past the type info
-        lIndex = lIndex + lParameterLength + 1;
-        while (lIndex < (aData.length()) - lFCSLength) {
-            auto lParameterType = GetRawData<uint8_t>(aData, lIndex);
-            switch (lParameterType) {
-                case Net_80211_Constants::cFixedParameterTypeSupportedRates:
-                    lIndex += UpdateMaxRate(lIndex + 1) + 2;
-                    break;
-                case Net_80211_Constants::cFixedParameterTypeDSParameterSet:
-                    lIndex += UpdateChannelInfo(lIndex + 1) + 2;
-                    break;
-                case Net_80211_Constants::cFixedParameterTypeExtendedRates:
-                    lIndex += UpdateMaxRate(lIndex + 1) + 2;
-                    break;
-                case Net_80211_Constants::cFixedParameterTypeIBSS:
-                    lIndex += UpdateIsAdhoc(lIndex + 1) + 2;
-                    break;
-                default:
-                    // Skip past unsupported parameters
-                    // Skip past type, always add at least one so this loop never becomes an infinite one
-                    lIndex += 1;
-                    lIndex += GetRawData<uint8_t>(aData, lIndex) + 1;
-                    break;
-            }
+    // Then go fill out all the others, starting at the type info right after the SSID. Hidden networks have an empty
+    // SSID, the other parameters are there all the same.
+    lIndex = lIndex + lParameterLength;
+    while (lIndex < (aData.length()) - lFCSLength) {
+        auto lParameterType = GetRawData<uint8_t>(aData, lIndex);
+        switch (lParameterType) {
+            case Net_80211_Constants::cFixedParameterTypeSupportedRates:
+                lIndex += UpdateMaxRate(lIndex + 1) + 2;
+                break;
+            case Net_80211_Constants::cFixedParameterTypeDSParameterSet:
+                lIndex += UpdateChannelInfo(lIndex + 1) + 2;
+                break;
+            case Net_80211_Constants::cFixedParameterTypeExtendedRates:
+                lIndex += UpdateMaxRate(lIndex + 1) + 2;
+                break;
+            case Net_80211_Constants::cFixedParameterTypeIBSS:
+                lIndex += UpdateIsAdhoc(lIndex + 1) + 2;
+                break;
+            default:
+                // Skip past unsupported parameters
+                // Skip past type, always add at least one so this loop never becomes an infinite one
+                lIndex += 1;
+                lIndex += GetRawData<uint8_t>(aData, lIndex) + 1;
+                break;
         }
     }
 }
@@ -90,7 +96,10 @@ uint8_t Parameter80211Reader::UpdateChannelInfo(uint16_t aIndex)
     // Don't need to know the size for channel, so just grab the channel immediately
     auto lChannel = GetRawData<uint8_t>(mLastReceivedPacket, aIndex + 1);
 
-    mFrequency = ConvertChannelToFrequency(lChannel);
+    // Channels outside of 2.4GHz are not converted, keep 0 for those instead of -1.
+    int lFrequency{ConvertChannelToFrequency(lChannel)};
+    mChannel   = lChannel;
+    mFrequency = lFrequency > 0 ? static_cast<uint16_t>(lFrequency) : 0;
 
     return 1;
 }
@@ -122,13 +131,15 @@ uint8_t Parameter80211Reader::UpdateSSID(uint16_t aIndex)
 {
     uint8_t lSSIDLength{0};
     lSSIDLength = GetRawData<uint8_t>(mLastReceivedPacket, aIndex);
-    mSSID       = GetRawString(mLastReceivedPacket, aIndex + 1, lSSIDLength);
+    // Assigning in place keeps the buffer of the previous SSID, a new string would be allocated every beacon.
+    mSSID.assign(mLastReceivedPacket.data() + aIndex + 1, lSSIDLength);
 
     return lSSIDLength;
 }
 
 void Parameter80211Reader::Reset()
 {
+    mChannel   = 0;
     mFrequency = 0;
     mMaxRate   = 0;
     mSSID      = "";
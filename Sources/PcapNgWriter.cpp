@@ -0,0 +1,126 @@
+#include "../Includes/PcapNgWriter.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - PcapNgWriter.cpp */
+
+#include "../Includes/Logger.h"
+
+using namespace PcapNgWriter_Constants;
+
+namespace
+{
+    template<typename Type> void AppendRaw(std::string& aBody, Type aValue)
+    {
+        aBody.append(reinterpret_cast<const char*>(&aValue), sizeof(aValue));
+    }
+
+    void PadToFourBytes(std::string& aBody)
+    {
+        aBody.append((4 - (aBody.size() % 4)) % 4, '\0');
+    }
+}  // namespace
+
+PcapNgWriter::~PcapNgWriter()
+{
+    Close();
+}
+
+bool PcapNgWriter::Open(std::string_view aPath)
+{
+    bool lReturn{false};
+
+    Close();
+    mInterfaceCount = 0;
+    mFile.open(std::string(aPath), std::ios::binary | std::ios::trunc);
+
+    if (mFile.is_open() && mFile.good()) {
+        std::string lBody{};
+        AppendRaw<uint32_t>(lBody, cByteOrderMagic);
+        AppendRaw<uint16_t>(lBody, 1);  // Major version
+        AppendRaw<uint16_t>(lBody, 0);  // Minor version
+        AppendRaw<int64_t>(lBody, -1);  // Section length, unknown
+        lReturn = WriteBlock(cSectionHeaderBlockType, lBody);
+    } else {
+        Logger::GetInstance().Log("Could not open pcapng file: " + std::string(aPath), Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
+
+void PcapNgWriter::Close()
+{
+    if (mFile.is_open()) {
+        mFile.close();
+    }
+}
+
+bool PcapNgWriter::IsOpen() const
+{
+    return mFile.is_open() && mFile.good();
+}
+
+uint32_t PcapNgWriter::AddInterface(uint16_t aLinkType, uint32_t aSnapshotLength)
+{
+    std::string lBody{};
+    AppendRaw<uint16_t>(lBody, aLinkType);
+    AppendRaw<uint16_t>(lBody, 0);  // Reserved
+    AppendRaw<uint32_t>(lBody, aSnapshotLength);
+    AppendOption(lBody,
+                 cOptionTimestampResolution,
+                 std::string_view(reinterpret_cast<const char*>(&cTimestampResolutionNanoseconds), 1));
+    AppendOption(lBody, cOptionEndOfOptions, "");
+
+    WriteBlock(cInterfaceDescriptionBlockType, lBody);
+
+    return mInterfaceCount++;
+}
+
+bool PcapNgWriter::WritePacket(uint32_t                 aInterface,
+                               std::chrono::nanoseconds aTimestamp,
+                               std::string_view         aData,
+                               uint32_t                 aOriginalLength,
+                               std::string_view         aComment)
+{
+    auto lTimestamp{static_cast<uint64_t>(aTimestamp.count())};
+
+    std::string lBody{};
+    lBody.reserve(aData.size() + aComment.size() + 32);
+    AppendRaw<uint32_t>(lBody, aInterface);
+    AppendRaw<uint32_t>(lBody, static_cast<uint32_t>(lTimestamp >> 32U));
+    AppendRaw<uint32_t>(lBody, static_cast<uint32_t>(lTimestamp & 0xFFFFFFFFU));
+    AppendRaw<uint32_t>(lBody, static_cast<uint32_t>(aData.size()));
+    AppendRaw<uint32_t>(lBody, (aOriginalLength != 0) ? aOriginalLength : static_cast<uint32_t>(aData.size()));
+    lBody.append(aData);
+    PadToFourBytes(lBody);
+
+    if (!aComment.empty()) {
+        AppendOption(lBody, cOptionComment, aComment);
+        AppendOption(lBody, cOptionEndOfOptions, "");
+    }
+
+    return WriteBlock(cEnhancedPacketBlockType, lBody);
+}
+
+void PcapNgWriter::AppendOption(std::string& aBody, uint16_t aCode, std::string_view aValue)
+{
+    AppendRaw<uint16_t>(aBody, aCode);
+    AppendRaw<uint16_t>(aBody, static_cast<uint16_t>(aValue.size()));
+    aBody.append(aValue);
+    PadToFourBytes(aBody);
+}
+
+bool PcapNgWriter::WriteBlock(uint32_t aType, std::string_view aBody)
+{
+    bool lReturn{false};
+
+    if (IsOpen()) {
+        // Type, length, body, length again; the body is always padded to 32 bits.
+        auto lLength{static_cast<uint32_t>(aBody.size() + 3 * sizeof(uint32_t))};
+        mFile.write(reinterpret_cast<const char*>(&aType), sizeof(aType));
+        mFile.write(reinterpret_cast<const char*>(&lLength), sizeof(lLength));
+        mFile.write(aBody.data(), static_cast<std::streamsize>(aBody.size()));
+        mFile.write(reinterpret_cast<const char*>(&lLength), sizeof(lLength));
+        lReturn = mFile.good();
+    }
+
+    return lReturn;
+}
@@ -76,7 +76,8 @@ void RadioTapReader::FillRadioTapParameters(std::string_view aData)
             lIndex += sizeof(uint16_t);
         }
         if ((mParameters.mPresentFlags & (1U << 5U)) != 0) {
-            // Antenna signal, Don't care skip over it
+            // Antenna signal, used to tell how well networks are received
+            mAntennaSignal = GetRawData<int8_t>(aData, lIndex);
             lIndex += sizeof(int8_t);
         }
         if ((mParameters.mPresentFlags & (1U << 6U)) != 0) {
@@ -162,6 +163,11 @@ void RadioTapReader::FillRadioTapParameters(std::string_view aData)
     }
 }
 
+int8_t RadioTapReader::GetAntennaSignal() const
+{
+    return mAntennaSignal;
+}
+
 uint16_t RadioTapReader::GetLength() const
 {
     return mParameters.mLength;
@@ -218,4 +224,5 @@ void RadioTapReader::Reset()
     mParameters.mMCSFlags     = 0;
     mParameters.mKnownMCSInfo = 0;
     mParameters.mMCSInfo      = 0;
+    mAntennaSignal            = 0;
 }
@@ -0,0 +1,21 @@
+#include "../Includes/SystemClock.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - SystemClock.cpp */
+
+#include <thread>
+
+using namespace std::chrono;
+
+steady_clock::time_point SystemClock::Now()
+{
+    return steady_clock::now();
+}
+
+void SystemClock::SleepUntil(steady_clock::time_point aDeadline)
+{
+    if (aDeadline - steady_clock::now() > cSpinThreshold) {
+        std::this_thread::sleep_until(aDeadline - cSpinThreshold);
+    }
+
+    while (steady_clock::now() < aDeadline) {}
+}
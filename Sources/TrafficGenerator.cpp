@@ -0,0 +1,443 @@
+#include "../Includes/TrafficGenerator.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - TrafficGenerator.cpp */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    // Sony Computer Entertainment OUI, used for PSP and Vita MAC addresses.
+    constexpr uint64_t     cSonyOUI{0xc51900};
+    constexpr uint64_t     cMACMask{(1ULL << 48U) - 1};
+    constexpr unsigned int cForeignClients{4};
+    constexpr uint16_t     cIPv4EtherType{0x0008};
+
+    constexpr uint8_t  cToDSFlag{0x01};
+    constexpr uint8_t  cQoSDataType{0x88};
+    constexpr uint8_t  cQoSNullType{0xc8};
+    constexpr uint16_t cIBSSCapabilities{0x0022};
+    constexpr uint16_t cESSCapabilities{0x0431};
+
+    // Present flags and header lengths of the radiotap layouts, see the radiotap specification for the alignment.
+    constexpr uint32_t cTSFTPresentFlags{0x0000402f};
+    constexpr uint16_t cTSFTLength{26};
+    constexpr uint32_t cMCSPresentFlags{0x0008402a};
+    constexpr uint16_t cMCSLength{21};
+    constexpr uint32_t cExtendedPresentFlags{0xa000402f};
+    constexpr uint32_t cSecondPresentFlags{0x00000820};
+    constexpr uint16_t cExtendedLength{36};
+
+    template<typename Type> void Append(std::string& aData, Type aValue)
+    {
+        aData.append(reinterpret_cast<const char*>(&aValue), sizeof(aValue));
+    }
+
+    void AppendMAC(std::string& aData, uint64_t aMAC)
+    {
+        aData.append(reinterpret_cast<const char*>(&aMAC), Net_80211_Constants::cSourceAddressLength);
+    }
+
+    void AppendTag(std::string& aData, uint8_t aType, std::string_view aValue)
+    {
+        aData += static_cast<char>(aType);
+        aData += static_cast<char>(aValue.size());
+        aData.append(aValue);
+    }
+
+    // Orders the pending frames as a min-heap on their timestamp.
+    bool IsLater(const GeneratedFrame& aFirst, const GeneratedFrame& aSecond)
+    {
+        return aFirst.mTimestamp > aSecond.mTimestamp;
+    }
+
+    uint32_t Crc32(std::string_view aData)
+    {
+        uint32_t lCrc{0xffffffff};
+        for (char lByte : aData) {
+            lCrc ^= static_cast<uint8_t>(lByte);
+            for (unsigned int lBit = 0; lBit < 8; lBit++) {
+                lCrc = (lCrc >> 1U) ^ (0xedb88320U & (0U - (lCrc & 1U)));
+            }
+        }
+        return ~lCrc;
+    }
+}  // namespace
+
+TrafficGenerator::TrafficGenerator(const TrafficMix& aMix) : mMix(aMix), mRandom(aMix.mSeed)
+{
+    unsigned int lAdhocNetworks{mMix.mPSPNetworks + mMix.mVitaNetworks};
+    unsigned int lNetworkCount{lAdhocNetworks + mMix.mForeignNetworks};
+
+    for (unsigned int lIndex = 0; lIndex < lNetworkCount; lIndex++) {
+        Network              lNetwork{};
+        std::array<char, 33> lSSID{};
+
+        // SSIDs have a fixed length, so none of them can match the SSID filter of another.
+        if (lIndex < mMix.mPSPNetworks) {
+            snprintf(lSSID.data(), lSSID.size(), "PSP_AULJM%05u_L_%08X", 5000 + lIndex, Uniform(0, UINT32_MAX));
+        } else if (lIndex < lAdhocNetworks) {
+            snprintf(lSSID.data(), lSSID.size(), "SCE_PCSB%05u_%08X", lIndex, Uniform(0, UINT32_MAX));
+        } else {
+            snprintf(lSSID.data(), lSSID.size(), "Foreign-%03u-%04X", lIndex, Uniform(0, UINT16_MAX));
+        }
+        lNetwork.mSSID   = lSSID.data();
+        lNetwork.mAdhoc  = (lIndex < lAdhocNetworks);
+        lNetwork.mTarget = (lIndex == 0) && (mMix.mPSPNetworks > 0);
+
+        // Ad-hoc networks have a random, locally administered BSSID, access points use the MAC of their vendor.
+        uint64_t lRandomMAC{(static_cast<uint64_t>(mRandom()) << 16U) ^ mRandom()};
+        lNetwork.mBSSID = lNetwork.mAdhoc ? ((lRandomMAC & ~1ULL) | 2ULL) & cMACMask : (lRandomMAC << 8U) & cMACMask;
+
+        lNetwork.mFirstStation = mStations.size();
+        lNetwork.mStationCount = lNetwork.mAdhoc ? mMix.mStationsPerNetwork : cForeignClients;
+        for (unsigned int lStation = 0; lStation < lNetwork.mStationCount; lStation++) {
+            uint64_t lRandomPart{static_cast<uint64_t>(mRandom()) << 16U};
+            Station  lNewStation{};
+            lNewStation.mNetwork = lIndex;
+            lNewStation.mMAC     = (lNetwork.mAdhoc ? cSonyOUI | (lRandomPart << 8U) : lRandomPart) & cMACMask;
+            lNewStation.mLayout  = RadioTapLayout::TSFT;
+            if (mMix.mVariedRadioTap) {
+                lNewStation.mLayout = static_cast<RadioTapLayout>(Uniform(0, cRadioTapLayoutCount - 1));
+            }
+            lNewStation.mTypicalPayload = Uniform(mMix.mMinimumPayload, mMix.mMaximumPayload);
+            mStations.push_back(lNewStation);
+        }
+        mNetworks.push_back(lNetwork);
+
+        // Every network beacons within the first beacon interval, its stations only start after the first beacon so
+        // the program has a chance to lock on.
+        nanoseconds lFirstBeacon{microseconds(Uniform(0, cBeaconInterval.count() - 1))};
+        mSources.push_back({lFirstBeacon, lIndex, -1});
+        for (unsigned int lStation = 0; lStation < lNetwork.mStationCount; lStation++) {
+            nanoseconds lFirstFrame{lFirstBeacon + microseconds(Uniform(1000, cBeaconInterval.count()))};
+            mSources.push_back({lFirstFrame, lIndex, static_cast<int>(lNetwork.mFirstStation + lStation)});
+        }
+    }
+}
+
+GeneratedFrame TrafficGenerator::Next()
+{
+    GeneratedFrame lReturn{};
+
+    auto lSource{std::min_element(mSources.begin(), mSources.end(), [](const Source& aFirst, const Source& aSecond) {
+        return aFirst.mNextTime < aSecond.mNextTime;
+    })};
+    // Sources keep their time relative to the start of the traffic, frames carry the capture time.
+    if (!mPending.empty() &&
+        ((lSource == mSources.end()) || (mPending.front().mTimestamp <= cStartTime + lSource->mNextTime))) {
+        // Retries and acknowledgements that were scheduled earlier.
+        std::pop_heap(mPending.begin(), mPending.end(), IsLater);
+        lReturn = std::move(mPending.back());
+        mPending.pop_back();
+    } else if (lSource != mSources.end()) {
+        if (lSource->mStation < 0) {
+            lReturn = MakeBeacon(mNetworks.at(lSource->mNetwork), lSource->mNextTime);
+        } else {
+            lReturn = MakeData(mStations.at(lSource->mStation), lSource->mNextTime);
+        }
+        Schedule(*lSource);
+    }
+
+    return lReturn;
+}
+
+std::vector<GeneratedFrame> TrafficGenerator::Generate(nanoseconds aDuration)
+{
+    std::vector<GeneratedFrame> lReturn{};
+
+    GeneratedFrame lFrame{Next()};
+    while (!lFrame.mData.empty() && (lFrame.mTimestamp < cStartTime + aDuration)) {
+        lReturn.push_back(std::move(lFrame));
+        lFrame = Next();
+    }
+
+    return lReturn;
+}
+
+std::string_view TrafficGenerator::GetSSID(unsigned int aNetwork) const
+{
+    return mNetworks.at(aNetwork).mSSID;
+}
+
+uint64_t TrafficGenerator::GetBSSID(unsigned int aNetwork) const
+{
+    return mNetworks.at(aNetwork).mBSSID;
+}
+
+std::string TrafficGenerator::ToKaiDatagram(std::string_view aEthernet)
+{
+    return cEthernetDataString + std::string(aEthernet);
+}
+
+void TrafficGenerator::AddRadioTapHeader(std::string& aFrame, RadioTapLayout aLayout, bool aFCS)
+{
+    uint8_t  lFlags{static_cast<uint8_t>(aFCS ? RadioTap_Constants::cFCSAvailableFlag : 0)};
+    int8_t   lSignal{static_cast<int8_t>(-30 - static_cast<int>(Uniform(0, 60)))};
+    uint64_t lTSFT{mRandom()};
+
+    Append<uint8_t>(aFrame, 0);
+    Append<uint8_t>(aFrame, 0);
+    switch (aLayout) {
+        case RadioTapLayout::Injection:
+            Append<uint16_t>(aFrame, RadioTap_Constants::cRadioTapSize);
+            Append<uint32_t>(aFrame, RadioTap_Constants::cSendPresentFlags);
+            Append<uint8_t>(aFrame, lFlags);
+            Append<uint8_t>(aFrame, RadioTap_Constants::cRateFlags);
+            Append<uint16_t>(aFrame, cFrequency);
+            Append<uint16_t>(aFrame, RadioTap_Constants::cChannelFlags);
+            Append<uint16_t>(aFrame, RadioTap_Constants::cTXFlags);
+            break;
+        case RadioTapLayout::TSFT:
+        case RadioTapLayout::ExtendedBitmap:
+            Append<uint16_t>(aFrame, (aLayout == RadioTapLayout::TSFT) ? cTSFTLength : cExtendedLength);
+            if (aLayout == RadioTapLayout::TSFT) {
+                Append<uint32_t>(aFrame, cTSFTPresentFlags);
+            } else {
+                Append<uint32_t>(aFrame, cExtendedPresentFlags);
+                Append<uint32_t>(aFrame, cSecondPresentFlags);
+                Append<uint32_t>(aFrame, 0);
+            }
+            Append<uint64_t>(aFrame, lTSFT);
+            Append<uint8_t>(aFrame, lFlags);
+            Append<uint8_t>(aFrame, RadioTap_Constants::cRateFlags);
+            Append<uint16_t>(aFrame, cFrequency);
+            Append<uint16_t>(aFrame, RadioTap_Constants::cChannelFlags);
+            Append<int8_t>(aFrame, lSignal);
+            Append<uint8_t>(aFrame, 0);
+            Append<uint16_t>(aFrame, 0);
+            if (aLayout == RadioTapLayout::ExtendedBitmap) {
+                // Per antenna signal and antenna index from the second bitmap.
+                Append<int8_t>(aFrame, lSignal);
+                Append<uint8_t>(aFrame, 0);
+            }
+            break;
+        case RadioTapLayout::MCS:
+            Append<uint16_t>(aFrame, cMCSLength);
+            Append<uint32_t>(aFrame, cMCSPresentFlags);
+            Append<uint8_t>(aFrame, lFlags);
+            Append<uint8_t>(aFrame, 0);
+            Append<uint16_t>(aFrame, cFrequency);
+            Append<uint16_t>(aFrame, RadioTap_Constants::cChannelFlags);
+            Append<int8_t>(aFrame, lSignal);
+            Append<uint8_t>(aFrame, 0);
+            Append<uint16_t>(aFrame, 0);
+            // Known bandwidth, guard interval and MCS index, 20MHz long guard interval MCS 7.
+            Append<uint8_t>(aFrame, 0x07);
+            Append<uint8_t>(aFrame, 0x00);
+            Append<uint8_t>(aFrame, 0x07);
+            break;
+        default:
+            break;
+    }
+}
+
+void TrafficGenerator::AddFCS(std::string& aFrame, std::size_t aStart)
+{
+    Append<uint32_t>(aFrame, Crc32(std::string_view(aFrame).substr(aStart)));
+}
+
+GeneratedFrame TrafficGenerator::MakeBeacon(const Network& aNetwork, nanoseconds aTime)
+{
+    GeneratedFrame lReturn{};
+    lReturn.mTimestamp = cStartTime + aTime;
+    lReturn.mType      = FrameType::Beacon;
+
+    // In an ad-hoc network the beaconing is done by one of the stations.
+    uint64_t       lTransmitter{aNetwork.mBSSID};
+    RadioTapLayout lLayout{RadioTapLayout::TSFT};
+    if (aNetwork.mAdhoc && (aNetwork.mStationCount > 0)) {
+        lTransmitter = mStations.at(aNetwork.mFirstStation).mMAC;
+        lLayout      = mStations.at(aNetwork.mFirstStation).mLayout;
+    }
+
+    bool lFCS{Chance(mMix.mFCSRatio)};
+    AddRadioTapHeader(lReturn.mData, lLayout, lFCS);
+    std::size_t lStart{lReturn.mData.size()};
+
+    ieee80211_hdr lHeader{};
+    lHeader.frame_control = Net_80211_Constants::cBeaconType;
+    memcpy(&lHeader.addr1[0], &Net_Constants::cBroadcastMac, Net_80211_Constants::cDestinationAddressLength);
+    memcpy(&lHeader.addr2[0], &lTransmitter, Net_80211_Constants::cSourceAddressLength);
+    memcpy(&lHeader.addr3[0], &aNetwork.mBSSID, Net_80211_Constants::cBSSIDLength);
+    Append(lReturn.mData, lHeader);
+
+    Append<uint64_t>(lReturn.mData, duration_cast<microseconds>(aTime).count());
+    Append<uint16_t>(lReturn.mData, cBeaconInterval.count() / 1024);
+    Append<uint16_t>(lReturn.mData, aNetwork.mAdhoc ? cIBSSCapabilities : cESSCapabilities);
+
+    AppendTag(lReturn.mData, 0, aNetwork.mSSID);
+    AppendTag(lReturn.mData, Net_80211_Constants::cFixedParameterTypeSupportedRates, "\x82\x84\x8b\x96");
+    AppendTag(lReturn.mData, Net_80211_Constants::cFixedParameterTypeDSParameterSet, "\x06");
+    if (aNetwork.mAdhoc) {
+        AppendTag(lReturn.mData, Net_80211_Constants::cFixedParameterTypeIBSS, std::string(2, '\0'));
+    } else {
+        AppendTag(lReturn.mData, 5, std::string("\x00\x01\x00\x00", 4));
+        AppendTag(lReturn.mData, 42, std::string(1, '\0'));
+        AppendTag(
+            lReturn.mData, Net_80211_Constants::cFixedParameterTypeExtendedRates, "\x0c\x12\x18\x24\x30\x48\x60\x6c");
+    }
+
+    if (lFCS) {
+        AddFCS(lReturn.mData, lStart);
+    }
+
+    return lReturn;
+}
+
+GeneratedFrame TrafficGenerator::MakeData(Station& aStation, nanoseconds aTime)
+{
+    GeneratedFrame lReturn{};
+    lReturn.mTimestamp = cStartTime + aTime;
+
+    const Network& lNetwork{mNetworks.at(aStation.mNetwork)};
+
+    // Game traffic goes to everyone or to one of the other players, foreign clients talk to the internet.
+    uint64_t lDestination{Net_Constants::cBroadcastMac};
+    uint16_t lEtherType{Net_Constants::cPSPEtherType};
+    uint16_t lPayloadLength{aStation.mTypicalPayload};
+    if (lNetwork.mAdhoc) {
+        if ((lNetwork.mStationCount > 1) && Chance(0.5)) {
+            // Any station in the network except for this one.
+            auto         lSelf{static_cast<unsigned int>(&aStation - mStations.data())};
+            unsigned int lPeer{lNetwork.mFirstStation + Uniform(0, lNetwork.mStationCount - 2)};
+            lPeer += (lPeer >= lSelf) ? 1 : 0;
+            lDestination = mStations.at(lPeer).mMAC;
+        }
+        // Games send roughly the same amount of state every frame.
+        lPayloadLength = std::clamp<uint16_t>(Uniform(lPayloadLength * 9 / 10, lPayloadLength * 11 / 10),
+                                              mMix.mMinimumPayload,
+                                              mMix.mMaximumPayload);
+    } else {
+        lDestination   = (static_cast<uint64_t>(mRandom()) << 16U) & cMACMask;
+        lEtherType     = cIPv4EtherType;
+        lPayloadLength = Chance(0.6) ? Uniform(40, 128) : Uniform(1000, 1500);
+    }
+
+    bool lQoS{Chance(mMix.mQoSRatio)};
+    bool lNull{Chance(mMix.mNullRatio)};
+    if (lNull) {
+        lReturn.mType = lQoS ? FrameType::QoSNull : FrameType::Null;
+    } else {
+        lReturn.mType = lQoS ? FrameType::QoSData : FrameType::Data;
+    }
+
+    bool lFCS{Chance(mMix.mFCSRatio)};
+    AddRadioTapHeader(lReturn.mData, aStation.mLayout, lFCS);
+    std::size_t lStart{lReturn.mData.size()};
+
+    ieee80211_hdr lHeader{};
+    uint8_t       lType{Net_80211_Constants::cDataType};
+    if (lNull) {
+        lType = lQoS ? cQoSNullType : Net_80211_Constants::cDataNullFuncType;
+    } else if (lQoS) {
+        lType = cQoSDataType;
+    }
+    lHeader.frame_control = lType;
+    lHeader.seq_ctrl      = static_cast<uint16_t>(aStation.mSequence++ << 4U);
+    if (lNetwork.mAdhoc) {
+        memcpy(&lHeader.addr1[0], &lDestination, Net_80211_Constants::cDestinationAddressLength);
+        memcpy(&lHeader.addr2[0], &aStation.mMAC, Net_80211_Constants::cSourceAddressLength);
+        memcpy(&lHeader.addr3[0], &lNetwork.mBSSID, Net_80211_Constants::cBSSIDLength);
+    } else {
+        lHeader.frame_control |= static_cast<uint16_t>(cToDSFlag << 8U);
+        memcpy(&lHeader.addr1[0], &lNetwork.mBSSID, Net_80211_Constants::cBSSIDLength);
+        memcpy(&lHeader.addr2[0], &aStation.mMAC, Net_80211_Constants::cSourceAddressLength);
+        memcpy(&lHeader.addr3[0], &lDestination, Net_80211_Constants::cDestinationAddressLength);
+    }
+    Append(lReturn.mData, lHeader);
+
+    if (lQoS) {
+        Append<uint16_t>(lReturn.mData, 0);
+    }
+
+    std::string lPayload{};
+    if (!lNull) {
+        Append(lReturn.mData, Net_80211_Constants::cSnapLLC);
+        lReturn.mData.resize(lReturn.mData.size() - sizeof(lEtherType));
+        Append(lReturn.mData, lEtherType);
+
+        lPayload.resize(lPayloadLength);
+        for (char& lByte : lPayload) {
+            lByte = static_cast<char>(mRandom());
+        }
+        lReturn.mData.append(lPayload);
+    }
+
+    if (lFCS) {
+        AddFCS(lReturn.mData, lStart);
+    }
+
+    // What the program should send to XLink Kai when locked on this network.
+    if (lNetwork.mTarget && !lNull) {
+        AppendMAC(lReturn.mEthernet, lDestination);
+        AppendMAC(lReturn.mEthernet, aStation.mMAC);
+        Append(lReturn.mEthernet, lEtherType);
+        lReturn.mEthernet.append(lPayload);
+    }
+
+    // Unicast frames get acknowledged, or retried when the acknowledgement got lost.
+    bool lUnicast{lNetwork.mAdhoc ? (lDestination != Net_Constants::cBroadcastMac) : true};
+    if (lUnicast && Chance(mMix.mRetryRatio)) {
+        GeneratedFrame lRetry{lReturn.mTimestamp + cRetryDelay, lReturn.mType, lReturn.mData, ""};
+        lRetry.mData.at(lStart + 1) |= static_cast<char>(Net_80211_Constants::cDataRetryFlag);
+        if (lFCS) {
+            lRetry.mData.resize(lRetry.mData.size() - Net_80211_Constants::cFCSLength);
+            AddFCS(lRetry.mData, lStart);
+        }
+        mPending.push_back(std::move(lRetry));
+        std::push_heap(mPending.begin(), mPending.end(), IsLater);
+    } else if (lUnicast && Chance(mMix.mAcknowledgementRatio)) {
+        GeneratedFrame lAcknowledgement{lReturn.mTimestamp + cAcknowledgementDelay, FrameType::Acknowledgement};
+        bool           lAcknowledgementFCS{Chance(mMix.mFCSRatio)};
+        AddRadioTapHeader(lAcknowledgement.mData, aStation.mLayout, lAcknowledgementFCS);
+        std::size_t lAcknowledgementStart{lAcknowledgement.mData.size()};
+
+        AcknowledgementHeader lAcknowledgementHeader{};
+        lAcknowledgementHeader.frame_control = Net_80211_Constants::cAcknowledgementType;
+        memcpy(&lAcknowledgementHeader.recv_address[0], &aStation.mMAC, Net_80211_Constants::cSourceAddressLength);
+        Append(lAcknowledgement.mData, lAcknowledgementHeader);
+        if (lAcknowledgementFCS) {
+            AddFCS(lAcknowledgement.mData, lAcknowledgementStart);
+        }
+
+        mPending.push_back(std::move(lAcknowledgement));
+        std::push_heap(mPending.begin(), mPending.end(), IsLater);
+    }
+
+    return lReturn;
+}
+
+void TrafficGenerator::Schedule(Source& aSource)
+{
+    if (aSource.mStation < 0) {
+        aSource.mNextTime += cBeaconInterval;
+    } else if (mNetworks.at(aSource.mNetwork).mAdhoc) {
+        // Up to 25% jitter around the game frame interval.
+        aSource.mNextTime += cGameFrameInterval * Uniform(75, 125) / 100;
+    } else {
+        // Foreign traffic arrives randomly, so the time between frames is exponentially distributed.
+        double lRate{std::max(mMix.mForeignFrameRate / cForeignClients, 0.001)};
+        double lUniform{(static_cast<double>(mRandom()) + 1.0) / 4294967296.0};
+        aSource.mNextTime += nanoseconds(static_cast<int64_t>(-std::log(lUniform) / lRate * 1e9));
+    }
+}
+
+bool TrafficGenerator::Chance(double aRatio)
+{
+    return static_cast<double>(mRandom()) < aRatio * 4294967296.0;
+}
+
+uint32_t TrafficGenerator::Uniform(uint32_t aMinimum, uint32_t aMaximum)
+{
+    // Not std::uniform_int_distribution, its output differs between standard libraries.
+    uint64_t lRange{static_cast<uint64_t>(aMaximum) - aMinimum + 1};
+    return aMinimum + static_cast<uint32_t>(mRandom() % lRange);
+}
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <utility>
 
+#include "../../Includes/UserInterface/Button.h"
 #include "../../Includes/UserInterface/CheckBox.h"
 #include "../../Includes/UserInterface/TextField.h"
 
@@ -44,6 +45,11 @@ Dimensions ScaleSearchTakeHintsXLinkKai(const int& /*aMaxHeight*/, const int& /*
     return {8, 2, 0, 0};
 }
 
+Dimensions ScaleSearchNetworks(const int& /*aMaxHeight*/, const int& /*aMaxWidth*/)
+{
+    return {9, 2, 0, 0};
+}
+
 NetworkingWindow::NetworkingWindow(WindowModel&                       aModel,
                                    std::string_view                   aTitle,
                                    const std::function<Dimensions()>& aCalculation) :
@@ -105,6 +111,15 @@ void NetworkingWindow::SetUp()
         true,
         std::vector<char>{':'}));
 
+    AddObject(std::make_shared<Button>(
+        *this,
+        cSearchNetworks,
+        [&] { return ScaleSearchNetworks(GetHeightReference(), GetWidthReference()); },
+        [&] {
+            GetModel().mCommand = WindowModel_Constants::Command::StartSearchNetworks;
+            return true;
+        }));
+
     // TODO: Add when XLink Kai adds it
     //    AddObject(std::make_shared<CheckBox>(
     //        *this,
@@ -121,6 +136,7 @@ void NetworkingWindow::Draw()
     GetObjects().at(3)->SetVisible(!lPSPPluginCheckBox->IsChecked());
     GetObjects().at(4)->SetVisible(!lPSPPluginCheckBox->IsChecked());
     GetObjects().at(5)->SetVisible(!lPSPPluginCheckBox->IsChecked());
+    GetObjects().at(6)->SetVisible(!lPSPPluginCheckBox->IsChecked());
 
     Window::Draw();
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "../../Includes/UserInterface/SSIDSelectionWindow.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "../../Includes/NetConversionFunctions.h"
+#include "../../Includes/UserInterface/Button.h"
+#include "../../Includes/UserInterface/String.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - SSIDSelectionWindow.cpp */
+
+using namespace std::chrono;
+
+namespace
+{
+    Dimensions ScaleNetworkLine(const int& /*aMaxHeight*/, const int& /*aMaxWidth*/, int aLine)
+    {
+        return {2 + aLine, 2, 0, 0};
+    }
+
+    Dimensions ScaleCloseButton(const int& aMaxHeight, const int& aMaxWidth)
+    {
+        return {aMaxHeight - 2, static_cast<int>(aMaxWidth - 5 - cCloseMessage.length()), 0, 0};
+    }
+
+    std::string FormatNetwork(const DiscoveredNetwork& aNetwork)
+    {
+        std::stringstream lStream{};
+        lStream << std::left << std::setw(19) << IntToMac(aNetwork.mBSSID) << std::setw(4)
+                << static_cast<int>(aNetwork.mChannel);
+
+        // Rates are in units of 500 kbps, the highest bit marks basic rates.
+        lStream << std::setw(6) << static_cast<int>((aNetwork.mMaxRate & 0x7FU) / 2);
+
+        if (aNetwork.mSignal != 0) {
+            lStream << std::setw(9) << (std::to_string(aNetwork.mSignal) + " dBm");
+        } else {
+            lStream << std::setw(9) << "?";
+        }
+
+        lStream << std::setw(7) << (aNetwork.mIsAdhoc ? "Adhoc" : "AP") << aNetwork.mSSID;
+
+        return lStream.str();
+    }
+}  // namespace
+
+SSIDSelectionWindow::SSIDSelectionWindow(WindowModel&                       aModel,
+                                         std::string_view                   aTitle,
+                                         const std::function<Dimensions()>& aCalculation) :
+    Window(aModel, aTitle, aCalculation, true, true, false)
+{
+    SetUp();
+}
+
+void SSIDSelectionWindow::SetUp()
+{
+    Window::SetUp();
+
+    // Get size of window so scaling works properly.
+    GetSize();
+
+    // The header and one line per network.
+    for (int lCount = 0; lCount <= cShownNetworks; lCount++) {
+        AddObject(std::make_shared<String>(*this, "", [&, lCount] {
+            return ScaleNetworkLine(GetHeightReference(), GetWidthReference(), lCount);
+        }));
+    }
+
+    AddObject(std::make_shared<Button>(
+        *this,
+        cCloseMessage,
+        [&] { return ScaleCloseButton(GetHeightReference(), GetWidthReference()); },
+        [&] {
+            GetModel().mCommand = WindowModel_Constants::Command::StopSearchNetworks;
+            return true;
+        }));
+}
+
+void SSIDSelectionWindow::Draw()
+{
+    if (steady_clock::now() >= (mLastSample + cNetworksRefreshInterval)) {
+        Sample();
+    }
+
+    Window::Draw();
+}
+
+void SSIDSelectionWindow::Sample()
+{
+    std::vector<DiscoveredNetwork> lNetworks{GetModel().mNetworkTable->GetNetworks()};
+
+    SetLine(0, lNetworks.empty() ? cNoNetworksMessage : cNetworksHeader);
+
+    for (int lCount = 0; lCount < cShownNetworks; lCount++) {
+        // Lines that do not fit above the close button are not drawn.
+        GetObjects().at(lCount + 1)->SetVisible(ScaleNetworkLine(0, 0, lCount + 1).at(0) < GetHeightReference() - 2);
+
+        if (lCount < static_cast<int>(lNetworks.size())) {
+            SetLine(lCount + 1, FormatNetwork(lNetworks.at(lCount)));
+        } else {
+            SetLine(lCount + 1, "");
+        }
+    }
+
+    mLastSample = steady_clock::now();
+}
+
+void SSIDSelectionWindow::SetLine(int aLine, std::string_view aText)
+{
+    // Leave room for the border and the indentation.
+    std::size_t lWidth{static_cast<std::size_t>(std::max(GetWidthReference() - 3, 0))};
+    std::string lText{aText.substr(0, lWidth)};
+    lText.resize(lWidth, ' ');
+
+    GetObjects().at(static_cast<std::size_t>(aLine))->SetName(lText);
+}
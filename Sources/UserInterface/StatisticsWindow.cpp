@@ -0,0 +1,173 @@
+#include "../../Includes/UserInterface/StatisticsWindow.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "../../Includes/UserInterface/String.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - StatisticsWindow.cpp */
+
+using namespace std::chrono;
+
+namespace
+{
+    Dimensions ScaleStatisticsLine(const int& /*aMaxHeight*/, const int& /*aMaxWidth*/, Line aLine)
+    {
+        return {2 + static_cast<int>(aLine), 2, 0, 0};
+    }
+
+    // Shortens large numbers, for example 12345 to 12.3k.
+    std::string FormatValue(double aValue)
+    {
+        std::stringstream lStream{};
+        lStream << std::fixed << std::setprecision(1);
+
+        if (aValue >= 1000000.0) {
+            lStream << aValue / 1000000.0 << "M";
+        } else if (aValue >= 1000.0) {
+            lStream << aValue / 1000.0 << "k";
+        } else {
+            lStream << aValue;
+        }
+
+        return lStream.str();
+    }
+
+    std::string FormatMicroseconds(nanoseconds aValue)
+    {
+        return FormatValue(static_cast<double>(aValue.count()) / 1000.0);
+    }
+
+    void AddToHistory(std::deque<double>& aHistory, double aValue)
+    {
+        aHistory.push_back(aValue);
+        if (aHistory.size() > cHistoryLength) {
+            aHistory.pop_front();
+        }
+    }
+}  // namespace
+
+StatisticsWindow::StatisticsWindow(WindowModel&                       aModel,
+                                   std::string_view                   aTitle,
+                                   const std::function<Dimensions()>& aCalculation) :
+    Window(aModel, aTitle, aCalculation)
+{
+    SetUp();
+}
+
+void StatisticsWindow::SetUp()
+{
+    Window::SetUp();
+
+    // Get size of window so scaling works properly.
+    GetSize();
+
+    for (int lCount = 0; lCount < static_cast<int>(Line::Count); lCount++) {
+        AddObject(std::make_shared<String>(*this, "", [&, lCount] {
+            return ScaleStatisticsLine(GetHeightReference(), GetWidthReference(), static_cast<Line>(lCount));
+        }));
+    }
+
+    mLastSnapshot = Metrics::GetInstance().GetSnapshot();
+    mLastSample   = mLastSnapshot.mTime;
+}
+
+void StatisticsWindow::Draw()
+{
+    if (steady_clock::now() >= (mLastSample + cRefreshInterval)) {
+        Sample();
+    }
+
+    Window::Draw();
+}
+
+void StatisticsWindow::Sample()
+{
+    MetricsSnapshot lSnapshot{Metrics::GetInstance().GetSnapshot()};
+    double          lSeconds{duration<double>(lSnapshot.mTime - mLastSnapshot.mTime).count()};
+
+    if (lSeconds > 0) {
+        auto lRate = [&](Counter aCounter) {
+            return static_cast<double>(lSnapshot.Get(aCounter) - mLastSnapshot.Get(aCounter)) / lSeconds;
+        };
+
+        double lAirToKaiPackets{lRate(Counter::KaiFramesSent)};
+        double lKaiToAirPackets{lRate(Counter::KaiFramesReceived)};
+        AddToHistory(mAirToKaiHistory, lAirToKaiPackets);
+        AddToHistory(mKaiToAirHistory, lKaiToAirPackets);
+        AddToHistory(mKaiLinkHistory, static_cast<double>(lSnapshot.Get(Gauge::KaiLinkState)));
+
+        SetLine(Line::AirToKai,
+                std::string(cAirToKaiMessage) + FormatValue(lAirToKaiPackets) + " pkt/s, " +
+                    FormatValue(lRate(Counter::KaiBytesSent)) + "B/s");
+        SetLine(Line::AirToKaiHistory, ToSparkLine(mAirToKaiHistory));
+
+        // Measured where frames come in from XLink Kai, so the acknowledgements injected by us do not count.
+        SetLine(Line::KaiToAir,
+                std::string(cKaiToAirMessage) + FormatValue(lKaiToAirPackets) + " pkt/s, " +
+                    FormatValue(lRate(Counter::KaiBytesReceived)) + "B/s");
+        SetLine(Line::KaiToAirHistory, ToSparkLine(mKaiToAirHistory));
+
+        SetLine(Line::Drops,
+                std::string(cDropsMessage) + "BSSID " + FormatValue(lRate(Counter::DroppedBSSID)) + ", MAC " +
+                    FormatValue(lRate(Counter::DroppedMACFilter)) + ", SSID " +
+                    FormatValue(lRate(Counter::DroppedSSIDFilter)) + ", retry " +
+                    FormatValue(lRate(Counter::DroppedRetry)) + ", length " +
+                    FormatValue(lRate(Counter::DroppedInvalidLength)) + ", queue " +
+                    FormatValue(lRate(Counter::DroppedDeviceQueue)) + " pkt/s");
+
+        SetLine(Line::KernelDrops,
+                std::string(cKernelDropsMessage) + FormatValue(lRate(Counter::KernelDrops)) + ", interface " +
+                    FormatValue(lRate(Counter::InterfaceDrops)) + " pkt/s, buffer " +
+                    FormatValue(static_cast<double>(lSnapshot.Get(Gauge::CaptureBufferSize))) + "B" +
+                    ((lSnapshot.Get(Gauge::CaptureFilterTightened) != 0) ? ", filtered" : ""));
+
+        const HistogramSnapshot& lAckLatency{lSnapshot.Get(Histogram::AckLatency)};
+        SetLine(Line::AckLatency,
+                std::string(cAckLatencyMessage) + FormatMicroseconds(lAckLatency.GetPercentile(50)) + "/" +
+                    FormatMicroseconds(lAckLatency.GetPercentile(90)) + "/" +
+                    FormatMicroseconds(lAckLatency.GetPercentile(99)) + " us");
+
+        auto lKaiLinkState{static_cast<std::size_t>(
+            std::clamp<int64_t>(lSnapshot.Get(Gauge::KaiLinkState), 0, cKaiLinkStateTexts.size() - 1))};
+        SetLine(Line::KaiLink, std::string(cKaiLinkMessage) + cKaiLinkStateTexts.at(lKaiLinkState).data());
+        SetLine(Line::KaiLinkHistory, ToSparkLine(mKaiLinkHistory));
+    }
+
+    mLastSnapshot = lSnapshot;
+    mLastSample   = lSnapshot.mTime;
+}
+
+void StatisticsWindow::SetLine(Line aLine, std::string_view aText)
+{
+    // Leave room for the border and the indentation.
+    std::size_t lWidth{static_cast<std::size_t>(std::max(GetWidthReference() - 3, 0))};
+    std::string lText{aText.substr(0, lWidth)};
+    lText.resize(lWidth, ' ');
+
+    GetObjects().at(static_cast<std::size_t>(aLine))->SetName(lText);
+}
+
+std::string StatisticsWindow::ToSparkLine(const std::deque<double>& aHistory) const
+{
+    std::string lReturn{};
+    double      lMaximum{aHistory.empty() ? 0 : *std::max_element(aHistory.begin(), aHistory.end())};
+
+    for (double lValue : aHistory) {
+        std::size_t lIndex{0};
+        if (lMaximum > 0) {
+            lIndex = static_cast<std::size_t>((lValue / lMaximum) *
+                                              static_cast<double>(cSparkLineCharacters.size() - 1));
+        }
+        lReturn += cSparkLineCharacters.at(lIndex);
+    }
+
+    // Only show the newest values if the window is too small.
+    std::size_t lWidth{static_cast<std::size_t>(std::max(GetWidthReference() - 3, 0))};
+    if (lReturn.size() > lWidth) {
+        lReturn.erase(0, lReturn.size() - lWidth);
+    }
+
+    return lReturn;
+}
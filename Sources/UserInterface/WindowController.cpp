@@ -8,16 +8,29 @@
 
 #include "../../Includes/UserInterface/NCursesKeys.h"
 #include "../../Includes/UserInterface/NetworkingWindow.h"
+#include "../../Includes/UserInterface/SSIDSelectionWindow.h"
+#include "../../Includes/UserInterface/StatisticsWindow.h"
 #include "../../Includes/UserInterface/XLinkWindow.h"
 
 Dimensions ScaleNetworkingWindow(const int& aMaxHeight, const int& aMaxWidth)
 {
-    return {0, 0, static_cast<int>(floor(aMaxHeight / 2.0)), aMaxWidth};
+    return {0, 0, static_cast<int>(floor(aMaxHeight / 2.0)), static_cast<int>(floor(aMaxWidth / 2.0))};
 }
 
 Dimensions ScaleXLinkWindow(const int& aMaxHeight, const int& aMaxWidth)
 {
-    return {static_cast<int>(floor(aMaxHeight / 2.0)), 0, static_cast<int>(floor(aMaxHeight / 2.0)), aMaxWidth};
+    return {static_cast<int>(floor(aMaxHeight / 2.0)),
+            0,
+            static_cast<int>(floor(aMaxHeight / 2.0)),
+            static_cast<int>(floor(aMaxWidth / 2.0))};
+}
+
+Dimensions ScaleStatisticsWindow(const int& aMaxHeight, const int& aMaxWidth)
+{
+    return {0,
+            static_cast<int>(floor(aMaxWidth / 2.0)),
+            static_cast<int>(floor(aMaxHeight / 2.0)) * 2,
+            aMaxWidth - static_cast<int>(floor(aMaxWidth / 2.0))};
 }
 
 Dimensions ScaleSSIDSelectWindow(const int& aMaxHeight, const int& aMaxWidth)
@@ -27,7 +40,7 @@ Dimensions ScaleSSIDSelectWindow(const int& aMaxHeight, const int& aMaxWidth)
 
 WindowController::WindowController(WindowModel& aModel) :
     mMainCanvas{nullptr}, mHeight{0}, mWidth{0}, mDimensionsChanged{false}, mWindows{}, mExclusiveWindow{false},
-    mWindowSelector{0, nullptr}, mModel{aModel}
+    mWindowSelector{0, nullptr}, mSSIDSelectionWindowIndex{0}, mModel{aModel}
 {}
 
 bool WindowController::SetUp()
@@ -60,8 +73,12 @@ bool WindowController::SetUp()
     mWindows.emplace_back(
         std::make_shared<XLinkWindow>(mModel, "XLink Kai pane:", [&] { return ScaleXLinkWindow(mHeight, mWidth); }));
 
-    mWindows.emplace_back(std::make_shared<Window>(
-        mModel, "SSID Selection:", [&] { return ScaleSSIDSelectWindow(mHeight, mWidth); }, false, false, false));
+    mWindows.emplace_back(std::make_shared<StatisticsWindow>(
+        mModel, "Statistics pane:", [&] { return ScaleStatisticsWindow(mHeight, mWidth); }));
+
+    mWindows.emplace_back(std::make_shared<SSIDSelectionWindow>(
+        mModel, "SSID Selection:", [&] { return ScaleSSIDSelectWindow(mHeight, mWidth); }));
+    mSSIDSelectionWindowIndex = static_cast<int>(mWindows.size()) - 1;
 
     mWindowSelector.first  = 0;
     mWindowSelector.second = mWindows.at(0);
@@ -72,6 +89,14 @@ bool WindowController::SetUp()
     return true;
 }
 
+void WindowController::SelectWindow(int aIndex)
+{
+    mWindowSelector.second->DeSelect();
+    mWindowSelector = {aIndex, mWindows.at(aIndex)};
+    mWindowSelector.second->DeSelect();
+    mWindowSelector.second->AdvanceSelectionVertical();
+}
+
 void WindowController::AdvanceWindow()
 {
     if (!mExclusiveWindow) {
@@ -86,10 +111,7 @@ void WindowController::AdvanceWindow()
             }
 
             if (mWindows.at(lIndex)->IsVisible()) {
-                mWindowSelector.second->DeSelect();
-                mWindowSelector = {lIndex, mWindows.at(lIndex)};
-                mWindowSelector.second->DeSelect();
-                mWindowSelector.second->AdvanceSelectionVertical();
+                SelectWindow(lIndex);
                 lEndLoop = true;
             } else if (lIndex == lStartIndex) {
                 mWindowSelector = {lStartIndex, mWindowSelector.second};
@@ -127,6 +149,15 @@ bool WindowController::Process()
 
     wrefresh(mMainCanvas.get());
 
+    // The network list goes on top of the other windows while searching for networks, redraw them all after.
+    std::shared_ptr<IWindow>& lSSIDSelectionWindow{mWindows.at(mSSIDSelectionWindowIndex)};
+    if (mModel.mSearchingNetworks != lSSIDSelectionWindow->IsVisible()) {
+        lSSIDSelectionWindow->SetVisible(mModel.mSearchingNetworks);
+        SelectWindow(mModel.mSearchingNetworks ? mSSIDSelectionWindowIndex : 0);
+        mExclusiveWindow   = mModel.mSearchingNetworks;
+        mDimensionsChanged = true;
+    }
+
     if (mExclusiveWindow) {
         if (!mWindowSelector.second->IsVisible() || !(mWindowSelector.second->IsExclusive())) {
             mExclusiveWindow = false;
@@ -0,0 +1,80 @@
+#include "../Includes/VirtualClock.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - VirtualClock.cpp */
+
+using namespace std::chrono;
+
+VirtualClock::VirtualClock(steady_clock::time_point aStart) : mNow(aStart) {}
+
+steady_clock::time_point VirtualClock::Now()
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    return mNow;
+}
+
+void VirtualClock::SleepUntil(steady_clock::time_point aDeadline)
+{
+    Event lEvent{};
+    while (TakeNext(aDeadline, lEvent)) {
+        lEvent.mFunction();
+    }
+
+    std::lock_guard<std::mutex> lLock{mMutex};
+    mNow = std::max(mNow, aDeadline);
+}
+
+void VirtualClock::Schedule(steady_clock::time_point aTime, std::function<void()> aEvent)
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    mEvents.push({std::max(aTime, mNow), mSequence, std::move(aEvent)});
+    mSequence++;
+}
+
+void VirtualClock::ScheduleIn(steady_clock::duration aDelay, std::function<void()> aEvent)
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    mEvents.push({mNow + aDelay, mSequence, std::move(aEvent)});
+    mSequence++;
+}
+
+bool VirtualClock::RunNext()
+{
+    Event lEvent{};
+    bool  lReturn{TakeNext(steady_clock::time_point::max(), lEvent)};
+
+    if (lReturn) {
+        lEvent.mFunction();
+    }
+
+    return lReturn;
+}
+
+void VirtualClock::Run(steady_clock::time_point aLimit)
+{
+    Event lEvent{};
+    while (TakeNext(aLimit, lEvent)) {
+        lEvent.mFunction();
+    }
+}
+
+std::size_t VirtualClock::GetPendingEvents() const
+{
+    std::lock_guard<std::mutex> lLock{mMutex};
+    return mEvents.size();
+}
+
+bool VirtualClock::TakeNext(steady_clock::time_point aTime, Event& aEvent)
+{
+    bool lReturn{false};
+
+    // The event runs without the lock held, so it can use the clock itself.
+    std::lock_guard<std::mutex> lLock{mMutex};
+    if (!mEvents.empty() && (mEvents.top().mTime <= aTime)) {
+        aEvent = mEvents.top();
+        mEvents.pop();
+        mNow    = std::max(mNow, aEvent.mTime);
+        lReturn = true;
+    }
+
+    return lReturn;
+}
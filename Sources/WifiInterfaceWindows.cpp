@@ -1,5 +1,7 @@
 #include "../Includes/WifiInterfaceWindows.h"
 
+#include <utility>
+
 #include <Winsock2.h>
 #include <iphlpapi.h>
 #include <objbase.h>
@@ -261,11 +263,28 @@ bool WifiInterface::Connect(const IWifiInterface::WifiInformation& aConnection)
     mParameters.strProfile         = nullptr;
 
     lReturn = WlanConnect(mWifiHandle, &mGUID, &mParameters, nullptr);
+    if ((lReturn == ERROR_SUCCESS) && (mIBSSCallback != nullptr)) {
+        mIBSSCallback({true, aConnection.bssid});
+    }
     return lReturn == ERROR_SUCCESS;
 }
 
 
 bool WifiInterface::LeaveIBSS()
 {
-    return WlanDisconnect(mWifiHandle, &mGUID, nullptr) == ERROR_SUCCESS;
+    bool lReturn{WlanDisconnect(mWifiHandle, &mGUID, nullptr) == ERROR_SUCCESS};
+    if (lReturn && (mIBSSCallback != nullptr)) {
+        mIBSSCallback({false, {}});
+    }
+    return lReturn;
+}
+
+void WifiInterface::SetScanResultsCallback(ScanResultsCallback /*aCallback*/)
+{
+    // GetAdhocNetworks() waits for the scan itself, there are never results later on.
+}
+
+void WifiInterface::SetIBSSCallback(IBSSCallback aCallback)
+{
+    mIBSSCallback = std::move(aCallback);
 }
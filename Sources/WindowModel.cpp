@@ -38,6 +38,12 @@ bool WindowModel::SaveToFile(std::string_view aPath) const
         lFile << cSaveXLinkPort << ": \"" << mXLinkPort << "\"" << std::endl;
         lFile << cSaveAcknowledgeDataFrames << ": " << BoolToString(mAcknowledgeDataFrames) << std::endl;
         lFile << cSaveOnlyAcceptFromMac << ": \"" << mOnlyAcceptFromMac << "\"" << std::endl;
+        lFile << cSaveMetricsPort << ": \"" << mMetricsPort << "\"" << std::endl;
+        lFile << cSaveSlowFrameBudget << ": \"" << mSlowFrameBudget << "\"" << std::endl;
+        lFile << cSaveKaiRecording << ": \"" << mKaiRecording << "\"" << std::endl;
+        lFile << cSaveMultiNetwork << ": " << BoolToString(mMultiNetwork) << std::endl;
+        lFile << cSaveInjectionAdapter << ": \"" << mInjectionAdapter << "\"" << std::endl;
+        lFile << cSaveInjectionBackend << ": \"" << mInjectionBackend << "\"" << std::endl;
         lFile.close();
 
         if (lFile.good()) {
@@ -95,6 +101,18 @@ bool WindowModel::LoadFromFile(std::string_view aPath)
                             mAcknowledgeDataFrames = StringToBool(lResult);
                         } else if (lOption == cSaveOnlyAcceptFromMac) {
                             mOnlyAcceptFromMac = lResult.substr(1, lResult.size() - 2);
+                        } else if (lOption == cSaveMetricsPort) {
+                            mMetricsPort = lResult.substr(1, lResult.size() - 2);
+                        } else if (lOption == cSaveSlowFrameBudget) {
+                            mSlowFrameBudget = lResult.substr(1, lResult.size() - 2);
+                        } else if (lOption == cSaveKaiRecording) {
+                            mKaiRecording = lResult.substr(1, lResult.size() - 2);
+                        } else if (lOption == cSaveMultiNetwork) {
+                            mMultiNetwork = StringToBool(lResult);
+                        } else if (lOption == cSaveInjectionAdapter) {
+                            mInjectionAdapter = lResult.substr(1, lResult.size() - 2);
+                        } else if (lOption == cSaveInjectionBackend) {
+                            mInjectionBackend = lResult.substr(1, lResult.size() - 2);
                         } else {
                             Logger::GetInstance().Log(std::string("Option:") + lOption + " unknown",
                                                       Logger::Level::DEBUG);
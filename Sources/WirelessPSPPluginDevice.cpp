@@ -7,44 +7,81 @@
 #include <functional>
 #include <string>
 #include <thread>
+#include <utility>
 
+#include "../Includes/FlightRecorder.h"
+#include "../Includes/LatencyTrace.h"
+#include "../Includes/Metrics.h"
 #include "../Includes/NetConversionFunctions.h"
 
 using namespace std::chrono;
 
 // Keeping the SSID filter in because of future autoconnect
-bool WirelessPSPPluginDevice::Open(std::string_view aName, std::vector<std::string>& aSSIDFilter)
+bool WirelessPSPPluginDevice::Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter)
 {
     bool lReturn{true};
 
     mWifiInterface = std::make_shared<WifiInterface>(aName);
     mSSIDFilter    = aSSIDFilter;
-    ConnectToAdhoc();
-
-    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
-
-    mHandler = pcap_create(aName.data(), lErrorBuffer.data());
-    pcap_set_snaplen(mHandler, cSnapshotLength);
-    pcap_set_timeout(mHandler, cPCAPTimeoutMs);
-    pcap_setdirection(mHandler, PCAP_D_IN);
-    // TODO: Test without immediate mode, see if it helps
-    // pcap_set_immediate_mode(mHandler, 1);
+    mWifiInterface->SetIBSSCallback([&](const IWifiInterface::IBSSEvent& aEvent) { HandleIBSSEvent(aEvent); });
+    mWifiInterface->SetScanResultsCallback([&] { HandleScanResults(); });
+    mPeers.clear();
+    if (!ConnectToCached()) {
+        ConnectToAdhoc();
+    }
 
-    int lStatus{pcap_activate(mHandler)};
+    mAdapterName = aName;
+    mHandler     = Activate();
 
-    if (lStatus == 0) {
+    if (mHandler != nullptr) {
         mConnected         = true;
         mAdapterMACAddress = mWifiInterface->GetAdapterMACAddress();
         // Do not try to negiotiate with localhost
         BlackList(mAdapterMACAddress);
+
+        if ((mInjectionBackend != InjectionBackend::PCap) &&
+            !mPacketSocket.Open(mAdapterName, mInjectionBackend == InjectionBackend::PacketRing)) {
+            Logger::GetInstance().Log("Could not open packet socket, injecting with pcap", Logger::Level::WARNING);
+        }
     } else {
         lReturn = false;
-        Logger::GetInstance().Log("pcap_activate failed, " + std::string(pcap_statustostr(lStatus)),
-                                  Logger::Level::ERROR);
     }
 
     // Reset the timer
-    mReadWatchdog = std::chrono::system_clock::now();
+    ResetReadWatchdog();
+
+    return lReturn;
+}
+
+pcap_t* WirelessPSPPluginDevice::Activate()
+{
+    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+
+    pcap_t* lReturn{pcap_create(mAdapterName.c_str(), lErrorBuffer.data())};
+
+    if (lReturn != nullptr) {
+        pcap_set_snaplen(lReturn, cSnapshotLength);
+        pcap_set_timeout(lReturn, cPCAPTimeoutMs);
+        pcap_set_buffer_size(lReturn, static_cast<int>(mCaptureController.GetBufferSize()));
+        // Falls back to microseconds if the device does not support it.
+        mNanosecondTimestamps = (pcap_set_tstamp_precision(lReturn, PCAP_TSTAMP_PRECISION_NANO) == 0);
+        pcap_setdirection(lReturn, PCAP_D_IN);
+        // TODO: Test without immediate mode, see if it helps
+        // pcap_set_immediate_mode(lReturn, 1);
+
+        int lStatus{pcap_activate(lReturn)};
+
+        if (lStatus == 0) {
+            SetFilter(lReturn);
+        } else {
+            Logger::GetInstance().Log("pcap_activate failed, " + std::string(pcap_statustostr(lStatus)),
+                                      Logger::Level::ERROR);
+            pcap_close(lReturn);
+            lReturn = nullptr;
+        }
+    } else {
+        Logger::GetInstance().Log("pcap_create failed, " + std::string(lErrorBuffer.data()), Logger::Level::ERROR);
+    }
 
     return lReturn;
 }
@@ -53,8 +90,17 @@ void WirelessPSPPluginDevice::Close()
 {
     mConnected = false;
 
-    if (mHandler != nullptr) {
-        pcap_breakloop(mHandler);
+    if (mWifiInterface != nullptr) {
+        // Returns once callbacks that are running have finished.
+        mWifiInterface->SetScanResultsCallback(nullptr);
+        mWifiInterface->SetIBSSCallback(nullptr);
+    }
+
+    {
+        std::lock_guard<std::mutex> lLock{mHandlerMutex};
+        if (mHandler != nullptr) {
+            pcap_breakloop(mHandler);
+        }
     }
 
     if (mReceiverThread != nullptr) {
@@ -77,28 +123,47 @@ void WirelessPSPPluginDevice::Close()
         pcap_close(mHandler);
     }
 
+    {
+        std::lock_guard<std::mutex> lLock{mHandlerMutex};
+        mPacketSocket.Close();
+    }
+
+    // Both threads have stopped, so the network and peers can be read safely.
+    if ((mNetworkCache != nullptr) && (mJoinedNetwork.mBSSID != 0)) {
+        mJoinedNetwork.mPeers = mPeers;
+        mNetworkCache->Store(mJoinedNetwork);
+    }
+
     mHandler        = nullptr;
     mData           = nullptr;
     mHeader         = nullptr;
     mReceiverThread = nullptr;
     mWifiInterface  = nullptr;
+    mJoinedNetwork  = CachedNetwork{};
 }
 
 bool WirelessPSPPluginDevice::ReadCallback(const unsigned char* aData, const pcap_pkthdr* aHeader)
 {
     bool lReturn{false};
 
+    // The capture timestamp is the origin for all latency measurements of this frame.
+    LatencyTrace lTrace{Direction::AirToKai, LatencyTrace::FromTimestamp(aHeader->ts, mNanosecondTimestamps)};
+    lTrace.Mark(Point::Started);
+
     // Load all needed information into the handler
     std::string lData{DataToString(aData, aHeader)};
     uint64_t    lSourceMac{
         (GetRawData<uint64_t>(lData, Net_8023_Constants::cSourceAddressIndex) & Net_Constants::cBroadcastMac)};
 
+    Metrics::GetInstance().Increment(Counter::AirFramesReceived);
+    Metrics::GetInstance().Increment(Counter::AirBytesReceived, aHeader->caplen);
+
     if (!IsMACBlackListed(lSourceMac)) {
         if (((GetRawData<uint64_t>(lData, Net_8023_Constants::cDestinationAddressIndex) &
               Net_Constants::cBroadcastMac) == Net_Constants::cBroadcastMac) &&
             (GetRawData<uint16_t>(lData, Net_8023_Constants::cEtherTypeIndex) == Net_Constants::cPSPEtherType)) {
             // Reset the timer so it will not time out
-            mReadWatchdog = std::chrono::system_clock::now();
+            ResetReadWatchdog();
 
             // Obtain required MACs
             uint64_t lAdapterMAC = mAdapterMACAddress;
@@ -125,7 +190,7 @@ bool WirelessPSPPluginDevice::ReadCallback(const unsigned char* aData, const pca
             Send(lPacket, false);
         } else if ((GetRawData<uint16_t>(lData, Net_8023_Constants::cEtherTypeIndex) == Net_Constants::cPSPEtherType)) {
             // Reset the timer so it will not time out
-            mReadWatchdog = std::chrono::system_clock::now();
+            ResetReadWatchdog();
 
             // With the plugin the destination mac is kept at the end of the packet
             std::string lActualDestinationMac{
@@ -134,12 +199,23 @@ bool WirelessPSPPluginDevice::ReadCallback(const unsigned char* aData, const pca
                           Net_8023_Constants::cDestinationAddressLength,
                           lActualDestinationMac);
             lData.resize(lData.size() - Net_8023_Constants::cDestinationAddressLength);
+            if ((mPeers.size() < cMaxCachedPeers) &&
+                (std::find(mPeers.begin(), mPeers.end(), lSourceMac) == mPeers.end())) {
+                mPeers.push_back(lSourceMac);
+            }
+            lTrace.Mark(Point::Converted);
+            FlightRecorder::GetInstance().Record(
+                Stage::PluginReceived, Verdict::Forwarded, lData, lTrace.Get(Point::Origin));
             mConnector->Send(lData);
+            lTrace.Mark(Point::Sent);
+            lTrace.Finish();
 
             mData   = aData;
             mHeader = aHeader;
             mPacketCount++;
         }
+    } else {
+        Metrics::GetInstance().Increment(Counter::DroppedMACFilter);
     }
 
     return lReturn;
@@ -187,6 +263,57 @@ void WirelessPSPPluginDevice::ShowPacketStatistics(const pcap_pkthdr* aHeader) c
     }
 }
 
+void WirelessPSPPluginDevice::SampleCaptureStatistics()
+{
+    pcap_stat lStatistics{};
+
+    if ((mHandler != nullptr) && (pcap_stats(mHandler, &lStatistics) == 0)) {
+        CaptureAdjustment lAdjustment{
+            mCaptureController.Update(lStatistics.ps_drop, lStatistics.ps_ifdrop, steady_clock::now())};
+        bool lReactivated{false};
+
+        if (lAdjustment.mGrowBuffer) {
+            // The buffer size can only be set before activating, so the handle has to be replaced.
+            pcap_t* lHandler{Activate()};
+            if (lHandler != nullptr) {
+                pcap_t* lOldHandler{nullptr};
+                {
+                    std::lock_guard<std::mutex> lLock{mHandlerMutex};
+                    lOldHandler = std::exchange(mHandler, lHandler);
+                }
+                pcap_close(lOldHandler);
+                mCaptureController.Restarted();
+                lReactivated = true;
+            } else {
+                mCaptureController.RevertBufferSize();
+            }
+        }
+
+        if (!lReactivated && (lAdjustment.mTightenFilter || lAdjustment.mRelaxFilter)) {
+            SetFilter(mHandler);
+        }
+    }
+
+    mLastStatisticsSample = steady_clock::now();
+}
+
+void WirelessPSPPluginDevice::SetFilter(pcap_t* aHandler)
+{
+    // An empty filter lets everything through.
+    std::string lFilter{mCaptureController.IsFilterTightened() ? cTightFilter : ""};
+
+    bpf_program lProgram{};
+    if (pcap_compile(aHandler, &lProgram, lFilter.c_str(), 1, PCAP_NETMASK_UNKNOWN) == 0) {
+        if (pcap_setfilter(aHandler, &lProgram) != 0) {
+            Logger::GetInstance().Log("pcap_setfilter failed, " + std::string(pcap_geterr(aHandler)),
+                                      Logger::Level::ERROR);
+        }
+        pcap_freecode(&lProgram);
+    } else {
+        Logger::GetInstance().Log("pcap_compile failed, " + std::string(pcap_geterr(aHandler)), Logger::Level::ERROR);
+    }
+}
+
 const unsigned char* WirelessPSPPluginDevice::GetData()
 {
     return mData;
@@ -220,6 +347,8 @@ bool WirelessPSPPluginDevice::Send(std::string_view aData)
 bool WirelessPSPPluginDevice::Send(std::string_view aData, bool aModifyData)
 {
     bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mHandlerMutex};
     if (mHandler != nullptr) {
         if (!aData.empty()) {
             std::string lData{aData.data(), aData.size()};
@@ -239,11 +368,24 @@ bool WirelessPSPPluginDevice::Send(std::string_view aData, bool aModifyData)
 
             Logger::GetInstance().Log(std::string("Sent: ") + PrettyHexString(lData), Logger::Level::TRACE);
 
-            if (pcap_sendpacket(mHandler, reinterpret_cast<const unsigned char*>(lData.data()), lData.size()) == 0) {
-                lReturn = true;
+            if (mPacketSocket.IsOpen()) {
+                lReturn = mPacketSocket.Send(lData);
             } else {
-                Logger::GetInstance().Log("pcap_sendpacket failed, " + std::string(pcap_geterr(mHandler)),
-                                          Logger::Level::ERROR);
+                const auto* lPacket{reinterpret_cast<const unsigned char*>(lData.data())};
+                lReturn = (pcap_sendpacket(mHandler, lPacket, lData.size()) == 0);
+                if (!lReturn) {
+                    Logger::GetInstance().Log("pcap_sendpacket failed, " + std::string(pcap_geterr(mHandler)),
+                                              Logger::Level::ERROR);
+                }
+            }
+
+            if (lReturn) {
+                Metrics::GetInstance().Increment(Counter::AirFramesSent);
+                Metrics::GetInstance().Increment(Counter::AirBytesSent, lData.size());
+                FlightRecorder::GetInstance().Record(Stage::PluginSent, Verdict::Sent, lData);
+            } else {
+                Metrics::GetInstance().Increment(Counter::AirSendFailures);
+                FlightRecorder::GetInstance().Record(Stage::PluginSent, Verdict::Failed, lData);
             }
         }
     } else {
@@ -257,24 +399,119 @@ bool WirelessPSPPluginDevice::Send(std::string_view aData, bool aModifyData)
 bool WirelessPSPPluginDevice::ConnectToAdhoc()
 {
     bool lReturn{};
-    // Send leave IBSS command just in case
-    mWifiInterface->LeaveIBSS();
-    std::vector<IWifiInterface::WifiInformation>& lNetworks = mWifiInterface->GetAdhocNetworks();
-    for (const auto& lNetwork : lNetworks) {
-        for (const auto& lFilter : mSSIDFilter) {
-            if (lNetwork.ssid.find(lFilter) != std::string::npos && lNetwork.isadhoc && !lNetwork.isconnected) {
-                lReturn = mWifiInterface->Connect(lNetwork);
+
+    std::lock_guard<std::mutex> lLock{mWifiMutex};
+    if (mWifiInterface != nullptr) {
+        // Results of the last scan, a new one gets started in the background when these are getting old.
+        std::vector<IWifiInterface::WifiInformation> lNetworks{mWifiInterface->GetAdhocNetworks()};
+        for (const auto& lNetwork : lNetworks) {
+            for (const auto& lFilter : mSSIDFilter) {
+                if (!lReturn && lNetwork.ssid.find(lFilter) != std::string::npos && lNetwork.isadhoc &&
+                    !lNetwork.isconnected) {
+                    lReturn = JoinNetwork(lNetwork);
+                }
             }
         }
+        mJoinedAdhoc = mJoinedAdhoc || lReturn;
+    }
+
+    return lReturn;
+}
+
+bool WirelessPSPPluginDevice::ConnectToCached()
+{
+    bool          lReturn{false};
+    CachedNetwork lCachedNetwork{};
+
+    // Without a filter any network would match, leave picking one to the scan.
+    if ((mNetworkCache != nullptr) && !mSSIDFilter.empty() && mNetworkCache->Find(mSSIDFilter, lCachedNetwork) &&
+        lCachedNetwork.mIsAdhoc) {
+        IWifiInterface::WifiInformation lNetwork{lCachedNetwork.mSSID, {}, lCachedNetwork.mFrequency, true, false};
+        memcpy(lNetwork.bssid.data(), &lCachedNetwork.mBSSID, lNetwork.bssid.size());
+
+        std::lock_guard<std::mutex> lLock{mWifiMutex};
+        if (mWifiInterface != nullptr) {
+            Logger::GetInstance().Log("Warm start on cached network: " + lCachedNetwork.mSSID, Logger::Level::INFO);
+            lReturn = JoinNetwork(lNetwork);
+        }
+        mJoinedAdhoc = mJoinedAdhoc || lReturn;
     }
+
+    return lReturn;
+}
+
+bool WirelessPSPPluginDevice::IsReadWatchdogExpired() const
+{
+    steady_clock::time_point lReadWatchdog{steady_clock::duration(mReadWatchdog.load())};
+    return mClock->Now() > (lReadWatchdog + cReadWatchdogTimeout);
+}
+
+bool WirelessPSPPluginDevice::JoinNetwork(const IWifiInterface::WifiInformation& aNetwork)
+{
+    // Send leave IBSS command just in case
+    mWifiInterface->LeaveIBSS();
+    bool lReturn{mWifiInterface->Connect(aNetwork)};
+
+    if (lReturn) {
+        mJoinedNetwork            = CachedNetwork{};
+        mJoinedNetwork.mSSID      = aNetwork.ssid;
+        mJoinedNetwork.mFrequency = aNetwork.frequency;
+        mJoinedNetwork.mIsAdhoc   = aNetwork.isadhoc;
+        memcpy(&mJoinedNetwork.mBSSID, aNetwork.bssid.data(), aNetwork.bssid.size());
+    }
+
     return lReturn;
 }
 
+void WirelessPSPPluginDevice::HandleScanResults()
+{
+    // Nothing joined yet, or the network that is joined stopped delivering, so see what this scan found.
+    if (!mJoinedAdhoc || IsReadWatchdogExpired()) {
+        if (ConnectToAdhoc()) {
+            ResetReadWatchdog();
+        }
+    }
+}
+
+void WirelessPSPPluginDevice::HandleIBSSEvent(const IWifiInterface::IBSSEvent& aEvent)
+{
+    if (aEvent.joined) {
+        uint64_t lBSSID{0};
+        memcpy(&lBSSID, aEvent.bssid.data(), aEvent.bssid.size());
+        Logger::GetInstance().Log("Joined adhoc network " + IntToMac(lBSSID), Logger::Level::INFO);
+        // Give the new network the full timeout to start delivering.
+        ResetReadWatchdog();
+    } else {
+        Logger::GetInstance().Log("Left adhoc network", Logger::Level::DEBUG);
+    }
+    mJoinedAdhoc = aEvent.joined;
+}
+
+void WirelessPSPPluginDevice::ResetReadWatchdog()
+{
+    mReadWatchdog = mClock->Now().time_since_epoch().count();
+}
+
+void WirelessPSPPluginDevice::SetClock(std::shared_ptr<IClock> aClock)
+{
+    mClock = std::move(aClock);
+}
+
 void WirelessPSPPluginDevice::SetConnector(std::shared_ptr<IConnector> aDevice)
 {
     mConnector = aDevice;
 }
 
+void WirelessPSPPluginDevice::SetInjectionBackend(InjectionBackend aBackend)
+{
+    mInjectionBackend = aBackend;
+}
+
+void WirelessPSPPluginDevice::SetNetworkCache(std::shared_ptr<NetworkCache> aNetworkCache)
+{
+    mNetworkCache = std::move(aNetworkCache);
+}
+
 bool WirelessPSPPluginDevice::StartReceiverThread()
 {
     bool lReturn{true};
@@ -285,14 +522,13 @@ bool WirelessPSPPluginDevice::StartReceiverThread()
             if (mWifiTimeoutThread == nullptr) {
                 mWifiTimeoutThread = std::make_shared<std::thread>([&] {
                     while (mConnected) {
-                        if (std::chrono::system_clock::now() >
-                            (mReadWatchdog + WirelessPSPPluginDevice_Constants::cReadWatchdogTimeout)) {
+                        if (IsReadWatchdogExpired()) {
                             Logger::GetInstance().Log("Switching networks due to timeout!", Logger::Level::DEBUG);
                             // Read timed out try to connect to another network.
                             ConnectToAdhoc();
-                            mReadWatchdog = std::chrono::system_clock::now();
+                            ResetReadWatchdog();
                         }
-                        std::this_thread::sleep_for(1s);
+                        mClock->SleepFor(1s);
                     }
                 });
             }
@@ -301,7 +537,7 @@ bool WirelessPSPPluginDevice::StartReceiverThread()
                 // If we're receiving data from the receiver thread, send it off as well.
                 bool lSendReceivedDataOld = mSendReceivedData;
                 mSendReceivedData         = true;
-                mReadWatchdog             = std::chrono::system_clock::now();
+                ResetReadWatchdog();
 
                 auto lCallbackFunction =
                     [](unsigned char* aThis, const pcap_pkthdr* aHeader, const unsigned char* aPacket) {
@@ -317,6 +553,10 @@ bool WirelessPSPPluginDevice::StartReceiverThread()
                             "Error occurred while reading packet: " + std::string(pcap_geterr(mHandler)),
                             Logger::Level::DEBUG);
                     }
+
+                    if (std::chrono::steady_clock::now() > (mLastStatisticsSample + cStatisticsInterval)) {
+                        SampleCaptureStatistics();
+                    }
                 }
 
                 mSendReceivedData = lSendReceivedDataOld;
@@ -2,6 +2,7 @@
 
 /* Copyright (c) 2020 [Rick de Bondt] - XLinkKaiConnection.cpp */
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <iostream>
@@ -10,8 +11,11 @@
 #include <boost/bind/bind.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 
+#include "../Includes/FlightRecorder.h"
 #include "../Includes/IPCapDevice.h"
+#include "../Includes/LatencyTrace.h"
 #include "../Includes/Logger.h"
+#include "../Includes/Metrics.h"
 #include "../Includes/MonitorDevice.h"
 #include "../Includes/NetConversionFunctions.h"
 
@@ -20,6 +24,21 @@ using namespace boost::asio;
 using namespace boost::placeholders;
 using namespace std::chrono_literals;
 
+namespace
+{
+    /**
+     * Checks whether a command, the part of a message up to and including the first separator, has a format.
+     * @param aCommand - Command to check.
+     * @param aFormat - Format to check for, without separator.
+     * @return true if the command has the format.
+     */
+    bool IsCommand(std::string_view aCommand, std::string_view aFormat)
+    {
+        return (aCommand.size() == (aFormat.size() + cSeparator.size())) && aCommand.starts_with(aFormat) &&
+               aCommand.ends_with(cSeparator);
+    }
+}  // namespace
+
 XLinkKaiConnection::~XLinkKaiConnection()
 {
     Close();
@@ -64,7 +83,8 @@ bool XLinkKaiConnection::Connect()
     if (Send(cConnectString, "")) {
         // Start the timer for receiving a confirmation from XLink Kai.
         mConnectInitiated = true;
-        mConnectionTimerStart += (std::chrono::system_clock::now() - mConnectionTimerStart);
+        mConnectionTimerStart = mClock->Now();
+        Metrics::GetInstance().Set(Gauge::KaiLinkState, static_cast<int64_t>(KaiLinkState::Connecting));
     } else {
         // Logging in send function
         lReturn = false;
@@ -81,14 +101,27 @@ bool XLinkKaiConnection::Send(std::string_view aCommand, std::string_view aData)
         if ((mConnected || aCommand == cConnectString || aCommand == cDisconnectString)) {
             try {
                 if (aCommand == cEthernetDataString) {
-                    Logger::GetInstance().Log("Sent: " + std::string(aCommand) + PrettyHexString(aData),
-                                              Logger::Level::TRACE);
-                } else {
-                    Logger::GetInstance().Log("Sent: " + std::string(aCommand) + aData.data(), Logger::Level::DEBUG);
+                    if (Logger::GetInstance().ShouldLog(Logger::Level::TRACE)) {
+                        Logger::GetInstance().Log("Sent: " + std::string(aCommand) + PrettyHexString(aData),
+                                                  Logger::Level::TRACE);
+                    }
+                } else if (Logger::GetInstance().ShouldLog(Logger::Level::DEBUG)) {
+                    Logger::GetInstance().Log("Sent: " + std::string(aCommand) + std::string(aData),
+                                              Logger::Level::DEBUG);
                 }
 
-                mSocket.send_to(buffer(std::string(aCommand) + std::string(aData)), mRemote);
+                // Command and data go out as one datagram without copying them together first.
+                std::array<const_buffer, 2> lBuffers{buffer(aCommand.data(), aCommand.size()),
+                                                     buffer(aData.data(), aData.size())};
+                mSocket.send_to(lBuffers, mRemote);
+
+                if (aCommand == cEthernetDataString) {
+                    Metrics::GetInstance().Increment(Counter::KaiFramesSent);
+                    Metrics::GetInstance().Increment(Counter::KaiBytesSent, aData.size());
+                    FlightRecorder::GetInstance().Record(Stage::KaiSent, Verdict::Sent, aData);
+                }
             } catch (const boost::system::system_error& lException) {
+                Metrics::GetInstance().Increment(Counter::KaiSendFailures);
                 Logger::GetInstance().Log(
                     "Could not send message! " + std::string(aData) + std::string(lException.what()),
                     Logger::Level::ERROR);
@@ -136,65 +169,99 @@ bool XLinkKaiConnection::ReadNextData()
 
 void XLinkKaiConnection::ReceiveCallback(const boost::system::error_code& /*aError*/, size_t aBytesReceived)
 {
-    std::string lData{mData.begin(), mData.begin() + aBytesReceived};
+    // Receipt from XLink Kai is the origin for the latency measurements of frames going to the air.
+    LatencyTrace lTrace{Direction::KaiToAir, LatencyTrace::Now()};
+
+    std::string_view lData{mData.data(), aBytesReceived};
 
     // If we actually received anything useful, react.
     if (!lData.empty()) {
-        // Make sure the keepalive timer gets tickled so it doesn't bite.
-        mKeepAliveTimerStart += (std::chrono::system_clock::now() - mKeepAliveTimerStart);
-        std::size_t lFirstSeparator{lData.find(cSeparator)};
-        std::string lCommand{lData.substr(0, lFirstSeparator + 1)};
+        if (mRecording) {
+            Record(lData);
+        }
 
-        if (lCommand == cEthernetDataFormat) {
-            Logger::GetInstance().Log("Received: " + PrettyHexString(lData), Logger::Level::TRACE);
-        } else {
-            Logger::GetInstance().Log("Received: " + lCommand + lData, Logger::Level::TRACE);
+        // Make sure the keepalive timer gets tickled so it doesn't bite.
+        mKeepAliveTimerStart = mClock->Now();
+        std::size_t      lFirstSeparator{lData.find(cSeparator)};
+        std::string_view lCommand{lData.substr(0, lFirstSeparator + 1)};
+
+        if (Logger::GetInstance().ShouldLog(Logger::Level::TRACE)) {
+            if (lCommand == cEthernetDataFormat) {
+                Logger::GetInstance().Log("Received: " + PrettyHexString(lData), Logger::Level::TRACE);
+            } else {
+                Logger::GetInstance().Log("Received: " + std::string(lCommand) + std::string(lData),
+                                          Logger::Level::TRACE);
+            }
         }
 
-        if (!mConnected && (lCommand == std::string(cConnectedFormat) + cSeparator.data())) {
+        if (!mConnected && IsCommand(lCommand, cConnectedFormat)) {
             lCommand = lData.substr(0, cConnectedString.size());
             if (lCommand == cConnectedString) {
-                Logger::GetInstance().Log("XLink Kai succesfully connected: " + lCommand, Logger::Level::INFO);
+                Logger::GetInstance().Log("XLink Kai succesfully connected: " + std::string(lCommand),
+                                          Logger::Level::INFO);
+                Metrics::GetInstance().RecordLatency(Histogram::KaiConnectRoundTrip,
+                                                     mClock->Now() - mConnectionTimerStart);
                 mConnectInitiated = false;
                 mConnected        = true;
+                mLastKeepAlive    = mClock->Now();
+                Metrics::GetInstance().Set(Gauge::KaiLinkState, static_cast<int64_t>(KaiLinkState::Connected));
             }
         }
 
         // If no connection confirmation has been sent on XLink Kai's side, Don't care about any other message yet
         if (mConnected) {
             if (lCommand == cKeepAliveString) {
+                auto lNow{mClock->Now()};
+                Metrics::GetInstance().Increment(Counter::KaiKeepAlives);
+                Metrics::GetInstance().RecordLatency(Histogram::KaiKeepAliveInterval, lNow - mLastKeepAlive);
+                mLastKeepAlive = lNow;
+
                 HandleKeepAlive();
-            } else if (lCommand == std::string(cEthernetDataFormat) + cSeparator.data()) {
+            } else if (IsCommand(lCommand, cEthernetDataFormat)) {
                 // For data XLink Kai uses e;e; which doesn't filter all that well, so if we find e; just check if this
                 // is e;e;
                 lCommand = lData.substr(0, cEthernetDataString.size());
 
                 if (lCommand == cEthernetDataString) {
-                    if (mIncomingConnection != nullptr) {
+                    Metrics::GetInstance().Increment(Counter::KaiFramesReceived);
+                    Metrics::GetInstance().Increment(Counter::KaiBytesReceived,
+                                                     lData.length() - cEthernetDataString.length());
+
+                    if (!mIncomingConnections.empty()) {
                         // Strip e;e;
-                        mEthernetData =
-                            lData.substr(cEthernetDataString.length(), lData.length() - cEthernetDataString.length());
+                        mEthernetData.assign(lData.substr(cEthernetDataString.length()));
 
                         mPacketHandler.Update(mEthernetData);
+                        FlightRecorder::GetInstance().Record(Stage::KaiReceived, Verdict::Forwarded, mEthernetData);
 
-                        std::shared_ptr<MonitorDevice> lMonitorDevice =
-                            std::dynamic_pointer_cast<MonitorDevice>(mIncomingConnection);
+                        // Data from XLink Kai should never be caught in the receiver threads
+                        for (const auto& lDevice : mIncomingConnections) {
+                            lDevice->BlackList(mPacketHandler.GetSourceMAC());
+                        }
 
-                        // If it is actually a monitor device, do convert.
-                        if (lMonitorDevice != nullptr) {
-                            mEthernetData = mPacketHandler.ConvertPacket(lMonitorDevice->GetLockedBSSID(),
-                                                                         lMonitorDevice->GetDataPacketParameters());
+                        // A frame for a station that has been heard on one of the devices goes out on that device,
+                        // anything else on every device.
+                        auto lStation{mStationDevices.find(mPacketHandler.GetDestinationMAC())};
+                        if (lStation != mStationDevices.end()) {
+                            SendToDevice(*mIncomingConnections.at(lStation->second), lTrace);
+                        } else {
+                            for (const auto& lDevice : mIncomingConnections) {
+                                SendToDevice(*lDevice, lTrace);
+                            }
                         }
-                        // Data from XLink Kai should never be caught in the receiver thread
-                        mIncomingConnection->BlackList(mPacketHandler.GetSourceMAC());
-                        mIncomingConnection->Send(mEthernetData);
+                        lTrace.Mark(Point::Sent);
+                        lTrace.Finish();
                     }
                 }
-            } else if (lCommand == std::string(cDisconnectedFormat) + cSeparator.data()) {
+            } else if (IsCommand(lCommand, cDisconnectedFormat)) {
                 lCommand = lData.substr(0, cDisconnectedString.size());
                 if (lCommand == cDisconnectedString) {
-                    Logger::GetInstance().Log("Xlink Kai has disconnected us! " + lCommand, Logger::Level::ERROR);
+                    Logger::GetInstance().Log("Xlink Kai has disconnected us! " + std::string(lCommand),
+                                              Logger::Level::ERROR);
                     mConnected = false;
+                    Metrics::GetInstance().Increment(Counter::KaiDisconnects);
+                    Metrics::GetInstance().Set(Gauge::KaiLinkState, static_cast<int64_t>(KaiLinkState::Disconnected));
+                    FlightRecorder::GetInstance().Dump("kai-disconnected");
                 }
             }
         }
@@ -203,6 +270,60 @@ void XLinkKaiConnection::ReceiveCallback(const boost::system::error_code& /*aErr
     StartReceiverThread();
 }
 
+void XLinkKaiConnection::SendToDevice(IPCapDevice& aDevice, LatencyTrace& aTrace)
+{
+    auto* lMonitorDevice{dynamic_cast<MonitorDevice*>(&aDevice)};
+
+    if (lMonitorDevice != nullptr) {
+        // A frame for a station goes to the network it is in, anything else to every network locked onto.
+        std::size_t lRouteCount{lMonitorDevice->GetRoutes(mPacketHandler.GetDestinationMAC(), mRoutes)};
+        if (lRouteCount == 0) {
+            mRoutes.at(0) = {lMonitorDevice->GetLockedBSSID(), lMonitorDevice->GetDataPacketParameters()};
+            lRouteCount   = 1;
+        }
+
+        for (std::size_t lRoute = 0; lRoute < lRouteCount; lRoute++) {
+            const std::string& lConverted{
+                mPacketHandler.ConvertPacket(mRoutes.at(lRoute).mBSSID, mRoutes.at(lRoute).mParameters)};
+            aTrace.Mark(Point::Converted);
+
+            aDevice.Send(lConverted);
+        }
+    } else {
+        aTrace.Mark(Point::Converted);
+        aDevice.Send(mEthernetData);
+    }
+}
+
+std::chrono::steady_clock::duration XLinkKaiConnection::HandleTimers()
+{
+    std::chrono::steady_clock::duration lReturn{0};
+
+    if ((!mConnected && !mConnectInitiated)) {
+        // Lost connection somewhere, reconnect.
+        Close(false);
+        Open(mIp, mPort);
+        Connect();
+        lReturn = cReconnectDelay;
+    } else if ((!mConnected) && mConnectInitiated && (mClock->Now() > (mConnectionTimerStart + cConnectionTimeout))) {
+        Logger::GetInstance().Log("Timeout waiting for XLink Kai to connect", Logger::Level::ERROR);
+        Metrics::GetInstance().Set(Gauge::KaiLinkState, static_cast<int64_t>(KaiLinkState::Disconnected));
+        mConnectInitiated = false;
+        mConnected        = false;
+        lReturn           = cConnectRetryDelay;
+    } else if (mConnected && !mConnectInitiated && (mClock->Now() > (mKeepAliveTimerStart + cKeepAliveTimeout))) {
+        // KaiEngine stopped sending keepalive messages, must've died.
+        Logger::GetInstance().Log("It seems KaiEngine has stopped responding, resetting connection ...",
+                                  Logger::Level::ERROR);
+        Metrics::GetInstance().Increment(Counter::KaiDisconnects);
+        Metrics::GetInstance().Set(Gauge::KaiLinkState, static_cast<int64_t>(KaiLinkState::Disconnected));
+        mConnected        = false;
+        mConnectInitiated = false;
+    }
+
+    return lReturn;
+}
+
 bool XLinkKaiConnection::StartReceiverThread()
 {
     bool lReturn{true};
@@ -217,29 +338,13 @@ bool XLinkKaiConnection::StartReceiverThread()
             mReceiverThread = std::make_shared<std::thread>([&] {
                 mIoService.restart();
                 while (!mIoService.stopped()) {
-                    if ((!mConnected && !mConnectInitiated)) {
-                        // Lost connection somewhere, reconnect.
-                        Close(false);
-                        Open(mIp, mPort);
-                        Connect();
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    } else if ((!mConnected) && mConnectInitiated &&
-                               (std::chrono::system_clock::now() > (mConnectionTimerStart + cConnectionTimeout))) {
-                        Logger::GetInstance().Log("Timeout waiting for XLink Kai to connect", Logger::Level::ERROR);
-                        mConnectInitiated = false;
-                        mConnected        = false;
-                        // Retry in 10 seconds
-                        std::this_thread::sleep_for(10s);
-                    } else if (mConnected && !mConnectInitiated &&
-                               (std::chrono::system_clock::now() > (mKeepAliveTimerStart + cKeepAliveTimeout))) {
-                        // KaiEngine stopped sending keepalive messages, must've died.
-                        Logger::GetInstance().Log("It seems KaiEngine has stopped responding, resetting connection ...",
-                                                  Logger::Level::ERROR);
-                        mConnected        = false;
-                        mConnectInitiated = false;
+                    std::chrono::steady_clock::duration lWait{HandleTimers()};
+                    if (lWait > std::chrono::steady_clock::duration::zero()) {
+                        mClock->SleepFor(lWait);
                     } else {
                         mIoService.poll();
-                        // Very small delay to make the computer happy
+                        ProcessDeviceFrames();
+                        // Very small delay to make the computer happy, this gives up the CPU rather than timing.
                         std::this_thread::sleep_for(10us);
                     }
                 }
@@ -257,6 +362,7 @@ bool XLinkKaiConnection::StartReceiverThread()
 void XLinkKaiConnection::Close()
 {
     Close(true);
+    StopRecording();
 }
 
 void XLinkKaiConnection::Close(bool aKillThread)
@@ -266,6 +372,7 @@ void XLinkKaiConnection::Close(bool aKillThread)
             Send(cDisconnectString, "");
             mConnected        = false;
             mConnectInitiated = false;
+            Metrics::GetInstance().Set(Gauge::KaiLinkState, static_cast<int64_t>(KaiLinkState::Disconnected));
         }
 
         if (aKillThread && mReceiverThread != nullptr) {
@@ -284,6 +391,11 @@ void XLinkKaiConnection::Close(bool aKillThread)
     }
 }
 
+void XLinkKaiConnection::SetClock(std::shared_ptr<IClock> aClock)
+{
+    mClock = std::move(aClock);
+}
+
 void XLinkKaiConnection::SetPort(unsigned int aPort)
 {
     mPort = aPort;
@@ -291,5 +403,115 @@ void XLinkKaiConnection::SetPort(unsigned int aPort)
 
 void XLinkKaiConnection::SetIncomingConnection(std::shared_ptr<IPCapDevice> aDevice)
 {
-    mIncomingConnection = aDevice;
+    mIncomingConnections.clear();
+    mStationDevices.clear();
+    if (aDevice != nullptr) {
+        mIncomingConnections.push_back(std::move(aDevice));
+    }
+}
+
+std::shared_ptr<IConnector> XLinkKaiConnection::AddIncomingConnection(std::shared_ptr<IPCapDevice> aDevice)
+{
+    mStationDevices.reserve(cMaxLearnedStations);
+    mIncomingConnections.push_back(std::move(aDevice));
+
+    return std::make_shared<DevicePort>(*this, mIncomingConnections.size() - 1);
+}
+
+bool XLinkKaiConnection::Enqueue(std::size_t aDevice, std::string_view aData)
+{
+    bool lReturn{false};
+
+    if (aData.size() <= cMaxLength) {
+        lReturn = mDeviceQueue->TryPush([&](DeviceFrame& aFrame) {
+            aFrame.mDevice = aDevice;
+            aFrame.mLength = aData.size();
+            std::copy(aData.begin(), aData.end(), aFrame.mData.begin());
+        });
+    }
+
+    if (!lReturn) {
+        Metrics::GetInstance().Increment(Counter::DroppedDeviceQueue);
+    }
+
+    return lReturn;
+}
+
+std::size_t XLinkKaiConnection::ProcessDeviceFrames()
+{
+    std::size_t lReturn{0};
+
+    // Only what fits in the queue at once, so devices that keep capturing can not keep XLink Kai from being handled.
+    while ((lReturn < cDeviceQueueSize) && mDeviceQueue->TryPop([&](const DeviceFrame& aFrame) {
+        std::string_view lData{aFrame.mData.data(), aFrame.mLength};
+
+        if (lData.size() >= Net_8023_Constants::cHeaderLength) {
+            auto lSourceMAC{GetRawData<uint64_t>(lData, Net_8023_Constants::cSourceAddressIndex)};
+            lSourceMAC &= static_cast<uint64_t>(static_cast<uint64_t>(1LLU << 48U) - 1);  // it's actually a uint48.
+
+            // A station that moves to another device gets followed, new stations are only added while there is room.
+            auto lStation{mStationDevices.find(lSourceMAC)};
+            if (lStation != mStationDevices.end()) {
+                lStation->second = aFrame.mDevice;
+            } else if (mStationDevices.size() < cMaxLearnedStations) {
+                mStationDevices.emplace(lSourceMAC, aFrame.mDevice);
+            }
+        }
+
+        Send(cEthernetDataString, lData);
+    })) {
+        lReturn++;
+    }
+
+    return lReturn;
+}
+
+XLinkKaiConnection::DevicePort::DevicePort(XLinkKaiConnection& aConnection, std::size_t aDevice) :
+    mConnection(aConnection), mDevice(aDevice)
+{}
+
+bool XLinkKaiConnection::DevicePort::Send(std::string_view aData)
+{
+    return mConnection.Enqueue(mDevice, aData);
+}
+
+bool XLinkKaiConnection::StartRecording(std::string_view aPath)
+{
+    bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mRecorderMutex};
+    mRecorder = std::make_unique<PcapNgWriter>();
+    if (mRecorder->Open(aPath)) {
+        mRecorderInterface = mRecorder->AddInterface(PcapNgWriter_Constants::cLinkTypeUser0, cRecordingSnapshotLength);
+        mRecording         = true;
+        lReturn            = true;
+        Logger::GetInstance().Log("Recording XLink Kai traffic to " + std::string(aPath), Logger::Level::INFO);
+    } else {
+        Logger::GetInstance().Log("Could not open " + std::string(aPath) + " to record XLink Kai traffic to",
+                                  Logger::Level::ERROR);
+        mRecorder = nullptr;
+    }
+
+    return lReturn;
+}
+
+void XLinkKaiConnection::StopRecording()
+{
+    std::lock_guard<std::mutex> lLock{mRecorderMutex};
+    mRecording = false;
+    if (mRecorder != nullptr) {
+        mRecorder->Close();
+        mRecorder = nullptr;
+    }
+}
+
+void XLinkKaiConnection::Record(std::string_view aData)
+{
+    std::lock_guard<std::mutex> lLock{mRecorderMutex};
+    if ((mRecorder != nullptr) && !mRecorder->WritePacket(mRecorderInterface, LatencyTrace::Now(), aData)) {
+        Logger::GetInstance().Log("Could not record XLink Kai traffic, stopping the recording", Logger::Level::ERROR);
+        mRecorder->Close();
+        mRecorder  = nullptr;
+        mRecording = false;
+    }
 }
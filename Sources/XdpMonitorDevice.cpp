@@ -0,0 +1,80 @@
+#include "../Includes/XdpMonitorDevice.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - XdpMonitorDevice.cpp */
+
+#include <functional>
+#include <string>
+
+#include "../Includes/LatencyTrace.h"
+#include "../Includes/Logger.h"
+#include "../Includes/NetConversionFunctions.h"
+
+using namespace std::chrono;
+
+bool XdpMonitorDevice::Open(std::string_view aName, const std::vector<std::string>& aSSIDFilter)
+{
+    SetUpPacketHandler(aSSIDFilter);
+    mAdapterName = aName;
+    mConnected   = mSocket.Open(aName);
+
+    return mConnected;
+}
+
+void XdpMonitorDevice::Close()
+{
+    mConnected = false;
+    if (mReceiverThread != nullptr && mReceiverThread->joinable()) {
+        mReceiverThread->join();
+    }
+
+    mSocket.Close();
+    mReceiverThread = nullptr;
+
+    // Stores the network it was in.
+    MonitorDevice::Close();
+}
+
+bool XdpMonitorDevice::Send(std::string_view aData)
+{
+    bool lReturn{false};
+
+    if (!aData.empty()) {
+        if (Logger::GetInstance().ShouldLog(Logger::Level::TRACE)) {
+            Logger::GetInstance().Log(std::string("Sent: ") + PrettyHexString(aData), Logger::Level::TRACE);
+        }
+
+        lReturn = mSocket.Send(aData);
+        RecordSent(aData, lReturn);
+    }
+
+    return lReturn;
+}
+
+bool XdpMonitorDevice::StartReceiverThread()
+{
+    bool lReturn{mSocket.IsOpen()};
+
+    if (lReturn) {
+        if (mReceiverThread == nullptr) {
+            mReceiverThread = std::make_shared<std::thread>([&] {
+                std::function<void(std::string_view)> lCallback{[&](std::string_view aFrame) {
+                    // Same clock as the latency traces, so the time until the read callback stays meaningful.
+                    auto lNow{duration_cast<microseconds>(LatencyTrace::Now())};
+                    mFrameHeader.ts.tv_sec  = duration_cast<seconds>(lNow).count();
+                    mFrameHeader.ts.tv_usec = (lNow % seconds(1)).count();
+                    mFrameHeader.caplen     = aFrame.size();
+                    mFrameHeader.len        = aFrame.size();
+                    ReadCallback(reinterpret_cast<const unsigned char*>(aFrame.data()), &mFrameHeader);
+                }};
+
+                while (mConnected) {
+                    mSocket.Receive(lCallback, cReceiveTimeout);
+                }
+            });
+        }
+    } else {
+        Logger::GetInstance().Log("Can't start receiving without a socket!", Logger::Level::ERROR);
+    }
+
+    return lReturn;
+}
@@ -0,0 +1,447 @@
+#include "../Includes/XdpSocket.h"
+
+/* Copyright (c) 2021 [Rick de Bondt] - XdpSocket.cpp */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../Includes/Logger.h"
+
+#if defined(__linux__)
+namespace
+{
+    constexpr std::size_t               cUmemSize{cUmemFrameSize * cUmemFrameCount};
+    constexpr uint32_t                  cRingMask{cXdpRingSize - 1};
+    // The XDP program only calls helpers that are not limited to GPL programs.
+    constexpr std::string_view          cProgramLicense{"MIT"};
+    // The driver can keep refusing frames, give up on sending them for now after this many tries.
+    constexpr unsigned int              cMaxKicks{cXdpRingSize};
+    constexpr unsigned int              cBindRetries{100};
+    constexpr std::chrono::milliseconds cBindRetryDelay{1};
+
+    std::string ErrorString()
+    {
+        return std::string(strerror(errno));
+    }
+
+    // The kernel moves the other end of every ring, so the indices have to be read and written atomically.
+    std::atomic_ref<uint32_t> GetIndex(uint32_t* aIndex)
+    {
+        return std::atomic_ref<uint32_t>(*aIndex);
+    }
+
+    uint64_t ToAddress(const void* aPointer)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(aPointer));
+    }
+
+    int Bpf(bpf_cmd aCommand, bpf_attr& aAttributes)
+    {
+        return static_cast<int>(syscall(__NR_bpf, aCommand, &aAttributes, sizeof(aAttributes)));
+    }
+}  // namespace
+#endif
+
+XdpSocket::~XdpSocket()
+{
+    Close();
+}
+
+#if defined(__linux__)
+bool XdpSocket::Open(std::string_view aAdapter, uint32_t aQueue)
+{
+    bool lReturn{false};
+
+    Close();
+
+    unsigned int lAdapterIndex{if_nametoindex(std::string(aAdapter).c_str())};
+    void*        lUmem{mmap(nullptr, cUmemSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    mUmem = (lUmem != MAP_FAILED) ? static_cast<char*>(lUmem) : nullptr;
+
+    xdp_umem_reg lUmemRegistration{};
+    lUmemRegistration.addr       = ToAddress(mUmem);
+    lUmemRegistration.len        = cUmemSize;
+    lUmemRegistration.chunk_size = cUmemFrameSize;
+
+    int lRingSize{cXdpRingSize};
+
+    mSocket = socket(AF_XDP, SOCK_RAW, 0);
+
+    if (mSocket == -1) {
+        Logger::GetInstance().Log("Could not create XDP socket, " + ErrorString(), Logger::Level::ERROR);
+    } else if (lAdapterIndex == 0) {
+        Logger::GetInstance().Log("Could not find adapter " + std::string(aAdapter) + " to open XDP socket on",
+                                  Logger::Level::ERROR);
+    } else if (aQueue >= cMaxQueues) {
+        Logger::GetInstance().Log("XDP queue out of range: " + std::to_string(aQueue), Logger::Level::ERROR);
+    } else if (mUmem == nullptr) {
+        Logger::GetInstance().Log("Could not allocate UMEM, " + ErrorString(), Logger::Level::ERROR);
+    } else if (setsockopt(mSocket, SOL_XDP, XDP_UMEM_REG, &lUmemRegistration, sizeof(lUmemRegistration)) != 0) {
+        Logger::GetInstance().Log("Could not register UMEM, " + ErrorString(), Logger::Level::ERROR);
+    } else if ((setsockopt(mSocket, SOL_XDP, XDP_UMEM_FILL_RING, &lRingSize, sizeof(lRingSize)) != 0) ||
+               (setsockopt(mSocket, SOL_XDP, XDP_UMEM_COMPLETION_RING, &lRingSize, sizeof(lRingSize)) != 0) ||
+               (setsockopt(mSocket, SOL_XDP, XDP_RX_RING, &lRingSize, sizeof(lRingSize)) != 0) ||
+               (setsockopt(mSocket, SOL_XDP, XDP_TX_RING, &lRingSize, sizeof(lRingSize)) != 0)) {
+        Logger::GetInstance().Log("Could not set up XDP rings, " + ErrorString(), Logger::Level::ERROR);
+    } else if (MapRings()) {
+        // Hand every frame to receive into to the kernel, and keep the others to send from.
+        uint32_t lProducer{GetIndex(mFillRing.mProducer).load(std::memory_order_relaxed)};
+        auto*    lFillDescriptors{reinterpret_cast<uint64_t*>(mFillRing.mDescriptors)};
+        for (std::size_t lFrame = 0; lFrame < cReceiveFrameCount; lFrame++) {
+            lFillDescriptors[(lProducer++) & cRingMask] = lFrame * cUmemFrameSize;
+        }
+        GetIndex(mFillRing.mProducer).store(lProducer, std::memory_order_release);
+
+        for (std::size_t lFrame = 0; lFrame < cSendFrameCount; lFrame++) {
+            mFreeFrames.at(lFrame) = (cReceiveFrameCount + lFrame) * cUmemFrameSize;
+        }
+        mFreeFrameCount = cSendFrameCount;
+
+        // Generic mode, the kernel copies frames from and to the UMEM so any driver can be used.
+        sockaddr_xdp lAddress{};
+        lAddress.sxdp_family   = AF_XDP;
+        lAddress.sxdp_flags    = XDP_COPY;
+        lAddress.sxdp_ifindex  = lAdapterIndex;
+        lAddress.sxdp_queue_id = aQueue;
+
+        // The kernel lets go of the queue of a socket closed before in the background, so wait for it a bit.
+        int lBound{bind(mSocket, reinterpret_cast<sockaddr*>(&lAddress), sizeof(lAddress))};
+        for (unsigned int lRetry = 0; (lBound != 0) && (errno == EBUSY) && (lRetry < cBindRetries); lRetry++) {
+            std::this_thread::sleep_for(cBindRetryDelay);
+            lBound = bind(mSocket, reinterpret_cast<sockaddr*>(&lAddress), sizeof(lAddress));
+        }
+
+        if (lBound != 0) {
+            Logger::GetInstance().Log("Could not bind XDP socket, " + ErrorString(), Logger::Level::ERROR);
+        } else {
+            lReturn = AttachProgram(lAdapterIndex, aQueue);
+        }
+    }
+
+    if (!lReturn) {
+        Close();
+    }
+
+    return lReturn;
+}
+
+bool XdpSocket::MapRings()
+{
+    bool             lReturn{true};
+    xdp_mmap_offsets lOffsets{};
+    socklen_t        lOffsetsLength{sizeof(lOffsets)};
+
+    auto lMapRing{[&](Ring& aRing, off_t aPageOffset, const xdp_ring_offset& aOffsets, std::size_t aDescriptorSize) {
+        aRing.mMapSize = aOffsets.desc + cXdpRingSize * aDescriptorSize;
+        void* lMap{
+            mmap(nullptr, aRing.mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mSocket, aPageOffset)};
+        if (lMap != MAP_FAILED) {
+            aRing.mMap         = static_cast<char*>(lMap);
+            aRing.mProducer    = reinterpret_cast<uint32_t*>(aRing.mMap + aOffsets.producer);
+            aRing.mConsumer    = reinterpret_cast<uint32_t*>(aRing.mMap + aOffsets.consumer);
+            aRing.mDescriptors = aRing.mMap + aOffsets.desc;
+        } else {
+            Logger::GetInstance().Log("Could not map XDP ring, " + ErrorString(), Logger::Level::ERROR);
+            aRing.mMapSize = 0;
+            lReturn        = false;
+        }
+    }};
+
+    if (getsockopt(mSocket, SOL_XDP, XDP_MMAP_OFFSETS, &lOffsets, &lOffsetsLength) == 0) {
+        lMapRing(mFillRing, XDP_UMEM_PGOFF_FILL_RING, lOffsets.fr, sizeof(uint64_t));
+        lMapRing(mCompletionRing, XDP_UMEM_PGOFF_COMPLETION_RING, lOffsets.cr, sizeof(uint64_t));
+        lMapRing(mReceiveRing, XDP_PGOFF_RX_RING, lOffsets.rx, sizeof(xdp_desc));
+        lMapRing(mSendRing, XDP_PGOFF_TX_RING, lOffsets.tx, sizeof(xdp_desc));
+    } else {
+        Logger::GetInstance().Log("Could not get XDP ring offsets, " + ErrorString(), Logger::Level::ERROR);
+        lReturn = false;
+    }
+
+    return lReturn;
+}
+
+bool XdpSocket::AttachProgram(unsigned int aAdapterIndex, uint32_t aQueue)
+{
+    bool lReturn{false};
+
+    // The map tells the program which socket every queue of the adapter goes to.
+    bpf_attr lMapAttributes{};
+    lMapAttributes.map_type    = BPF_MAP_TYPE_XSKMAP;
+    lMapAttributes.key_size    = sizeof(uint32_t);
+    lMapAttributes.value_size  = sizeof(int);
+    lMapAttributes.max_entries = cMaxQueues;
+    int lMap{Bpf(BPF_MAP_CREATE, lMapAttributes)};
+
+    bpf_attr lElementAttributes{};
+    lElementAttributes.map_fd = static_cast<uint32_t>(lMap);
+    lElementAttributes.key    = ToAddress(&aQueue);
+    lElementAttributes.value  = ToAddress(&mSocket);
+    lElementAttributes.flags  = BPF_ANY;
+
+    // return bpf_redirect_map(&map, ctx->rx_queue_index, XDP_PASS), so frames on other queues go on as usual.
+    std::array<bpf_insn, 6> lInstructions{{
+        {BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(xdp_md, rx_queue_index), 0},
+        {BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, lMap},
+        {0, 0, 0, 0, 0},
+        {BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS},
+        {BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map},
+        {BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+    }};
+
+    bpf_attr lProgramAttributes{};
+    lProgramAttributes.prog_type            = BPF_PROG_TYPE_XDP;
+    lProgramAttributes.expected_attach_type = BPF_XDP;
+    lProgramAttributes.insn_cnt             = lInstructions.size();
+    lProgramAttributes.insns                = ToAddress(lInstructions.data());
+    lProgramAttributes.license              = ToAddress(cProgramLicense.data());
+
+    int lProgram{-1};
+    if (lMap == -1) {
+        Logger::GetInstance().Log("Could not create XDP socket map, " + ErrorString(), Logger::Level::ERROR);
+    } else if (Bpf(BPF_MAP_UPDATE_ELEM, lElementAttributes) != 0) {
+        Logger::GetInstance().Log("Could not add XDP socket to map, " + ErrorString(), Logger::Level::ERROR);
+    } else if ((lProgram = Bpf(BPF_PROG_LOAD, lProgramAttributes)) == -1) {
+        Logger::GetInstance().Log("Could not load XDP program, " + ErrorString(), Logger::Level::ERROR);
+    } else {
+        // A link detaches the program by itself once it gets closed, even if the program crashes.
+        bpf_attr lLinkAttributes{};
+        lLinkAttributes.link_create.prog_fd        = static_cast<uint32_t>(lProgram);
+        lLinkAttributes.link_create.target_ifindex = aAdapterIndex;
+        lLinkAttributes.link_create.attach_type    = BPF_XDP;
+        lLinkAttributes.link_create.flags          = XDP_FLAGS_SKB_MODE;
+
+        mLink = Bpf(BPF_LINK_CREATE, lLinkAttributes);
+        if (mLink != -1) {
+            lReturn = true;
+        } else {
+            Logger::GetInstance().Log("Could not attach XDP program, " + ErrorString(), Logger::Level::ERROR);
+        }
+    }
+
+    // The link keeps the program around, and the program the map.
+    if (lProgram != -1) {
+        close(lProgram);
+    }
+
+    if (lMap != -1) {
+        close(lMap);
+    }
+
+    return lReturn;
+}
+
+void XdpSocket::Close()
+{
+    std::lock_guard<std::mutex> lLock{mSendMutex};
+
+    if (mLink != -1) {
+        close(mLink);
+    }
+
+    for (Ring* lRing : {&mFillRing, &mCompletionRing, &mReceiveRing, &mSendRing}) {
+        if (lRing->mMap != nullptr) {
+            munmap(lRing->mMap, lRing->mMapSize);
+        }
+        *lRing = Ring{};
+    }
+
+    if (mSocket != -1) {
+        close(mSocket);
+    }
+
+    if (mUmem != nullptr) {
+        munmap(mUmem, cUmemSize);
+    }
+
+    mSocket         = -1;
+    mLink           = -1;
+    mUmem           = nullptr;
+    mFreeFrameCount = 0;
+    mQueued         = 0;
+}
+
+std::size_t XdpSocket::Receive(const std::function<void(std::string_view)>& aCallback,
+                               std::chrono::milliseconds                    aTimeout)
+{
+    std::size_t lReturn{0};
+    pollfd      lPoll{mSocket, POLLIN, 0};
+
+    if ((mSocket != -1) && (poll(&lPoll, 1, static_cast<int>(aTimeout.count())) > 0)) {
+        uint32_t lProducer{GetIndex(mReceiveRing.mProducer).load(std::memory_order_acquire)};
+        uint32_t lConsumer{GetIndex(mReceiveRing.mConsumer).load(std::memory_order_relaxed)};
+        uint32_t lFillProducer{GetIndex(mFillRing.mProducer).load(std::memory_order_relaxed)};
+        auto*    lDescriptors{reinterpret_cast<xdp_desc*>(mReceiveRing.mDescriptors)};
+        auto*    lFillDescriptors{reinterpret_cast<uint64_t*>(mFillRing.mDescriptors)};
+
+        for (; lConsumer != lProducer; lConsumer++) {
+            const xdp_desc& lDescriptor{lDescriptors[lConsumer & cRingMask]};
+            aCallback(std::string_view(mUmem + lDescriptor.addr, lDescriptor.len));
+
+            // Every frame goes right back to the kernel to receive into, it is a frame again from the start.
+            lFillDescriptors[(lFillProducer++) & cRingMask] = lDescriptor.addr - (lDescriptor.addr % cUmemFrameSize);
+            lReturn++;
+        }
+
+        GetIndex(mReceiveRing.mConsumer).store(lConsumer, std::memory_order_release);
+        GetIndex(mFillRing.mProducer).store(lFillProducer, std::memory_order_release);
+    }
+
+    return lReturn;
+}
+
+bool XdpSocket::Queue(std::string_view aData)
+{
+    bool lReturn{false};
+
+    std::lock_guard<std::mutex> lLock{mSendMutex};
+
+    if (mSocket == -1) {
+        Logger::GetInstance().Log("Cannot send packets on a socket that has not been opened yet!",
+                                  Logger::Level::ERROR);
+    } else if (aData.empty() || (aData.size() > cUmemFrameSize)) {
+        Logger::GetInstance().Log("Frame does not fit in UMEM: " + std::to_string(aData.size()), Logger::Level::ERROR);
+    } else {
+        Reclaim();
+
+        // Every frame to send from is waiting on the kernel, so have it catch up.
+        if (mFreeFrameCount == 0) {
+            Kick();
+            Reclaim();
+        }
+
+        if (mFreeFrameCount > 0) {
+            uint64_t lAddress{mFreeFrames.at(--mFreeFrameCount)};
+            std::copy(aData.begin(), aData.end(), mUmem + lAddress);
+
+            uint32_t lProducer{GetIndex(mSendRing.mProducer).load(std::memory_order_relaxed)};
+            auto&    lDescriptor{reinterpret_cast<xdp_desc*>(mSendRing.mDescriptors)[lProducer & cRingMask]};
+            lDescriptor.addr    = lAddress;
+            lDescriptor.len     = static_cast<uint32_t>(aData.size());
+            lDescriptor.options = 0;
+            GetIndex(mSendRing.mProducer).store(lProducer + 1, std::memory_order_release);
+
+            mQueued++;
+            lReturn = true;
+        } else {
+            Logger::GetInstance().Log("XDP TX ring is full", Logger::Level::ERROR);
+        }
+    }
+
+    return lReturn;
+}
+
+bool XdpSocket::Flush()
+{
+    bool lReturn{true};
+
+    std::lock_guard<std::mutex> lLock{mSendMutex};
+
+    if ((mSocket != -1) && (mQueued > 0)) {
+        mQueued = 0;
+        lReturn = Kick();
+    }
+
+    return lReturn;
+}
+
+bool XdpSocket::Kick()
+{
+    bool         lReturn{true};
+    unsigned int lKicks{0};
+    uint32_t     lProducer{GetIndex(mSendRing.mProducer).load(std::memory_order_relaxed)};
+
+    // In generic mode the frames get sent during the system call, a batch at a time.
+    while (lReturn && (GetIndex(mSendRing.mConsumer).load(std::memory_order_acquire) != lProducer)) {
+        if ((sendto(mSocket, nullptr, 0, MSG_DONTWAIT, nullptr, 0) == -1) && (errno != EAGAIN)) {
+            Logger::GetInstance().Log("Could not kick XDP TX ring, " + ErrorString(), Logger::Level::ERROR);
+            lReturn = false;
+        } else if (++lKicks >= cMaxKicks) {
+            Logger::GetInstance().Log("Adapter keeps refusing frames from XDP TX ring", Logger::Level::ERROR);
+            lReturn = false;
+        }
+    }
+
+    return lReturn;
+}
+
+void XdpSocket::Reclaim()
+{
+    uint32_t lProducer{GetIndex(mCompletionRing.mProducer).load(std::memory_order_acquire)};
+    uint32_t lConsumer{GetIndex(mCompletionRing.mConsumer).load(std::memory_order_relaxed)};
+    auto*    lDescriptors{reinterpret_cast<uint64_t*>(mCompletionRing.mDescriptors)};
+
+    for (; lConsumer != lProducer; lConsumer++) {
+        mFreeFrames.at(mFreeFrameCount++) = lDescriptors[lConsumer & cRingMask];
+    }
+
+    GetIndex(mCompletionRing.mConsumer).store(lConsumer, std::memory_order_release);
+}
+#else
+bool XdpSocket::Open(std::string_view /*aAdapter*/, uint32_t /*aQueue*/)
+{
+    Logger::GetInstance().Log("XDP sockets are only available on Linux", Logger::Level::ERROR);
+    return false;
+}
+
+void XdpSocket::Close() {}
+
+std::size_t XdpSocket::Receive(const std::function<void(std::string_view)>& /*aCallback*/,
+                               std::chrono::milliseconds aTimeout)
+{
+    std::this_thread::sleep_for(aTimeout);
+    return 0;
+}
+
+bool XdpSocket::Queue(std::string_view /*aData*/)
+{
+    return false;
+}
+
+bool XdpSocket::Flush()
+{
+    return true;
+}
+
+bool XdpSocket::Kick()
+{
+    return true;
+}
+
+bool XdpSocket::MapRings()
+{
+    return false;
+}
+
+bool XdpSocket::AttachProgram(unsigned int /*aAdapterIndex*/, uint32_t /*aQueue*/)
+{
+    return false;
+}
+
+void XdpSocket::Reclaim() {}
+#endif
+
+bool XdpSocket::IsOpen() const
+{
+    return mSocket != -1;
+}
+
+bool XdpSocket::Send(std::string_view aData)
+{
+    return Queue(aData) && Flush();
+}
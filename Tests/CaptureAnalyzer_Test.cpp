@@ -0,0 +1,158 @@
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureAnalyzer_Test.cpp
+ * This file contains tests for the parallel analysis of captures.
+ **/
+
+#include "../Includes/CaptureAnalyzer.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/PcapNgWriter.h"
+#include "../Includes/TrafficGenerator.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr uint32_t cSnapshotLength{65535};
+
+    /**
+     * Checks whether two sets of statistics are the same, apart from rounding of the inter-arrival times.
+     */
+    void ExpectSame(const FrameStatistics& aStatistics, const FrameStatistics& aExpected)
+    {
+        EXPECT_EQ(aStatistics.mFrames, aExpected.mFrames);
+        EXPECT_EQ(aStatistics.mBytes, aExpected.mBytes);
+        EXPECT_EQ(aStatistics.mRetries, aExpected.mRetries);
+        EXPECT_EQ(aStatistics.mForwarded, aExpected.mForwarded);
+        EXPECT_EQ(aStatistics.mDropped, aExpected.mDropped);
+        EXPECT_EQ(aStatistics.mRates, aExpected.mRates);
+        EXPECT_EQ(aStatistics.mInterArrival.mGaps, aExpected.mInterArrival.mGaps);
+        EXPECT_NEAR(aStatistics.mInterArrival.GetMean(), aExpected.mInterArrival.GetMean(), 1e-3);
+        EXPECT_NEAR(aStatistics.mInterArrival.GetJitter(), aExpected.mInterArrival.GetJitter(), 1e-3);
+    }
+}  // namespace
+
+class CaptureAnalyzerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        TrafficGenerator lGenerator{TrafficMix{}};
+        PcapNgWriter     lWriter{};
+        ASSERT_TRUE(lWriter.Open(cFileName));
+        uint32_t lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeRadioTap, cSnapshotLength)};
+        for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(2))) {
+            ASSERT_TRUE(lWriter.WritePacket(lInterface, lFrame.mTimestamp, lFrame.mData));
+
+            uint16_t lLength{0};
+            memcpy(&lLength, lFrame.mData.data() + RadioTap_Constants::cLengthIndex, sizeof(lLength));
+            mRetries += ((lFrame.mData.at(lLength + 1) & Net_80211_Constants::cDataRetryFlag) != 0) ? 1 : 0;
+            mForwarded += lFrame.mEthernet.empty() ? 0 : 1;
+            mFrames++;
+        }
+        lWriter.Close();
+
+        mOptions.mSSIDFilter.emplace_back(lGenerator.GetSSID(0));
+        mBSSID = lGenerator.GetBSSID(0);
+        ASSERT_TRUE(mCapture.Open(cFileName));
+    }
+
+    static constexpr std::string_view cFileName{"../Tests/Output/captureanalyzer.pcapng"};
+
+    ConvertOptions mOptions{};
+    MappedCapture  mCapture{};
+    uint64_t       mBSSID{0};
+    uint64_t       mFrames{0};
+    uint64_t       mRetries{0};
+    uint64_t       mForwarded{0};
+};
+
+// Tests whether the counts add up to what has been generated, and what the program would forward
+TEST_F(CaptureAnalyzerTest, Counts)
+{
+    CaptureAnalyzer lAnalyzer{mOptions};
+    ASSERT_TRUE(lAnalyzer.Analyze(mCapture));
+
+    const CaptureStatistics& lStatistics{lAnalyzer.GetStatistics()};
+    EXPECT_EQ(lStatistics.mTotal.mFrames, mFrames);
+    EXPECT_EQ(lStatistics.mTotal.mRetries, mRetries);
+    EXPECT_EQ(lStatistics.mTotal.mForwarded, mForwarded);
+    EXPECT_EQ(lStatistics.mTotal.mInterArrival.mGaps, mFrames - 1);
+
+    uint64_t lRateFrames{0};
+    for (const auto& [lRate, lFrames] : lStatistics.mTotal.mRates) {
+        EXPECT_NE(lRate, cUnknownRate);
+        lRateFrames += lFrames;
+    }
+    EXPECT_EQ(lRateFrames, mFrames);
+
+    // Only the network locked onto gets forwarded.
+    ASSERT_EQ(lStatistics.mBSSIDs.count(mBSSID), 1);
+    EXPECT_EQ(lStatistics.mBSSIDs.at(mBSSID).mForwarded, mForwarded);
+
+    uint64_t lStationFrames{0};
+    for (const auto& [lStation, lStationStatistics] : lStatistics.mStations) {
+        lStationFrames += lStationStatistics.mFrames;
+    }
+    EXPECT_LE(lStationFrames, mFrames);
+}
+
+// Tests whether splitting the capture up in chunks gives the same statistics as going through it in one go
+TEST_F(CaptureAnalyzerTest, ChunksSameAsWhole)
+{
+    mOptions.mThreads = 1;
+    CaptureAnalyzer lWhole{mOptions};
+    ASSERT_TRUE(lWhole.Analyze(mCapture));
+
+    mOptions.mThreads   = 4;
+    mOptions.mChunkSize = 33;
+    CaptureAnalyzer lChunked{mOptions};
+    ASSERT_TRUE(lChunked.Analyze(mCapture));
+
+    const CaptureStatistics& lExpected{lWhole.GetStatistics()};
+    const CaptureStatistics& lStatistics{lChunked.GetStatistics()};
+    ExpectSame(lStatistics.mTotal, lExpected.mTotal);
+    ASSERT_EQ(lStatistics.mBSSIDs.size(), lExpected.mBSSIDs.size());
+    for (const auto& [lBSSID, lBSSIDStatistics] : lExpected.mBSSIDs) {
+        ExpectSame(lStatistics.mBSSIDs.at(lBSSID), lBSSIDStatistics);
+    }
+    ASSERT_EQ(lStatistics.mStations.size(), lExpected.mStations.size());
+    for (const auto& [lStation, lStationStatistics] : lExpected.mStations) {
+        ExpectSame(lStatistics.mStations.at(lStation), lStationStatistics);
+    }
+}
+
+// Tests whether inter-arrival statistics of consecutive parts combine into those of the whole
+TEST(InterArrivalStatistics, Merge)
+{
+    std::vector<nanoseconds> lTimestamps{0us, 10us, 25us, 26us, 60us, 61us, 100us, 190us};
+
+    InterArrivalStatistics lWhole{};
+    for (nanoseconds lTimestamp : lTimestamps) {
+        lWhole.Add(lTimestamp);
+    }
+    EXPECT_NEAR(lWhole.GetMean(), 190000.0 / 7, 1e-6);
+
+    for (std::size_t lSplit = 0; lSplit <= lTimestamps.size(); lSplit++) {
+        InterArrivalStatistics lFirst{};
+        InterArrivalStatistics lSecond{};
+        for (std::size_t lIndex = 0; lIndex < lTimestamps.size(); lIndex++) {
+            (lIndex < lSplit ? lFirst : lSecond).Add(lTimestamps.at(lIndex));
+        }
+        lFirst.Merge(lSecond);
+
+        EXPECT_EQ(lFirst.mGaps, lWhole.mGaps) << lSplit;
+        EXPECT_NEAR(lFirst.GetMean(), lWhole.GetMean(), 1e-6) << lSplit;
+        EXPECT_NEAR(lFirst.GetJitter(), lWhole.GetJitter(), 1e-6) << lSplit;
+    }
+}
+
+// Tests whether rates show up like Wireshark shows them
+TEST(CaptureAnalyzer, RateToText)
+{
+    EXPECT_EQ(RateToText(2), "1");
+    EXPECT_EQ(RateToText(11), "5.5");
+    EXPECT_EQ(RateToText(108), "54");
+    EXPECT_EQ(RateToText(cMCSRate + 7), "MCS 7");
+    EXPECT_EQ(RateToText(cUnknownRate), "unknown");
+}
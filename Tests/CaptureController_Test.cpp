@@ -0,0 +1,100 @@
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureController_Test.cpp
+ * This file contains tests for the adaptive capture controller.
+ **/
+
+#include "../Includes/CaptureController.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/Metrics.h"
+
+using namespace std::chrono;
+
+// Tests whether drops grow the buffer and tighten the filter, and the filter gets relaxed after a quiet period
+TEST(CaptureControllerTest, GrowAndRelax)
+{
+    CaptureController        lController{};
+    steady_clock::time_point lNow{steady_clock::now()};
+
+    CaptureAdjustment lAdjustment{lController.Update(0, 0, lNow)};
+    EXPECT_FALSE(lAdjustment.mGrowBuffer || lAdjustment.mTightenFilter || lAdjustment.mRelaxFilter);
+    EXPECT_EQ(lController.GetBufferSize(), cInitialBufferSize);
+
+    lNow += 1s;
+    lAdjustment = lController.Update(10, 0, lNow);
+    EXPECT_TRUE(lAdjustment.mGrowBuffer);
+    EXPECT_TRUE(lAdjustment.mTightenFilter);
+    EXPECT_EQ(lController.GetBufferSize(), cInitialBufferSize * 2);
+    EXPECT_TRUE(lController.IsFilterTightened());
+
+    // The handle got re-activated, so the counters start from zero
+    lController.Restarted();
+    lNow += 1s;
+    lAdjustment = lController.Update(5, 0, lNow);
+    EXPECT_TRUE(lAdjustment.mGrowBuffer);
+    EXPECT_FALSE(lAdjustment.mTightenFilter);
+    EXPECT_EQ(lController.GetKernelDrops(), 15);
+
+    // Interface drops do not say anything about the buffer
+    lController.Restarted();
+    lNow += 1s;
+    lAdjustment = lController.Update(0, 3, lNow);
+    EXPECT_FALSE(lAdjustment.mGrowBuffer);
+    EXPECT_EQ(lController.GetInterfaceDrops(), 3);
+
+    lNow += cRelaxFilterAfter / 2;
+    EXPECT_FALSE(lController.Update(0, 3, lNow).mRelaxFilter);
+
+    lNow += cRelaxFilterAfter;
+    EXPECT_TRUE(lController.Update(0, 3, lNow).mRelaxFilter);
+    EXPECT_FALSE(lController.IsFilterTightened());
+    EXPECT_EQ(lController.GetBufferSize(), cInitialBufferSize * 4);
+}
+
+// Tests whether the buffer stops growing at the maximum, or at the size the handle could not be activated with
+TEST(CaptureControllerTest, BufferLimits)
+{
+    CaptureController        lController{};
+    steady_clock::time_point lNow{steady_clock::now()};
+
+    for (uint64_t lDrops = 1; lDrops < 20; lDrops++) {
+        lController.Update(lDrops, 0, lNow);
+    }
+    EXPECT_EQ(lController.GetBufferSize(), cMaximumBufferSize);
+
+    CaptureController lFailingController{};
+    lFailingController.Update(1, 0, lNow);
+    lFailingController.Update(2, 0, lNow);
+    lFailingController.RevertBufferSize();
+    EXPECT_EQ(lFailingController.GetBufferSize(), cInitialBufferSize * 2);
+    EXPECT_FALSE(lFailingController.Update(3, 0, lNow).mGrowBuffer);
+}
+
+// Tests whether the drops and capture gauges add up over multiple capture devices instead of overwriting each other
+TEST(CaptureControllerTest, GaugesAddUp)
+{
+    Metrics&                 lMetrics{Metrics::GetInstance()};
+    MetricsSnapshot          lBefore{lMetrics.GetSnapshot()};
+    steady_clock::time_point lNow{steady_clock::now()};
+
+    {
+        CaptureController lFirst{};
+        CaptureController lSecond{};
+        lFirst.Update(10, 1, lNow);
+        lSecond.Update(5, 0, lNow);
+        lSecond.Update(7, 0, lNow);
+
+        MetricsSnapshot lDuring{lMetrics.GetSnapshot()};
+        EXPECT_EQ(lDuring.Get(Counter::KernelDrops) - lBefore.Get(Counter::KernelDrops), 17);
+        EXPECT_EQ(lDuring.Get(Counter::InterfaceDrops) - lBefore.Get(Counter::InterfaceDrops), 1);
+        EXPECT_EQ(lDuring.Get(Gauge::CaptureBufferSize) - lBefore.Get(Gauge::CaptureBufferSize),
+                  lFirst.GetBufferSize() + lSecond.GetBufferSize());
+        EXPECT_EQ(lDuring.Get(Gauge::CaptureFilterTightened) - lBefore.Get(Gauge::CaptureFilterTightened), 2);
+    }
+
+    // Devices that are gone no longer have a buffer or filter, their drops stay counted
+    MetricsSnapshot lAfter{lMetrics.GetSnapshot()};
+    EXPECT_EQ(lAfter.Get(Counter::KernelDrops) - lBefore.Get(Counter::KernelDrops), 17);
+    EXPECT_EQ(lAfter.Get(Gauge::CaptureBufferSize), lBefore.Get(Gauge::CaptureBufferSize));
+    EXPECT_EQ(lAfter.Get(Gauge::CaptureFilterTightened), lBefore.Get(Gauge::CaptureFilterTightened));
+}
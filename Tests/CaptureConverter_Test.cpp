@@ -0,0 +1,144 @@
+/* Copyright (c) 2021 [Rick de Bondt] - CaptureConverter_Test.cpp
+ * This file contains tests for the parallel conversion of captures.
+ **/
+
+#include "../Includes/CaptureConverter.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/NetConversionFunctions.h"
+#include "../Includes/PcapNgWriter.h"
+#include "../Includes/TrafficGenerator.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr uint32_t cSnapshotLength{65535};
+
+    /**
+     * Reads all packets of a capture.
+     * @param aPath - Capture to read.
+     * @return the packets, empty if the capture could not be read.
+     */
+    std::vector<std::string> ReadAll(std::string_view aPath)
+    {
+        std::vector<std::string> lReturn{};
+        MappedCapture            lCapture{};
+        CapturedPacket           lPacket{};
+
+        if (lCapture.Open(aPath)) {
+            MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+            while (lCursor.Next(lPacket)) {
+                lReturn.emplace_back(lPacket.mData);
+            }
+        }
+
+        return lReturn;
+    }
+
+    /**
+     * Converts a capture.
+     * @param aOptions - How to convert.
+     * @param aInput - Capture to convert.
+     * @param aOutput - Capture to write to.
+     * @return true if successful.
+     */
+    bool Convert(const ConvertOptions& aOptions, std::string_view aInput, std::string_view aOutput)
+    {
+        CaptureConverter lConverter{aOptions};
+        MappedCapture    lInput{};
+        PcapNgWriter     lOutput{};
+
+        return lInput.Open(aInput) && lOutput.Open(aOutput) && lConverter.Convert(lInput, lOutput);
+    }
+}  // namespace
+
+class CaptureConverterTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        TrafficMix lMix{};
+        lMix.mForeignNetworks = 2;
+        lMix.mRetryRatio      = 0;
+
+        TrafficGenerator lGenerator{lMix};
+        PcapNgWriter     lWriter{};
+        ASSERT_TRUE(lWriter.Open(cMonitorFileName));
+        uint32_t lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeRadioTap, cSnapshotLength)};
+        for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(2))) {
+            ASSERT_TRUE(lWriter.WritePacket(lInterface, lFrame.mTimestamp, lFrame.mData));
+            if (!lFrame.mEthernet.empty()) {
+                mExpected.push_back(lFrame.mEthernet);
+            }
+        }
+        lWriter.Close();
+
+        mOptions.mSSIDFilter.emplace_back(lGenerator.GetSSID(0));
+        mOptions.mThreads   = 4;
+        mOptions.mChunkSize = 97;
+        mBSSID              = lGenerator.GetBSSID(0);
+    }
+
+    static constexpr std::string_view cMonitorFileName{"../Tests/Output/captureconverter_monitor.pcapng"};
+    static constexpr std::string_view cEthernetFileName{"../Tests/Output/captureconverter_ethernet.pcapng"};
+    static constexpr std::string_view cRadioTapFileName{"../Tests/Output/captureconverter_radiotap.pcapng"};
+
+    ConvertOptions           mOptions{};
+    std::vector<std::string> mExpected{};
+    uint64_t                 mBSSID{0};
+};
+
+// Tests whether converting in chunks on several threads gives the same frames, in the same order, as the program
+TEST_F(CaptureConverterTest, MonitorToPromiscuous)
+{
+    ASSERT_TRUE(Convert(mOptions, cMonitorFileName, cEthernetFileName));
+    EXPECT_EQ(ReadAll(cEthernetFileName), mExpected);
+
+    // Chunks that start before the first beacon, or consist of only one frame.
+    mOptions.mChunkSize = 1;
+    ASSERT_TRUE(Convert(mOptions, cMonitorFileName, cEthernetFileName));
+    EXPECT_EQ(ReadAll(cEthernetFileName), mExpected);
+}
+
+// Tests whether the converter gives the same output as the PacketHandling tests expect from the program
+TEST_F(CaptureConverterTest, MonitorHelloWorld)
+{
+    mOptions.mSSIDFilter = {"T#STNET"};
+    mOptions.mChunkSize  = 2;
+    ASSERT_TRUE(Convert(mOptions, "../Tests/Input/MonitorHelloWorld.pcapng", cEthernetFileName));
+    EXPECT_EQ(ReadAll(cEthernetFileName), ReadAll("../Tests/Input/MonitorToPromiscuousOutput_Expected.pcap"));
+}
+
+// Tests whether an ethernet capture converted to radiotap with the parameters of a reference converts back the same
+TEST_F(CaptureConverterTest, RoundTrip)
+{
+    ASSERT_TRUE(Convert(mOptions, cMonitorFileName, cEthernetFileName));
+
+    CaptureConverter lConverter{mOptions};
+    MappedCapture    lReference{};
+    ASSERT_TRUE(lReference.Open(cMonitorFileName));
+    ASSERT_TRUE(lConverter.TakeParametersFrom(lReference));
+    EXPECT_EQ(lConverter.GetOptions().mBSSID, mBSSID);
+
+    ASSERT_TRUE(Convert(lConverter.GetOptions(), cEthernetFileName, cRadioTapFileName));
+    EXPECT_EQ(ReadAll(cRadioTapFileName).size(), mExpected.size());
+
+    // There are no beacons in the converted capture, so the BSSID has to be given.
+    mOptions.mBSSID = mBSSID;
+    ASSERT_TRUE(Convert(mOptions, cRadioTapFileName, cEthernetFileName));
+    EXPECT_EQ(ReadAll(cEthernetFileName), mExpected);
+}
+
+// Tests whether captures that are neither radiotap nor ethernet are refused
+TEST_F(CaptureConverterTest, UnsupportedLinkType)
+{
+    PcapNgWriter lWriter{};
+    ASSERT_TRUE(lWriter.Open(cRadioTapFileName));
+    uint32_t lInterface{lWriter.AddInterface(0, cSnapshotLength)};
+    ASSERT_TRUE(lWriter.WritePacket(lInterface, nanoseconds(0), std::string(64, '\0')));
+    lWriter.Close();
+
+    EXPECT_FALSE(Convert(mOptions, cRadioTapFileName, cEthernetFileName));
+}
@@ -0,0 +1,60 @@
+/* Copyright (c) 2021 [Rick de Bondt] - FlightRecorder_Test.cpp
+ * This file contains tests for the flight recorder.
+ **/
+
+#include "../Includes/FlightRecorder.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+#include <pcap/pcap.h>
+
+class FlightRecorderTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        // Stop recording so other tests are not affected.
+        FlightRecorder::GetInstance().Init(0, "");
+    }
+};
+
+// Tests whether only the last frames are kept and dumped in the order they were recorded
+TEST_F(FlightRecorderTest, DumpKeepsLastFrames)
+{
+    FlightRecorder& lRecorder{FlightRecorder::GetInstance()};
+    lRecorder.Init(4, "../Tests/Output/");
+
+    for (int lCount = 0; lCount < 6; lCount++) {
+        lRecorder.Record(Stage::KaiReceived, Verdict::Forwarded, "Frame" + std::to_string(lCount));
+    }
+
+    ASSERT_TRUE(lRecorder.DumpToFile("../Tests/Output/flightrecorder.pcapng"));
+
+    std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+    pcap_t* lHandler{pcap_open_offline("../Tests/Output/flightrecorder.pcapng", lErrorBuffer.data())};
+    ASSERT_NE(lHandler, nullptr);
+
+    pcap_pkthdr*         lHeader{nullptr};
+    const unsigned char* lData{nullptr};
+    int                  lExpectedFrame{2};
+    while (pcap_next_ex(lHandler, &lHeader, &lData) == 1) {
+        std::string lFrame{reinterpret_cast<const char*>(lData), lHeader->caplen};
+        EXPECT_EQ(lFrame, "Frame" + std::to_string(lExpectedFrame));
+        lExpectedFrame++;
+    }
+    pcap_close(lHandler);
+
+    EXPECT_EQ(lExpectedFrame, 6);
+}
+
+// Tests whether nothing gets recorded or dumped without initializing
+TEST_F(FlightRecorderTest, NotInitialized)
+{
+    FlightRecorder& lRecorder{FlightRecorder::GetInstance()};
+    lRecorder.Init(0, "");
+    lRecorder.Record(Stage::MonitorReceived, Verdict::Dropped, "Frame");
+
+    EXPECT_EQ(lRecorder.GetFrameCount(), 0);
+    EXPECT_FALSE(lRecorder.DumpToFile("../Tests/Output/flightrecorder_empty.pcapng"));
+}
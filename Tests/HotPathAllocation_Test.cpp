@@ -0,0 +1,215 @@
+/* Copyright (c) 2021 [Rick de Bondt] - HotPathAllocation_Test.cpp
+ * This file contains tests that make sure frames are forwarded without heap allocations once everything is warmed up,
+ * with logging disabled. Built into its own executable, because it replaces operator new and malloc.
+ **/
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+
+#include "../Benchmarks/AllocationCounter.h"
+#include "../Includes/Logger.h"
+#include "../Includes/Metrics.h"
+#include "../Includes/MonitorDevice.h"
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/TrafficGenerator.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace boost::asio;
+using namespace std::chrono;
+
+namespace
+{
+    constexpr seconds      cTimeout{5};
+    constexpr microseconds cPollInterval{50};
+    constexpr unsigned int cKaiFrames{2000};
+    constexpr unsigned int cPayloadLength{300};
+    constexpr uint64_t     cSourceMAC{0x0000aa5a0c00};
+
+    /**
+     * Monitor device that does not inject, but remembers how many allocations the sending thread did.
+     */
+    class InjectionSink : public MonitorDevice
+    {
+    public:
+        bool Send(std::string_view aData) override
+        {
+            mAllocations = AllocationCounter::GetAllocations();
+            mBytes += aData.size();
+            mFrames++;
+            return true;
+        }
+
+        std::atomic<uint64_t> mAllocations{0};
+        std::atomic<uint64_t> mBytes{0};
+        std::atomic<uint64_t> mFrames{0};
+    };
+
+    /**
+     * Waits until a condition is met or the timeout passed.
+     * @param aCondition - Condition to wait for.
+     * @return true if the condition has been met.
+     */
+    template<typename Condition> bool WaitFor(Condition aCondition)
+    {
+        auto lStart{steady_clock::now()};
+        bool lReturn{aCondition()};
+        while (!lReturn && (steady_clock::now() < lStart + cTimeout)) {
+            std::this_thread::sleep_for(cPollInterval);
+            lReturn = aCondition();
+        }
+        return lReturn;
+    }
+}  // namespace
+
+class HotPathAllocationTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // Only the case without logging has to be free of allocations.
+        Logger::GetInstance().SetLogToScreen(false);
+        Logger::GetInstance().SetLogToDisk(false);
+
+        mKai.open(ip::udp::v4());
+        mKai.bind(ip::udp::endpoint(ip::address::from_string(cIp.data()), 0));
+        mKai.non_blocking(true);
+
+        mConnection->Open(cIp, mKai.local_endpoint().port());
+        mConnection->SetIncomingConnection(mSink);
+        mConnection->StartReceiverThread();
+
+        // Play XLink Kai: accept the connection request.
+        std::array<char, cMaxLength> lData{};
+        ASSERT_TRUE(WaitFor([&] {
+            boost::system::error_code lError;
+            std::size_t               lLength{mKai.receive_from(buffer(lData), mProgram, 0, lError)};
+            return !lError && (std::string_view(lData.data(), lLength).substr(0, cConnectFormat.size()) ==
+                               cConnectFormat);
+        }));
+        mKai.send_to(buffer(cConnectedString), mProgram);
+
+        ASSERT_TRUE(WaitFor([] {
+            return Metrics::GetInstance().GetSnapshot().Get(Gauge::KaiLinkState) ==
+                   static_cast<int64_t>(KaiLinkState::Connected);
+        }));
+    }
+
+    void TearDown() override
+    {
+        mConnection->Close();
+        mKai.close();
+    }
+
+    /**
+     * Throws away what the program sent to XLink Kai so far.
+     * @return amount of e;e; frames.
+     */
+    uint64_t DrainKai()
+    {
+        uint64_t                     lReturn{0};
+        std::array<char, cMaxLength> lData{};
+        boost::system::error_code    lError;
+        ip::udp::endpoint            lSender{};
+
+        std::size_t lLength{mKai.receive_from(buffer(lData), lSender, 0, lError)};
+        while (!lError) {
+            if (std::string_view(lData.data(), lLength).substr(0, cEthernetDataString.size()) == cEthernetDataString) {
+                lReturn++;
+            }
+            lLength = mKai.receive_from(buffer(lData), lSender, 0, lError);
+        }
+
+        return lReturn;
+    }
+
+    io_service                          mIoService{};
+    ip::udp::socket                     mKai{mIoService};
+    ip::udp::endpoint                   mProgram{};
+    std::shared_ptr<XLinkKaiConnection> mConnection{std::make_shared<XLinkKaiConnection>()};
+    std::shared_ptr<InjectionSink>      mSink{std::make_shared<InjectionSink>()};
+};
+
+// Tests whether captured frames go from MonitorDevice::ReadCallback through Handler80211 to XLinkKaiConnection::Send
+// without allocating.
+TEST_F(HotPathAllocationTest, AirToKai)
+{
+    TrafficMix lMix{};
+    lMix.mForeignNetworks    = 0;
+    lMix.mStationsPerNetwork = 4;
+
+    TrafficGenerator            lGenerator{lMix};
+    std::vector<GeneratedFrame> lFrames{lGenerator.Generate(seconds(1))};
+    std::vector<pcap_pkthdr>    lHeaders{};
+    uint64_t                    lExpected{0};
+    for (const GeneratedFrame& lFrame : lFrames) {
+        pcap_pkthdr lHeader{};
+        lHeader.caplen     = lFrame.mData.size();
+        lHeader.len        = lFrame.mData.size();
+        lHeader.ts.tv_sec  = duration_cast<seconds>(lFrame.mTimestamp).count();
+        lHeader.ts.tv_usec = duration_cast<microseconds>(lFrame.mTimestamp % seconds(1)).count();
+        lHeaders.push_back(lHeader);
+        lExpected += lFrame.mEthernet.empty() ? 0 : 1;
+    }
+
+    MonitorDevice lDevice{};
+    lDevice.SetConnector(mConnection);
+
+    // The first round locks onto the network and grows all buffers to the largest frame.
+    for (std::size_t lIndex = 0; lIndex < lFrames.size(); lIndex++) {
+        lDevice.ReadCallback(reinterpret_cast<const unsigned char*>(lFrames.at(lIndex).mData.data()),
+                             &lHeaders.at(lIndex));
+    }
+    DrainKai();
+
+    uint64_t lSentBefore{Metrics::GetInstance().GetSnapshot().Get(Counter::KaiFramesSent)};
+    uint64_t lAllocations{AllocationCounter::GetAllocations()};
+    for (std::size_t lIndex = 0; lIndex < lFrames.size(); lIndex++) {
+        lDevice.ReadCallback(reinterpret_cast<const unsigned char*>(lFrames.at(lIndex).mData.data()),
+                             &lHeaders.at(lIndex));
+    }
+    lAllocations = AllocationCounter::GetAllocations() - lAllocations;
+
+    EXPECT_EQ(lAllocations, 0);
+    EXPECT_EQ(Metrics::GetInstance().GetSnapshot().Get(Counter::KaiFramesSent) - lSentBefore, lExpected);
+    EXPECT_GT(DrainKai(), 0);
+}
+
+// Tests whether frames from XLink Kai go from XLinkKaiConnection::ReceiveCallback through Handler8023::ConvertPacket
+// to MonitorDevice::Send without allocating, on the receiver thread.
+TEST_F(HotPathAllocationTest, KaiToAir)
+{
+    std::string lDatagram{cEthernetDataString};
+    std::string lFrame(Net_8023_Constants::cHeaderLength + cPayloadLength, '\0');
+    memcpy(lFrame.data() + Net_8023_Constants::cDestinationAddressIndex,
+           &Net_Constants::cBroadcastMac,
+           Net_8023_Constants::cDestinationAddressLength);
+    memcpy(lFrame.data() + Net_8023_Constants::cSourceAddressIndex,
+           &cSourceMAC,
+           Net_8023_Constants::cSourceAddressLength);
+    memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex,
+           &Net_Constants::cPSPEtherType,
+           Net_8023_Constants::cEtherTypeLength);
+    lDatagram += lFrame;
+
+    // Warm up, one at a time so no frames get lost.
+    for (unsigned int lCount = 1; lCount <= cKaiFrames; lCount++) {
+        mKai.send_to(buffer(lDatagram), mProgram);
+        ASSERT_TRUE(WaitFor([&] { return mSink->mFrames == lCount; }));
+    }
+    uint64_t lAllocations{mSink->mAllocations};
+
+    for (unsigned int lCount = cKaiFrames + 1; lCount <= 2 * cKaiFrames; lCount++) {
+        mKai.send_to(buffer(lDatagram), mProgram);
+        ASSERT_TRUE(WaitFor([&] { return mSink->mFrames == lCount; }));
+    }
+
+    EXPECT_EQ(mSink->mAllocations - lAllocations, 0);
+    EXPECT_GT(mSink->mBytes, 2 * cKaiFrames * lFrame.size());
+}
@@ -0,0 +1,135 @@
+/* Copyright (c) 2021 [Rick de Bondt] - ImpairedLink_Test.cpp
+ * This file contains tests for the Impairment class of the benchmark harness, on simulated time.
+ **/
+
+#include "../Benchmarks/ImpairedLink.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/VirtualClock.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr std::string_view cDatagram{"e;e;frame"};
+    constexpr unsigned int     cDatagrams{10000};
+}  // namespace
+
+// Tests whether datagrams are held back for the delay, with the jitter spread around it
+TEST(ImpairmentTest, Delay)
+{
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    ImpairmentProfile             lProfile{"test", 10ms, 2ms};
+    Impairment                    lImpairment{lProfile, lClock, 1};
+
+    lImpairment.Push(cDatagram);
+    ASSERT_TRUE(lImpairment.GetNextDue().has_value());
+    steady_clock::time_point lDue{*lImpairment.GetNextDue()};
+    EXPECT_GE(lDue, steady_clock::time_point{8ms});
+    EXPECT_LE(lDue, steady_clock::time_point{12ms});
+
+    lClock->SleepUntil(lDue - 1us);
+    EXPECT_FALSE(lImpairment.Pop().has_value());
+    lClock->SleepUntil(lDue);
+    EXPECT_EQ(lImpairment.Pop(), std::string(cDatagram));
+    EXPECT_FALSE(lImpairment.GetNextDue().has_value());
+
+    // Without reordering every datagram stays within the jitter of the delay, so about 100 are in flight at a time.
+    unsigned int lDelivered{0};
+    for (unsigned int lCount = 0; lCount < cDatagrams; lCount++) {
+        lImpairment.Push(cDatagram);
+        lClock->SleepFor(100us);
+        while (lImpairment.Pop().has_value()) {
+            lDelivered++;
+        }
+    }
+    EXPECT_LE(lImpairment.GetStatistics().mPeakQueue, 121);
+    lClock->SleepFor(12ms);
+    while (lImpairment.Pop().has_value()) {
+        lDelivered++;
+    }
+    EXPECT_EQ(lDelivered, cDatagrams);
+    EXPECT_EQ(lImpairment.GetStatistics().mReordered, 0);
+}
+
+// Tests whether loss, duplication and reordering happen about as often as asked, the same way for the same seed
+TEST(ImpairmentTest, Chances)
+{
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    ImpairmentProfile             lProfile{"test", 50ms, 0ms, 0.2, 0.1, 0.05, cDatagrams * 2};
+    Impairment                    lImpairment{lProfile, lClock, 7};
+    Impairment                    lSameSeed{lProfile, lClock, 7};
+
+    for (unsigned int lCount = 0; lCount < cDatagrams; lCount++) {
+        lImpairment.Push(cDatagram);
+        lSameSeed.Push(cDatagram);
+    }
+
+    ImpairmentStatistics lStatistics{lImpairment.GetStatistics()};
+    EXPECT_EQ(lStatistics.mOffered, cDatagrams);
+    EXPECT_NEAR(lStatistics.mLost, cDatagrams * 0.2, cDatagrams * 0.02);
+    EXPECT_NEAR(lStatistics.mDuplicated, cDatagrams * 0.8 * 0.1, cDatagrams * 0.02);
+    EXPECT_NEAR(lStatistics.mReordered, cDatagrams * 0.88 * 0.05, cDatagrams * 0.02);
+
+    // Reordered datagrams skip the delay.
+    unsigned int lEarly{0};
+    while (lImpairment.Pop().has_value()) {
+        lEarly++;
+    }
+    EXPECT_EQ(lEarly, lStatistics.mReordered);
+
+    ImpairmentStatistics lSameSeedStatistics{lSameSeed.GetStatistics()};
+    EXPECT_EQ(lSameSeedStatistics.mLost, lStatistics.mLost);
+    EXPECT_EQ(lSameSeedStatistics.mDuplicated, lStatistics.mDuplicated);
+    EXPECT_EQ(lSameSeedStatistics.mReordered, lStatistics.mReordered);
+}
+
+// Tests whether nothing gets through at the end of every outage period
+TEST(ImpairmentTest, Outage)
+{
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    ImpairmentProfile             lProfile{"test", 0ms, 0ms, 0, 0, 0, 1000, 10s, 4s};
+    Impairment                    lImpairment{lProfile, lClock, 1};
+
+    for (unsigned int lSecond = 0; lSecond < 20; lSecond++) {
+        lImpairment.Push(cDatagram);
+        EXPECT_EQ(lImpairment.Pop().has_value(), (lSecond % 10) < 6) << lSecond;
+        lClock->SleepFor(1s);
+    }
+    EXPECT_EQ(lImpairment.GetStatistics().mOutageDrops, 8);
+}
+
+// Tests whether datagrams over the limit get dropped
+TEST(ImpairmentTest, Limit)
+{
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    ImpairmentProfile             lProfile{"test", 1s, 0ms, 0, 0, 0, 2};
+    Impairment                    lImpairment{lProfile, lClock, 1};
+
+    lImpairment.Push(cDatagram);
+    lImpairment.Push(cDatagram);
+    lImpairment.Push(cDatagram);
+    EXPECT_EQ(lImpairment.GetStatistics().mLimitDrops, 1);
+    EXPECT_EQ(lImpairment.GetStatistics().mPeakQueue, 2);
+
+    lClock->SleepFor(1s);
+    EXPECT_TRUE(lImpairment.Pop().has_value());
+    EXPECT_TRUE(lImpairment.Pop().has_value());
+    EXPECT_FALSE(lImpairment.Pop().has_value());
+}
+
+// Tests whether the profiles can be found by name
+TEST(ImpairmentTest, Profiles)
+{
+    for (const ImpairmentProfile& lProfile : cImpairmentProfiles) {
+        ASSERT_TRUE(ImpairedLink::GetProfile(lProfile.mName).has_value());
+        EXPECT_EQ(ImpairedLink::GetProfile(lProfile.mName)->mDelay, lProfile.mDelay);
+    }
+    EXPECT_FALSE(ImpairedLink::GetProfile("unknown").has_value());
+
+    // The dropout profile has to outlast the keepalive timeout, or it does not test the reconnect.
+    ASSERT_TRUE(ImpairedLink::GetProfile("dropout").has_value());
+    EXPECT_GT(ImpairedLink::GetProfile("dropout")->mOutageLength, cKeepAliveTimeout);
+}
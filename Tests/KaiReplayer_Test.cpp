@@ -0,0 +1,243 @@
+/* Copyright (c) 2021 [Rick de Bondt] - KaiReplayer_Test.cpp
+ * This file contains tests for recording XLink Kai sessions and replaying them with the KaiReplayer class.
+ **/
+
+#include "../Benchmarks/KaiReplayer.h"
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "../Includes/IPCapDevice.h"
+#include "../Includes/MappedCapture.h"
+#include "../Includes/Metrics.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr std::string_view cSessionFileName{"../Tests/Input/KaiSession.pcapng"};
+    constexpr std::string_view cRecordingFileName{"../Tests/Output/KaiSessionRecorded.pcapng"};
+    constexpr seconds          cReplayTimeout{10};
+    constexpr milliseconds     cPollInterval{10};
+    constexpr milliseconds     cDrain{200};
+
+    /**
+     * Stands in for the device injecting frames from XLink Kai, keeps everything it is asked to send.
+     */
+    class CollectingDevice : public IPCapDevice
+    {
+    public:
+        void BlackList(uint64_t /*aMAC*/) override {}
+
+        void Close() override {}
+
+        bool Open(std::string_view /*aName*/, const std::vector<std::string>& /*aSSIDFilter*/) override
+        {
+            return true;
+        }
+
+        std::string DataToString(const unsigned char* aData, const pcap_pkthdr* aHeader) override
+        {
+            return std::string(reinterpret_cast<const char*>(aData), aHeader->caplen);
+        }
+
+        const unsigned char* GetData() override
+        {
+            return nullptr;
+        }
+
+        const pcap_pkthdr* GetHeader() override
+        {
+            return nullptr;
+        }
+
+        bool Send(std::string_view aData) override
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            mFrames.emplace_back(aData);
+            return true;
+        }
+
+        void SetConnector(std::shared_ptr<IConnector> /*aDevice*/) override {}
+
+        bool StartReceiverThread() override
+        {
+            return true;
+        }
+
+        std::vector<std::string> GetFrames()
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            return mFrames;
+        }
+
+    private:
+        std::vector<std::string> mFrames{};
+        std::mutex               mMutex{};
+    };
+
+    std::vector<std::string> ReadDatagrams(std::string_view aFileName)
+    {
+        std::vector<std::string> lReturn{};
+        MappedCapture            lCapture{};
+
+        if (lCapture.Open(aFileName)) {
+            MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+            CapturedPacket        lPacket{};
+            while (lCursor.Next(lPacket)) {
+                lReturn.emplace_back(lPacket.mData);
+            }
+        }
+
+        return lReturn;
+    }
+
+    std::vector<std::string> GetFrames(const std::vector<std::string>& aDatagrams)
+    {
+        std::vector<std::string> lReturn{};
+
+        for (const std::string& lDatagram : aDatagrams) {
+            if (lDatagram.substr(0, cEthernetDataString.size()) == cEthernetDataString) {
+                lReturn.push_back(lDatagram.substr(cEthernetDataString.size()));
+            }
+        }
+
+        return lReturn;
+    }
+
+    // Time from the first datagram after the confirmation of the connection until the last one.
+    nanoseconds GetSpan(std::string_view aFileName)
+    {
+        nanoseconds   lFirst{0};
+        nanoseconds   lLast{0};
+        MappedCapture lCapture{};
+
+        if (lCapture.Open(aFileName)) {
+            MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+            CapturedPacket        lPacket{};
+            for (unsigned int lIndex = 0; lCursor.Next(lPacket); lIndex++) {
+                lFirst = (lIndex == 1) ? lPacket.mTimestamp : lFirst;
+                lLast  = lPacket.mTimestamp;
+            }
+        }
+
+        return lLast - lFirst;
+    }
+
+    /**
+     * Connects an XLinkKaiConnection to the replayer and waits until the session has been replayed and nothing more
+     * arrives.
+     * @param aReplayer - Started replayer.
+     * @param aDevice - Device the connection hands the frames to.
+     * @param aFrames - Amount of frames in the session, stops waiting when all arrived.
+     * @param aRecordingFileName - File the connection should record to, empty to not record.
+     */
+    void ReceiveSession(KaiReplayer&                             aReplayer,
+                        const std::shared_ptr<CollectingDevice>& aDevice,
+                        std::size_t                              aFrames,
+                        std::string_view                         aRecordingFileName)
+    {
+        XLinkKaiConnection lConnection{};
+        ASSERT_TRUE(lConnection.Open(cIp, aReplayer.GetPort()));
+        if (!aRecordingFileName.empty()) {
+            ASSERT_TRUE(lConnection.StartRecording(aRecordingFileName));
+        }
+        lConnection.SetIncomingConnection(aDevice);
+        lConnection.StartReceiverThread();
+
+        auto        lStart{steady_clock::now()};
+        auto        lLastProgress{lStart};
+        std::size_t lLastFrames{0};
+        while ((!aReplayer.IsDone() || ((lLastFrames < aFrames) && (steady_clock::now() < lLastProgress + cDrain))) &&
+               (steady_clock::now() < lStart + cReplayTimeout)) {
+            std::this_thread::sleep_for(cPollInterval);
+            std::size_t lFrames{aDevice->GetFrames().size()};
+            if (lFrames != lLastFrames) {
+                lLastFrames   = lFrames;
+                lLastProgress = steady_clock::now();
+            }
+        }
+        lConnection.Close();
+    }
+}  // namespace
+
+class KaiReplayerTest : public ::testing::Test
+{
+protected:
+    // The replayed frames are counted and timed in the metrics every test shares.
+    void TearDown() override
+    {
+        Metrics::GetInstance().Reset();
+    }
+};
+
+// Tests whether a session replayed with the original timing reaches the device unchanged and is recorded as it was
+TEST_F(KaiReplayerTest, ReplayAndRecord)
+{
+    std::vector<std::string> lDatagrams{ReadDatagrams(cSessionFileName)};
+    std::vector<std::string> lExpectedFrames{GetFrames(lDatagrams)};
+    ASSERT_FALSE(lExpectedFrames.empty());
+
+    KaiReplayer lReplayer{};
+    ASSERT_TRUE(lReplayer.Open(cSessionFileName));
+    ASSERT_TRUE(lReplayer.Start(0));
+
+    auto lDevice{std::make_shared<CollectingDevice>()};
+    ReceiveSession(lReplayer, lDevice, lExpectedFrames.size(), cRecordingFileName);
+    lReplayer.Stop();
+
+    KaiReplayStatistics lStatistics{lReplayer.GetStatistics()};
+    EXPECT_TRUE(lReplayer.IsDone());
+    EXPECT_EQ(lStatistics.mDatagrams, lDatagrams.size() + 1);
+    EXPECT_EQ(lStatistics.mDataFrames, lExpectedFrames.size());
+    EXPECT_EQ(lStatistics.mSendFailures, 0);
+    EXPECT_EQ(lDevice->GetFrames(), lExpectedFrames);
+
+    // Timing is kept from the first datagram after the confirmation.
+    EXPECT_GE(lStatistics.mDuration, GetSpan(cSessionFileName));
+
+    // The session starts with the connection being confirmed, so the recording holds exactly what was replayed: the
+    // session with the keepalive the replayer waits on after the confirmation.
+    lDatagrams.insert(lDatagrams.begin() + 1, std::string(cKeepAliveString));
+    EXPECT_EQ(ReadDatagrams(cRecordingFileName), lDatagrams);
+}
+
+// Tests whether a session replayed as fast as possible is sent faster than it was recorded, and arrives in order
+TEST_F(KaiReplayerTest, AsFastAsPossible)
+{
+    std::vector<std::string> lDatagrams{ReadDatagrams(cSessionFileName)};
+    std::vector<std::string> lExpectedFrames{GetFrames(lDatagrams)};
+
+    KaiReplayer lReplayer{};
+    ASSERT_TRUE(lReplayer.Open(cSessionFileName));
+    lReplayer.SetTimeAccurate(false);
+    ASSERT_TRUE(lReplayer.Start(0));
+
+    auto lDevice{std::make_shared<CollectingDevice>()};
+    ReceiveSession(lReplayer, lDevice, lExpectedFrames.size(), "");
+    lReplayer.Stop();
+
+    KaiReplayStatistics lStatistics{lReplayer.GetStatistics()};
+    EXPECT_TRUE(lReplayer.IsDone());
+    EXPECT_EQ(lStatistics.mDataFrames, lExpectedFrames.size());
+    EXPECT_LT(lStatistics.mDuration, GetSpan(cSessionFileName));
+
+    // Like with the real XLink Kai, frames the program can not keep up with are lost in the socket buffer.
+    std::vector<std::string> lFrames{lDevice->GetFrames()};
+    EXPECT_FALSE(lFrames.empty());
+    auto lExpected{lExpectedFrames.begin()};
+    for (const std::string& lFrame : lFrames) {
+        lExpected = std::find(lExpected, lExpectedFrames.end(), lFrame);
+        ASSERT_NE(lExpected, lExpectedFrames.end());
+    }
+}
+
+// Tests whether captures that do not hold XLink Kai traffic are refused
+TEST_F(KaiReplayerTest, RefusesOtherCaptures)
+{
+    KaiReplayer lReplayer{};
+    EXPECT_FALSE(lReplayer.Open("../Tests/Input/PromiscuousHelloWorld.pcapng"));
+    EXPECT_FALSE(lReplayer.Start(0));
+}
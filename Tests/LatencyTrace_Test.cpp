@@ -0,0 +1,55 @@
+/* Copyright (c) 2021 [Rick de Bondt] - LatencyTrace_Test.cpp
+ * This file contains tests for the per-frame latency trace.
+ **/
+
+#include "../Includes/LatencyTrace.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono;
+
+// Tests whether pcap timestamps in both precisions are converted to time since epoch
+TEST(LatencyTraceTest, FromTimestamp)
+{
+    timeval lTimestamp{};
+    lTimestamp.tv_sec  = 1600000000;
+    lTimestamp.tv_usec = 123456;
+
+    EXPECT_EQ(LatencyTrace::FromTimestamp(lTimestamp, false), seconds(1600000000) + microseconds(123456));
+    EXPECT_EQ(LatencyTrace::FromTimestamp(lTimestamp, true), seconds(1600000000) + nanoseconds(123456));
+}
+
+// Tests whether every step and the total end up in the right histograms
+TEST(LatencyTraceTest, Histograms)
+{
+    MetricsSnapshot lBefore{Metrics::GetInstance().GetSnapshot()};
+
+    LatencyTrace::SetSlowFrameBudget(nanoseconds(1));
+    LatencyTrace lTrace{Direction::AirToKai, LatencyTrace::Now() - milliseconds(1)};
+    lTrace.Mark(Point::Started);
+    lTrace.Mark(Point::Converted);
+    lTrace.Mark(Point::Sent);
+    lTrace.Finish();
+    LatencyTrace::SetSlowFrameBudget(nanoseconds(0));
+
+    // Frames from XLink Kai have no separate start
+    LatencyTrace lKaiTrace{Direction::KaiToAir, LatencyTrace::Now()};
+    lKaiTrace.Mark(Point::Converted);
+    lKaiTrace.Mark(Point::Sent);
+    lKaiTrace.Finish();
+
+    MetricsSnapshot lAfter{Metrics::GetInstance().GetSnapshot()};
+    auto            lRecorded = [&](Histogram aHistogram) {
+        return lAfter.Get(aHistogram).mCount - lBefore.Get(aHistogram).mCount;
+    };
+
+    EXPECT_EQ(lRecorded(Histogram::CaptureToCallback), 1);
+    EXPECT_EQ(lRecorded(Histogram::CallbackToConverted), 1);
+    EXPECT_EQ(lRecorded(Histogram::ConvertedToKaiSent), 1);
+    EXPECT_EQ(lRecorded(Histogram::CaptureToKai), 1);
+    EXPECT_GE(lAfter.Get(Histogram::CaptureToKai).mMax, static_cast<uint64_t>(nanoseconds(milliseconds(1)).count()));
+
+    EXPECT_EQ(lRecorded(Histogram::KaiToConverted), 1);
+    EXPECT_EQ(lRecorded(Histogram::ConvertedToInject), 1);
+    EXPECT_EQ(lRecorded(Histogram::KaiToInject), 1);
+}
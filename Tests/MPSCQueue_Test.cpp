@@ -0,0 +1,85 @@
+/* Copyright (c) 2021 [Rick de Bondt] - MPSCQueue_Test.cpp
+ * This file contains tests for the MPSCQueue class.
+ **/
+
+#include "../Includes/MPSCQueue.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    constexpr std::size_t  cCapacity{64};
+    constexpr unsigned int cProducers{4};
+    constexpr uint64_t     cItemsPerProducer{100000};
+
+    struct Item
+    {
+        unsigned int mProducer{0};
+        uint64_t     mSequence{0};
+    };
+}  // namespace
+
+// Tests whether a full queue refuses items, and whether items come out in the order they went in
+TEST(MPSCQueueTest, FullAndEmpty)
+{
+    MPSCQueue<uint64_t, cCapacity> lQueue{};
+    uint64_t                       lValue{0};
+
+    EXPECT_FALSE(lQueue.TryPop([&](uint64_t aValue) { lValue = aValue; }));
+
+    // Going around the ring a couple of times.
+    for (uint64_t lRound = 0; lRound < 3; lRound++) {
+        for (uint64_t lIndex = 0; lIndex < cCapacity; lIndex++) {
+            ASSERT_TRUE(lQueue.TryPush([&](uint64_t& aValue) { aValue = lRound * cCapacity + lIndex; }));
+        }
+        EXPECT_FALSE(lQueue.TryPush([](uint64_t& aValue) { aValue = 0; }));
+
+        for (uint64_t lIndex = 0; lIndex < cCapacity; lIndex++) {
+            ASSERT_TRUE(lQueue.TryPop([&](uint64_t aValue) { lValue = aValue; }));
+            EXPECT_EQ(lValue, lRound * cCapacity + lIndex);
+        }
+        EXPECT_FALSE(lQueue.TryPop([&](uint64_t aValue) { lValue = aValue; }));
+    }
+}
+
+// Tests whether nothing gets lost or reordered when multiple threads push while one thread pops
+TEST(MPSCQueueTest, MultipleProducers)
+{
+    MPSCQueue<Item, cCapacity> lQueue{};
+    std::vector<std::thread>   lProducers{};
+
+    for (unsigned int lProducer = 0; lProducer < cProducers; lProducer++) {
+        lProducers.emplace_back([&lQueue, lProducer] {
+            for (uint64_t lSequence = 0; lSequence < cItemsPerProducer; lSequence++) {
+                while (!lQueue.TryPush([&](Item& aItem) { aItem = {lProducer, lSequence}; })) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<uint64_t> lNextSequence(cProducers, 0);
+    uint64_t              lPopped{0};
+    bool                  lInOrder{true};
+    while (lPopped < cProducers * cItemsPerProducer) {
+        if (lQueue.TryPop([&](const Item& aItem) {
+                lInOrder = lInOrder && (aItem.mSequence == lNextSequence.at(aItem.mProducer));
+                lNextSequence.at(aItem.mProducer) = aItem.mSequence + 1;
+            })) {
+            lPopped++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (std::thread& lProducer : lProducers) {
+        lProducer.join();
+    }
+
+    EXPECT_TRUE(lInOrder);
+    EXPECT_EQ(lNextSequence, std::vector<uint64_t>(cProducers, cItemsPerProducer));
+    EXPECT_FALSE(lQueue.TryPop([](const Item& /*aItem*/) {}));
+}
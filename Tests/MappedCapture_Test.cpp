@@ -0,0 +1,273 @@
+/* Copyright (c) 2021 [Rick de Bondt] - MappedCapture_Test.cpp
+ * This file contains tests for the memory mapped capture reader.
+ **/
+
+#include "../Includes/MappedCapture.h"
+
+#include <array>
+#include <fstream>
+
+#include <gtest/gtest.h>
+#include <pcap/pcap.h>
+
+#include "../Includes/PcapNgWriter.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr uint32_t cSnapshotLength{65535};
+
+    std::string MakePayload(unsigned int aNumber)
+    {
+        return "packet " + std::to_string(aNumber) + std::string(aNumber % 64, static_cast<char>(aNumber));
+    }
+
+    /**
+     * Writes packets with the given timestamps to a pcapng file, alternating between a radiotap and an ethernet
+     * interface.
+     * @param aPath - File to write to.
+     * @param aTimestamps - Timestamps of the packets, payloads come from MakePayload.
+     */
+    void WriteCapture(std::string_view aPath, const std::vector<nanoseconds>& aTimestamps)
+    {
+        PcapNgWriter lWriter{};
+        ASSERT_TRUE(lWriter.Open(aPath));
+        std::array<uint32_t, 2> lInterfaces{};
+        lInterfaces.at(0) = lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeRadioTap, cSnapshotLength);
+        lInterfaces.at(1) = lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cSnapshotLength);
+        for (std::size_t lIndex = 0; lIndex < aTimestamps.size(); lIndex++) {
+            ASSERT_TRUE(lWriter.WritePacket(lInterfaces.at(lIndex % 2), aTimestamps.at(lIndex), MakePayload(lIndex)));
+        }
+        lWriter.Close();
+    }
+
+    /**
+     * Reads the whole capture with a single cursor.
+     * @param aCapture - Capture to read.
+     * @return all packets.
+     */
+    std::vector<CapturedPacket> ReadAll(const MappedCapture& aCapture)
+    {
+        std::vector<CapturedPacket> lReturn{};
+        MappedCapture::Cursor       lCursor{aCapture.GetCursor()};
+        CapturedPacket              lPacket{};
+        while (lCursor.Next(lPacket)) {
+            lReturn.push_back(lPacket);
+        }
+        return lReturn;
+    }
+}  // namespace
+
+// Tests whether the mapped reader gives the same packets as libpcap for the captures used by the other tests
+TEST(MappedCaptureTest, SameAsLibPcap)
+{
+    for (const std::string& lFileName : {"../Tests/Input/MonitorHelloWorld.pcapng",
+                                         "../Tests/Input/PromiscuousHelloWorld.pcapng",
+                                         "../Tests/Input/MonitorToPromiscuousOutput_Expected.pcap",
+                                         "../Tests/Input/PromiscuousToMonitorOutput_Expected.pcap"}) {
+        MappedCapture lCapture{};
+        ASSERT_TRUE(lCapture.Open(lFileName)) << lFileName;
+
+        std::array<char, PCAP_ERRBUF_SIZE> lErrorBuffer{};
+        pcap_t*                            lHandler{pcap_open_offline(lFileName.c_str(), lErrorBuffer.data())};
+        ASSERT_NE(lHandler, nullptr) << lFileName;
+        EXPECT_EQ(lCapture.GetLinkType(), pcap_datalink(lHandler)) << lFileName;
+
+        MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+        CapturedPacket        lPacket{};
+        pcap_pkthdr*          lHeader{nullptr};
+        const unsigned char*  lData{nullptr};
+        unsigned int          lCount{0};
+        while (pcap_next_ex(lHandler, &lHeader, &lData) == 1) {
+            ASSERT_TRUE(lCursor.Next(lPacket)) << lFileName << " packet " << lCount;
+            EXPECT_EQ(lPacket.mData, std::string_view(reinterpret_cast<const char*>(lData), lHeader->caplen));
+            EXPECT_EQ(lPacket.mOriginalLength, lHeader->len);
+            EXPECT_EQ(duration_cast<microseconds>(lPacket.mTimestamp),
+                      seconds(lHeader->ts.tv_sec) + microseconds(lHeader->ts.tv_usec));
+            lCount++;
+        }
+        pcap_close(lHandler);
+
+        EXPECT_FALSE(lCursor.Next(lPacket)) << lFileName;
+        EXPECT_GT(lCount, 0) << lFileName;
+    }
+}
+
+// Tests whether interfaces, link types and nanosecond timestamps of pcapng files come through
+TEST(MappedCaptureTest, PcapNgInterfaces)
+{
+    std::vector<nanoseconds> lTimestamps{};
+    for (unsigned int lCount = 0; lCount < 100; lCount++) {
+        lTimestamps.emplace_back(seconds(1600000000) + nanoseconds(lCount * 1001));
+    }
+    WriteCapture("../Tests/Output/mappedcapture_interfaces.pcapng", lTimestamps);
+
+    MappedCapture lCapture{};
+    ASSERT_TRUE(lCapture.Open("../Tests/Output/mappedcapture_interfaces.pcapng"));
+    EXPECT_TRUE(lCapture.IsPcapNg());
+    EXPECT_EQ(lCapture.GetLinkType(), PcapNgWriter_Constants::cLinkTypeRadioTap);
+
+    std::vector<CapturedPacket> lPackets{ReadAll(lCapture)};
+    ASSERT_EQ(lPackets.size(), lTimestamps.size());
+    for (std::size_t lIndex = 0; lIndex < lPackets.size(); lIndex++) {
+        EXPECT_EQ(lPackets.at(lIndex).mTimestamp, lTimestamps.at(lIndex));
+        EXPECT_EQ(lPackets.at(lIndex).mData, MakePayload(lIndex));
+        EXPECT_EQ(lPackets.at(lIndex).mInterface, lIndex % 2);
+        EXPECT_EQ(lPackets.at(lIndex).mLinkType,
+                  (lIndex % 2 == 0) ? PcapNgWriter_Constants::cLinkTypeRadioTap :
+                                      PcapNgWriter_Constants::cLinkTypeEthernet);
+
+        // The data should point into the mapping, not into a copy.
+        EXPECT_GE(lPackets.at(lIndex).mData.data(), lCapture.GetContents().data());
+        EXPECT_LE(lPackets.at(lIndex).mData.data() + lPackets.at(lIndex).mData.size(),
+                  lCapture.GetContents().data() + lCapture.GetContents().size());
+    }
+}
+
+// Tests whether big endian pcap files with nanosecond timestamps can be read
+TEST(MappedCaptureTest, SwappedNanosecondPcap)
+{
+    std::string lFile{};
+    auto        lAppend = [&](uint32_t aValue) {
+        for (int lShift = 24; lShift >= 0; lShift -= 8) {
+            lFile.push_back(static_cast<char>((aValue >> lShift) & 0xFF));
+        }
+    };
+
+    lAppend(MappedCapture_Constants::cPcapMagicNanoseconds);
+    lAppend(0x00020004);  // Version 2.4
+    lAppend(0);           // Time zone
+    lAppend(0);           // Timestamp accuracy
+    lAppend(cSnapshotLength);
+    lAppend(PcapNgWriter_Constants::cLinkTypeRadioTap);
+    for (unsigned int lCount = 0; lCount < 3; lCount++) {
+        std::string lPayload{MakePayload(lCount)};
+        lAppend(1600000000 + lCount);
+        lAppend(123456789);
+        lAppend(lPayload.size());
+        lAppend(lPayload.size() + 10);
+        lFile += lPayload;
+    }
+    std::ofstream("../Tests/Output/mappedcapture_swapped.pcap", std::ios::binary) << lFile;
+
+    MappedCapture lCapture{};
+    ASSERT_TRUE(lCapture.Open("../Tests/Output/mappedcapture_swapped.pcap"));
+    EXPECT_FALSE(lCapture.IsPcapNg());
+    EXPECT_EQ(lCapture.GetLinkType(), PcapNgWriter_Constants::cLinkTypeRadioTap);
+
+    std::vector<CapturedPacket> lPackets{ReadAll(lCapture)};
+    ASSERT_EQ(lPackets.size(), 3);
+    for (unsigned int lCount = 0; lCount < 3; lCount++) {
+        EXPECT_EQ(lPackets.at(lCount).mTimestamp, seconds(1600000000 + lCount) + nanoseconds(123456789));
+        EXPECT_EQ(lPackets.at(lCount).mData, MakePayload(lCount));
+        EXPECT_EQ(lPackets.at(lCount).mOriginalLength, MakePayload(lCount).size() + 10);
+    }
+}
+
+// Tests whether seeking with an index lands on the same packet as reading from the start, also with strides and
+// timestamps that go back in time
+TEST(MappedCaptureTest, Seek)
+{
+    std::vector<nanoseconds> lTimestamps{};
+    for (unsigned int lCount = 0; lCount < 1000; lCount++) {
+        // Every tenth packet is a bit late, as happens with multiple capture interfaces.
+        lTimestamps.emplace_back(seconds(1600000000) + milliseconds(lCount) - ((lCount % 10 == 0) ? 5ms : 0ms));
+    }
+    WriteCapture("../Tests/Output/mappedcapture_seek.pcapng", lTimestamps);
+
+    MappedCapture lCapture{};
+    ASSERT_TRUE(lCapture.Open("../Tests/Output/mappedcapture_seek.pcapng"));
+
+    for (std::size_t lStride : {0, 1, 7, 1000}) {
+        if (lStride > 0) {
+            ASSERT_TRUE(lCapture.BuildIndex(lStride));
+            EXPECT_EQ(lCapture.GetPacketCount(), lTimestamps.size());
+        }
+
+        MappedCapture::Cursor lCursor{lCapture.GetCursor()};
+        for (nanoseconds lTime = seconds(1600000000) - 1s; lTime < seconds(1600000001) + 1s; lTime += 777us) {
+            auto lExpected{std::find_if(lTimestamps.begin(), lTimestamps.end(), [&](nanoseconds aTimestamp) {
+                return aTimestamp >= lTime;
+            })};
+
+            CapturedPacket lPacket{};
+            ASSERT_EQ(lCursor.Seek(lTime), lExpected != lTimestamps.end()) << lStride << " " << lTime.count();
+            ASSERT_EQ(lCursor.Next(lPacket), lExpected != lTimestamps.end());
+            if (lExpected != lTimestamps.end()) {
+                ASSERT_EQ(lPacket.mData, MakePayload(lExpected - lTimestamps.begin())) << lStride;
+                ASSERT_EQ(lPacket.mLinkType,
+                          ((lExpected - lTimestamps.begin()) % 2 == 0) ? PcapNgWriter_Constants::cLinkTypeRadioTap :
+                                                                          PcapNgWriter_Constants::cLinkTypeEthernet);
+            }
+        }
+    }
+}
+
+// Tests whether cursors do not influence each other
+TEST(MappedCaptureTest, IndependentCursors)
+{
+    std::vector<nanoseconds> lTimestamps{};
+    for (unsigned int lCount = 0; lCount < 100; lCount++) {
+        lTimestamps.emplace_back(seconds(1600000000) + milliseconds(lCount));
+    }
+    WriteCapture("../Tests/Output/mappedcapture_cursors.pcapng", lTimestamps);
+
+    MappedCapture lCapture{};
+    ASSERT_TRUE(lCapture.Open("../Tests/Output/mappedcapture_cursors.pcapng"));
+
+    MappedCapture::Cursor lFirst{lCapture.GetCursor()};
+    MappedCapture::Cursor lSecond{lCapture.GetCursor()};
+    ASSERT_TRUE(lSecond.Seek(seconds(1600000000) + 50ms));
+
+    CapturedPacket lPacket{};
+    for (unsigned int lCount = 0; lCount < 50; lCount++) {
+        ASSERT_TRUE(lFirst.Next(lPacket));
+        EXPECT_EQ(lPacket.mData, MakePayload(lCount));
+
+        ASSERT_TRUE(lSecond.Next(lPacket));
+        EXPECT_EQ(lPacket.mData, MakePayload(lCount + 50));
+    }
+    EXPECT_FALSE(lSecond.Next(lPacket));
+
+    // A copy carries on where the original is.
+    MappedCapture::Cursor lCopy{lFirst};
+    ASSERT_TRUE(lCopy.Next(lPacket));
+    EXPECT_EQ(lPacket.mData, MakePayload(50));
+    ASSERT_TRUE(lFirst.Next(lPacket));
+    EXPECT_EQ(lPacket.mData, MakePayload(50));
+
+    lFirst.Rewind();
+    ASSERT_TRUE(lFirst.Next(lPacket));
+    EXPECT_EQ(lPacket.mData, MakePayload(0));
+}
+
+// Tests whether a truncated capture gives the packets before the damage, and files that are not captures fail
+TEST(MappedCaptureTest, Malformed)
+{
+    std::vector<nanoseconds> lTimestamps{};
+    for (unsigned int lCount = 0; lCount < 10; lCount++) {
+        lTimestamps.emplace_back(seconds(1600000000) + milliseconds(lCount));
+    }
+    WriteCapture("../Tests/Output/mappedcapture_truncated.pcapng", lTimestamps);
+
+    std::string lFile{};
+    {
+        MappedCapture lCapture{};
+        ASSERT_TRUE(lCapture.Open("../Tests/Output/mappedcapture_truncated.pcapng"));
+        lFile = lCapture.GetContents();
+    }
+    std::ofstream("../Tests/Output/mappedcapture_truncated.pcapng", std::ios::binary | std::ios::trunc)
+        << lFile.substr(0, lFile.size() - 10);
+
+    MappedCapture lCapture{};
+    ASSERT_TRUE(lCapture.Open("../Tests/Output/mappedcapture_truncated.pcapng"));
+    EXPECT_FALSE(lCapture.BuildIndex());
+    EXPECT_EQ(lCapture.GetPacketCount(), 9);
+    EXPECT_EQ(ReadAll(lCapture).size(), 9);
+
+    MappedCapture lNotACapture{};
+    EXPECT_FALSE(lNotACapture.Open("../Tests/Input/config_expected.txt"));
+    EXPECT_FALSE(lNotACapture.IsOpen());
+    EXPECT_FALSE(lNotACapture.Open("../Tests/Input/DoesNotExist.pcap"));
+}
@@ -0,0 +1,69 @@
+/* Copyright (c) 2021 [Rick de Bondt] - MetricsServer_Test.cpp
+ * This file contains tests for the Prometheus metrics endpoint.
+ **/
+
+#include "../Includes/MetricsServer.h"
+
+#include <gtest/gtest.h>
+
+using namespace boost::asio;
+using namespace std::chrono;
+
+// Tests whether a snapshot is converted to the Prometheus text format
+TEST(MetricsServerTest, FormatMetrics)
+{
+    MetricsSnapshot lSnapshot{};
+    lSnapshot.mCounters.at(static_cast<std::size_t>(Counter::AcksSent)) = 42;
+    lSnapshot.mFrameTypes.at(2 * 16 + 8)                                = 7;
+    lSnapshot.mGauges.at(static_cast<std::size_t>(Gauge::KaiLinkState)) = static_cast<int64_t>(KaiLinkState::Connected);
+    lSnapshot.mInfo.at(static_cast<std::size_t>(Info::LockedSSID))      = "PSP_\"Test\"";
+
+    // Drops only ever go up, so they are counters as well.
+    lSnapshot.mCounters.at(static_cast<std::size_t>(Counter::KernelDrops)) = 3;
+
+    HistogramSnapshot& lHistogram{lSnapshot.mHistograms.at(static_cast<std::size_t>(Histogram::AckLatency))};
+    lHistogram.mBuckets.at(HistogramSnapshot::GetBucketIndex(1500))    = 2;
+    lHistogram.mBuckets.at(HistogramSnapshot::GetBucketIndex(3000000)) = 1;
+    lHistogram.mCount = 3;
+    lHistogram.mSum   = 3003000;
+
+    std::string lText{MetricsServer::FormatMetrics(lSnapshot)};
+
+    EXPECT_NE(lText.find("xlha_acks_sent_total 42\n"), std::string::npos);
+    EXPECT_NE(lText.find("# TYPE xlha_kernel_drops_total counter\nxlha_kernel_drops_total 3\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_frames_total{type=\"data\",subtype=\"8\"} 7\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_kai_link_state{state=\"Connected\"} 1\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_kai_link_state{state=\"Connecting\"} 0\n"), std::string::npos);
+    EXPECT_NE(lText.find("ssid=\"PSP_\\\"Test\\\"\""), std::string::npos);
+    EXPECT_NE(lText.find("xlha_build_info{"), std::string::npos);
+
+    // Buckets are cumulative
+    EXPECT_NE(lText.find("xlha_ack_latency_seconds_bucket{le=\"1e-06\"} 0\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_ack_latency_seconds_bucket{le=\"0.002\"} 2\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_ack_latency_seconds_bucket{le=\"0.005\"} 3\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_ack_latency_seconds_bucket{le=\"+Inf\"} 3\n"), std::string::npos);
+    EXPECT_NE(lText.find("xlha_ack_latency_seconds_count 3\n"), std::string::npos);
+}
+
+// Tests whether the server answers a scrape over HTTP
+TEST(MetricsServerTest, Scrape)
+{
+    MetricsServer lServer{};
+    ASSERT_TRUE(lServer.Start(0));
+    ASSERT_NE(lServer.GetPort(), 0);
+
+    io_context      lIoContext{};
+    ip::tcp::socket lSocket{lIoContext};
+    lSocket.connect(ip::tcp::endpoint(ip::make_address(cAddress.data()), lServer.GetPort()));
+    write(lSocket, buffer(std::string("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n")));
+
+    std::string               lResponse{};
+    boost::system::error_code lError{};
+    read(lSocket, dynamic_buffer(lResponse), lError);
+
+    EXPECT_EQ(lResponse.rfind("HTTP/1.1 200 OK", 0), 0);
+    EXPECT_NE(lResponse.find("xlha_air_frames_received_total"), std::string::npos);
+
+    lServer.Stop();
+    EXPECT_EQ(lServer.GetPort(), 0);
+}
@@ -0,0 +1,76 @@
+/* Copyright (c) 2021 [Rick de Bondt] - Metrics_Test.cpp
+ * This file contains tests for the metrics registry.
+ **/
+
+#include "../Includes/Metrics.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono;
+
+// Tests whether every value ends up in a bucket that actually contains it
+TEST(MetricsTest, HistogramBuckets)
+{
+    for (uint64_t lValue : {0LLU, 1LLU, 15LLU, 16LLU, 17LLU, 1000LLU, 123456LLU, 987654321LLU}) {
+        std::size_t lIndex{HistogramSnapshot::GetBucketIndex(lValue)};
+        EXPECT_GE(HistogramSnapshot::GetBucketUpperBound(lIndex), lValue);
+        if (lIndex > 0) {
+            EXPECT_LT(HistogramSnapshot::GetBucketUpperBound(lIndex - 1), lValue);
+        }
+    }
+
+    // Way too large values should end up in the last bucket
+    EXPECT_EQ(HistogramSnapshot::GetBucketIndex(UINT64_MAX), cBucketCount - 1);
+}
+
+// Tests whether counters and histograms from multiple threads are summed up in a snapshot
+TEST(MetricsTest, SnapshotSumsThreads)
+{
+    Metrics&        lMetrics{Metrics::GetInstance()};
+    MetricsSnapshot lBefore{lMetrics.GetSnapshot()};
+
+    constexpr int            cThreadCount{4};
+    constexpr int            cIncrements{1000};
+    std::vector<std::thread> lThreads{};
+    for (int lCount = 0; lCount < cThreadCount; lCount++) {
+        lThreads.emplace_back([&] {
+            for (int lIncrement = 0; lIncrement < cIncrements; lIncrement++) {
+                lMetrics.Increment(Counter::AcksSent);
+                lMetrics.RecordLatency(Histogram::KaiToInject, microseconds(lIncrement + 1));
+            }
+        });
+    }
+
+    for (auto& lThread : lThreads) {
+        lThread.join();
+    }
+
+    MetricsSnapshot lAfter{lMetrics.GetSnapshot()};
+    EXPECT_EQ(lAfter.Get(Counter::AcksSent) - lBefore.Get(Counter::AcksSent), cThreadCount * cIncrements);
+
+    const HistogramSnapshot& lHistogram{lAfter.Get(Histogram::KaiToInject)};
+    EXPECT_EQ(lHistogram.mCount - lBefore.Get(Histogram::KaiToInject).mCount, cThreadCount * cIncrements);
+    EXPECT_EQ(lHistogram.mMax, duration_cast<nanoseconds>(microseconds(cIncrements)).count());
+
+    // Buckets are accurate to about 6%
+    EXPECT_NEAR(lHistogram.GetPercentile(50).count(), 500000, 500000 * 0.07);
+    EXPECT_NEAR(lHistogram.GetPercentile(99).count(), 990000, 990000 * 0.07);
+}
+
+// Tests whether 802.11 frames are counted by type and subtype
+TEST(MetricsTest, FrameTypes)
+{
+    Metrics&        lMetrics{Metrics::GetInstance()};
+    MetricsSnapshot lBefore{lMetrics.GetSnapshot()};
+
+    // Beacon (management, subtype 8) and QoS data (data, subtype 8)
+    lMetrics.CountFrameType(0x80);
+    lMetrics.CountFrameType(0x88);
+
+    MetricsSnapshot lAfter{lMetrics.GetSnapshot()};
+    EXPECT_EQ(lAfter.mFrameTypes.at(8) - lBefore.mFrameTypes.at(8), 1);
+    EXPECT_EQ(lAfter.mFrameTypes.at((2 * 16) + 8) - lBefore.mFrameTypes.at((2 * 16) + 8), 1);
+}
@@ -0,0 +1,161 @@
+/* Copyright (c) 2021 [Rick de Bondt] - MonitorDevice_Test.cpp
+ * This file contains tests for injecting with the MonitorDevice class from its injection queue, on the loopback
+ * adapter.
+ **/
+
+#include "../Includes/MonitorDevice.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+#include "../Includes/Metrics.h"
+#include "TestHelpers.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr std::string_view cLoopbackAdapter{"lo"};
+    constexpr std::size_t      cFrameLength{64};
+    // Way more than fit in the queue, frames get handed over a lot faster than they can be injected.
+    constexpr unsigned int     cMaxFrames{cInjectionQueueSize * 64};
+    constexpr seconds          cTimeout{5};
+    constexpr milliseconds     cPollInterval{1};
+
+    /**
+     * Monitor device without a capture handle, that injects from its queue like it does on a separate injection
+     * adapter. The loopback adapter is not in monitor mode, but the frames go out on the packet socket anyway.
+     */
+    class QueuedInjectionDevice : public MonitorDevice
+    {
+    public:
+        bool Open(std::string_view aName, const std::vector<std::string>& /*aSSIDFilter*/) override
+        {
+            SetInjectionAdapter(aName);
+            return OpenInjection();
+        }
+
+        bool StartReceiverThread() override
+        {
+            StartInjectionThread();
+            return true;
+        }
+
+    protected:
+        pcap_t* ActivateInjection() override
+        {
+            return pcap_open_dead(DLT_IEEE802_11_RADIO, cSnapshotLength);
+        }
+    };
+
+    /**
+     * Waits until a condition is met or the timeout passed.
+     * @param aCondition - Condition to wait for.
+     * @return true if the condition has been met.
+     */
+    template<typename Condition> bool WaitFor(Condition aCondition)
+    {
+        auto lStart{steady_clock::now()};
+        bool lReturn{aCondition()};
+        while (!lReturn && (steady_clock::now() < lStart + cTimeout)) {
+            std::this_thread::sleep_for(cPollInterval);
+            lReturn = aCondition();
+        }
+        return lReturn;
+    }
+
+    /**
+     * Hands frames to the device until the injection queue is full.
+     * @param aDevice - Device to send the frames with.
+     * @param aFirstIndex - Number of the first frame.
+     * @param aAccepted - Filled in with the frames the device accepted, in order.
+     * @return the amount of frames handed over, including the one that did not fit.
+     */
+    unsigned int FillQueue(MonitorDevice& aDevice, unsigned int aFirstIndex, std::vector<std::string>& aAccepted)
+    {
+        unsigned int lReturn{0};
+        bool         lFull{false};
+        while (!lFull && (lReturn < cMaxFrames)) {
+            std::string lFrame{MakeFrame(aFirstIndex + lReturn, cFrameLength)};
+            if (aDevice.Send(lFrame)) {
+                aAccepted.push_back(lFrame);
+            } else {
+                lFull = true;
+            }
+            lReturn++;
+        }
+        return lReturn;
+    }
+
+    uint64_t GetCount(Counter aCounter)
+    {
+        return Metrics::GetInstance().GetSnapshot().Get(aCounter);
+    }
+}  // namespace
+
+// Tests whether frames sent through the injection queue get injected in order, and whether every frame is counted as
+// either sent or failed: when the queue is full, and when frames are left in it after closing the device
+TEST(MonitorDeviceTest, InjectionQueue)
+{
+    Receiver lReceiver{cLoopbackAdapter, cFrameLength};
+    if (!lReceiver.IsOpen()) {
+        GTEST_SKIP() << "Packet sockets need CAP_NET_RAW";
+    }
+
+    for (InjectionBackend lBackend : {InjectionBackend::Packet, InjectionBackend::PacketRing}) {
+        QueuedInjectionDevice    lDevice{};
+        std::vector<std::string> lSSIDFilter{};
+        lDevice.SetInjectionBackend(lBackend);
+        ASSERT_TRUE(lDevice.Open(cLoopbackAdapter, lSSIDFilter));
+        ASSERT_TRUE(lDevice.StartReceiverThread());
+
+        uint64_t                 lSent{GetCount(Counter::AirFramesSent)};
+        uint64_t                 lFailed{GetCount(Counter::AirSendFailures)};
+        std::vector<std::string> lAccepted{};
+        unsigned int             lFrames{FillQueue(lDevice, 0, lAccepted)};
+        ASSERT_LT(lAccepted.size(), lFrames);
+
+        // The loopback adapter hands the slots of the TX ring back before the frames in them have been received, so
+        // with the ring, frames still waiting to be received get overwritten and only the amount can be checked.
+        bool                     lCheckOrder{lBackend != InjectionBackend::PacketRing};
+        std::vector<std::string> lReceived{lReceiver.Receive(lAccepted.size())};
+        EXPECT_EQ(lReceived.size(), lAccepted.size());
+        EXPECT_TRUE(!lCheckOrder || (lReceived == lAccepted));
+
+        // The frame that did not fit is counted as failed right away, the others once they have been injected.
+        EXPECT_TRUE(WaitFor([&] { return GetCount(Counter::AirFramesSent) - lSent == lAccepted.size(); }));
+        EXPECT_EQ(GetCount(Counter::AirSendFailures) - lFailed, 1);
+
+        // Closing right after filling the queue leaves frames in it, those are thrown away when starting again.
+        lSent   = GetCount(Counter::AirFramesSent);
+        lFailed = GetCount(Counter::AirSendFailures);
+        lAccepted.clear();
+        unsigned int lFirstIndex{lFrames};
+        lFrames = FillQueue(lDevice, lFirstIndex, lAccepted);
+        lDevice.Close();
+
+        uint64_t lSentBeforeClose{GetCount(Counter::AirFramesSent) - lSent};
+        ASSERT_LE(lSentBeforeClose, lAccepted.size());
+        lAccepted.resize(lSentBeforeClose);
+        lReceived = lReceiver.Receive(lAccepted.size());
+        EXPECT_EQ(lReceived.size(), lAccepted.size());
+        EXPECT_TRUE(!lCheckOrder || (lReceived == lAccepted));
+
+        ASSERT_TRUE(lDevice.Open(cLoopbackAdapter, lSSIDFilter));
+        ASSERT_TRUE(lDevice.StartReceiverThread());
+        EXPECT_EQ(GetCount(Counter::AirFramesSent) - lSent + GetCount(Counter::AirSendFailures) - lFailed, lFrames);
+
+        std::string lFrame{MakeFrame(lFirstIndex + lFrames, cFrameLength)};
+        lSent = GetCount(Counter::AirFramesSent);
+        EXPECT_TRUE(lDevice.Send(lFrame));
+        EXPECT_TRUE(lReceiver.Receive(1) == std::vector<std::string>{lFrame});
+        EXPECT_TRUE(WaitFor([&] { return GetCount(Counter::AirFramesSent) - lSent == 1; }));
+
+        lDevice.Close();
+    }
+}
+#endif
@@ -0,0 +1,223 @@
+/* Copyright (c) 2021 [Rick de Bondt] - NetworkCache_Test.cpp
+ * This file contains tests for the NetworkCache class and for warm starting Handler80211 on a cached network.
+ **/
+
+#include "../Includes/NetworkCache.h"
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "../Includes/Handler80211.h"
+#include "../Includes/TrafficGenerator.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr std::string_view cCacheFile{"../Tests/Output/networks.txt"};
+    constexpr uint64_t         cStaleBSSID{0x0A0B0C0D0E0F};
+
+    CachedNetwork MakeNetwork(std::string_view aSSID, uint64_t aBSSID)
+    {
+        CachedNetwork lNetwork{};
+        lNetwork.mSSID      = aSSID;
+        lNetwork.mBSSID     = aBSSID;
+        lNetwork.mFrequency = 2437;
+        lNetwork.mPeers     = {0x112233445566, 0x665544332211};
+        return lNetwork;
+    }
+
+    TrafficMix MakeGameMix()
+    {
+        TrafficMix lMix{};
+        lMix.mPSPNetworks     = 2;
+        lMix.mForeignNetworks = 2;
+        lMix.mSeed            = 5678;
+        return lMix;
+    }
+
+    // Plays a session locked onto the first PSP network, and gets what would be cached when it ends.
+    CachedNetwork PlaySession()
+    {
+        TrafficGenerator lGenerator{MakeGameMix()};
+        Handler80211     lHandler{PhysicalDeviceHeaderType::RadioTap};
+
+        std::vector<std::string> lSSIDFilter{std::string(lGenerator.GetSSID(0))};
+        lHandler.SetSSIDFilterList(lSSIDFilter);
+        for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(2))) {
+            lHandler.Update(lFrame.mData);
+        }
+
+        return lHandler.GetLockedNetwork();
+    }
+}  // namespace
+
+// Tests whether the most recently used network matching the filter is found
+TEST(NetworkCacheTest, Find)
+{
+    NetworkCache  lCache{};
+    CachedNetwork lNetwork{};
+    EXPECT_FALSE(lCache.Find({}, lNetwork));
+
+    lCache.Store(MakeNetwork("PSP_AULES00001_L_GameName", 1));
+    lCache.Store(MakeNetwork("SCE_VITA_GameName", 2));
+    lCache.Store(MakeNetwork("PSP_AULES00002_L_OtherGame", 3));
+
+    ASSERT_TRUE(lCache.Find({"PSP_"}, lNetwork));
+    EXPECT_EQ(lNetwork.mBSSID, 3);
+    ASSERT_TRUE(lCache.Find({"AULES00001", "Nothing"}, lNetwork));
+    EXPECT_EQ(lNetwork.mBSSID, 1);
+    ASSERT_TRUE(lCache.Find({}, lNetwork));
+    EXPECT_EQ(lNetwork.mBSSID, 3);
+    EXPECT_FALSE(lCache.Find({"Nothing"}, lNetwork));
+
+    // Storing it again makes it the most recent, without adding it twice.
+    lCache.Store(MakeNetwork("PSP_AULES00001_L_GameName", 1));
+    ASSERT_TRUE(lCache.Find({"PSP_"}, lNetwork));
+    EXPECT_EQ(lNetwork.mBSSID, 1);
+    EXPECT_EQ(lCache.GetNetworks().size(), 3);
+}
+
+// Tests whether the cache stops growing when full, dropping the least recently used networks
+TEST(NetworkCacheTest, Limit)
+{
+    NetworkCache lCache{};
+
+    CachedNetwork lNetwork{MakeNetwork("PSP_AULES00001_L_GameName", 0)};
+    for (uint64_t lPeer = 1; lPeer <= cMaxCachedPeers + 5; lPeer++) {
+        lNetwork.mPeers.push_back(lPeer);
+    }
+    for (uint64_t lBSSID = 1; lBSSID <= cMaxCachedNetworks + 5; lBSSID++) {
+        lNetwork.mBSSID = lBSSID;
+        lCache.Store(lNetwork);
+    }
+
+    std::vector<CachedNetwork> lNetworks{lCache.GetNetworks()};
+    ASSERT_EQ(lNetworks.size(), cMaxCachedNetworks);
+    EXPECT_EQ(lNetworks.front().mBSSID, cMaxCachedNetworks + 5);
+    EXPECT_EQ(lNetworks.back().mBSSID, 6);
+    EXPECT_EQ(lNetworks.front().mPeers.size(), cMaxCachedPeers);
+}
+
+// Tests whether the cache survives a save and load, and leaves out networks that are too old
+TEST(NetworkCacheTest, SaveAndLoad)
+{
+    NetworkCache  lCache{};
+    CachedNetwork lNetwork{MakeNetwork("PSP_AULES00001_L_GameName", 0x1A2B3C4D5E6F)};
+    lNetwork.mIsAdhoc                  = true;
+    lNetwork.mHasParameters            = true;
+    lNetwork.mParameters.mLength       = 18;
+    lNetwork.mParameters.mDataRate     = 0x16;
+    lNetwork.mParameters.mFrequency    = 2437;
+    lNetwork.mParameters.mKnownMCSInfo = 7;
+    lCache.Store(lNetwork);
+    lCache.Store(MakeNetwork("HomeNetwork", 0x6F5E4D3C2B1A));
+    ASSERT_TRUE(lCache.SaveToFile(cCacheFile));
+
+    // A network from a long time ago, added to the file by hand.
+    {
+        std::ofstream lFile{cCacheFile.data(), std::ios::app};
+        lFile << "Network: \"PSP_OldGame\"" << std::endl;
+        lFile << "BSSID: \"12:34:56:78:9A:BC\"" << std::endl;
+        lFile << "LastUsed: 1000" << std::endl;
+    }
+
+    NetworkCache lLoaded{};
+    ASSERT_TRUE(lLoaded.LoadFromFile(cCacheFile));
+    std::vector<CachedNetwork> lNetworks{lLoaded.GetNetworks()};
+    ASSERT_EQ(lNetworks.size(), 2);
+    EXPECT_EQ(lNetworks.at(0).mSSID, "HomeNetwork");
+
+    CachedNetwork lFound{};
+    ASSERT_TRUE(lLoaded.Find({"PSP_"}, lFound));
+    EXPECT_EQ(lFound.mSSID, lNetwork.mSSID);
+    EXPECT_EQ(lFound.mBSSID, lNetwork.mBSSID);
+    EXPECT_EQ(lFound.mFrequency, lNetwork.mFrequency);
+    EXPECT_TRUE(lFound.mIsAdhoc);
+    ASSERT_TRUE(lFound.mHasParameters);
+    EXPECT_EQ(lFound.mParameters.mLength, 18);
+    EXPECT_EQ(lFound.mParameters.mDataRate, 0x16);
+    EXPECT_EQ(lFound.mParameters.mFrequency, 2437);
+    EXPECT_EQ(lFound.mParameters.mKnownMCSInfo, 7);
+    EXPECT_EQ(lFound.mPeers, lNetwork.mPeers);
+    EXPECT_EQ(duration_cast<seconds>(lFound.mLastUsed.time_since_epoch()),
+              duration_cast<seconds>(lCache.GetNetworks().at(1).mLastUsed.time_since_epoch()));
+
+    EXPECT_FALSE(lLoaded.LoadFromFile("../Tests/Output/DoesNotExist.txt"));
+}
+
+// Tests whether Handler80211 reports the network it was in, with the stations that sent data in it
+TEST(NetworkCacheTest, LockedNetwork)
+{
+    TrafficGenerator lGenerator{MakeGameMix()};
+    CachedNetwork    lNetwork{PlaySession()};
+
+    EXPECT_EQ(lNetwork.mSSID, lGenerator.GetSSID(0));
+    EXPECT_EQ(lNetwork.mBSSID, lGenerator.GetBSSID(0));
+    EXPECT_EQ(lNetwork.mFrequency, cFrequency);
+    EXPECT_TRUE(lNetwork.mIsAdhoc);
+    EXPECT_TRUE(lNetwork.mHasParameters);
+    EXPECT_FALSE(lNetwork.mPeers.empty());
+    EXPECT_LE(lNetwork.mPeers.size(), cMaxCachedPeers);
+}
+
+// Tests whether a warm started Handler80211 forwards frames of the cached network before any beacon locks it on
+TEST(NetworkCacheTest, WarmStart)
+{
+    TrafficGenerator lGenerator{MakeGameMix()};
+    Handler80211     lHandler{PhysicalDeviceHeaderType::RadioTap};
+
+    // The beacons never match, so only the cache can get the handler into the network.
+    std::vector<std::string> lSSIDFilter{"NoSuchNetwork"};
+    lHandler.SetSSIDFilterList(lSSIDFilter);
+    lHandler.SetCachedNetwork(PlaySession());
+
+    unsigned int lForwarded{0};
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(2))) {
+        lHandler.Update(lFrame.mData);
+
+        if (!lFrame.mEthernet.empty()) {
+            ASSERT_TRUE(lHandler.ShouldSend());
+            ASSERT_EQ(lHandler.ConvertPacket(), lFrame.mEthernet);
+        }
+        lForwarded += lHandler.ShouldSend() ? 1 : 0;
+    }
+
+    EXPECT_EQ(lHandler.GetLockedBSSID(), lGenerator.GetBSSID(0));
+    EXPECT_GT(lForwarded, 100);
+}
+
+// Tests whether a warm started Handler80211 follows the cached peers when the network got a new BSSID
+TEST(NetworkCacheTest, FollowPeers)
+{
+    TrafficGenerator lGenerator{MakeGameMix()};
+    Handler80211     lHandler{PhysicalDeviceHeaderType::RadioTap};
+
+    std::vector<std::string> lSSIDFilter{"NoSuchNetwork"};
+    lHandler.SetSSIDFilterList(lSSIDFilter);
+
+    // Same players, but the network they host now has another BSSID than when it was cached.
+    CachedNetwork lNetwork{PlaySession()};
+    lNetwork.mSSID  = "";
+    lNetwork.mBSSID = cStaleBSSID;
+    lHandler.SetCachedNetwork(lNetwork);
+    EXPECT_EQ(lHandler.GetLockedBSSID(), cStaleBSSID);
+
+    unsigned int lForwarded{0};
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(2))) {
+        lHandler.Update(lFrame.mData);
+        lForwarded += lHandler.ShouldSend() ? 1 : 0;
+    }
+
+    EXPECT_EQ(lHandler.GetLockedBSSID(), lGenerator.GetBSSID(0));
+    EXPECT_GT(lForwarded, 100);
+
+    // A beacon of the network locked onto confirms it, after which peers are not followed anymore.
+    lSSIDFilter = {std::string(lGenerator.GetSSID(0))};
+    lHandler.SetSSIDFilterList(lSSIDFilter);
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(3))) {
+        lHandler.Update(lFrame.mData);
+    }
+    EXPECT_EQ(lHandler.GetLockedNetwork().mSSID, lGenerator.GetSSID(0));
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2021 [Rick de Bondt] - NetworkTable_Test.cpp
+ * This file contains tests for the NetworkTable class and for discovering networks from captured beacons.
+ **/
+
+#include "../Includes/NetworkTable.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/Handler80211.h"
+#include "../Includes/TrafficGenerator.h"
+#include "../Includes/VirtualClock.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr uint64_t cFirstBSSID{0x112233445566};
+    constexpr uint64_t cSecondBSSID{0x665544332211};
+
+    TrafficMix MakeDiscoveryMix()
+    {
+        TrafficMix lMix{};
+        lMix.mPSPNetworks     = 2;
+        lMix.mVitaNetworks    = 1;
+        lMix.mForeignNetworks = 3;
+        lMix.mSeed            = 4321;
+        return lMix;
+    }
+}  // namespace
+
+// Tests whether networks get updated in place, sorted on signal strength and aged out
+TEST(NetworkTableTest, UpdateAndAge)
+{
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    NetworkTable                  lTable{};
+    lTable.SetClock(lClock);
+
+    lTable.Update(cFirstBSSID, "PSP_AULES00001_L_GameName", 6, 0x6C, true, -70);
+    lTable.Update(cSecondBSSID, "HomeNetwork", 11, 0x6C, false, 0);
+    lClock->SleepFor(seconds(2));
+    // Beacon without a channel or signal strength, what was known before is kept.
+    lTable.Update(cFirstBSSID, "PSP_AULES00001_L_GameName", 0, 0x16, true, 0);
+
+    std::vector<DiscoveredNetwork> lNetworks{lTable.GetNetworks()};
+    ASSERT_EQ(lNetworks.size(), 2);
+    // Unknown signal strengths go last.
+    EXPECT_EQ(lNetworks.at(0).mBSSID, cFirstBSSID);
+    EXPECT_EQ(lNetworks.at(0).mSSID, "PSP_AULES00001_L_GameName");
+    EXPECT_EQ(lNetworks.at(0).mChannel, 6);
+    EXPECT_EQ(lNetworks.at(0).mMaxRate, 0x16);
+    EXPECT_TRUE(lNetworks.at(0).mIsAdhoc);
+    EXPECT_EQ(lNetworks.at(0).mSignal, -70);
+    EXPECT_EQ(lNetworks.at(0).mBeacons, 2);
+    EXPECT_EQ(lNetworks.at(0).mLastSeen, lClock->Now());
+    EXPECT_EQ(lNetworks.at(1).mBSSID, cSecondBSSID);
+    EXPECT_FALSE(lNetworks.at(1).mIsAdhoc);
+
+    lTable.Update(cSecondBSSID, "HomeNetwork", 11, 0x6C, false, -40);
+    EXPECT_EQ(lTable.GetNetworks().at(0).mBSSID, cSecondBSSID);
+
+    // The first network sends its last beacon 2 seconds after the second one.
+    lClock->SleepFor(seconds(2));
+    lTable.Update(cFirstBSSID, "PSP_AULES00001_L_GameName", 6, 0x16, true, -70);
+    lClock->SleepFor(cNetworkMaxAge - seconds(1));
+    EXPECT_TRUE(lTable.IsPresent(cFirstBSSID));
+    EXPECT_FALSE(lTable.IsPresent(cSecondBSSID));
+    lNetworks = lTable.GetNetworks();
+    ASSERT_EQ(lNetworks.size(), 1);
+    EXPECT_EQ(lNetworks.at(0).mBSSID, cFirstBSSID);
+
+    lTable.Clear();
+    EXPECT_TRUE(lTable.GetNetworks().empty());
+    EXPECT_FALSE(lTable.IsPresent(cFirstBSSID));
+}
+
+// Tests whether the table stops growing when full, and makes room once networks age out
+TEST(NetworkTableTest, Limit)
+{
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    NetworkTable                  lTable{};
+    lTable.SetClock(lClock);
+
+    for (uint64_t lBSSID = 1; lBSSID <= cMaxNetworks + 10; lBSSID++) {
+        lTable.Update(lBSSID, "Network", 1, 0x6C, false, -50);
+    }
+    EXPECT_EQ(lTable.GetNetworks().size(), cMaxNetworks);
+    EXPECT_FALSE(lTable.IsPresent(cMaxNetworks + 1));
+
+    lClock->SleepFor(cNetworkMaxAge + seconds(1));
+    lTable.Update(cMaxNetworks + 1, "Network", 1, 0x6C, false, -50);
+    EXPECT_TRUE(lTable.IsPresent(cMaxNetworks + 1));
+    EXPECT_EQ(lTable.GetNetworks().size(), 1);
+}
+
+// Tests whether Handler80211 finds every network in the beacons, whatever the filters, and keeps its lock
+TEST(NetworkTableTest, Discovery)
+{
+    TrafficGenerator              lGenerator{MakeDiscoveryMix()};
+    Handler80211                  lHandler{PhysicalDeviceHeaderType::RadioTap};
+    std::shared_ptr<NetworkTable> lTable{std::make_shared<NetworkTable>()};
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    lTable->SetClock(lClock);
+    lHandler.SetNetworkTable(lTable);
+
+    // Matches both PSP networks.
+    std::vector<std::string> lSSIDFilter{"PSP_"};
+    lHandler.SetSSIDFilterList(lSSIDFilter);
+
+    uint64_t lFirstLocked{0};
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(3))) {
+        lClock->SleepUntil(steady_clock::time_point(lFrame.mTimestamp));
+        lHandler.Update(lFrame.mData);
+
+        if (lFirstLocked == 0) {
+            lFirstLocked = lHandler.GetLockedBSSID();
+        }
+        ASSERT_TRUE(lFirstLocked == 0 || lHandler.GetLockedBSSID() == lFirstLocked);
+    }
+    EXPECT_NE(lFirstLocked, 0);
+
+    std::vector<DiscoveredNetwork> lNetworks{lTable->GetNetworks()};
+    ASSERT_EQ(lNetworks.size(), 6);
+    for (unsigned int lIndex = 0; lIndex < lNetworks.size(); lIndex++) {
+        auto lNetwork{std::find_if(lNetworks.begin(), lNetworks.end(), [&](const DiscoveredNetwork& aNetwork) {
+            return aNetwork.mBSSID == lGenerator.GetBSSID(lIndex);
+        })};
+        ASSERT_NE(lNetwork, lNetworks.end()) << lGenerator.GetSSID(lIndex);
+        EXPECT_EQ(lNetwork->mSSID, lGenerator.GetSSID(lIndex));
+        EXPECT_EQ(lNetwork->mChannel, 6);
+        EXPECT_EQ(lNetwork->mIsAdhoc, lIndex < 3);
+        EXPECT_GT(lNetwork->mBeacons, 20);
+    }
+}
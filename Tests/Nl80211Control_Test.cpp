@@ -0,0 +1,410 @@
+/* Copyright (c) 2021 [Rick de Bondt] - Nl80211Control_Test.cpp
+ * This file contains tests for the Nl80211Control class, against a fake nl80211 on the other end of a socketpair.
+ **/
+
+#include "../Includes/Nl80211Control.h"
+
+#include <optional>
+
+#include <gtest/gtest.h>
+#include <linux/genetlink.h>
+#include <linux/nl80211.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <netlink/attr.h>
+#include <netlink/msg.h>
+
+#include "../Includes/VirtualClock.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr unsigned int           cInterfaceIndex{3};
+    constexpr unsigned int           cOtherInterfaceIndex{4};
+    constexpr uint16_t               cFamilyId{28};
+    constexpr uint32_t               cScanGroup{5};
+    constexpr uint32_t               cMlmeGroup{6};
+    constexpr milliseconds           cTimeout{2000};
+    constexpr milliseconds           cQuiet{100};
+    constexpr std::array<uint8_t, 6> cPSPBSSID{0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+    constexpr std::array<uint8_t, 6> cAccessPointBSSID{0x00, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE};
+
+    struct Request
+    {
+        uint16_t    mType{0};
+        uint16_t    mFlags{0};
+        uint32_t    mSequence{0};
+        uint8_t     mCommand{0};
+        std::string mFamilyName{};
+        uint32_t    mInterfaceIndex{0};
+    };
+
+    /**
+     * Plays nl80211 and the generic netlink controller: reads the requests and sends replies and events.
+     */
+    class FakeNl80211
+    {
+    public:
+        FakeNl80211()
+        {
+            std::array<int, 2> lSockets{-1, -1};
+            socketpair(AF_UNIX, SOCK_SEQPACKET, 0, lSockets.data());
+            mControlSocket = lSockets.at(0);
+            mSocket        = lSockets.at(1);
+        }
+
+        ~FakeNl80211()
+        {
+            Close();
+        }
+
+        FakeNl80211(const FakeNl80211& aFakeNl80211) = delete;
+        FakeNl80211& operator=(const FakeNl80211& aFakeNl80211) = delete;
+
+        [[nodiscard]] int GetControlSocket() const
+        {
+            return mControlSocket;
+        }
+
+        void Close()
+        {
+            if (mSocket >= 0) {
+                close(mSocket);
+                mSocket = -1;
+            }
+        }
+
+        std::optional<Request> Receive(milliseconds aTimeout = cTimeout)
+        {
+            std::optional<Request> lReturn{};
+            pollfd                 lPoll{mSocket, POLLIN, 0};
+
+            if (poll(&lPoll, 1, static_cast<int>(aTimeout.count())) > 0) {
+                std::array<char, 4096> lBuffer{};
+                ssize_t                lLength{recv(mSocket, lBuffer.data(), lBuffer.size(), 0)};
+                auto*                  lHeader{reinterpret_cast<nlmsghdr*>(lBuffer.data())};
+
+                if (nlmsg_ok(lHeader, static_cast<int>(lLength))) {
+                    Request lRequest{};
+                    lRequest.mType     = lHeader->nlmsg_type;
+                    lRequest.mFlags    = lHeader->nlmsg_flags;
+                    lRequest.mSequence = lHeader->nlmsg_seq;
+                    lRequest.mCommand  = reinterpret_cast<genlmsghdr*>(nlmsg_data(lHeader))->cmd;
+
+                    std::array<nlattr*, NL80211_ATTR_MAX + 1> lAttributes{};
+                    nla_parse(lAttributes.data(),
+                              NL80211_ATTR_MAX,
+                              nlmsg_attrdata(lHeader, GENL_HDRLEN),
+                              nlmsg_attrlen(lHeader, GENL_HDRLEN),
+                              nullptr);
+                    if (lRequest.mType == GENL_ID_CTRL) {
+                        lRequest.mFamilyName = reinterpret_cast<char*>(nla_data(lAttributes.at(CTRL_ATTR_FAMILY_NAME)));
+                    } else if (lAttributes.at(NL80211_ATTR_IFINDEX) != nullptr) {
+                        lRequest.mInterfaceIndex = nla_get_u32(lAttributes.at(NL80211_ATTR_IFINDEX));
+                    }
+                    lReturn = lRequest;
+                }
+            }
+
+            return lReturn;
+        }
+
+        void SendFamily(uint32_t aSequence)
+        {
+            nl_msg* lMessage{Create(GENL_ID_CTRL, 0, aSequence, CTRL_CMD_NEWFAMILY)};
+            nla_put_string(lMessage, CTRL_ATTR_FAMILY_NAME, cFamilyName.data());
+            nla_put_u16(lMessage, CTRL_ATTR_FAMILY_ID, cFamilyId);
+
+            nlattr* lGroups{nla_nest_start(lMessage, CTRL_ATTR_MCAST_GROUPS)};
+            uint16_t lIndex{1};
+            for (const auto& [lName, lId] : {std::pair{"config", 4U}, {"scan", cScanGroup}, {"mlme", cMlmeGroup}}) {
+                nlattr* lGroup{nla_nest_start(lMessage, lIndex++)};
+                nla_put_string(lMessage, CTRL_ATTR_MCAST_GRP_NAME, lName);
+                nla_put_u32(lMessage, CTRL_ATTR_MCAST_GRP_ID, lId);
+                nla_nest_end(lMessage, lGroup);
+            }
+            nla_nest_end(lMessage, lGroups);
+            Send(lMessage);
+        }
+
+        void SendError(uint32_t aSequence, int aError)
+        {
+            nl_msg*  lMessage{nlmsg_alloc_simple(NLMSG_ERROR, 0)};
+            nlmsgerr lError{aError, {}};
+            nlmsg_hdr(lMessage)->nlmsg_seq = aSequence;
+            nlmsg_append(lMessage, &lError, sizeof(lError), NLMSG_ALIGNTO);
+            Send(lMessage);
+        }
+
+        void SendDone(uint32_t aSequence)
+        {
+            nl_msg* lMessage{nlmsg_alloc_simple(NLMSG_DONE, NLM_F_MULTI)};
+            int     lError{0};
+            nlmsg_hdr(lMessage)->nlmsg_seq = aSequence;
+            nlmsg_append(lMessage, &lError, sizeof(lError), NLMSG_ALIGNTO);
+            Send(lMessage);
+        }
+
+        void SendEvent(uint8_t aCommand, unsigned int aInterfaceIndex, const std::array<uint8_t, 6>* aMAC = nullptr)
+        {
+            nl_msg* lMessage{Create(cFamilyId, 0, 0, aCommand)};
+            nla_put_u32(lMessage, NL80211_ATTR_IFINDEX, aInterfaceIndex);
+            if (aMAC != nullptr) {
+                nla_put(lMessage, NL80211_ATTR_MAC, aMAC->size(), aMAC->data());
+            }
+            Send(lMessage);
+        }
+
+        void SendBSS(uint32_t                      aSequence,
+                     std::string_view              aSSID,
+                     const std::array<uint8_t, 6>& aBSSID,
+                     bool                          aAdhoc,
+                     bool                          aJoined)
+        {
+            nl_msg* lMessage{Create(cFamilyId, NLM_F_MULTI, aSequence, NL80211_CMD_NEW_SCAN_RESULTS)};
+            nla_put_u32(lMessage, NL80211_ATTR_IFINDEX, cInterfaceIndex);
+
+            std::string lElements{'\0', static_cast<char>(aSSID.size())};
+            lElements.append(aSSID);
+            // Supported rates, which come after the SSID.
+            lElements.append({'\x01', '\x01', '\x82'});
+
+            nlattr* lBSS{nla_nest_start(lMessage, NL80211_ATTR_BSS)};
+            nla_put(lMessage, NL80211_BSS_BSSID, aBSSID.size(), aBSSID.data());
+            nla_put_u32(lMessage, NL80211_BSS_FREQUENCY, 2412);
+            nla_put_u16(lMessage, NL80211_BSS_CAPABILITY, aAdhoc ? 0b10U : 0b1U);
+            nla_put(lMessage, NL80211_BSS_INFORMATION_ELEMENTS, lElements.size(), lElements.data());
+            if (aJoined) {
+                nla_put_u32(lMessage, NL80211_BSS_STATUS, NL80211_BSS_STATUS_IBSS_JOINED);
+            }
+            nla_nest_end(lMessage, lBSS);
+            Send(lMessage);
+        }
+
+    private:
+        static nl_msg* Create(uint16_t aType, uint16_t aFlags, uint32_t aSequence, uint8_t aCommand)
+        {
+            nl_msg*    lMessage{nlmsg_alloc_simple(aType, aFlags)};
+            genlmsghdr lHeader{aCommand, 1, 0};
+            nlmsg_hdr(lMessage)->nlmsg_seq = aSequence;
+            nlmsg_append(lMessage, &lHeader, sizeof(lHeader), NLMSG_ALIGNTO);
+            return lMessage;
+        }
+
+        void Send(nl_msg* aMessage)
+        {
+            nlmsghdr* lHeader{nlmsg_hdr(aMessage)};
+            send(mSocket, lHeader, lHeader->nlmsg_len, 0);
+            nlmsg_free(aMessage);
+        }
+
+        int mControlSocket{-1};
+        int mSocket{-1};
+    };
+
+    bool WaitUntil(const std::function<bool()>& aCondition)
+    {
+        auto lDeadline{steady_clock::now() + cTimeout};
+        while (!aCondition() && (steady_clock::now() < lDeadline)) {
+            std::this_thread::sleep_for(1ms);
+        }
+        return aCondition();
+    }
+
+    /**
+     * Opens the control on the fake and answers the family lookup and the dump of the results the kernel already had.
+     * @param aControl - Control to open.
+     * @param aFake - Fake to open it on.
+     */
+    void OpenControl(Nl80211Control& aControl, FakeNl80211& aFake)
+    {
+        bool        lOpened{false};
+        std::thread lOpen{[&] { lOpened = aControl.Open(aFake.GetControlSocket(), cInterfaceIndex); }};
+
+        std::optional<Request> lFamilyRequest{aFake.Receive()};
+        if (lFamilyRequest.has_value()) {
+            aFake.SendFamily(lFamilyRequest->mSequence);
+        }
+        lOpen.join();
+        ASSERT_TRUE(lFamilyRequest.has_value());
+        EXPECT_EQ(lFamilyRequest->mType, GENL_ID_CTRL);
+        EXPECT_EQ(lFamilyRequest->mCommand, CTRL_CMD_GETFAMILY);
+        EXPECT_EQ(lFamilyRequest->mFamilyName, cFamilyName);
+        ASSERT_TRUE(lOpened);
+
+        std::optional<Request> lDumpRequest{aFake.Receive()};
+        ASSERT_TRUE(lDumpRequest.has_value());
+        EXPECT_EQ(lDumpRequest->mType, cFamilyId);
+        EXPECT_EQ(lDumpRequest->mCommand, NL80211_CMD_GET_SCAN);
+        EXPECT_EQ(lDumpRequest->mFlags & NLM_F_DUMP, NLM_F_DUMP);
+        EXPECT_EQ(lDumpRequest->mInterfaceIndex, cInterfaceIndex);
+        aFake.SendDone(lDumpRequest->mSequence);
+
+        ASSERT_TRUE(WaitUntil([&] { return aControl.GetScanResults() != nullptr; }));
+        EXPECT_TRUE(aControl.GetScanResults()->mNetworks.empty());
+    }
+}  // namespace
+
+// Tests whether a scan gets triggered without waiting for it, and its results are dumped and swapped in as a whole
+TEST(Nl80211ControlTest, ScanCycle)
+{
+    auto           lClock{std::make_shared<VirtualClock>(steady_clock::time_point{1h})};
+    FakeNl80211    lFake{};
+    Nl80211Control lControl{};
+    lControl.SetClock(lClock);
+
+    std::vector<std::shared_ptr<const ScanResults>> lCallbacks{};
+    std::mutex                                      lMutex{};
+    lControl.SetScanResultsCallback([&](const std::shared_ptr<const ScanResults>& aResults) {
+        std::lock_guard<std::mutex> lLock{lMutex};
+        lCallbacks.push_back(aResults);
+    });
+
+    ASSERT_NO_FATAL_FAILURE(OpenControl(lControl, lFake));
+    std::shared_ptr<const ScanResults> lFirstResults{lControl.GetScanResults()};
+    EXPECT_EQ(lFirstResults->mGeneration, 1);
+
+    EXPECT_TRUE(lControl.TriggerScan());
+    EXPECT_TRUE(lControl.IsScanning());
+    std::optional<Request> lTrigger{lFake.Receive()};
+    ASSERT_TRUE(lTrigger.has_value());
+    EXPECT_EQ(lTrigger->mCommand, NL80211_CMD_TRIGGER_SCAN);
+    EXPECT_EQ(lTrigger->mInterfaceIndex, cInterfaceIndex);
+    lFake.SendError(lTrigger->mSequence, 0);
+
+    // Asking again while scanning does not disturb the running scan.
+    EXPECT_TRUE(lControl.TriggerScan());
+    EXPECT_FALSE(lFake.Receive(cQuiet).has_value());
+
+    lClock->SleepFor(3s);
+    lFake.SendEvent(NL80211_CMD_NEW_SCAN_RESULTS, cInterfaceIndex);
+    std::optional<Request> lDump{lFake.Receive()};
+    ASSERT_TRUE(lDump.has_value());
+    EXPECT_EQ(lDump->mCommand, NL80211_CMD_GET_SCAN);
+    EXPECT_FALSE(lControl.IsScanning());
+
+    lFake.SendBSS(lDump->mSequence, "AccessPoint", cAccessPointBSSID, false, false);
+    lFake.SendBSS(lDump->mSequence, "PSP_AULES12345_L_Match", cPSPBSSID, true, true);
+    // Parts of other dumps do not belong in these results.
+    lFake.SendBSS(lDump->mSequence + 100, "Stray", cAccessPointBSSID, true, false);
+    lFake.SendDone(lDump->mSequence);
+
+    ASSERT_TRUE(WaitUntil([&] { return lControl.GetScanResults()->mGeneration == 2; }));
+    std::shared_ptr<const ScanResults> lResults{lControl.GetScanResults()};
+    ASSERT_EQ(lResults->mNetworks.size(), 2);
+    EXPECT_EQ(lResults->mTime, lClock->Now());
+    EXPECT_EQ(lControl.GetScanResultsAge(), 0s);
+
+    // The network that is joined comes first.
+    EXPECT_EQ(lResults->mNetworks.at(0).ssid, "PSP_AULES12345_L_Match");
+    EXPECT_EQ(lResults->mNetworks.at(0).bssid, cPSPBSSID);
+    EXPECT_EQ(lResults->mNetworks.at(0).frequency, 2412);
+    EXPECT_TRUE(lResults->mNetworks.at(0).isadhoc);
+    EXPECT_TRUE(lResults->mNetworks.at(0).isconnected);
+    EXPECT_EQ(lResults->mNetworks.at(1).ssid, "AccessPoint");
+    EXPECT_FALSE(lResults->mNetworks.at(1).isadhoc);
+    EXPECT_FALSE(lResults->mNetworks.at(1).isconnected);
+
+    // Whoever held on to the previous results still has them as they were.
+    EXPECT_TRUE(lFirstResults->mNetworks.empty());
+
+    std::lock_guard<std::mutex> lLock{lMutex};
+    ASSERT_EQ(lCallbacks.size(), 2);
+    EXPECT_EQ(lCallbacks.back(), lResults);
+}
+
+// Tests whether failed, busy, aborted and lost scans leave the control ready for the next scan
+TEST(Nl80211ControlTest, ScanFailures)
+{
+    auto           lClock{std::make_shared<VirtualClock>()};
+    FakeNl80211    lFake{};
+    Nl80211Control lControl{};
+    lControl.SetClock(lClock);
+    ASSERT_NO_FATAL_FAILURE(OpenControl(lControl, lFake));
+
+    // Someone else is scanning, their results will do.
+    ASSERT_TRUE(lControl.TriggerScan());
+    std::optional<Request> lTrigger{lFake.Receive()};
+    ASSERT_TRUE(lTrigger.has_value());
+    lFake.SendError(lTrigger->mSequence, -EBUSY);
+    lFake.SendEvent(NL80211_CMD_SCAN_ABORTED, cOtherInterfaceIndex);
+    std::this_thread::sleep_for(cQuiet);
+    EXPECT_TRUE(lControl.IsScanning());
+
+    lFake.SendEvent(NL80211_CMD_SCAN_ABORTED, cInterfaceIndex);
+    EXPECT_TRUE(WaitUntil([&] { return !lControl.IsScanning(); }));
+
+    ASSERT_TRUE(lControl.TriggerScan());
+    lTrigger = lFake.Receive();
+    ASSERT_TRUE(lTrigger.has_value());
+    lFake.SendError(lTrigger->mSequence, -ENETDOWN);
+    EXPECT_TRUE(WaitUntil([&] { return !lControl.IsScanning(); }));
+
+    // A scan that never finishes does not block scanning forever.
+    ASSERT_TRUE(lControl.TriggerScan());
+    ASSERT_TRUE(lFake.Receive().has_value());
+    lClock->SleepFor(cScanLostTimeout - 1s);
+    EXPECT_TRUE(lControl.TriggerScan());
+    EXPECT_FALSE(lFake.Receive(cQuiet).has_value());
+    lClock->SleepFor(1s);
+    EXPECT_TRUE(lControl.TriggerScan());
+    EXPECT_TRUE(lFake.Receive().has_value());
+
+    // Scans started by others are followed as well.
+    lFake.SendEvent(NL80211_CMD_NEW_SCAN_RESULTS, cInterfaceIndex);
+    std::optional<Request> lDump{lFake.Receive()};
+    ASSERT_TRUE(lDump.has_value());
+    lFake.SendEvent(NL80211_CMD_TRIGGER_SCAN, cInterfaceIndex);
+    EXPECT_TRUE(WaitUntil([&] { return lControl.IsScanning(); }));
+    lFake.SendDone(lDump->mSequence);
+    EXPECT_TRUE(WaitUntil([&] { return lControl.GetScanResults()->mGeneration == 2; }));
+}
+
+// Tests whether joining and leaving adhoc networks on the adapter is reported
+TEST(Nl80211ControlTest, IBSSEvents)
+{
+    FakeNl80211    lFake{};
+    Nl80211Control lControl{};
+
+    std::vector<IWifiInterface::IBSSEvent> lEvents{};
+    std::mutex                             lMutex{};
+    lControl.SetIBSSCallback([&](const IWifiInterface::IBSSEvent& aEvent) {
+        std::lock_guard<std::mutex> lLock{lMutex};
+        lEvents.push_back(aEvent);
+    });
+    ASSERT_NO_FATAL_FAILURE(OpenControl(lControl, lFake));
+
+    lFake.SendEvent(NL80211_CMD_JOIN_IBSS, cOtherInterfaceIndex, &cAccessPointBSSID);
+    lFake.SendEvent(NL80211_CMD_JOIN_IBSS, cInterfaceIndex, &cPSPBSSID);
+    lFake.SendEvent(NL80211_CMD_LEAVE_IBSS, cInterfaceIndex);
+
+    ASSERT_TRUE(WaitUntil([&] {
+        std::lock_guard<std::mutex> lLock{lMutex};
+        return lEvents.size() >= 2;
+    }));
+    std::lock_guard<std::mutex> lLock{lMutex};
+    ASSERT_EQ(lEvents.size(), 2);
+    EXPECT_TRUE(lEvents.at(0).joined);
+    EXPECT_EQ(lEvents.at(0).bssid, cPSPBSSID);
+    EXPECT_FALSE(lEvents.at(1).joined);
+}
+
+// Tests whether opening fails when nl80211 is not there
+TEST(Nl80211ControlTest, FamilyMissing)
+{
+    FakeNl80211    lFake{};
+    Nl80211Control lControl{};
+    bool           lOpened{true};
+    std::thread    lOpen{[&] { lOpened = lControl.Open(lFake.GetControlSocket(), cInterfaceIndex); }};
+
+    std::optional<Request> lFamilyRequest{lFake.Receive()};
+    if (lFamilyRequest.has_value()) {
+        lFake.SendError(lFamilyRequest->mSequence, -ENOENT);
+    }
+    lOpen.join();
+    EXPECT_FALSE(lOpened);
+    EXPECT_FALSE(lControl.TriggerScan());
+}
@@ -0,0 +1,182 @@
+/* Copyright (c) 2021 [Rick de Bondt] - PCapReader_Test.cpp
+ * This file contains tests for the time accurate replay of the PCapReader class.
+ **/
+
+#include "../Includes/PCapReader.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/Metrics.h"
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/PcapNgWriter.h"
+#include "../Includes/VirtualClock.h"
+#include "TestHelpers.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr unsigned int cFrames{100};
+    constexpr uint32_t     cSnapshotLength{65535};
+
+    // Scheduling on a busy machine can be late by a couple of milliseconds, but it should never add up.
+    constexpr milliseconds cTolerance{5};
+}  // namespace
+
+class PCapReaderTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // Short gaps that have to be spun away and longer ones that can be slept.
+        nanoseconds lTimestamp{seconds(1600000000)};
+        for (unsigned int lCount = 0; lCount < cFrames; lCount++) {
+            mTimestamps.push_back(lTimestamp);
+            lTimestamp += (lCount % 2 == 0) ? nanoseconds(50us) : nanoseconds(3ms);
+        }
+
+        PcapNgWriter lWriter{};
+        ASSERT_TRUE(lWriter.Open(cFileName));
+        uint32_t    lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cSnapshotLength)};
+        std::string lFrame(Net_8023_Constants::cHeaderLength + 64, '\0');
+        memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex,
+               &Net_Constants::cPSPEtherType,
+               Net_8023_Constants::cEtherTypeLength);
+        for (nanoseconds lFrameTimestamp : mTimestamps) {
+            ASSERT_TRUE(lWriter.WritePacket(lInterface, lFrameTimestamp, lFrame));
+        }
+        lWriter.Close();
+
+        mReader.SetConnector(mConnector);
+        ASSERT_TRUE(mReader.Open(cFileName));
+    }
+
+    void TearDown() override
+    {
+        mReader.Close();
+    }
+
+    /**
+     * Replays the capture and waits until it is done.
+     */
+    void Replay()
+    {
+        ASSERT_TRUE(mReader.StartReceiverThread());
+        auto lStart{steady_clock::now()};
+        while (!mReader.IsDoneReceiving() && (steady_clock::now() < lStart + seconds(10))) {
+            std::this_thread::sleep_for(1ms);
+        }
+        ASSERT_TRUE(mReader.IsDoneReceiving());
+    }
+
+    /**
+     * Checks whether frames have been handed over at the time they have been captured at, scaled by the speed.
+     * @param aSpeed - Speed of the replay.
+     * @param aLoops - Times the capture has been replayed.
+     */
+    void ExpectOnTime(double aSpeed, unsigned int aLoops)
+    {
+        std::vector<steady_clock::time_point> lTimes{mConnector->GetTimes()};
+        ASSERT_EQ(lTimes.size(), cFrames * aLoops);
+
+        nanoseconds lDuration{mTimestamps.back() - mTimestamps.front()};
+        nanoseconds lLoopDuration{lDuration + lDuration / (cFrames - 1)};
+        for (std::size_t lIndex = 0; lIndex < lTimes.size(); lIndex++) {
+            nanoseconds lCaptured{(lIndex / cFrames) * lLoopDuration + mTimestamps.at(lIndex % cFrames) -
+                                  mTimestamps.front()};
+            nanoseconds lExpected{duration_cast<nanoseconds>(lCaptured / aSpeed)};
+            nanoseconds lActual{lTimes.at(lIndex) - lTimes.front()};
+
+            // Never early, and never later than the tolerance, also not at the end of the replay.
+            EXPECT_GT(lActual - lExpected, -nanoseconds(100us)) << lIndex;
+            EXPECT_LT(lActual - lExpected, cTolerance) << lIndex;
+        }
+    }
+
+    static constexpr std::string_view cFileName{"../Tests/Output/pcapreader_replay.pcapng"};
+
+    std::shared_ptr<RecordingConnector> mConnector{std::make_shared<RecordingConnector>()};
+    PCapReader                          mReader{false, true};
+    std::vector<nanoseconds>            mTimestamps{};
+};
+
+// Tests whether frames are replayed at the time they have been captured at
+TEST_F(PCapReaderTest, TimeAccurate)
+{
+    uint64_t lScheduled{Metrics::GetInstance().GetSnapshot().Get(Histogram::ReplayScheduleError).mCount};
+
+    Replay();
+    ExpectOnTime(1, 1);
+
+    EXPECT_EQ(Metrics::GetInstance().GetSnapshot().Get(Histogram::ReplayScheduleError).mCount - lScheduled, cFrames);
+}
+
+// Tests whether the speed multiplier scales the gaps between frames
+TEST_F(PCapReaderTest, Speed)
+{
+    mReader.SetReplaySpeed(4);
+    Replay();
+    ExpectOnTime(4, 1);
+}
+
+// Tests whether looping replays the capture again, continuing the timing where the last loop left off
+TEST_F(PCapReaderTest, Loops)
+{
+    mReader.SetReplaySpeed(2);
+    mReader.SetReplayLoops(3);
+    Replay();
+    ExpectOnTime(2, 3);
+}
+
+// Tests whether an endless replay stops when the reader gets closed
+TEST_F(PCapReaderTest, EndlessLoopStopsOnClose)
+{
+    mReader.SetReplaySpeed(cMaximumReplaySpeed);
+    mReader.SetReplayLoops(0);
+    ASSERT_TRUE(mReader.StartReceiverThread());
+    std::this_thread::sleep_for(50ms);
+
+    mReader.Close();
+    EXPECT_TRUE(mReader.IsDoneReceiving());
+    EXPECT_GT(mConnector->GetTimes().size(), cFrames);
+}
+
+// Tests whether looping a single frame capture keeps a cadence instead of sending it as fast as possible
+TEST_F(PCapReaderTest, SingleFrameLoops)
+{
+    constexpr std::string_view cSingleFrameFileName{"../Tests/Output/pcapreader_single_frame.pcapng"};
+    constexpr unsigned int     cLoops{5};
+
+    PcapNgWriter lWriter{};
+    ASSERT_TRUE(lWriter.Open(cSingleFrameFileName));
+    uint32_t    lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cSnapshotLength)};
+    std::string lFrame(Net_8023_Constants::cHeaderLength + 64, '\0');
+    memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex,
+           &Net_Constants::cPSPEtherType,
+           Net_8023_Constants::cEtherTypeLength);
+    ASSERT_TRUE(lWriter.WritePacket(lInterface, seconds(1600000000), lFrame));
+    lWriter.Close();
+
+    // On simulated time, so the gaps between the loops can be checked exactly.
+    std::shared_ptr<VirtualClock>       lClock{std::make_shared<VirtualClock>()};
+    std::shared_ptr<RecordingConnector> lConnector{std::make_shared<RecordingConnector>(lClock)};
+    PCapReader                          lReader{false, true};
+    lReader.SetClock(lClock);
+    lReader.SetConnector(lConnector);
+    lReader.SetReplayLoops(cLoops);
+    ASSERT_TRUE(lReader.Open(cSingleFrameFileName));
+
+    auto lStart{steady_clock::now()};
+    ASSERT_TRUE(lReader.StartReceiverThread());
+    while (!lReader.IsDoneReceiving() && (steady_clock::now() < lStart + seconds(10))) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_TRUE(lReader.IsDoneReceiving());
+    lReader.Close();
+
+    std::vector<steady_clock::time_point> lTimes{lConnector->GetTimes()};
+    ASSERT_EQ(lTimes.size(), cLoops);
+    for (std::size_t lIndex = 1; lIndex < cLoops; lIndex++) {
+        EXPECT_EQ(lTimes.at(lIndex) - lTimes.at(lIndex - 1), cMinimumLoopGap) << lIndex;
+    }
+}
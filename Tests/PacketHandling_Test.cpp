@@ -3,11 +3,16 @@
  **/
 
 
+#include <cstring>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include "../Includes/NetConversionFunctions.h"
+#include "../Includes/NetworkTable.h"
 #include "../Includes/PCapReader.h"
+#include "../Includes/TrafficGenerator.h"
+#include "../Includes/VirtualClock.h"
 #include "../Includes/XLinkKaiConnection.h"
 
 
@@ -15,6 +20,44 @@ using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Return;
 using ::testing::WithArg;
+using namespace std::chrono;
+
+namespace
+{
+    constexpr std::size_t cRadioTapLength{8};
+    constexpr std::size_t cPayloadLength{16};
+
+    // Builds an ad-hoc data frame behind a radiotap header without any fields.
+    std::string MakeDataFrame(uint64_t aSource, uint64_t aBSSID)
+    {
+        std::string lFrame(cRadioTapLength + Net_80211_Constants::cDataHeaderLength + cPayloadLength, '\0');
+        lFrame.at(RadioTap_Constants::cLengthIndex) = static_cast<char>(cRadioTapLength);
+        lFrame.at(cRadioTapLength + Net_80211_Constants::cTypeIndex) =
+            static_cast<char>(Net_80211_Constants::cDataType);
+
+        uint64_t lDestination{Net_Constants::cBroadcastMac};
+        std::memcpy(&lFrame.at(cRadioTapLength + Net_80211_Constants::cDestinationAddressIndex),
+                    &lDestination,
+                    Net_80211_Constants::cDestinationAddressLength);
+        std::memcpy(&lFrame.at(cRadioTapLength + Net_80211_Constants::cSourceAddressIndex),
+                    &aSource,
+                    Net_80211_Constants::cSourceAddressLength);
+        std::memcpy(&lFrame.at(cRadioTapLength + Net_80211_Constants::cBSSIDIndex),
+                    &aBSSID,
+                    Net_80211_Constants::cBSSIDLength);
+        return lFrame;
+    }
+
+    CachedNetwork MakeCachedNetwork(uint64_t aBSSID, uint64_t aPeer)
+    {
+        CachedNetwork lNetwork{};
+        lNetwork.mSSID  = "PSP_AULES00001_L_GameName";
+        lNetwork.mBSSID = aBSSID;
+        lNetwork.mPeers = {aPeer};
+        return lNetwork;
+    }
+}  // namespace
+
 class IConnectorMock : public IConnector
 {
 public:
@@ -32,7 +75,7 @@ class IPCapDeviceMock : public IPCapDevice
 public:
     MOCK_METHOD(void, BlackList, (uint64_t aMac));
     MOCK_METHOD(void, Close, ());
-    MOCK_METHOD(bool, Open, (std::string_view aName, std::vector<std::string>& aSSIDFilter));
+    MOCK_METHOD(bool, Open, (std::string_view aName, const std::vector<std::string>& aSSIDFilter));
     MOCK_METHOD(std::string, DataToString, (const unsigned char* aData, const pcap_pkthdr* aHeader));
     MOCK_METHOD(const unsigned char*, GetData, ());
     MOCK_METHOD(const pcap_pkthdr*, GetHeader, ());
@@ -313,3 +356,156 @@ TEST_F(PacketHandlingTest, ConstructAcknowledgementFrame)
     lPCapReader.Close();
     lPCapExpectedReader.Close();
 }
+
+// Tests whether Handler80211 forwards every PSP network at once, and routes frames back to the network a station is in
+TEST_F(PacketHandlingTest, Handler80211MultiNetwork)
+{
+    TrafficMix lMix{};
+    lMix.mPSPNetworks        = 3;
+    lMix.mVitaNetworks       = 2;
+    lMix.mForeignNetworks    = 4;
+    lMix.mStationsPerNetwork = 4;
+    lMix.mSeed               = 1234;
+    TrafficGenerator lGenerator{lMix};
+
+    std::vector<std::string> lSSIDFilter{"PSP_"};
+    mHandler80211.SetSSIDFilterList(lSSIDFilter);
+    mHandler80211.SetMultiNetwork(true);
+
+    std::array<unsigned int, 3> lForwarded{};
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(10))) {
+        mHandler80211.Update(lFrame.mData);
+
+        // Frames of the first network come through as if it was the only one.
+        if (!lFrame.mEthernet.empty()) {
+            ASSERT_TRUE(mHandler80211.ShouldSend());
+            ASSERT_EQ(mHandler80211.ConvertPacket(), lFrame.mEthernet);
+        }
+        if (mHandler80211.ShouldSend()) {
+            unsigned int lNetwork{0};
+            while ((lNetwork < lForwarded.size()) && (mHandler80211.GetBSSID() != lGenerator.GetBSSID(lNetwork))) {
+                lNetwork++;
+            }
+            ASSERT_LT(lNetwork, lForwarded.size());
+            lForwarded.at(lNetwork)++;
+        }
+    }
+
+    for (unsigned int lForwardedInNetwork : lForwarded) {
+        EXPECT_GT(lForwardedInNetwork, 1000);
+    }
+
+    std::vector<NetworkSession> lSessions{mHandler80211.GetSessions()};
+    ASSERT_EQ(lSessions.size(), 3);
+    for (const NetworkSession& lSession : lSessions) {
+        EXPECT_TRUE(lSession.mConfirmed);
+        EXPECT_TRUE(lSession.mIsAdhoc);
+        EXPECT_EQ(lSession.mSSID.substr(0, 4), "PSP_");
+        EXPECT_EQ(lSession.mParametersData.mFrequency, cFrequency);
+        ASSERT_FALSE(lSession.mPeers.empty());
+
+        // A station gets frames in its own network only.
+        std::array<NetworkRoute, cMaxSessions> lRoutes{};
+        ASSERT_EQ(mHandler80211.GetRoutes(lSession.mPeers.front(), lRoutes), 1);
+        EXPECT_EQ(lRoutes.at(0).mBSSID, lSession.mBSSID);
+    }
+
+    // Broadcasts go to every network.
+    std::array<NetworkRoute, cMaxSessions> lRoutes{};
+    ASSERT_EQ(mHandler80211.GetRoutes(Net_Constants::cBroadcastMac, lRoutes), 3);
+
+    // The first network that came in stays the one that gets cached.
+    EXPECT_NE(mHandler80211.GetLockedBSSID(), 0);
+    EXPECT_EQ(mHandler80211.GetLockedNetwork().mBSSID, mHandler80211.GetLockedBSSID());
+}
+
+// Tests whether a network that stopped sending beacons makes room for a new one once all sessions are in use
+TEST_F(PacketHandlingTest, Handler80211SessionEviction)
+{
+    constexpr uint64_t cPeer{0x0A0000000001};
+
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    std::shared_ptr<NetworkTable> lTable{std::make_shared<NetworkTable>()};
+    lTable->SetClock(lClock);
+    mHandler80211.SetNetworkTable(lTable);
+    mHandler80211.SetMultiNetwork(true);
+
+    for (uint64_t lBSSID = 1; lBSSID <= cMaxSessions; lBSSID++) {
+        lTable->Update(lBSSID, "PSP_AULES00001_L_GameName", 6, 0x16, true, -50);
+    }
+    mHandler80211.SetCachedNetwork(MakeCachedNetwork(1, cPeer));
+    for (uint64_t lBSSID = 2; lBSSID <= cMaxSessions; lBSSID++) {
+        mHandler80211.SetBSSID(lBSSID);
+    }
+    ASSERT_EQ(mHandler80211.GetSessions().size(), cMaxSessions);
+    EXPECT_EQ(mHandler80211.GetLockedBSSID(), 1);
+
+    std::array<NetworkRoute, cMaxSessions> lRoutes{};
+    ASSERT_EQ(mHandler80211.GetRoutes(cPeer, lRoutes), 1);
+    EXPECT_EQ(lRoutes.at(0).mBSSID, 1);
+
+    // Every network is still there, so there is no room.
+    uint64_t lChanges{mHandler80211.GetSessionChanges()};
+    mHandler80211.SetBSSID(cMaxSessions + 1);
+    EXPECT_EQ(mHandler80211.GetSessions().size(), cMaxSessions);
+    EXPECT_EQ(mHandler80211.GetSessionChanges(), lChanges);
+    EXPECT_EQ(mHandler80211.GetRoutes(cPeer, lRoutes), 1);
+
+    // The cached network goes quiet, the others keep sending beacons.
+    lClock->SleepUntil(lClock->Now() + cNetworkMaxAge + seconds(1));
+    for (uint64_t lBSSID = 2; lBSSID <= cMaxSessions + 1; lBSSID++) {
+        lTable->Update(lBSSID, "PSP_AULES00001_L_GameName", 6, 0x16, true, -50);
+    }
+    mHandler80211.SetBSSID(cMaxSessions + 1);
+    EXPECT_GT(mHandler80211.GetSessionChanges(), lChanges);
+
+    std::vector<NetworkSession> lSessions{mHandler80211.GetSessions()};
+    ASSERT_EQ(lSessions.size(), cMaxSessions);
+    for (const NetworkSession& lSession : lSessions) {
+        EXPECT_NE(lSession.mBSSID, 1);
+        EXPECT_TRUE(lSession.mConfirmed);
+    }
+    EXPECT_EQ(mHandler80211.GetLockedBSSID(), cMaxSessions + 1);
+
+    // The peer left with its network, so it is no longer routed to one network only.
+    EXPECT_EQ(mHandler80211.GetRoutes(cPeer, lRoutes), cMaxSessions);
+}
+
+// Tests whether a cached network follows its peers to the BSSID they show up on, until a beacon confirmed it
+TEST_F(PacketHandlingTest, Handler80211SessionMove)
+{
+    constexpr uint64_t cPeer{0x0A0000000001};
+    constexpr uint64_t cCachedBSSID{0x0B0000000001};
+    constexpr uint64_t cNewBSSID{0x0B0000000002};
+    constexpr uint64_t cOtherBSSID{0x0B0000000003};
+
+    mHandler80211.SetMultiNetwork(true);
+    mHandler80211.SetCachedNetwork(MakeCachedNetwork(cCachedBSSID, cPeer));
+    uint64_t lChanges{mHandler80211.GetSessionChanges()};
+
+    mHandler80211.Update(MakeDataFrame(cPeer, cNewBSSID));
+    EXPECT_TRUE(mHandler80211.ShouldSend());
+    EXPECT_GT(mHandler80211.GetSessionChanges(), lChanges);
+    EXPECT_EQ(mHandler80211.GetLockedBSSID(), cNewBSSID);
+
+    std::vector<NetworkSession> lSessions{mHandler80211.GetSessions()};
+    ASSERT_EQ(lSessions.size(), 1);
+    EXPECT_EQ(lSessions.front().mBSSID, cNewBSSID);
+    EXPECT_EQ(lSessions.front().mPeers, std::vector<uint64_t>{cPeer});
+
+    std::array<NetworkRoute, cMaxSessions> lRoutes{};
+    ASSERT_EQ(mHandler80211.GetRoutes(cPeer, lRoutes), 1);
+    EXPECT_EQ(lRoutes.at(0).mBSSID, cNewBSSID);
+
+    // Once confirmed the network stays where it is.
+    mHandler80211.SetBSSID(cNewBSSID);
+    lChanges = mHandler80211.GetSessionChanges();
+    mHandler80211.Update(MakeDataFrame(cPeer, cOtherBSSID));
+    EXPECT_FALSE(mHandler80211.ShouldSend());
+    EXPECT_EQ(mHandler80211.GetSessionChanges(), lChanges);
+    EXPECT_EQ(mHandler80211.GetLockedBSSID(), cNewBSSID);
+
+    lSessions = mHandler80211.GetSessions();
+    ASSERT_EQ(lSessions.size(), 1);
+    EXPECT_EQ(lSessions.front().mBSSID, cNewBSSID);
+}
@@ -0,0 +1,82 @@
+/* Copyright (c) 2021 [Rick de Bondt] - PacketSocket_Test.cpp
+ * This file contains tests for injecting with the PacketSocket class, on the loopback adapter.
+ **/
+
+#include "../Includes/PacketSocket.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+#include "TestHelpers.h"
+
+namespace
+{
+    constexpr std::string_view cLoopbackAdapter{"lo"};
+    constexpr unsigned int     cRounds{3};
+}  // namespace
+
+// Tests whether all frames get injected, with and without TX ring, going around the ring a couple of times
+TEST(PacketSocketTest, Inject)
+{
+    Receiver lReceiver{cLoopbackAdapter, cRingFrameSize};
+    if (!lReceiver.IsOpen()) {
+        GTEST_SKIP() << "Packet sockets need CAP_NET_RAW";
+    }
+
+    for (bool lUseRing : {false, true}) {
+        PacketSocket lSocket{};
+        ASSERT_TRUE(lSocket.Open(cLoopbackAdapter, lUseRing));
+        ASSERT_TRUE(lSocket.IsOpen());
+        ASSERT_EQ(lSocket.UsesRing(), lUseRing);
+
+        // The loopback adapter hands slots back before the frames in them have been received, so every round gets
+        // received before the ring is reused.
+        for (unsigned int lRound = 0; lRound < cRounds; lRound++) {
+            std::vector<std::string> lFrames{};
+            for (unsigned int lIndex = 0; lIndex < cRingFrameCount; lIndex++) {
+                lFrames.push_back(MakeFrame(lRound * cRingFrameCount + lIndex, 64 + lIndex));
+                ASSERT_TRUE(lSocket.Queue(lFrames.back()));
+            }
+            ASSERT_TRUE(lSocket.Flush());
+
+            // Frames have to come out in the order they have been queued in.
+            std::vector<std::string> lReceived{lReceiver.Receive(lFrames.size())};
+            EXPECT_EQ(lReceived.size(), lFrames.size());
+            EXPECT_TRUE(lReceived == lFrames);
+        }
+
+        // A frame too big for a slot of the ring only gets sent without one.
+        std::string lBigFrame{MakeFrame(0, cRingFrameSize)};
+        EXPECT_EQ(lSocket.Queue(lBigFrame), !lUseRing);
+        std::string lFrame{MakeFrame(1, 64)};
+        ASSERT_TRUE(lSocket.Send(lFrame));
+
+        std::vector<std::string> lFrames{lFrame};
+        if (!lUseRing) {
+            lFrames.insert(lFrames.begin(), lBigFrame);
+        }
+        EXPECT_TRUE(lReceiver.Receive(lFrames.size()) == lFrames);
+
+        lSocket.Close();
+        EXPECT_FALSE(lSocket.IsOpen());
+        EXPECT_FALSE(lSocket.UsesRing());
+    }
+}
+#endif
+
+// Tests whether backends can be read from the config file, falling back to pcap
+TEST(PacketSocketTest, ConvertStringToBackend)
+{
+    EXPECT_EQ(PacketSocket::ConvertStringToBackend("pcap"), InjectionBackend::PCap);
+    EXPECT_EQ(PacketSocket::ConvertStringToBackend("packet"), InjectionBackend::Packet);
+    EXPECT_EQ(PacketSocket::ConvertStringToBackend("packet_ring"), InjectionBackend::PacketRing);
+    EXPECT_EQ(PacketSocket::ConvertStringToBackend("something"), InjectionBackend::PCap);
+
+    PacketSocket lSocket{};
+    EXPECT_FALSE(lSocket.Open("no_such_adapter", false));
+    EXPECT_FALSE(lSocket.IsOpen());
+    EXPECT_FALSE(lSocket.Send("frame"));
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+/* Copyright (c) 2021 [Rick de Bondt] - TestHelpers.h
+ *
+ * This file contains helpers shared by the tests: a connector that records what it is asked to send and, on Linux,
+ * building and receiving the ethernet frames the injection tests send.
+ *
+ **/
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Includes/IClock.h"
+#include "../Includes/IConnector.h"
+#include "../Includes/SystemClock.h"
+
+/**
+ * Stands in for XLink Kai, remembers every frame it is asked to send and when that happened.
+ */
+class RecordingConnector : public IConnector
+{
+public:
+    RecordingConnector() : RecordingConnector(std::make_shared<SystemClock>()) {}
+
+    /**
+     * @param aClock - Clock to take the times frames came in from, for example a VirtualClock.
+     */
+    explicit RecordingConnector(std::shared_ptr<IClock> aClock) : mClock(std::move(aClock)) {}
+
+    bool Open(std::string_view /*aArgument*/) override
+    {
+        return true;
+    }
+
+    void Close() override {}
+
+    bool ReadNextData() override
+    {
+        return false;
+    }
+
+    bool Send(std::string_view aData) override
+    {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        mFrames.emplace_back(aData);
+        mTimes.push_back(mClock->Now());
+        return true;
+    }
+
+    void SetIncomingConnection(std::shared_ptr<IPCapDevice> /*aDevice*/) override {}
+
+    bool StartReceiverThread() override
+    {
+        return true;
+    }
+
+    std::vector<std::string> GetFrames()
+    {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        return mFrames;
+    }
+
+    std::vector<std::chrono::steady_clock::time_point> GetTimes()
+    {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        return mTimes;
+    }
+
+private:
+    std::shared_ptr<IClock>                            mClock{nullptr};
+    std::vector<std::string>                           mFrames{};
+    std::vector<std::chrono::steady_clock::time_point> mTimes{};
+    std::mutex                                         mMutex{};
+};
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../Includes/NetworkingHeaders.h"
+
+namespace TestHelpers_Constants
+{
+    // Local experimental EtherType, so only the frames sent by the tests get received.
+    static constexpr uint16_t cEtherType{0x88B5};
+    static constexpr int      cReceiveTimeoutMs{1000};
+    // Everything the socket under test sends at once gets sent before anything gets received, so the receive buffer
+    // has to hold it all.
+    static constexpr int      cReceiveBufferSize{8 * 1024 * 1024};
+}  // namespace TestHelpers_Constants
+
+using namespace TestHelpers_Constants;
+
+/**
+ * Builds a broadcast test frame.
+ * @param aIndex - Number of the frame, stored right after the header.
+ * @param aLength - Length of the frame.
+ * @return the frame.
+ */
+inline std::string MakeFrame(unsigned int aIndex, std::size_t aLength)
+{
+    std::string lFrame(aLength, '\0');
+    uint16_t    lEtherType{htons(cEtherType)};
+    memset(lFrame.data() + Net_8023_Constants::cDestinationAddressIndex,
+           0xFF,
+           Net_8023_Constants::cDestinationAddressLength);
+    memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex, &lEtherType, sizeof(lEtherType));
+    memcpy(lFrame.data() + Net_8023_Constants::cHeaderLength, &aIndex, sizeof(aIndex));
+    return lFrame;
+}
+
+/**
+ * @param aFrame - The frame to check.
+ * @return true if the frame has been built by MakeFrame.
+ */
+inline bool IsTestFrame(std::string_view aFrame)
+{
+    uint16_t lEtherType{htons(cEtherType)};
+    return (aFrame.size() >= Net_8023_Constants::cHeaderLength) &&
+           (aFrame.substr(Net_8023_Constants::cEtherTypeIndex, sizeof(lEtherType)) ==
+            std::string_view(reinterpret_cast<const char*>(&lEtherType), sizeof(lEtherType)));
+}
+
+/**
+ * Receives the test frames on an adapter.
+ */
+class Receiver
+{
+public:
+    /**
+     * @param aAdapter - Adapter to receive on.
+     * @param aFrameSize - Size of the biggest frame that can come in.
+     */
+    Receiver(std::string_view aAdapter, std::size_t aFrameSize) :
+        mSocket(socket(AF_PACKET, SOCK_RAW, htons(cEtherType))), mFrameSize(aFrameSize)
+    {
+        sockaddr_ll lAddress{};
+        lAddress.sll_family   = AF_PACKET;
+        lAddress.sll_protocol = htons(cEtherType);
+        lAddress.sll_ifindex  = static_cast<int>(if_nametoindex(std::string(aAdapter).c_str()));
+        setsockopt(mSocket, SOL_SOCKET, SO_RCVBUFFORCE, &cReceiveBufferSize, sizeof(cReceiveBufferSize));
+        if ((mSocket != -1) && (bind(mSocket, reinterpret_cast<sockaddr*>(&lAddress), sizeof(lAddress)) != 0)) {
+            close(mSocket);
+            mSocket = -1;
+        }
+    }
+
+    ~Receiver()
+    {
+        if (mSocket != -1) {
+            close(mSocket);
+        }
+    }
+
+    Receiver(const Receiver& aReceiver) = delete;
+    Receiver& operator=(const Receiver& aReceiver) = delete;
+
+    [[nodiscard]] bool IsOpen() const
+    {
+        return mSocket != -1;
+    }
+
+    /**
+     * Receives frames until the expected amount came in, or none came in for a while.
+     * @param aCount - Amount of frames expected.
+     * @return the frames received, in the order they came in.
+     */
+    std::vector<std::string> Receive(std::size_t aCount)
+    {
+        std::vector<std::string> lReturn{};
+        std::string              lBuffer(mFrameSize, '\0');
+        pollfd                   lPoll{mSocket, POLLIN, 0};
+
+        while ((lReturn.size() < aCount) && (poll(&lPoll, 1, cReceiveTimeoutMs) > 0)) {
+            ssize_t lLength{recv(mSocket, lBuffer.data(), lBuffer.size(), 0)};
+            if (lLength > 0) {
+                lReturn.emplace_back(lBuffer.substr(0, static_cast<std::size_t>(lLength)));
+            }
+        }
+
+        return lReturn;
+    }
+
+private:
+    int         mSocket{-1};
+    std::size_t mFrameSize{0};
+};
+#endif
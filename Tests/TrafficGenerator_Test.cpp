@@ -0,0 +1,105 @@
+/* Copyright (c) 2021 [Rick de Bondt] - TrafficGenerator_Test.cpp
+ * This file contains tests for the synthetic traffic generator, and uses it to test Handler80211 at scale.
+ **/
+
+#include "../Includes/TrafficGenerator.h"
+
+#include <gtest/gtest.h>
+
+#include "../Includes/Handler80211.h"
+#include "../Includes/RadioTapReader.h"
+#include "../Includes/XLinkKaiConnection.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    TrafficMix MakeBusyMix()
+    {
+        TrafficMix lMix{};
+        lMix.mPSPNetworks        = 3;
+        lMix.mVitaNetworks       = 2;
+        lMix.mForeignNetworks    = 4;
+        lMix.mStationsPerNetwork = 4;
+        lMix.mSeed               = 1234;
+        return lMix;
+    }
+}  // namespace
+
+// Tests whether the same seed gives the same traffic, in capture order
+TEST(TrafficGeneratorTest, Deterministic)
+{
+    TrafficGenerator lFirst{MakeBusyMix()};
+    TrafficGenerator lSecond{MakeBusyMix()};
+
+    std::vector<GeneratedFrame> lFrames{lFirst.Generate(seconds(1))};
+    std::vector<GeneratedFrame> lSameFrames{lSecond.Generate(seconds(1))};
+
+    ASSERT_FALSE(lFrames.empty());
+    ASSERT_EQ(lFrames.size(), lSameFrames.size());
+    for (std::size_t lIndex = 0; lIndex < lFrames.size(); lIndex++) {
+        EXPECT_EQ(lFrames.at(lIndex).mData, lSameFrames.at(lIndex).mData);
+        if (lIndex > 0) {
+            EXPECT_GE(lFrames.at(lIndex).mTimestamp, lFrames.at(lIndex - 1).mTimestamp);
+        }
+    }
+}
+
+// Tests whether the mix contains every frame type and every radiotap layout can be read
+TEST(TrafficGeneratorTest, Mix)
+{
+    TrafficGenerator lGenerator{MakeBusyMix()};
+
+    std::array<unsigned int, cFrameTypeCount> lTypes{};
+    RadioTapReader                            lReader{};
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(5))) {
+        lTypes.at(static_cast<std::size_t>(lFrame.mType))++;
+
+        lReader.FillRadioTapParameters(lFrame.mData);
+        ASSERT_GT(lReader.GetLength(), 0);
+        ASSERT_LT(lReader.GetLength(), lFrame.mData.size());
+        EXPECT_EQ(lReader.GetFrequency(), cFrequency);
+    }
+
+    for (std::size_t lType = 0; lType < cFrameTypeCount; lType++) {
+        EXPECT_GT(lTypes.at(lType), 0) << cFrameTypeTexts.at(lType);
+    }
+
+    // Roughly 60 game frames per second per player, 20 players in ad-hoc networks.
+    EXPECT_NEAR(lTypes.at(static_cast<std::size_t>(FrameType::Data)) +
+                    lTypes.at(static_cast<std::size_t>(FrameType::QoSData)),
+                5 * (20 * 60 + 4 * 200),
+                1000);
+}
+
+// Tests whether Handler80211 forwards exactly the frames of the network it is locked on, converted correctly
+TEST(TrafficGeneratorTest, Handler80211AtScale)
+{
+    TrafficGenerator lGenerator{MakeBusyMix()};
+    Handler80211     lHandler{PhysicalDeviceHeaderType::RadioTap};
+
+    std::vector<std::string> lSSIDFilter{std::string(lGenerator.GetSSID(0))};
+    lHandler.SetSSIDFilterList(lSSIDFilter);
+
+    unsigned int lForwarded{0};
+    for (const GeneratedFrame& lFrame : lGenerator.Generate(seconds(10))) {
+        lHandler.Update(lFrame.mData);
+
+        ASSERT_EQ(lHandler.ShouldSend(), !lFrame.mEthernet.empty())
+            << cFrameTypeTexts.at(static_cast<std::size_t>(lFrame.mType)) << " at " << lFrame.mTimestamp.count();
+        if (lHandler.ShouldSend()) {
+            ASSERT_EQ(lHandler.ConvertPacket(), lFrame.mEthernet);
+            lForwarded++;
+        }
+    }
+
+    EXPECT_EQ(lHandler.GetLockedBSSID(), lGenerator.GetBSSID(0));
+    EXPECT_GT(lForwarded, 2000);
+}
+
+// Tests whether the frames for XLink Kai are put in e;e; datagrams
+TEST(TrafficGeneratorTest, KaiDatagram)
+{
+    std::string lDatagram{TrafficGenerator::ToKaiDatagram("frame")};
+    EXPECT_EQ(lDatagram, cEthernetDataString + "frame");
+}
@@ -0,0 +1,169 @@
+/* Copyright (c) 2021 [Rick de Bondt] - VirtualClock_Test.cpp
+ * This file contains tests for the VirtualClock class and for running timers of the engine on simulated time.
+ **/
+
+#include "../Includes/VirtualClock.h"
+
+#include <boost/asio.hpp>
+#include <gtest/gtest.h>
+
+#include "../Includes/Metrics.h"
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/PCapReader.h"
+#include "../Includes/PcapNgWriter.h"
+#include "../Includes/XLinkKaiConnection.h"
+#include "TestHelpers.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr unsigned int cFrames{24};
+    constexpr uint32_t     cSnapshotLength{65535};
+}  // namespace
+
+// Tests whether events run in order of time, and events at the same time in the order they were scheduled in
+TEST(VirtualClockTest, Order)
+{
+    VirtualClock                          lClock{};
+    std::vector<int>                      lOrder{};
+    std::vector<steady_clock::time_point> lTimes{};
+    auto lEvent = [&](int aNumber) {
+        return [&, aNumber] {
+            lOrder.push_back(aNumber);
+            lTimes.push_back(lClock.Now());
+        };
+    };
+
+    lClock.Schedule(steady_clock::time_point{3s}, lEvent(1));
+    lClock.Schedule(steady_clock::time_point{1s}, lEvent(2));
+    lClock.Schedule(steady_clock::time_point{1s}, lEvent(3));
+    lClock.ScheduleIn(2s, lEvent(4));
+    EXPECT_EQ(lClock.GetPendingEvents(), 4);
+
+    lClock.Run();
+
+    EXPECT_EQ(lOrder, (std::vector<int>{2, 3, 4, 1}));
+    EXPECT_EQ(lTimes,
+              (std::vector<steady_clock::time_point>{
+                  steady_clock::time_point{1s}, steady_clock::time_point{1s}, steady_clock::time_point{2s},
+                  steady_clock::time_point{3s}}));
+    EXPECT_EQ(lClock.GetPendingEvents(), 0);
+    EXPECT_FALSE(lClock.RunNext());
+}
+
+// Tests whether waiting on the clock runs the events that are due and then jumps to the deadline
+TEST(VirtualClockTest, SleepRunsDueEvents)
+{
+    VirtualClock lClock{};
+    unsigned int lRuns{0};
+
+    // Event that keeps rescheduling itself every 3 seconds.
+    std::function<void()> lRepeat = [&] {
+        lRuns++;
+        lClock.ScheduleIn(3s, lRepeat);
+    };
+    lClock.ScheduleIn(3s, lRepeat);
+
+    lClock.SleepFor(10s);
+    EXPECT_EQ(lRuns, 3);
+    EXPECT_EQ(lClock.Now(), steady_clock::time_point{10s});
+
+    // Events scheduled in the past run right away.
+    bool lRan{false};
+    lClock.Schedule(steady_clock::time_point{1s}, [&] { lRan = true; });
+    EXPECT_TRUE(lClock.RunNext());
+    EXPECT_TRUE(lRan);
+    EXPECT_EQ(lClock.Now(), steady_clock::time_point{10s});
+
+    lClock.Run(steady_clock::time_point{30s});
+    EXPECT_EQ(lRuns, 10);
+    EXPECT_EQ(lClock.Now(), steady_clock::time_point{30s});
+    EXPECT_EQ(lClock.GetPendingEvents(), 1);
+}
+
+// Tests whether a capture with hours between frames replays in simulated time, frame for frame on the exact time
+TEST(VirtualClockTest, PCapReaderReplay)
+{
+    constexpr std::string_view cFileName{"../Tests/Output/virtualclock_replay.pcapng"};
+
+    std::vector<nanoseconds> lTimestamps{};
+    nanoseconds              lTimestamp{seconds(1600000000)};
+    for (unsigned int lCount = 0; lCount < cFrames; lCount++) {
+        lTimestamps.push_back(lTimestamp);
+        lTimestamp += (lCount % 2 == 0) ? nanoseconds(1h) : nanoseconds(250us);
+    }
+
+    PcapNgWriter lWriter{};
+    ASSERT_TRUE(lWriter.Open(cFileName));
+    uint32_t    lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cSnapshotLength)};
+    std::string lFrame(Net_8023_Constants::cHeaderLength + 64, '\0');
+    memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex,
+           &Net_Constants::cPSPEtherType,
+           Net_8023_Constants::cEtherTypeLength);
+    for (nanoseconds lFrameTimestamp : lTimestamps) {
+        ASSERT_TRUE(lWriter.WritePacket(lInterface, lFrameTimestamp, lFrame));
+    }
+    lWriter.Close();
+
+    std::shared_ptr<VirtualClock>       lClock{std::make_shared<VirtualClock>()};
+    std::shared_ptr<RecordingConnector> lConnector{std::make_shared<RecordingConnector>(lClock)};
+    PCapReader                          lReader{false, true};
+    lReader.SetClock(lClock);
+    lReader.SetConnector(lConnector);
+    lReader.SetReplaySpeed(2);
+    ASSERT_TRUE(lReader.Open(cFileName));
+
+    // Twelve hours of traffic, which should not take more than a blink.
+    auto lStart{steady_clock::now()};
+    ASSERT_TRUE(lReader.StartReceiverThread());
+    while (!lReader.IsDoneReceiving() && (steady_clock::now() < lStart + seconds(10))) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_TRUE(lReader.IsDoneReceiving());
+    lReader.Close();
+
+    std::vector<steady_clock::time_point> lTimes{lConnector->GetTimes()};
+    ASSERT_EQ(lTimes.size(), cFrames);
+    for (std::size_t lIndex = 0; lIndex < cFrames; lIndex++) {
+        EXPECT_EQ(lTimes.at(lIndex) - lTimes.front(), (lTimestamps.at(lIndex) - lTimestamps.front()) / 2) << lIndex;
+    }
+}
+
+// Tests whether the XLink Kai connection times out and reconnects on simulated time
+TEST(VirtualClockTest, KaiConnectionTimeout)
+{
+    boost::asio::io_service        lIoService{};
+    boost::asio::ip::udp::socket   lFakeKai{lIoService, {boost::asio::ip::address::from_string("127.0.0.1"), 0}};
+    std::array<char, 1024>         lBuffer{};
+    boost::asio::ip::udp::endpoint lSender{};
+
+    std::shared_ptr<VirtualClock> lClock{std::make_shared<VirtualClock>()};
+    XLinkKaiConnection            lConnection{};
+    lConnection.SetClock(lClock);
+    ASSERT_TRUE(lConnection.Open("127.0.0.1", lFakeKai.local_endpoint().port()));
+    ASSERT_TRUE(lConnection.Connect());
+
+    std::size_t lLength{lFakeKai.receive_from(boost::asio::buffer(lBuffer), lSender)};
+    EXPECT_EQ(std::string_view(lBuffer.data(), lLength), cConnectString);
+
+    // Nothing happens before the timeout.
+    lClock->SleepFor(cConnectionTimeout);
+    EXPECT_EQ(lConnection.HandleTimers(), steady_clock::duration::zero());
+
+    // XLink Kai never answered, so it should back off and try again.
+    lClock->SleepFor(1s);
+    EXPECT_EQ(lConnection.HandleTimers(), cConnectRetryDelay);
+    EXPECT_EQ(Metrics::GetInstance().GetSnapshot().Get(Gauge::KaiLinkState),
+              static_cast<int64_t>(KaiLinkState::Disconnected));
+
+    lClock->SleepFor(cConnectRetryDelay);
+    EXPECT_EQ(lConnection.HandleTimers(), cReconnectDelay);
+    EXPECT_EQ(Metrics::GetInstance().GetSnapshot().Get(Gauge::KaiLinkState),
+              static_cast<int64_t>(KaiLinkState::Connecting));
+    lLength = lFakeKai.receive_from(boost::asio::buffer(lBuffer), lSender);
+    EXPECT_EQ(std::string_view(lBuffer.data(), lLength), cConnectString);
+    EXPECT_EQ(lClock->Now(), steady_clock::time_point{cConnectionTimeout + 1s + cConnectRetryDelay});
+
+    lConnection.Close();
+}
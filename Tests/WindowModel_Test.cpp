@@ -67,4 +67,10 @@ TEST_F(WindowModelTest, LoadModel)
     EXPECT_EQ(mWindowModel.mXLinkPort, WindowModel_Constants::cDefaultXLinkPort);
     EXPECT_EQ(mWindowModel.mAcknowledgeDataFrames, WindowModel_Constants::cDefaultAcknowledgeDataFrames);
     EXPECT_EQ(mWindowModel.mOnlyAcceptFromMac, WindowModel_Constants::cDefaultOnlyAcceptFromMac);
+    EXPECT_EQ(mWindowModel.mMetricsPort, WindowModel_Constants::cDefaultMetricsPort);
+    EXPECT_EQ(mWindowModel.mSlowFrameBudget, WindowModel_Constants::cDefaultSlowFrameBudget);
+    EXPECT_EQ(mWindowModel.mKaiRecording, WindowModel_Constants::cDefaultKaiRecording);
+    EXPECT_EQ(mWindowModel.mMultiNetwork, WindowModel_Constants::cDefaultMultiNetwork);
+    EXPECT_EQ(mWindowModel.mInjectionAdapter, WindowModel_Constants::cDefaultInjectionAdapter);
+    EXPECT_EQ(mWindowModel.mInjectionBackend, WindowModel_Constants::cDefaultInjectionBackend);
 }
\ No newline at end of file
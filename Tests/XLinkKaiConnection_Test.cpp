@@ -0,0 +1,154 @@
+/* Copyright (c) 2021 [Rick de Bondt] - XLinkKaiConnection_Test.cpp
+ * This file contains tests for feeding XLinkKaiConnection from multiple capture devices at once.
+ **/
+
+#include "../Includes/XLinkKaiConnection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include <gtest/gtest.h>
+
+#include "../Benchmarks/FakeKaiEngine.h"
+#include "../Includes/Metrics.h"
+#include "../Includes/NetworkingHeaders.h"
+#include "../Includes/PCapReader.h"
+#include "../Includes/PcapNgWriter.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    constexpr unsigned int cAdapters{2};
+    constexpr unsigned int cFramesPerAdapter{100};
+    constexpr unsigned int cKaiFrames{10};
+    constexpr uint32_t     cSnapshotLength{65535};
+    constexpr seconds      cTimeout{10};
+    constexpr milliseconds cPollInterval{10};
+    constexpr milliseconds cDrain{200};
+
+    constexpr std::array<std::string_view, cAdapters> cCaptureFileNames{"../Tests/Output/AdapterOne.pcapng",
+                                                                        "../Tests/Output/AdapterTwo.pcapng"};
+    // A station playing on every adapter, and one only known to XLink Kai.
+    constexpr std::array<std::string_view, cAdapters> cStations{std::string_view("\x02\x00\x00\x00\x00\x01", 6),
+                                                                std::string_view("\x02\x00\x00\x00\x00\x02", 6)};
+    constexpr std::string_view                        cKaiStation{"\x02\x00\x00\x00\x00\x03", 6};
+    constexpr std::string_view                        cBroadcast{"\xff\xff\xff\xff\xff\xff", 6};
+
+    std::string MakeFrame(std::string_view aDestination, std::string_view aSource)
+    {
+        std::string lFrame(Net_8023_Constants::cHeaderLength + 64, '\0');
+        memcpy(lFrame.data() + Net_8023_Constants::cDestinationAddressIndex, aDestination.data(), aDestination.size());
+        memcpy(lFrame.data() + Net_8023_Constants::cSourceAddressIndex, aSource.data(), aSource.size());
+        memcpy(lFrame.data() + Net_8023_Constants::cEtherTypeIndex,
+               &Net_Constants::cPSPEtherType,
+               Net_8023_Constants::cEtherTypeLength);
+        return lFrame;
+    }
+
+    /**
+     * Stands in for a capture adapter: replays a capture as if it was captured, and keeps everything it is asked to
+     * send.
+     */
+    class AdapterReader : public PCapReader
+    {
+    public:
+        AdapterReader() : PCapReader(false, false) {}
+
+        bool Send(std::string_view aData) override
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            mFrames.emplace_back(aData);
+            return true;
+        }
+
+        std::vector<std::string> GetFrames()
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            return mFrames;
+        }
+
+    private:
+        std::vector<std::string> mFrames{};
+        std::mutex               mMutex{};
+    };
+
+    bool WaitFor(const std::function<bool()>& aCondition)
+    {
+        auto lStart{steady_clock::now()};
+        while (!aCondition() && (steady_clock::now() < lStart + cTimeout)) {
+            std::this_thread::sleep_for(cPollInterval);
+        }
+        return aCondition();
+    }
+
+    std::size_t CountFramesFor(const std::vector<std::string>& aFrames, std::string_view aDestination)
+    {
+        return std::count_if(aFrames.begin(), aFrames.end(), [&](const std::string& aFrame) {
+            return std::string_view(aFrame).substr(Net_8023_Constants::cDestinationAddressIndex,
+                                                   Net_8023_Constants::cDestinationAddressLength) == aDestination;
+        });
+    }
+}  // namespace
+
+// Tests whether the frames of multiple adapters all reach XLink Kai, and frames from XLink Kai go out on the adapter
+// the station they are for has been heard on
+TEST(XLinkKaiConnectionTest, MultipleAdapters)
+{
+    FakeKaiEngine lEngine{};
+    ASSERT_TRUE(lEngine.Start(0));
+
+    auto lConnection{std::make_shared<XLinkKaiConnection>()};
+    ASSERT_TRUE(lConnection->Open(cIp, lEngine.GetPort()));
+
+    std::array<std::shared_ptr<AdapterReader>, cAdapters> lAdapters{};
+    for (unsigned int lIndex = 0; lIndex < cAdapters; lIndex++) {
+        PcapNgWriter lWriter{};
+        ASSERT_TRUE(lWriter.Open(cCaptureFileNames.at(lIndex)));
+        uint32_t    lInterface{lWriter.AddInterface(PcapNgWriter_Constants::cLinkTypeEthernet, cSnapshotLength)};
+        std::string lFrame{MakeFrame(cBroadcast, cStations.at(lIndex))};
+        for (unsigned int lCount = 0; lCount < cFramesPerAdapter; lCount++) {
+            ASSERT_TRUE(lWriter.WritePacket(lInterface, seconds(1600000000) + milliseconds(lCount), lFrame));
+        }
+        lWriter.Close();
+
+        lAdapters.at(lIndex) = std::make_shared<AdapterReader>();
+        ASSERT_TRUE(lAdapters.at(lIndex)->Open(cCaptureFileNames.at(lIndex)));
+        lAdapters.at(lIndex)->SetConnector(lConnection->AddIncomingConnection(lAdapters.at(lIndex)));
+    }
+
+    // Frames captured before XLink Kai confirmed the connection would not be sent.
+    lConnection->StartReceiverThread();
+    ASSERT_TRUE(WaitFor([&] {
+        return lEngine.IsConnected() && (Metrics::GetInstance().GetSnapshot().Get(Gauge::KaiLinkState) ==
+                                         static_cast<int64_t>(KaiLinkState::Connected));
+    }));
+
+    // Every adapter captures on its own thread.
+    for (const auto& lAdapter : lAdapters) {
+        ASSERT_TRUE(lAdapter->StartReceiverThread());
+    }
+    EXPECT_TRUE(WaitFor([&] { return lEngine.GetReceived().mFrames == cAdapters * cFramesPerAdapter; }));
+
+    // A station heard on one adapter only gets its frames there.
+    lEngine.Blast(MakeFrame(cStations.at(1), cKaiStation), cKaiFrames, 0, 1);
+    EXPECT_TRUE(WaitFor([&] { return lAdapters.at(1)->GetFrames().size() == cKaiFrames; }));
+
+    // Anything else goes out on every adapter.
+    lEngine.Blast(MakeFrame(cBroadcast, cKaiStation), cKaiFrames, 0, 1);
+    EXPECT_TRUE(WaitFor([&] { return lAdapters.at(0)->GetFrames().size() == cKaiFrames; }));
+    EXPECT_TRUE(WaitFor([&] { return lAdapters.at(1)->GetFrames().size() == 2 * cKaiFrames; }));
+    std::this_thread::sleep_for(cDrain);
+
+    EXPECT_EQ(CountFramesFor(lAdapters.at(0)->GetFrames(), cStations.at(1)), 0);
+    EXPECT_EQ(CountFramesFor(lAdapters.at(0)->GetFrames(), cBroadcast), cKaiFrames);
+    EXPECT_EQ(CountFramesFor(lAdapters.at(1)->GetFrames(), cStations.at(1)), cKaiFrames);
+    EXPECT_EQ(CountFramesFor(lAdapters.at(1)->GetFrames(), cBroadcast), cKaiFrames);
+
+    for (const auto& lAdapter : lAdapters) {
+        lAdapter->Close();
+    }
+    lConnection->Close();
+    lEngine.Stop();
+}
@@ -0,0 +1,340 @@
+/* Copyright (c) 2021 [Rick de Bondt] - XdpSocket_Test.cpp
+ * This file contains tests for capturing and injecting over AF_XDP with the XdpSocket and XdpMonitorDevice classes, on
+ * a veth pair created for the test.
+ **/
+
+#include "../Includes/XdpSocket.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/veth.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../Includes/Metrics.h"
+#include "../Includes/PacketSocket.h"
+#include "../Includes/TrafficGenerator.h"
+#include "../Includes/XdpMonitorDevice.h"
+#include "TestHelpers.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    // The XDP socket goes on the first adapter, frames are sent and received with packet sockets on its peer.
+    constexpr std::string_view cXdpAdapter{"xlhaxdp0"};
+    constexpr std::string_view cPeerAdapter{"xlhaxdp1"};
+    // Fits every generated monitor mode frame, which a veth pair would otherwise refuse.
+    constexpr uint32_t         cMtu{3000};
+    constexpr unsigned int     cBatch{64};
+    constexpr unsigned int     cRounds{8};
+    constexpr seconds          cTimeout{5};
+    constexpr milliseconds     cPollInterval{1};
+    constexpr unsigned int     cDeviceRounds{2};
+
+    /**
+     * Builds and sends rtnetlink messages, to create and delete the veth pair.
+     */
+    class RouteMessage
+    {
+    public:
+        RouteMessage(uint16_t aType, uint16_t aFlags, int aIndex)
+        {
+            nlmsghdr lHeader{};
+            lHeader.nlmsg_type  = aType;
+            lHeader.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | aFlags;
+            Append(&lHeader, sizeof(lHeader));
+            AddInterface(aIndex);
+        }
+
+        /**
+         * Adds the interface info every link message starts with, an existing interface gets brought up. A veth pair
+         * cannot be brought up while it is being created, as the ends do not know each other yet.
+         * @param aIndex - Index of the interface, 0 to create one.
+         */
+        void AddInterface(int aIndex)
+        {
+            ifinfomsg lInterface{};
+            lInterface.ifi_family = AF_UNSPEC;
+            lInterface.ifi_index  = aIndex;
+            lInterface.ifi_flags  = (aIndex != 0) ? IFF_UP : 0;
+            lInterface.ifi_change = IFF_UP;
+            Append(&lInterface, sizeof(lInterface));
+        }
+
+        void AddAttribute(uint16_t aType, const void* aData, std::size_t aLength)
+        {
+            rtattr lAttribute{};
+            lAttribute.rta_type = aType;
+            lAttribute.rta_len  = static_cast<uint16_t>(RTA_LENGTH(aLength));
+            Append(&lAttribute, sizeof(lAttribute));
+            Append(aData, aLength);
+        }
+
+        void AddString(uint16_t aType, std::string_view aText)
+        {
+            AddAttribute(aType, std::string(aText).c_str(), aText.size() + 1);
+        }
+
+        /**
+         * Starts an attribute that holds other attributes.
+         * @return where it starts, to pass to EndNested.
+         */
+        std::size_t StartNested(uint16_t aType)
+        {
+            std::size_t lReturn{mMessage.size()};
+            AddAttribute(aType, nullptr, 0);
+            return lReturn;
+        }
+
+        void EndNested(std::size_t aStart)
+        {
+            auto* lAttribute{reinterpret_cast<rtattr*>(mMessage.data() + aStart)};
+            lAttribute->rta_len = static_cast<uint16_t>(mMessage.size() - aStart);
+        }
+
+        /**
+         * Sends the message to the kernel.
+         * @return true if the kernel accepted it.
+         */
+        bool Send()
+        {
+            bool lReturn{false};
+            int  lSocket{socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)};
+
+            reinterpret_cast<nlmsghdr*>(mMessage.data())->nlmsg_len = static_cast<uint32_t>(mMessage.size());
+            if ((lSocket != -1) && (send(lSocket, mMessage.data(), mMessage.size(), 0) != -1)) {
+                std::array<char, 4096> lResponse{};
+                ssize_t                lLength{recv(lSocket, lResponse.data(), lResponse.size(), 0)};
+                auto*                  lHeader{reinterpret_cast<nlmsghdr*>(lResponse.data())};
+                if ((lLength >= static_cast<ssize_t>(NLMSG_LENGTH(sizeof(nlmsgerr)))) &&
+                    (lHeader->nlmsg_type == NLMSG_ERROR)) {
+                    lReturn = (reinterpret_cast<nlmsgerr*>(NLMSG_DATA(lHeader))->error == 0);
+                }
+            }
+
+            if (lSocket != -1) {
+                close(lSocket);
+            }
+
+            return lReturn;
+        }
+
+    private:
+        void Append(const void* aData, std::size_t aLength)
+        {
+            const auto* lData{static_cast<const char*>(aData)};
+            mMessage.append(lData, lData + aLength);
+            mMessage.resize(NLMSG_ALIGN(mMessage.size()), '\0');
+        }
+
+        std::string mMessage{};
+    };
+
+    template<typename Condition> bool WaitFor(Condition aCondition)
+    {
+        auto lStart{steady_clock::now()};
+        bool lReturn{aCondition()};
+        while (!lReturn && (steady_clock::now() < lStart + cTimeout)) {
+            std::this_thread::sleep_for(cPollInterval);
+            lReturn = aCondition();
+        }
+        return lReturn;
+    }
+}  // namespace
+
+class XdpSocketTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        RouteMessage lMessage{RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL, 0};
+        lMessage.AddString(IFLA_IFNAME, cXdpAdapter);
+        lMessage.AddAttribute(IFLA_MTU, &cMtu, sizeof(cMtu));
+        std::size_t lLinkInfo{lMessage.StartNested(IFLA_LINKINFO)};
+        lMessage.AddString(IFLA_INFO_KIND, "veth");
+        std::size_t lData{lMessage.StartNested(IFLA_INFO_DATA)};
+        std::size_t lPeer{lMessage.StartNested(VETH_INFO_PEER)};
+        lMessage.AddInterface(0);
+        lMessage.AddString(IFLA_IFNAME, cPeerAdapter);
+        lMessage.AddAttribute(IFLA_MTU, &cMtu, sizeof(cMtu));
+        lMessage.EndNested(lPeer);
+        lMessage.EndNested(lData);
+        lMessage.EndNested(lLinkInfo);
+
+        if (!lMessage.Send()) {
+            GTEST_SKIP() << "Creating a veth pair needs CAP_NET_ADMIN";
+        }
+        mCreated = true;
+
+        for (std::string_view lAdapter : {cXdpAdapter, cPeerAdapter}) {
+            RouteMessage lUp{RTM_SETLINK, 0, static_cast<int>(if_nametoindex(lAdapter.data()))};
+            ASSERT_TRUE(lUp.Send());
+        }
+        ASSERT_TRUE(mPeer.Open(cPeerAdapter, false));
+    }
+
+    void TearDown() override
+    {
+        mPeer.Close();
+        if (mCreated) {
+            // Deleting one end deletes the pair.
+            RouteMessage lMessage{RTM_DELLINK, 0, static_cast<int>(if_nametoindex(cXdpAdapter.data()))};
+            EXPECT_TRUE(lMessage.Send());
+        }
+    }
+
+    bool         mCreated{false};
+    PacketSocket mPeer{};
+};
+
+// Tests whether frames sent to the adapter all end up in the UMEM, going around the frames to receive into a couple of
+// times
+TEST_F(XdpSocketTest, Receive)
+{
+    XdpSocket lSocket{};
+    ASSERT_TRUE(lSocket.Open(cXdpAdapter));
+    ASSERT_TRUE(lSocket.IsOpen());
+
+    std::vector<std::string> lReceived{};
+    auto                     lCallback{[&](std::string_view aFrame) {
+        if (IsTestFrame(aFrame)) {
+            lReceived.emplace_back(aFrame);
+        }
+    }};
+
+    std::vector<std::string> lFrames{};
+    for (unsigned int lRound = 0; lRound < cRounds; lRound++) {
+        for (unsigned int lIndex = 0; lIndex < cBatch; lIndex++) {
+            lFrames.push_back(MakeFrame(lRound * cBatch + lIndex, 64 + lIndex));
+            ASSERT_TRUE(mPeer.Send(lFrames.back()));
+        }
+        EXPECT_TRUE(WaitFor([&] {
+            lSocket.Receive(lCallback, milliseconds(0));
+            return lReceived.size() == lFrames.size();
+        }));
+    }
+
+    // A single queue hands frames over in the order they have been sent in.
+    EXPECT_TRUE(lReceived == lFrames);
+
+    // Closing detaches the program, so frames reach the network stack again.
+    lSocket.Close();
+    EXPECT_FALSE(lSocket.IsOpen());
+    EXPECT_EQ(lSocket.Receive(lCallback, milliseconds(0)), 0);
+
+    // The kernel lets go of the queue in the background, reopening right away has to wait for that.
+    EXPECT_TRUE(lSocket.Open(cXdpAdapter));
+}
+
+// Tests whether all frames get sent, in batches and one by one, going around the frames to send from a couple of times
+TEST_F(XdpSocketTest, Send)
+{
+    Receiver  lReceiver{cPeerAdapter, cUmemFrameSize};
+    XdpSocket lSocket{};
+    ASSERT_TRUE(lSocket.Open(cXdpAdapter));
+
+    for (unsigned int lRound = 0; lRound < cRounds; lRound++) {
+        std::vector<std::string> lFrames{};
+        for (unsigned int lIndex = 0; lIndex < cBatch; lIndex++) {
+            lFrames.push_back(MakeFrame(lRound * cBatch + lIndex, 64 + lIndex));
+            // Every other round sends right away.
+            ASSERT_TRUE(((lRound % 2) == 0) ? lSocket.Queue(lFrames.back()) : lSocket.Send(lFrames.back()));
+        }
+        ASSERT_TRUE(lSocket.Flush());
+
+        EXPECT_TRUE(lReceiver.Receive(lFrames.size()) == lFrames);
+    }
+
+    // More frames than there are to send from get queued by kicking the kernel in between.
+    std::vector<std::string> lFrames{};
+    for (unsigned int lIndex = 0; lIndex < cSendFrameCount + cBatch; lIndex++) {
+        lFrames.push_back(MakeFrame(lIndex, 64));
+        ASSERT_TRUE(lSocket.Queue(lFrames.back()));
+    }
+    ASSERT_TRUE(lSocket.Flush());
+    EXPECT_TRUE(lReceiver.Receive(lFrames.size()) == lFrames);
+
+    EXPECT_FALSE(lSocket.Queue(std::string(cUmemFrameSize + 1, '\0')));
+}
+
+// Tests whether monitor mode frames captured over AF_XDP go through the handler to XLink Kai like they do with pcap
+TEST_F(XdpSocketTest, MonitorDevice)
+{
+    TrafficMix lMix{};
+    lMix.mForeignNetworks    = 1;
+    lMix.mStationsPerNetwork = 2;
+
+    TrafficGenerator            lGenerator{lMix};
+    std::vector<GeneratedFrame> lFrames{lGenerator.Generate(milliseconds(500))};
+
+    // What a device forwards when fed the frames straight from pcap, the first round locks onto the network.
+    auto          lReference{std::make_shared<RecordingConnector>()};
+    MonitorDevice lReferenceDevice{};
+    lReferenceDevice.SetConnector(lReference);
+    for (unsigned int lRound = 0; lRound < cDeviceRounds; lRound++) {
+        for (const GeneratedFrame& lFrame : lFrames) {
+            pcap_pkthdr lHeader{};
+            lHeader.caplen = lFrame.mData.size();
+            lHeader.len    = lFrame.mData.size();
+            lReferenceDevice.ReadCallback(reinterpret_cast<const unsigned char*>(lFrame.mData.data()), &lHeader);
+        }
+    }
+    std::vector<std::string> lExpected{lReference->GetFrames()};
+    ASSERT_FALSE(lExpected.empty());
+
+    auto                     lConnector{std::make_shared<RecordingConnector>()};
+    XdpMonitorDevice         lDevice{};
+    std::vector<std::string> lSSIDFilter{};
+    lDevice.SetConnector(lConnector);
+    ASSERT_TRUE(lDevice.Open(cXdpAdapter, lSSIDFilter));
+    ASSERT_TRUE(lDevice.StartReceiverThread());
+
+    for (unsigned int lRound = 0; lRound < cDeviceRounds; lRound++) {
+        for (std::size_t lStart = 0; lStart < lFrames.size(); lStart += cBatch) {
+            // Waits for every batch, so no frame gets dropped because the receiver thread fell behind.
+            std::size_t lEnd{std::min<std::size_t>(lStart + cBatch, lFrames.size())};
+            uint64_t    lReceived{Metrics::GetInstance().GetSnapshot().Get(Counter::AirFramesReceived)};
+            for (std::size_t lIndex = lStart; lIndex < lEnd; lIndex++) {
+                ASSERT_TRUE(mPeer.Send(lFrames.at(lIndex).mData));
+            }
+            EXPECT_TRUE(WaitFor([&] {
+                return Metrics::GetInstance().GetSnapshot().Get(Counter::AirFramesReceived) >=
+                       lReceived + (lEnd - lStart);
+            }));
+        }
+    }
+
+    EXPECT_TRUE(WaitFor([&] { return lConnector->GetFrames().size() == lExpected.size(); }));
+    std::vector<std::string> lForwarded{lConnector->GetFrames()};
+    EXPECT_TRUE(lForwarded == lExpected);
+
+    // Frames to the air go out on the adapter.
+    Receiver    lReceiver{cPeerAdapter, cUmemFrameSize};
+    std::string lFrame{MakeFrame(0, 128)};
+    EXPECT_TRUE(lDevice.Send(lFrame));
+    EXPECT_TRUE(lReceiver.Receive(1) == std::vector<std::string>{lFrame});
+
+    lDevice.Close();
+}
+#endif
+
+// Tests whether opening fails cleanly where it cannot work
+TEST(XdpSocketErrorTest, Open)
+{
+    XdpSocket lSocket{};
+    EXPECT_FALSE(lSocket.Open("no_such_adapter"));
+    EXPECT_FALSE(lSocket.IsOpen());
+    EXPECT_FALSE(lSocket.Send("frame"));
+    EXPECT_FALSE(lSocket.Open("lo", cMaxQueues));
+}
@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -10,12 +13,19 @@
 #include "Includes/IPCapDevice.h"
 #undef timeout
 
+#include "Includes/FlightRecorder.h"
+#include "Includes/LatencyTrace.h"
 #include "Includes/Logger.h"
+#include "Includes/MetricsServer.h"
 #include "Includes/MonitorDevice.h"
 #include "Includes/NetConversionFunctions.h"
+#include "Includes/NetworkCache.h"
+#include "Includes/PacketSocket.h"
+#include "Includes/SystemClock.h"
 #include "Includes/UserInterface/WindowController.h"
 #include "Includes/WirelessPSPPluginDevice.h"
 #include "Includes/XLinkKaiConnection.h"
+#include "Includes/XdpMonitorDevice.h"
 namespace
 {
     constexpr std::string_view cLogFileName{"log.txt"};
@@ -23,6 +33,10 @@ namespace
     constexpr std::string_view cVitaSSIDFilterName{"SCE_"};
     constexpr bool             cLogToDisk{true};
     constexpr std::string_view cConfigFileName{"config.txt"};
+    // Multiple adapters can feed the engine, for example "wlan0,xdp:wlan1,plugin:wlan2".
+    constexpr char             cAdapterSeparator{','};
+    constexpr std::string_view cPluginAdapterPrefix{"plugin:"};
+    constexpr std::string_view cXdpAdapterPrefix{"xdp:"};
 
     // Indicates if the program should be running or not, used to gracefully exit the program.
     bool gRunning{true};
@@ -49,13 +63,98 @@ bool InitNPcapDLLPath()
 #endif
 
 
-static void SignalHandler(const boost::system::error_code& aError, int aSignalNumber)
+static void SignalHandler(boost::asio::signal_set* aSignals, const boost::system::error_code& aError, int aSignalNumber)
 {
     if (!aError) {
         if (aSignalNumber == SIGINT || aSignalNumber == SIGTERM) {
             // Quit gracefully.
             gRunning = false;
         }
+#if not defined(_WIN32) && not defined(_WIN64)
+        else if (aSignalNumber == SIGUSR1) {
+            // Dump what the engine has seen lately, then keep listening for signals.
+            FlightRecorder::GetInstance().Dump("sigusr1");
+            aSignals->async_wait([aSignals](const boost::system::error_code& aNextError, int aNextSignalNumber) {
+                SignalHandler(aSignals, aNextError, aNextSignalNumber);
+            });
+        }
+#endif
+    }
+}
+
+/**
+ * Makes sure there is a device of the right kind for every adapter in the settings, devices that are still of the
+ * right kind are kept.
+ * @param aModel - Settings to use.
+ * @param aNetworkCache - Cache the devices look up and store networks in.
+ * @param aDevices - Devices, one for every adapter after this.
+ * @param aAdapters - Filled in with the names of the adapters, without prefix.
+ */
+static void SetUpDevices(WindowModel&                               aModel,
+                         const std::shared_ptr<NetworkCache>&       aNetworkCache,
+                         std::vector<std::shared_ptr<IPCapDevice>>& aDevices,
+                         std::vector<std::string>&                  aAdapters)
+{
+    std::istringstream lAdapters{aModel.mWifiAdapter};
+    std::string        lAdapter{};
+
+    aAdapters.clear();
+    while (getline(lAdapters, lAdapter, cAdapterSeparator)) {
+        aAdapters.push_back(lAdapter);
+    }
+    // Without adapters the device picks one itself, like it always did.
+    if (aAdapters.empty()) {
+        aAdapters.emplace_back();
+    }
+    aDevices.resize(aAdapters.size());
+
+    // Injection adapters pair up with the capture adapters in the same position, empty ones inject on the capture one.
+    std::istringstream       lInjectionAdapters{aModel.mInjectionAdapter};
+    std::vector<std::string> lInjectionNames{};
+    while (getline(lInjectionAdapters, lAdapter, cAdapterSeparator)) {
+        lInjectionNames.push_back(lAdapter);
+    }
+    lInjectionNames.resize(aAdapters.size());
+    InjectionBackend lBackend{PacketSocket::ConvertStringToBackend(aModel.mInjectionBackend)};
+
+    for (std::size_t lIndex = 0; lIndex < aAdapters.size(); lIndex++) {
+        std::string&                  lName{aAdapters.at(lIndex)};
+        std::shared_ptr<IPCapDevice>& lDevice{aDevices.at(lIndex)};
+
+        // If we are using a PSP plugin device set up normal WiFi adapter
+        bool lUsePSPPlugin{aModel.mUsePSPPlugin};
+        bool lUseXdp{false};
+        if (lName.starts_with(cPluginAdapterPrefix)) {
+            lName.erase(0, cPluginAdapterPrefix.size());
+            lUsePSPPlugin = true;
+        } else if (lName.starts_with(cXdpAdapterPrefix)) {
+            lName.erase(0, cXdpAdapterPrefix.size());
+            lUseXdp = true;
+        }
+
+        if (lUsePSPPlugin) {
+            if (std::dynamic_pointer_cast<WirelessPSPPluginDevice>(lDevice) == nullptr) {
+                lDevice = std::make_shared<WirelessPSPPluginDevice>();
+                std::dynamic_pointer_cast<WirelessPSPPluginDevice>(lDevice)->SetNetworkCache(aNetworkCache);
+            }
+            // These can be changed in the options while the device is kept, so apply them on every start.
+            std::dynamic_pointer_cast<WirelessPSPPluginDevice>(lDevice)->SetInjectionBackend(lBackend);
+        } else {
+            if ((std::dynamic_pointer_cast<MonitorDevice>(lDevice) == nullptr) ||
+                ((std::dynamic_pointer_cast<XdpMonitorDevice>(lDevice) != nullptr) != lUseXdp)) {
+                lDevice = lUseXdp ? std::make_shared<XdpMonitorDevice>() : std::make_shared<MonitorDevice>();
+                std::shared_ptr<MonitorDevice> lMonitorDevice = std::dynamic_pointer_cast<MonitorDevice>(lDevice);
+                lMonitorDevice->SetSourceMACToFilter(MacToInt(aModel.mOnlyAcceptFromMac));
+                lMonitorDevice->SetAcknowledgePackets(aModel.mAcknowledgeDataFrames);
+                lMonitorDevice->SetMultiNetwork(aModel.mMultiNetwork);
+                lMonitorDevice->SetNetworkTable(aModel.mNetworkTable);
+                lMonitorDevice->SetNetworkCache(aNetworkCache);
+            }
+            // These can be changed in the options while the device is kept, so apply them on every start.
+            std::shared_ptr<MonitorDevice> lMonitorDevice = std::dynamic_pointer_cast<MonitorDevice>(lDevice);
+            lMonitorDevice->SetInjectionAdapter(lInjectionNames.at(lIndex));
+            lMonitorDevice->SetInjectionBackend(lBackend);
+        }
     }
 }
 
@@ -86,27 +185,64 @@ int main(int /*argc*/, char* argv[])
     // Handle quit signals gracefully.
     boost::asio::io_service lSignalIoService{};
     boost::asio::signal_set lSignals(lSignalIoService, SIGINT, SIGTERM);
-    lSignals.async_wait(&SignalHandler);
+#if not defined(_WIN32) && not defined(_WIN64)
+    // Dump the flight recorder on request.
+    lSignals.add(SIGUSR1);
+#endif
+    lSignals.async_wait([lSignals = &lSignals](const boost::system::error_code& aError, int aSignalNumber) {
+        SignalHandler(lSignals, aError, aSignalNumber);
+    });
     std::thread lThread{[lIoService = &lSignalIoService] { lIoService->run(); }};
     WindowModel mWindowModel{};
     mWindowModel.LoadFromFile(lProgramPath + cConfigFileName.data());
 
     Logger::GetInstance().Init(mWindowModel.mLogLevel, cLogToDisk, lProgramPath + cLogFileName.data());
+    FlightRecorder::GetInstance().Init(cDefaultFrameCount, lProgramPath);
+
+    try {
+        LatencyTrace::SetSlowFrameBudget(std::chrono::microseconds(std::stoi(mWindowModel.mSlowFrameBudget)));
+    } catch (const std::exception& lException) {
+        Logger::GetInstance().Log("Invalid slow frame budget: " + std::string(lException.what()), Logger::Level::ERROR);
+    }
+
+    // Only serve metrics when a port has been configured.
+    MetricsServer lMetricsServer{};
+    if (!mWindowModel.mMetricsPort.empty()) {
+        try {
+            lMetricsServer.Start(std::stoi(mWindowModel.mMetricsPort));
+        } catch (const std::exception& lException) {
+            Logger::GetInstance().Log("Invalid metrics port: " + std::string(lException.what()), Logger::Level::ERROR);
+        }
+    }
 
     std::vector<std::string> lSSIDFilters{};
     WindowController         lWindowController(mWindowModel);
     lWindowController.SetUp();
 
-    std::shared_ptr<IPCapDevice>        lDevice{nullptr};
-    std::shared_ptr<XLinkKaiConnection> lXLinkKaiConnection{std::make_shared<XLinkKaiConnection>()};
+    std::vector<std::shared_ptr<IPCapDevice>> lDevices{};
+    std::vector<std::string>                  lAdapters{};
+    std::shared_ptr<XLinkKaiConnection>       lXLinkKaiConnection{std::make_shared<XLinkKaiConnection>()};
+
+    // Networks of earlier sessions, so the engine can get back into them without waiting for a scan or beacon.
+    std::shared_ptr<NetworkCache> lNetworkCache{std::make_shared<NetworkCache>()};
+    lNetworkCache->LoadFromFile(lProgramPath + cNetworkCacheFileName.data());
 
     bool lSuccess{false};
 
     // If we need more entry methods, make an actual state machine
-    bool                                               lWaitEntry{true};
-    std::chrono::time_point<std::chrono::system_clock> lWaitStart{std::chrono::seconds{0}};
+    std::shared_ptr<IClock>               lClock{std::make_shared<SystemClock>()};
+    bool                                  lWaitEntry{true};
+    std::chrono::steady_clock::time_point lWaitStart{};
+    WindowModel_Constants::EngineStatus   lLastEngineStatus{mWindowModel.mEngineStatus};
 
     while (gRunning) {
+        // Keep the frames that led up to the error around for later inspection.
+        if ((mWindowModel.mEngineStatus == WindowModel_Constants::EngineStatus::Error) &&
+            (lLastEngineStatus != WindowModel_Constants::EngineStatus::Error)) {
+            FlightRecorder::GetInstance().Dump("engine-error");
+        }
+        lLastEngineStatus = mWindowModel.mEngineStatus;
+
         if (lWindowController.Process()) {
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
             switch (mWindowModel.mCommand) {
@@ -115,22 +251,18 @@ int main(int /*argc*/, char* argv[])
                         Logger::GetInstance().SetLogLevel(mWindowModel.mLogLevel);
                     }
 
-                    // If we are using a PSP plugin device set up normal WiFi adapter
-                    if (mWindowModel.mUsePSPPlugin) {
-                        if (std::dynamic_pointer_cast<WirelessPSPPluginDevice>(lDevice) == nullptr) {
-                            lDevice = std::make_shared<WirelessPSPPluginDevice>();
-                        }
+                    SetUpDevices(mWindowModel, lNetworkCache, lDevices, lAdapters);
+
+                    // A single device sends straight to XLink Kai, multiple devices get their frames merged.
+                    if (lDevices.size() == 1) {
+                        lXLinkKaiConnection->SetIncomingConnection(lDevices.front());
+                        lDevices.front()->SetConnector(lXLinkKaiConnection);
                     } else {
-                        if (std::dynamic_pointer_cast<MonitorDevice>(lDevice) == nullptr) {
-                            lDevice = std::make_shared<MonitorDevice>();
-                            std::shared_ptr<MonitorDevice> lMonitorDevice =
-                                std::dynamic_pointer_cast<MonitorDevice>(lDevice);
-                            lMonitorDevice->SetSourceMACToFilter(MacToInt(mWindowModel.mOnlyAcceptFromMac));
-                            lMonitorDevice->SetAcknowledgePackets(mWindowModel.mAcknowledgeDataFrames);
+                        lXLinkKaiConnection->SetIncomingConnection(nullptr);
+                        for (const auto& lDevice : lDevices) {
+                            lDevice->SetConnector(lXLinkKaiConnection->AddIncomingConnection(lDevice));
                         }
                     }
-                    lXLinkKaiConnection->SetIncomingConnection(lDevice);
-                    lDevice->SetConnector(lXLinkKaiConnection);
 
                     // If we are auto discovering PSP/VITA networks add those to the filter list
                     if (mWindowModel.mAutoDiscoverPSPVitaNetworks) {
@@ -145,10 +277,25 @@ int main(int /*argc*/, char* argv[])
                         lSuccess = lXLinkKaiConnection->Open("");
                     }
 
-                    // Now set up the wifi interface
+                    // Keep what XLink Kai sends, so the session can be replayed later.
+                    if (lSuccess && !mWindowModel.mKaiRecording.empty()) {
+                        lXLinkKaiConnection->StartRecording(mWindowModel.mKaiRecording);
+                    }
+
+                    // Now set up the wifi interfaces, every device captures on its own thread.
                     if (lSuccess) {
-                        if (lDevice->Open(mWindowModel.mWifiAdapter, lSSIDFilters)) {
-                            if (lDevice->StartReceiverThread() && lXLinkKaiConnection->StartReceiverThread()) {
+                        bool lOpened{true};
+                        for (std::size_t lIndex = 0; lIndex < lDevices.size(); lIndex++) {
+                            lOpened = lOpened && lDevices.at(lIndex)->Open(lAdapters.at(lIndex), lSSIDFilters);
+                        }
+
+                        if (lOpened) {
+                            bool lStarted{true};
+                            for (const auto& lDevice : lDevices) {
+                                lStarted = lStarted && lDevice->StartReceiverThread();
+                            }
+
+                            if (lStarted && lXLinkKaiConnection->StartReceiverThread()) {
                                 mWindowModel.mEngineStatus = WindowModel_Constants::EngineStatus::Running;
                                 mWindowModel.mCommand      = WindowModel_Constants::Command::NoCommand;
                             } else {
@@ -177,28 +324,42 @@ int main(int /*argc*/, char* argv[])
                 case WindowModel_Constants::Command::WaitForTime:
                     // Wait state, use this to add a delay without making the UI unresponsive.
                     if (lWaitEntry) {
-                        lWaitStart = std::chrono::system_clock::now();
+                        lWaitStart = lClock->Now();
                         lWaitEntry = false;
                     }
 
-                    if (std::chrono::system_clock::now() > lWaitStart + mWindowModel.mTimeToWait) {
+                    if (lClock->Now() > lWaitStart + mWindowModel.mTimeToWait) {
                         mWindowModel.mCommand = mWindowModel.mCommandAfterWait;
                         lWaitEntry            = true;
                     }
                     break;
                 case WindowModel_Constants::Command::StopEngine:
                     lXLinkKaiConnection->Close();
-                    lDevice->Close();
+                    for (const auto& lDevice : lDevices) {
+                        lDevice->Close();
+                    }
                     lSSIDFilters.clear();
+                    // The device stored the network it was in when closed.
+                    lNetworkCache->SaveToFile(lProgramPath + cNetworkCacheFileName.data());
 
                     mWindowModel.mEngineStatus = WindowModel_Constants::EngineStatus::Idle;
                     mWindowModel.mCommand      = WindowModel_Constants::Command::NoCommand;
                     break;
                 case WindowModel_Constants::Command::StartSearchNetworks:
-                    // TODO: implement.
+                    // Networks are found in the beacons the engine captures, so there is nothing to start here.
+                    if ((mWindowModel.mEngineStatus != WindowModel_Constants::EngineStatus::Running) ||
+                        std::none_of(lDevices.begin(), lDevices.end(), [](const auto& aDevice) {
+                            return std::dynamic_pointer_cast<MonitorDevice>(aDevice) != nullptr;
+                        })) {
+                        Logger::GetInstance().Log("Networks are only found while the engine runs in monitor mode",
+                                                  Logger::Level::INFO);
+                    }
+                    mWindowModel.mSearchingNetworks = true;
+                    mWindowModel.mCommand           = WindowModel_Constants::Command::NoCommand;
                     break;
                 case WindowModel_Constants::Command::StopSearchNetworks:
-                    // TODO: implement.
+                    mWindowModel.mSearchingNetworks = false;
+                    mWindowModel.mCommand           = WindowModel_Constants::Command::NoCommand;
                     break;
                 case WindowModel_Constants::Command::SaveSettings:
                     mWindowModel.SaveToFile(cConfigFileName);
@@ -211,6 +372,16 @@ int main(int /*argc*/, char* argv[])
         }
     }
 
+    // Remember the network the engine is in for the next start.
+    if (mWindowModel.mEngineStatus == WindowModel_Constants::EngineStatus::Running) {
+        lXLinkKaiConnection->Close();
+        for (const auto& lDevice : lDevices) {
+            lDevice->Close();
+        }
+        lNetworkCache->SaveToFile(lProgramPath + cNetworkCacheFileName.data());
+    }
+
+    lMetricsServer.Stop();
     lSignalIoService.stop();
     if (lThread.joinable()) {
         lThread.join();